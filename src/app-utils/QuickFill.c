@@ -32,11 +32,18 @@
 #include "gnc-ui-util.h"
 
 
+typedef struct
+{
+    guint key;           /* upper-cased next character         */
+    QuickFill *qf;
+} QuickFillMatch;
+
 struct _QuickFill
 {
     char *text;          /* the first matching text string     */
     int len;             /* number of chars in text string     */
-    GHashTable *matches; /* array of children in the tree      */
+    guint n_matches;     /* number of children in the tree     */
+    QuickFillMatch *matches; /* children, sorted by key        */
 };
 
 
@@ -69,7 +76,8 @@ gnc_quickfill_new (void)
     qf->text = NULL;
     qf->len = 0;
 
-    qf->matches = g_hash_table_new (g_direct_hash, g_direct_equal);
+    qf->n_matches = 0;
+    qf->matches = NULL;
 
     return qf;
 }
@@ -77,11 +85,17 @@ gnc_quickfill_new (void)
 /********************************************************************\
 \********************************************************************/
 
-static gboolean
-destroy_helper (gpointer key, gpointer value, gpointer data)
+static void
+destroy_matches (QuickFill *qf)
 {
-    gnc_quickfill_destroy (value);
-    return TRUE;
+    guint i;
+
+    for (i = 0; i < qf->n_matches; i++)
+        gnc_quickfill_destroy (qf->matches[i].qf);
+
+    g_free (qf->matches);
+    qf->matches = NULL;
+    qf->n_matches = 0;
 }
 
 void
@@ -90,9 +104,7 @@ gnc_quickfill_destroy (QuickFill *qf)
     if (qf == NULL)
         return;
 
-    g_hash_table_foreach (qf->matches, (GHFunc)destroy_helper, NULL);
-    g_hash_table_destroy (qf->matches);
-    qf->matches = NULL;
+    destroy_matches (qf);
 
     if (qf->text)
         CACHE_REMOVE(qf->text);
@@ -108,7 +120,7 @@ gnc_quickfill_purge (QuickFill *qf)
     if (qf == NULL)
         return;
 
-    g_hash_table_foreach_remove (qf->matches, destroy_helper, NULL);
+    destroy_matches (qf);
 
     if (qf->text)
         CACHE_REMOVE (qf->text);
@@ -131,6 +143,37 @@ gnc_quickfill_string (QuickFill *qf)
 /********************************************************************\
 \********************************************************************/
 
+/* Returns the position of 'key' among the children of 'qf', or where
+ * it would be inserted if it isn't there. */
+static guint
+quickfill_find_match (QuickFill *qf, guint key)
+{
+    guint lo = 0, hi = qf->n_matches;
+
+    while (lo < hi)
+    {
+        guint mid = lo + (hi - lo) / 2;
+
+        if (qf->matches[mid].key < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+static QuickFill *
+quickfill_lookup (QuickFill *qf, guint key)
+{
+    guint i = quickfill_find_match (qf, key);
+
+    if (i < qf->n_matches && qf->matches[i].key == key)
+        return qf->matches[i].qf;
+
+    return NULL;
+}
+
 QuickFill *
 gnc_quickfill_get_char_match (QuickFill *qf, gunichar uc)
 {
@@ -140,7 +183,7 @@ gnc_quickfill_get_char_match (QuickFill *qf, gunichar uc)
 
     DEBUG ("xaccGetQuickFill(): index = %u\n", key);
 
-    return g_hash_table_lookup (qf->matches, GUINT_TO_POINTER (key));
+    return quickfill_lookup (qf, key);
 }
 
 /********************************************************************\
@@ -187,14 +230,6 @@ gnc_quickfill_get_string_match (QuickFill *qf, const char *str)
 /********************************************************************\
 \********************************************************************/
 
-static void
-unique_len_helper (gpointer key, gpointer value, gpointer data)
-{
-    QuickFill **qf_p = data;
-
-    *qf_p = value;
-}
-
 QuickFill *
 gnc_quickfill_get_unique_len_match (QuickFill *qf, int *length)
 {
@@ -206,16 +241,12 @@ gnc_quickfill_get_unique_len_match (QuickFill *qf, int *length)
 
     while (1)
     {
-        guint count;
-
-        count = g_hash_table_size (qf->matches);
-
-        if (count != 1)
+        if (qf->n_matches != 1)
         {
             return qf;
         }
 
-        g_hash_table_foreach (qf->matches, unique_len_helper, &qf);
+        qf = qf->matches[0].qf;
 
         if (length != NULL)
             (*length)++;
@@ -264,11 +295,19 @@ quickfill_insert_recursive (QuickFill *qf, const char *text, int depth,
     key_char_uc = g_utf8_get_char (key_char);
     key = g_unichar_toupper (key_char_uc);
 
-    match_qf = g_hash_table_lookup (qf->matches, GUINT_TO_POINTER (key));
+    match_qf = quickfill_lookup (qf, key);
     if (match_qf == NULL)
     {
+        guint i = quickfill_find_match (qf, key);
+
         match_qf = gnc_quickfill_new ();
-        g_hash_table_insert (qf->matches, GUINT_TO_POINTER (key), match_qf);
+
+        qf->matches = g_renew (QuickFillMatch, qf->matches, qf->n_matches + 1);
+        memmove (&qf->matches[i + 1], &qf->matches[i],
+                 (qf->n_matches - i) * sizeof (QuickFillMatch));
+        qf->matches[i].key = key;
+        qf->matches[i].qf = match_qf;
+        qf->n_matches++;
     }
 
     old_text = match_qf->text;
@@ -331,10 +370,8 @@ struct _BestText
 };
 
 static void
-best_text_helper (gpointer key, gpointer value, gpointer user_data)
+best_text_helper (QuickFill *qf, struct _BestText *best)
 {
-    QuickFill *qf = value;
-    struct _BestText *best = user_data;
 
     if (best->text == NULL)
     {
@@ -380,7 +417,7 @@ gnc_quickfill_remove_recursive (QuickFill *qf, const gchar *text, gint depth,
         key_char_uc = g_utf8_get_char (key_char);
         key = g_unichar_toupper (key_char_uc);
 
-        match_qf = g_hash_table_lookup (qf->matches, GUINT_TO_POINTER (key));
+        match_qf = quickfill_lookup (qf, key);
         if (match_qf)
         {
             /* remove text from child qf */
@@ -389,7 +426,11 @@ gnc_quickfill_remove_recursive (QuickFill *qf, const gchar *text, gint depth,
             if (match_qf->text == NULL)
             {
                 /* text was the only word with a prefix up to match_qf */
-                g_hash_table_remove (qf->matches, GUINT_TO_POINTER (key));
+                guint i = quickfill_find_match (qf, key);
+
+                qf->n_matches--;
+                memmove (&qf->matches[i], &qf->matches[i + 1],
+                         (qf->n_matches - i) * sizeof (QuickFillMatch));
                 gnc_quickfill_destroy (match_qf);
 
             }
@@ -421,14 +462,16 @@ gnc_quickfill_remove_recursive (QuickFill *qf, const gchar *text, gint depth,
         }
         else
         {
-            if (g_hash_table_size (qf->matches) != 0)
+            if (qf->n_matches != 0)
             {
                 /* otherwise search for another good text */
                 struct _BestText bts;
+                guint i;
                 bts.text = NULL;
                 bts.sort = sort;
 
-                g_hash_table_foreach (qf->matches, (GHFunc) best_text_helper, &bts);
+                for (i = 0; i < qf->n_matches; i++)
+                    best_text_helper (qf->matches[i].qf, &bts);
                 best_text = bts.text;
                 best_len = (best_text == NULL) ? 0 : g_utf8_strlen (best_text, -1);
             }
@@ -253,27 +253,34 @@ add_event_type (ComponentEventInfo *cei, QofIdTypeConst entity_type,
 }
 
 static void
-gnc_cm_event_handler (QofInstance *entity,
-                      QofEventId event_type,
-                      gpointer user_data,
-                      gpointer event_data)
+gnc_cm_event_handler (const QofEventChange *entity_changes,
+                      guint n_changes,
+                      gpointer user_data)
 {
-    const GncGUID *guid = qof_entity_get_guid(entity);
+    guint i;
+
+    /* Refresh once for the whole set of changes */
+    for (i = 0; i < n_changes; i++)
+    {
+        QofInstance *entity = entity_changes[i].entity;
+        QofEventId event_type = entity_changes[i].events;
+        const GncGUID *guid = qof_entity_get_guid(entity);
 #if CM_DEBUG
-    fprintf (stderr, "event_handler: event %d, entity %p, guid %s\n", event_type,
-             entity, guid_to_string(guid));
+        fprintf (stderr, "event_handler: event %d, entity %p, guid %s\n", event_type,
+                 entity, guid_to_string(guid));
 #endif
-    add_event (&changes, guid, event_type, TRUE);
+        add_event (&changes, guid, event_type, TRUE);
 
-    if (QOF_CHECK_TYPE(entity, GNC_ID_SPLIT))
-    {
-        /* split events are never generated by the engine, but might
-         * be generated by a backend (viz. the postgres backend.)
-         * Handle them like a transaction modify event. */
-        add_event_type (&changes, GNC_ID_TRANS, QOF_EVENT_MODIFY, TRUE);
+        if (QOF_CHECK_TYPE(entity, GNC_ID_SPLIT))
+        {
+            /* split events are never generated by the engine, but might
+             * be generated by a backend (viz. the postgres backend.)
+             * Handle them like a transaction modify event. */
+            add_event_type (&changes, GNC_ID_TRANS, QOF_EVENT_MODIFY, TRUE);
+        }
+        else
+            add_event_type (&changes, entity->e_type, event_type, TRUE);
     }
-    else
-        add_event_type (&changes, entity->e_type, event_type, TRUE);
 
     got_events = TRUE;
 
@@ -298,7 +305,7 @@ gnc_component_manager_init (void)
     changes_backup.event_masks = g_hash_table_new (g_str_hash, g_str_equal);
     changes_backup.entity_events = guid_hash_table_new ();
 
-    handler_id = qof_event_register_handler (gnc_cm_event_handler, NULL);
+    handler_id = qof_event_register_batch_handler (gnc_cm_event_handler, NULL);
 }
 
 void
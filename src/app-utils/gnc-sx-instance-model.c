@@ -255,8 +255,171 @@ _get_vars_helper(Transaction *txn, void *var_hash_data)
     return 0;
 }
 
-Account*
-gnc_sx_get_template_transaction_account(const SchedXaction *sx)
+/* What is known about a single SX, kept across instance models and
+ * cash flow forecasts until the SX, its template transactions or the
+ * accounts those refer to change. */
+typedef struct
+{
+    GncGUID sx_guid;
+    QofBook *book;
+    GncGUID template_guid;
+    /* SxCacheAccount: the accounts named by the template splits */
+    GArray *accounts;
+    /* the variables of the template transactions, without values */
+    GHashTable *variable_names;
+    /* SxCashflowSplit: the cash flow of a single occurrence */
+    GList *cashflow;
+    gboolean cashflow_valid;
+    /* the dates of the occurrences still to come, as far as computed */
+    GArray *occurrences;
+    SXTmpStateData *occur_state;
+    gboolean occur_complete;
+} SxCache;
+
+typedef struct
+{
+    GncGUID guid;
+    gboolean found;
+    gnc_commodity *commodity;
+} SxCacheAccount;
+
+typedef struct
+{
+    /* GStrings of the errors met evaluating the template split */
+    GList *errors;
+    /* FALSE if the account of the split couldn't be found */
+    gboolean has_amount;
+    GncGUID account;
+    gnc_numeric amount;
+    /* set if the split needs an exchange rate to the first split */
+    gchar *no_rate_error;
+} SxCashflowSplit;
+
+/* The SxCaches of a book, kept as book data so they go with it */
+typedef struct
+{
+    QofBook *book;
+    /* SX guid -> SxCache, and template account guid -> the same SxCache */
+    GHashTable *by_sx;
+    GHashTable *by_template;
+    gint listener;
+} SxBookCache;
+
+#define SX_CACHE_KEY "gnc-sx-cache"
+
+static void
+sx_cashflow_split_free(SxCashflowSplit *flow)
+{
+    GList *iter;
+
+    for (iter = flow->errors; iter != NULL; iter = iter->next)
+        g_string_free((GString*)iter->data, TRUE);
+    g_list_free(flow->errors);
+    g_free(flow->no_rate_error);
+    g_free(flow);
+}
+
+static void
+sx_cache_free(SxCache *cache)
+{
+    g_array_free(cache->accounts, TRUE);
+    if (cache->variable_names != NULL)
+        g_hash_table_destroy(cache->variable_names);
+    g_list_foreach(cache->cashflow, (GFunc)sx_cashflow_split_free, NULL);
+    g_list_free(cache->cashflow);
+    if (cache->occurrences != NULL)
+        g_array_free(cache->occurrences, TRUE);
+    if (cache->occur_state != NULL)
+        gnc_sx_destroy_temporal_state(cache->occur_state);
+    g_free(cache);
+}
+
+static void
+sx_cache_forget(SxBookCache *book_cache, SxCache *cache)
+{
+    g_hash_table_remove(book_cache->by_template, &cache->template_guid);
+    g_hash_table_remove(book_cache->by_sx, &cache->sx_guid);
+}
+
+static void
+sx_cache_forget_template(SxBookCache *book_cache, Account *acct)
+{
+    SxCache *cache;
+
+    if (acct == NULL)
+        return;
+    cache = g_hash_table_lookup(book_cache->by_template, xaccAccountGetGUID(acct));
+    if (cache != NULL)
+        sx_cache_forget(book_cache, cache);
+}
+
+/* Any change to an SX or to anything in its template account drops
+ * what is known about it. Changes to the accounts the template splits
+ * refer to are caught when the cache is used. */
+static void
+sx_cache_event_handler(QofInstance *ent, QofEventId event_type, gpointer user_data, gpointer evt_data)
+{
+    SxBookCache *book_cache = user_data;
+
+    if (g_hash_table_size(book_cache->by_sx) == 0)
+        return;
+    if (!QOF_IS_INSTANCE(ent) || qof_instance_get_book(ent) != book_cache->book)
+        return;
+
+    if (GNC_IS_SX(ent))
+    {
+        SxCache *cache = g_hash_table_lookup(book_cache->by_sx, qof_instance_get_guid(ent));
+        if (cache != NULL)
+            sx_cache_forget(book_cache, cache);
+    }
+    else if (GNC_IS_ACCOUNT(ent))
+    {
+        sx_cache_forget_template(book_cache, GNC_ACCOUNT(ent));
+    }
+    else if (GNC_IS_SPLIT(ent))
+    {
+        sx_cache_forget_template(book_cache, xaccSplitGetAccount(GNC_SPLIT(ent)));
+    }
+    else if (GNC_IS_TRANS(ent))
+    {
+        GList *split_iter;
+
+        for (split_iter = xaccTransGetSplitList(GNC_TRANS(ent)); split_iter != NULL; split_iter = split_iter->next)
+            sx_cache_forget_template(book_cache, xaccSplitGetAccount((Split*)split_iter->data));
+    }
+}
+
+static void
+sx_book_cache_destroy(QofBook *book, gpointer key, gpointer user_data)
+{
+    SxBookCache *book_cache = user_data;
+
+    qof_event_unregister_handler(book_cache->listener);
+    g_hash_table_destroy(book_cache->by_template);
+    g_hash_table_destroy(book_cache->by_sx);
+    g_free(book_cache);
+}
+
+static SxBookCache*
+sx_book_cache_get(QofBook *book)
+{
+    SxBookCache *book_cache = qof_book_get_data(book, SX_CACHE_KEY);
+
+    if (book_cache != NULL)
+        return book_cache;
+
+    book_cache = g_new0(SxBookCache, 1);
+    book_cache->book = book;
+    book_cache->by_sx = g_hash_table_new_full(guid_hash_to_guint, guid_g_hash_table_equal,
+                        NULL, (GDestroyNotify)sx_cache_free);
+    book_cache->by_template = g_hash_table_new(guid_hash_to_guint, guid_g_hash_table_equal);
+    book_cache->listener = qof_event_register_handler(sx_cache_event_handler, book_cache);
+    qof_book_set_data_fin(book, SX_CACHE_KEY, book_cache, sx_book_cache_destroy);
+    return book_cache;
+}
+
+static Account*
+sx_find_template_account(const SchedXaction *sx)
 {
     Account *template_root, *sx_template_acct;
     char sx_guid_str[GUID_ENCODING_LENGTH+1];
@@ -267,6 +430,169 @@ gnc_sx_get_template_transaction_account(const SchedXaction *sx)
     return sx_template_acct;
 }
 
+static void
+sx_cache_note_accounts(SxCache *cache, Account *template_acct)
+{
+    GList *split_iter;
+
+    for (split_iter = xaccAccountGetSplitList(template_acct); split_iter != NULL; split_iter = split_iter->next)
+    {
+        kvp_value *kvp_val;
+        GncGUID *acct_guid;
+        SxCacheAccount seen;
+        Account *acct;
+
+        kvp_val = kvp_frame_get_slot_path(xaccSplitGetSlots((Split*)split_iter->data),
+                                          GNC_SX_ID,
+                                          GNC_SX_ACCOUNT,
+                                          NULL);
+        acct_guid = kvp_value_get_guid(kvp_val);
+        if (acct_guid == NULL)
+            continue;
+
+        acct = xaccAccountLookup(acct_guid, cache->book);
+        seen.guid = *acct_guid;
+        seen.found = (acct != NULL);
+        seen.commodity = acct ? xaccAccountGetCommodity(acct) : NULL;
+        g_array_append_val(cache->accounts, seen);
+    }
+}
+
+static gboolean
+sx_cache_accounts_unchanged(SxCache *cache)
+{
+    guint i;
+
+    for (i = 0; i < cache->accounts->len; i++)
+    {
+        SxCacheAccount *seen = &g_array_index(cache->accounts, SxCacheAccount, i);
+        Account *acct = xaccAccountLookup(&seen->guid, cache->book);
+
+        if ((acct != NULL) != seen->found)
+            return FALSE;
+        if (acct != NULL && xaccAccountGetCommodity(acct) != seen->commodity)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+/* @return the cache entry of the SX, or NULL if it has no template
+ * account. Owned by the cache; only good until the next change to the
+ * book. */
+static SxCache*
+sx_cache_lookup(const SchedXaction *sx)
+{
+    QofBook *book = gnc_get_current_book();
+    SxBookCache *book_cache = sx_book_cache_get(book);
+    Account *template_acct;
+    SxCache *cache;
+
+    cache = g_hash_table_lookup(book_cache->by_sx, xaccSchedXactionGetGUID(sx));
+    if (cache != NULL)
+    {
+        if (sx_cache_accounts_unchanged(cache))
+            return cache;
+        sx_cache_forget(book_cache, cache);
+    }
+
+    template_acct = sx_find_template_account(sx);
+    if (template_acct == NULL)
+        return NULL;
+
+    cache = g_new0(SxCache, 1);
+    cache->sx_guid = *xaccSchedXactionGetGUID(sx);
+    cache->book = book;
+    cache->template_guid = *xaccAccountGetGUID(template_acct);
+    cache->accounts = g_array_new(FALSE, FALSE, sizeof(SxCacheAccount));
+    sx_cache_note_accounts(cache, template_acct);
+
+    g_hash_table_insert(book_cache->by_sx, &cache->sx_guid, cache);
+    g_hash_table_insert(book_cache->by_template, &cache->template_guid, cache);
+    return cache;
+}
+
+static GHashTable*
+sx_cache_get_variable_names(SxCache *cache)
+{
+    if (cache->variable_names == NULL)
+    {
+        Account *template_acct = xaccAccountLookup(&cache->template_guid, cache->book);
+
+        cache->variable_names = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)gnc_sx_variable_free);
+        xaccAccountForEachTransaction(template_acct, _get_vars_helper, cache->variable_names);
+        g_hash_table_foreach(cache->variable_names, (GHFunc)_wipe_parsed_sx_var, NULL);
+    }
+    return cache->variable_names;
+}
+
+/* @return the number of dates in @a dates before @a date, or on or
+ * before it if @a or_on. */
+static guint
+sx_dates_before(GArray *dates, const GDate *date, gboolean or_on)
+{
+    guint lo = 0, hi = dates->len;
+
+    while (lo < hi)
+    {
+        guint mid = lo + (hi - lo) / 2;
+        gint cmp = g_date_compare(&g_array_index(dates, GDate, mid), date);
+
+        if (cmp < 0 || (or_on && cmp == 0))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* The same count as gnc_sx_get_num_occur_daterange(), from the cached
+ * occurrences, which are carried on as far as @a end first. */
+static gint
+sx_cache_num_occur(SxCache *cache, const SchedXaction *sx, const GDate *start, const GDate *end)
+{
+    GArray *dates;
+    guint before, through;
+
+    if (cache->occurrences == NULL)
+    {
+        cache->occurrences = g_array_new(FALSE, FALSE, sizeof(GDate));
+        cache->occur_state = gnc_sx_create_temporal_state(sx);
+    }
+    dates = cache->occurrences;
+
+    while (!cache->occur_complete
+            && (dates->len == 0
+                || g_date_compare(&g_array_index(dates, GDate, dates->len - 1), end) <= 0))
+    {
+        SXTmpStateData *state = cache->occur_state;
+
+        gnc_sx_incr_temporal_state(sx, state);
+        if (!g_date_valid(&state->last_date)
+                || (xaccSchedXactionHasEndDate(sx)
+                    && g_date_compare(&state->last_date, xaccSchedXactionGetEndDate(sx)) > 0)
+                || (xaccSchedXactionHasOccurDef(sx) && state->num_occur_rem < 0))
+        {
+            cache->occur_complete = TRUE;
+            break;
+        }
+        g_array_append_val(dates, state->last_date);
+    }
+
+    before = sx_dates_before(dates, start, FALSE);
+    through = sx_dates_before(dates, end, TRUE);
+    return through > before ? (gint)(through - before) : 0;
+}
+
+Account*
+gnc_sx_get_template_transaction_account(const SchedXaction *sx)
+{
+    SxCache *cache = sx_cache_lookup(sx);
+
+    if (cache == NULL)
+        return NULL;
+    return xaccAccountLookup(&cache->template_guid, cache->book);
+}
+
 void
 gnc_sx_get_variables(SchedXaction *sx, GHashTable *var_hash)
 {
@@ -311,9 +637,11 @@ gnc_sx_instance_new(GncSxInstances *parent, GncSxInstanceState state, GDate *dat
 
     if (! parent->variable_names_parsed)
     {
+        SxCache *cache = sx_cache_lookup(parent->sx);
+
         parent->variable_names = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)gnc_sx_variable_free);
-        gnc_sx_get_variables(parent->sx, parent->variable_names);
-        g_hash_table_foreach(parent->variable_names, (GHFunc)_wipe_parsed_sx_var, NULL);
+        if (cache != NULL)
+            g_hash_table_foreach(sx_cache_get_variable_names(cache), _clone_sx_var_hash_entry, parent->variable_names);
         parent->variable_names_parsed = TRUE;
     }
 
@@ -386,7 +714,7 @@ _gnc_sx_gen_instances(gpointer *data, gpointer user_data)
             inst_date = xaccSchedXactionGetNextInstance(sx, postponed->data);
             seq_num = gnc_sx_get_instance_count(sx, postponed->data);
             inst = gnc_sx_instance_new(instances, SX_INSTANCE_STATE_POSTPONED, &inst_date, postponed->data, seq_num);
-            instances->instance_list = g_list_append(instances->instance_list, inst);
+            instances->instance_list = g_list_prepend(instances->instance_list, inst);
         }
     }
 
@@ -401,7 +729,7 @@ _gnc_sx_gen_instances(gpointer *data, gpointer user_data)
         int seq_num;
         seq_num = gnc_sx_get_instance_count(sx, sequence_ctx);
         inst = gnc_sx_instance_new(instances, SX_INSTANCE_STATE_TO_CREATE, &cur_date, sequence_ctx, seq_num);
-        instances->instance_list = g_list_append(instances->instance_list, inst);
+        instances->instance_list = g_list_prepend(instances->instance_list, inst);
         gnc_sx_incr_temporal_state(sx, sequence_ctx);
         cur_date = xaccSchedXactionGetInstanceAfter(sx, &cur_date, sequence_ctx);
     }
@@ -413,11 +741,12 @@ _gnc_sx_gen_instances(gpointer *data, gpointer user_data)
         int seq_num;
         seq_num = gnc_sx_get_instance_count(sx, sequence_ctx);
         inst = gnc_sx_instance_new(instances, SX_INSTANCE_STATE_REMINDER, &cur_date, sequence_ctx, seq_num);
-        instances->instance_list = g_list_append(instances->instance_list, inst);
+        instances->instance_list = g_list_prepend(instances->instance_list, inst);
         gnc_sx_incr_temporal_state(sx, sequence_ctx);
         cur_date = xaccSchedXactionGetInstanceAfter(sx, &cur_date, sequence_ctx);
     }
 
+    instances->instance_list = g_list_reverse(instances->instance_list);
     return instances;
 }
 
@@ -1484,10 +1813,8 @@ GHashTable* gnc_g_hash_new_guid_numeric()
 
 typedef struct
 {
-    GHashTable *hash;
-    GList **creation_errors;
+    SxCache *cache;
     const SchedXaction *sx;
-    gnc_numeric count;
 } SxCashflowData;
 
 static void add_to_hash_amount(GHashTable* hash, const GncGUID* guid, const gnc_numeric* amount)
@@ -1547,12 +1874,13 @@ static void add_to_hash_amount(GHashTable* hash, const GncGUID* guid, const gnc_
             gnc_num_dbg_to_string(*elem));
 }
 
+/* Work out the cash flow of a single occurrence of the template
+ * transaction into the cache, split by split. */
 static gboolean
 create_cashflow_helper(Transaction *template_txn, void *user_data)
 {
     SxCashflowData *creation_data = user_data;
     GList *template_splits;
-    gboolean err_flag = FALSE;
     const gnc_commodity *first_cmdty = NULL;
 
     g_debug("Evaluating txn desc [%s] for sx [%s]",
@@ -1578,12 +1906,14 @@ create_cashflow_helper(Transaction *template_txn, void *user_data)
         Account *split_acct;
         const gnc_commodity *split_cmdty = NULL;
         const Split *template_split = (const Split*) template_splits->data;
+        SxCashflowSplit *flow = g_new0(SxCashflowSplit, 1);
+
+        creation_data->cache->cashflow = g_list_prepend(creation_data->cache->cashflow, flow);
 
         /* Get the account that should be used for this split. */
-        if (!_get_template_split_account(creation_data->sx, template_split, &split_acct, creation_data->creation_errors))
+        if (!_get_template_split_account(creation_data->sx, template_split, &split_acct, &flow->errors))
         {
             g_debug("Could not find account for split");
-            err_flag = TRUE;
             break;
         }
 
@@ -1598,69 +1928,50 @@ create_cashflow_helper(Transaction *template_txn, void *user_data)
         {
             gnc_numeric credit_num = gnc_numeric_zero();
             gnc_numeric debit_num = gnc_numeric_zero();
-            gnc_numeric final_once, final;
-            gint gncn_error;
 
             /* Credit value */
-            _get_sx_formula_value(creation_data->sx, template_split, &credit_num, creation_data->creation_errors, GNC_SX_CREDIT_FORMULA, GNC_SX_CREDIT_NUMERIC, NULL);
+            _get_sx_formula_value(creation_data->sx, template_split, &credit_num, &flow->errors, GNC_SX_CREDIT_FORMULA, GNC_SX_CREDIT_NUMERIC, NULL);
             /* Debit value */
-            _get_sx_formula_value(creation_data->sx, template_split, &debit_num, creation_data->creation_errors, GNC_SX_DEBIT_FORMULA, GNC_SX_DEBIT_NUMERIC, NULL);
+            _get_sx_formula_value(creation_data->sx, template_split, &debit_num, &flow->errors, GNC_SX_DEBIT_FORMULA, GNC_SX_DEBIT_NUMERIC, NULL);
 
-            /* The resulting cash flow number: debit minus credit,
-             * multiplied with the count factor. */
-            final_once = gnc_numeric_sub_fixed( debit_num, credit_num );
-            /* Multiply with the count factor. */
-            final = gnc_numeric_mul(final_once, creation_data->count,
-                                    gnc_numeric_denom(final_once),
-                                    GNC_HOW_RND_ROUND_HALF_UP);
+            /* The cash flow number of one occurrence: debit minus
+             * credit. */
+            flow->has_amount = TRUE;
+            flow->account = *xaccAccountGetGUID(split_acct);
+            flow->amount = gnc_numeric_sub_fixed( debit_num, credit_num );
 
-            gncn_error = gnc_numeric_check(final);
-            if (gncn_error != GNC_ERROR_OK)
-            {
-                GString *err = g_string_new("");
-                g_string_printf(err, "error %d in SX [%s] final gnc_numeric value, using 0 instead",
-                                gncn_error, xaccSchedXactionGetName(creation_data->sx));
-                g_critical("%s", err->str);
-                if (creation_data->creation_errors != NULL)
-                    *creation_data->creation_errors = g_list_append(*creation_data->creation_errors, err);
-                else
-                    g_string_free(err, TRUE);
-                final = gnc_numeric_zero();
-            }
-
-            /* Print error message if we would have needed an exchange rate */
+            /* We would have needed an exchange rate */
             if (! gnc_commodity_equal(split_cmdty, first_cmdty))
             {
-                GString *err = g_string_new("");
-                g_string_printf(err, "No exchange rate available in SX [%s] for %s -> %s, value is zero",
-                                xaccSchedXactionGetName(creation_data->sx),
-                                gnc_commodity_get_mnemonic(split_cmdty),
-                                gnc_commodity_get_mnemonic(first_cmdty));
-                g_critical("%s", err->str);
-                if (creation_data->creation_errors != NULL)
-                    *creation_data->creation_errors = g_list_append(*creation_data->creation_errors, err);
-                else
-                    g_string_free(err, TRUE);
-                final = gnc_numeric_zero();
+                flow->no_rate_error
+                = g_strdup_printf("No exchange rate available in SX [%s] for %s -> %s, value is zero",
+                                  xaccSchedXactionGetName(creation_data->sx),
+                                  gnc_commodity_get_mnemonic(split_cmdty),
+                                  gnc_commodity_get_mnemonic(first_cmdty));
             }
-
-            /* And add the resulting value to the hash */
-            add_to_hash_amount(creation_data->hash, xaccAccountGetGUID(split_acct), &final);
         }
     }
 
     return FALSE;
 }
 
+static void
+add_creation_error(GList **creation_errors, const gchar *message)
+{
+    if (creation_errors != NULL)
+        *creation_errors = g_list_append(*creation_errors, g_string_new(message));
+}
+
 static void
 instantiate_cashflow_internal(const SchedXaction* sx,
                               GHashTable* map,
                               GList **creation_errors, gint count)
 {
-    SxCashflowData create_cashflow_data;
-    Account* sx_template_account = gnc_sx_get_template_transaction_account(sx);
+    SxCache *cache = sx_cache_lookup(sx);
+    gnc_numeric count_num;
+    GList *flow_iter;
 
-    if (!sx_template_account)
+    if (!cache)
     {
         g_critical("Huh? No template account for the SX %s", xaccSchedXactionGetName(sx));
         return;
@@ -1673,16 +1984,67 @@ instantiate_cashflow_internal(const SchedXaction* sx,
         return;
     }
 
-    create_cashflow_data.hash = map;
-    create_cashflow_data.creation_errors = creation_errors;
-    create_cashflow_data.sx = sx;
-    create_cashflow_data.count = gnc_numeric_create(count, 1);
-
     /* The cash flow numbers are in the transactions of the template
-     * account, so run this foreach on the transactions. */
-    xaccAccountForEachTransaction(sx_template_account,
-                                  create_cashflow_helper,
-                                  &create_cashflow_data);
+     * account; they only need to be worked out again once those
+     * change. */
+    if (!cache->cashflow_valid)
+    {
+        SxCashflowData create_cashflow_data;
+
+        create_cashflow_data.cache = cache;
+        create_cashflow_data.sx = sx;
+        xaccAccountForEachTransaction(xaccAccountLookup(&cache->template_guid, cache->book),
+                                      create_cashflow_helper,
+                                      &create_cashflow_data);
+        cache->cashflow = g_list_reverse(cache->cashflow);
+        cache->cashflow_valid = TRUE;
+    }
+
+    count_num = gnc_numeric_create(count, 1);
+    for (flow_iter = cache->cashflow; flow_iter != NULL; flow_iter = flow_iter->next)
+    {
+        SxCashflowSplit *flow = flow_iter->data;
+        Account *split_acct;
+        gnc_numeric final;
+        gint gncn_error;
+        GList *err_iter;
+
+        for (err_iter = flow->errors; err_iter != NULL; err_iter = err_iter->next)
+            add_creation_error(creation_errors, ((GString*)err_iter->data)->str);
+
+        if (!flow->has_amount)
+            continue;
+
+        /* Multiply with the count factor. */
+        final = gnc_numeric_mul(flow->amount, count_num,
+                                gnc_numeric_denom(flow->amount),
+                                GNC_HOW_RND_ROUND_HALF_UP);
+
+        gncn_error = gnc_numeric_check(final);
+        if (gncn_error != GNC_ERROR_OK)
+        {
+            GString *err = g_string_new("");
+            g_string_printf(err, "error %d in SX [%s] final gnc_numeric value, using 0 instead",
+                            gncn_error, xaccSchedXactionGetName(sx));
+            g_critical("%s", err->str);
+            add_creation_error(creation_errors, err->str);
+            g_string_free(err, TRUE);
+            final = gnc_numeric_zero();
+        }
+
+        /* Print error message if we would have needed an exchange rate */
+        if (flow->no_rate_error != NULL)
+        {
+            g_critical("%s", flow->no_rate_error);
+            add_creation_error(creation_errors, flow->no_rate_error);
+            final = gnc_numeric_zero();
+        }
+
+        /* And add the resulting value to the hash */
+        split_acct = xaccAccountLookup(&flow->account, cache->book);
+        if (split_acct != NULL)
+            add_to_hash_amount(map, xaccAccountGetGUID(split_acct), &final);
+    }
 }
 
 void gnc_sx_instantiate_cashflow(const SchedXaction* sx,
@@ -1705,14 +2067,20 @@ static void instantiate_cashflow_cb(gpointer data, gpointer _user_data)
 {
     const SchedXaction* sx = (const SchedXaction*) data;
     SxAllCashflow* userdata = (SxAllCashflow*) _user_data;
+    SxCache *cache;
     gint count;
 
     g_assert(sx);
     g_assert(userdata);
 
     /* How often does this particular SX occur in the date range? */
-    count = gnc_sx_get_num_occur_daterange(sx, userdata->range_start,
-                                           userdata->range_end);
+    cache = sx_cache_lookup(sx);
+    if (cache != NULL)
+        count = sx_cache_num_occur(cache, sx, userdata->range_start,
+                                   userdata->range_end);
+    else
+        count = gnc_sx_get_num_occur_daterange(sx, userdata->range_start,
+                                               userdata->range_end);
     if (count > 0)
     {
         /* If it occurs at least once, calculate ("instantiate") its
@@ -247,6 +247,10 @@ void gnc_sx_instantiate_cashflow(const SchedXaction* sx,
  * given date range. Each SX is counted with multiplicity as it has
  * occurrences in the given date range.
  *
+ * The cash flow of one occurrence and the occurrence dates of each SX
+ * are kept between calls, until the SX or its template transactions
+ * change, so repeated forecasts only work out what changed.
+ *
  * The creation_errors list, if non-NULL, receive any errors that
  * occurred during creation, similar as in
  * gnc_sx_instance_model_effect_change(). */
@@ -0,0 +1,213 @@
+/********************************************************************\
+ * gnc-trans-quickfill.c -- Create a transaction text quick-fill    *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+ *                                                                  *
+\********************************************************************/
+
+#include "config.h"
+#include "gnc-trans-quickfill.h"
+#include "engine/gnc-event.h"
+#include "engine/gnc-engine.h"
+#include "engine/Transaction.h"
+
+/* This static indicates the debugging module that this .o belongs to. */
+static QofLogModule log_module = GNC_MOD_REGISTER;
+
+/* The quickfills of one account */
+typedef struct
+{
+    QuickFill *qf[TRANS_QF_NUM_FIELDS];
+} AccountTransQF;
+
+typedef struct
+{
+    GHashTable *accounts;   /* Account* -> AccountTransQF* */
+    QuickFillSort qf_sort;
+    QofBook *book;
+    gint  listener;
+} TransQF;
+
+static void
+account_trans_qf_destroy (gpointer data)
+{
+    AccountTransQF *aqf = data;
+    int i;
+
+    for (i = 0; i < TRANS_QF_NUM_FIELDS; i++)
+        gnc_quickfill_destroy (aqf->qf[i]);
+    g_free (aqf);
+}
+
+static void
+insert_text (QuickFill *qf, const char *text, QuickFillSort sort)
+{
+    if (!text || *text == '\0')
+        return;
+
+    gnc_quickfill_insert (qf, text, sort);
+}
+
+static void
+add_trans_texts (AccountTransQF *aqf, Transaction *trans, QuickFillSort sort)
+{
+    GList *node;
+
+    insert_text (aqf->qf[TRANS_QF_DESCRIPTION],
+                 xaccTransGetDescription (trans), sort);
+    insert_text (aqf->qf[TRANS_QF_NOTES], xaccTransGetNotes (trans), sort);
+
+    for (node = xaccTransGetSplitList (trans); node; node = node->next)
+    {
+        if (!xaccTransStillHasSplit (trans, node->data)) continue;
+
+        insert_text (aqf->qf[TRANS_QF_MEMO],
+                     xaccSplitGetMemo (node->data), sort);
+    }
+}
+
+static void
+listen_for_trans_events(QofInstance *entity,  QofEventId event_type,
+                        gpointer user_data, gpointer event_data)
+{
+    TransQF *qfb = user_data;
+    AccountTransQF *aqf;
+    Transaction *trans;
+    GList *node;
+
+    /* Forget the quickfills of an account that goes away. */
+    if (GNC_IS_ACCOUNT (entity))
+    {
+        if (event_type & QOF_EVENT_DESTROY)
+            g_hash_table_remove (qfb->accounts, entity);
+        return;
+    }
+
+    /* Otherwise we only listen for Transaction events */
+    if (!GNC_IS_TRANS (entity))
+        return;
+
+    /* A changed transaction may bring new texts, or splits in another
+     * account. */
+    if (0 == (event_type & QOF_EVENT_MODIFY))
+        return;
+
+    trans = GNC_TRANS (entity);
+    if (qof_instance_get_book (entity) != qfb->book)
+        return;
+
+    for (node = xaccTransGetSplitList (trans); node; node = node->next)
+    {
+        Split *split = node->data;
+
+        if (!xaccTransStillHasSplit (trans, split)) continue;
+
+        aqf = g_hash_table_lookup (qfb->accounts, xaccSplitGetAccount (split));
+        if (aqf)
+            add_trans_texts (aqf, trans, QUICKFILL_LIFO);
+    }
+}
+
+static void
+shared_quickfill_destroy (QofBook *book, gpointer key, gpointer user_data)
+{
+    TransQF *qfb = user_data;
+    g_hash_table_destroy (qfb->accounts);
+    qof_event_unregister_handler (qfb->listener);
+    g_free (qfb);
+}
+
+static TransQF* build_shared_quickfill (QofBook *book, const char * key)
+{
+    TransQF *result;
+
+    result = g_new0(TransQF, 1);
+
+    result->accounts = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                       NULL, account_trans_qf_destroy);
+    result->qf_sort = QUICKFILL_LIFO;
+    result->book = book;
+
+    result->listener =
+        qof_event_register_handler (listen_for_trans_events,
+                                    result);
+
+    qof_book_set_data_fin (book, key, result, shared_quickfill_destroy);
+
+    return result;
+}
+
+/* Fill the quickfills of 'account' from its splits, oldest first so
+ * that the latest texts win. */
+static AccountTransQF* build_account_quickfill (TransQF *qfb, Account *account)
+{
+    AccountTransQF *aqf;
+    Transaction *last_trans = NULL;
+    GList *node;
+    int i;
+
+    aqf = g_new0(AccountTransQF, 1);
+    for (i = 0; i < TRANS_QF_NUM_FIELDS; i++)
+        aqf->qf[i] = gnc_quickfill_new();
+
+    for (node = xaccAccountGetSplitList (account); node; node = node->next)
+    {
+        Transaction *trans = xaccSplitGetParent (node->data);
+
+        /* A transaction with several splits in the account only needs
+         * to be added once. */
+        if (!trans || trans == last_trans)
+            continue;
+        last_trans = trans;
+
+        add_trans_texts (aqf, trans, qfb->qf_sort);
+    }
+
+    g_hash_table_insert (qfb->accounts, account, aqf);
+
+    return aqf;
+}
+
+QuickFill * gnc_get_shared_trans_quickfill (Account *account,
+        const char * key, GncTransQuickFillField field)
+{
+    QofBook *book;
+    TransQF *qfb;
+    AccountTransQF *aqf;
+
+    g_assert(account);
+    g_assert(key);
+    g_assert(field < TRANS_QF_NUM_FIELDS);
+
+    book = gnc_account_get_book (account);
+    qfb = qof_book_get_data (book, key);
+
+    if (!qfb)
+    {
+        qfb = build_shared_quickfill(book, key);
+    }
+
+    aqf = g_hash_table_lookup (qfb->accounts, account);
+
+    if (!aqf)
+    {
+        aqf = build_account_quickfill(qfb, account);
+    }
+
+    return aqf->qf[field];
+}
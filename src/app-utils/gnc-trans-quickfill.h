@@ -0,0 +1,76 @@
+/********************************************************************\
+ * gnc-trans-quickfill.h -- Create a transaction text quick-fill    *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+ *                                                                  *
+\********************************************************************/
+/** @addtogroup QuickFill Auto-complete typed user input.
+   @{
+*/
+/** Similar to the @ref Account_QuickFill account name quickfill, we
+ * create cached quickfills with the descriptions, notes and memos of
+ * the transactions of an account.
+*/
+
+#ifndef GNC_TRANS_QUICKFILL_H
+#define GNC_TRANS_QUICKFILL_H
+
+#include "qof.h"
+#include "Account.h"
+#include "app-utils/QuickFill.h"
+
+/** The transaction texts a shared quickfill can hold. */
+typedef enum
+{
+    TRANS_QF_DESCRIPTION,
+    TRANS_QF_NOTES,
+    TRANS_QF_MEMO,
+    TRANS_QF_NUM_FIELDS
+} GncTransQuickFillField;
+
+/** Create/fetch a quickfill of the texts of the transactions in an
+ *  account.
+ *
+ *  The quickfills of all accounts are kept together in the book of
+ *  the account under 'key', so every register open on an account
+ *  completes from the same tree instead of building its own.  Be sure
+ *  to use distinct, unique keys that don't conflict with other users
+ *  of QofBook.
+ *
+ *  The quickfills of an account are built from its splits the first
+ *  time they are asked for.  After that this code listens to
+ *  transaction change events and adds the new texts of the
+ *  transactions with a split in the account.  Texts that are no
+ *  longer used are not removed, just as a register never forgot the
+ *  texts it had loaded.
+ *
+ * \param account The account whose transactions are completed
+ * \param key The identifier to look up the shared object in the book
+ * \param field Which text of the transactions to complete: the
+ * description, the notes, or the memos of their splits
+ *
+ * \return The shared QuickFill object which is created on first
+ * calling of this function and subsequently looked up in the book by
+ * using the key.
+ */
+QuickFill * gnc_get_shared_trans_quickfill (Account *account,
+        const char * key, GncTransQuickFillField field);
+
+#endif
+
+/** @} */
@@ -1,7 +1,12 @@
 #include "config.h"
 #include <stdlib.h>
 #include <glib.h>
+#include "Account.h"
 #include "SX-book.h"
+#include "SchedXaction.h"
+#include "Split.h"
+#include "Transaction.h"
+#include "gnc-commodity.h"
 #include "gnc-sx-instance-model.h"
 #include "gnc-ui-util.h"
 
@@ -189,6 +194,115 @@ test_state_changes()
     remove_sx(foo);
 }
 
+static Account*
+add_account(QofBook *book, const gchar *name)
+{
+    Account *acct = xaccMallocAccount(book);
+    gnc_commodity *usd = gnc_commodity_table_lookup(gnc_commodity_table_get_table(book),
+                         GNC_COMMODITY_NS_CURRENCY, "USD");
+
+    xaccAccountBeginEdit(acct);
+    xaccAccountSetName(acct, name);
+    xaccAccountSetCommodity(acct, usd);
+    xaccAccountCommitEdit(acct);
+    gnc_account_append_child(gnc_book_get_root_account(book), acct);
+    return acct;
+}
+
+static Split*
+add_template_split(Transaction *txn, Account *template_acct, Account *acct,
+                   const gchar *numeric_key, gint64 amount)
+{
+    Split *split = xaccMallocSplit(xaccTransGetBook(txn));
+    gchar *path;
+
+    xaccSplitSetParent(split, txn);
+    xaccSplitSetAccount(split, template_acct);
+    kvp_frame_set_guid(xaccSplitGetSlots(split), GNC_SX_ID "/" GNC_SX_ACCOUNT,
+                       xaccAccountGetGUID(acct));
+    path = g_strdup_printf("%s/%s", GNC_SX_ID, numeric_key);
+    kvp_frame_set_numeric(xaccSplitGetSlots(split), path, gnc_numeric_create(amount, 1));
+    g_free(path);
+    return split;
+}
+
+static gnc_numeric
+cashflow_on(SchedXaction *sx, Account *acct, const GDate *start, const GDate *end)
+{
+    GHashTable *map = gnc_g_hash_new_guid_numeric();
+    GList *sxes = g_list_append(NULL, sx);
+    gnc_numeric *amount;
+    gnc_numeric result;
+
+    gnc_sx_all_instantiate_cashflow(sxes, start, end, map, NULL);
+    amount = g_hash_table_lookup(map, xaccAccountGetGUID(acct));
+    result = amount ? *amount : gnc_numeric_zero();
+    g_hash_table_destroy(map);
+    g_list_free(sxes);
+    return result;
+}
+
+static void
+test_cashflow()
+{
+    QofBook *book = qof_session_get_book(gnc_get_current_session());
+    SchedXaction *sx;
+    Account *template_acct, *bank, *expense;
+    Transaction *txn;
+    Split *debit;
+    GDate start, end, later;
+    gint count;
+
+    g_date_clear(&start, 1);
+    g_date_set_time_t(&start, time(NULL));
+    end = start;
+    g_date_add_days(&end, 9);
+    later = start;
+    g_date_add_days(&later, 4);
+
+    sx = add_daily_sx("cashflow", &start, NULL, NULL);
+    bank = add_account(book, "Bank");
+    expense = add_account(book, "Expense");
+    template_acct = gnc_sx_get_template_transaction_account(sx);
+    do_test(template_acct != NULL, "template account");
+
+    txn = xaccMallocTransaction(book);
+    xaccTransBeginEdit(txn);
+    xaccTransSetCurrency(txn, xaccAccountGetCommodity(bank));
+    add_template_split(txn, template_acct, bank, GNC_SX_CREDIT_NUMERIC, 10);
+    debit = add_template_split(txn, template_acct, expense, GNC_SX_DEBIT_NUMERIC, 10);
+    xaccTransCommitEdit(txn);
+
+    count = gnc_sx_get_num_occur_daterange(sx, &start, &end);
+    do_test(count == 10, "10 days");
+    do_test(gnc_numeric_equal(cashflow_on(sx, expense, &start, &end),
+                              gnc_numeric_create(10 * count, 1)), "expense over 10 days");
+    do_test(gnc_numeric_equal(cashflow_on(sx, bank, &start, &end),
+                              gnc_numeric_create(-10 * count, 1)), "bank over 10 days");
+
+    count = gnc_sx_get_num_occur_daterange(sx, &later, &end);
+    do_test(gnc_numeric_equal(cashflow_on(sx, expense, &later, &end),
+                              gnc_numeric_create(10 * count, 1)), "part of the range again");
+
+    /* Changing the template transaction is picked up */
+    xaccTransBeginEdit(txn);
+    kvp_frame_set_numeric(xaccSplitGetSlots(debit), GNC_SX_ID "/" GNC_SX_DEBIT_NUMERIC,
+                          gnc_numeric_create(20, 1));
+    xaccTransCommitEdit(txn);
+    count = gnc_sx_get_num_occur_daterange(sx, &start, &end);
+    do_test(gnc_numeric_equal(cashflow_on(sx, expense, &start, &end),
+                              gnc_numeric_create(20 * count, 1)), "changed template amount");
+
+    /* and so is changing the SX */
+    xaccSchedXactionSetEndDate(sx, &later);
+    count = gnc_sx_get_num_occur_daterange(sx, &start, &end);
+    do_test(count == 5, "5 days to the end date");
+    do_test(gnc_numeric_equal(cashflow_on(sx, expense, &start, &end),
+                              gnc_numeric_create(20 * count, 1)), "changed end date");
+
+    remove_sx(sx);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -204,6 +318,7 @@ main(int argc, char **argv)
     }
     test_basic();
     test_state_changes();
+    test_cashflow();
 
     print_test_results();
     exit(get_rv());
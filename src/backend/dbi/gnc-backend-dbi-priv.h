@@ -24,6 +24,7 @@
 #define GNC_BACKEND_DBI_PRIV_H
 
 #include <dbi/dbi.h>
+#include <locale.h>
 #include "gnc-backend-sql.h"
 
 /**
@@ -96,6 +97,13 @@ typedef struct
     // be used to prevent infinite loops.
     gboolean retry;         // Signals the calling function that it should retry (the error handler detected
     // transient error and managed to resolve it, but it can't run the original query)
+    gboolean is_clone;      // Extra connection used from a worker thread. It owns its dbi_conn, has no
+    // error handler, leaves the (process-global) locale alone and reads its results into memory
+    // before handing them over, so that only the worker ever calls libdbi on it.
+#ifdef HAVE_USELOCALE
+    locale_t c_locale;      // Clones only: the worker's locale, with LC_NUMERIC "C", set with uselocale()
+    // around each query.
+#endif
 
 } GncDbiSqlConnection;
 
@@ -31,6 +31,7 @@
 #include <errno.h>
 #include <glib.h>
 #include <glib/gstdio.h>
+#include <locale.h>
 #if !HAVE_GMTIME_R
 #include "gmtime_r.h"
 #endif
@@ -125,6 +126,13 @@ static provider_functions_t provider_pgsql =
 };
 #define PGSQL_TIMESPEC_STR_FORMAT "%04d%02d%02d %02d%02d%02d"
 
+/* Rows per multi-row INSERT when saving.  SQLite accepts them from
+ * 3.7.11 and, before 3.8.8, no more than 500 rows in one; PostgreSQL
+ * from 8.2. */
+#define DBI_INSERT_BATCH_SIZE 200
+#define SQLITE3_MULTIROW_INSERT_VERSION 30711
+#define PGSQL_MULTIROW_INSERT_VERSION 80200
+
 static gboolean gnc_dbi_lock_database( QofBackend *qbe, gboolean ignore_lock );
 static void gnc_dbi_unlock( QofBackend *qbe );
 static gboolean save_may_clobber_data( QofBackend* qbe );
@@ -341,6 +349,9 @@ gnc_dbi_sqlite3_session_begin( QofBackend *qbe, QofSession *session,
     }
     be->sql_be.conn = create_dbi_connection( GNC_DBI_PROVIDER_SQLITE, qbe, be->conn );
     be->sql_be.timespec_format = SQLITE3_TIMESPEC_STR_FORMAT;
+    be->sql_be.insert_batch_size =
+        dbi_conn_get_engine_version( be->conn ) >= SQLITE3_MULTIROW_INSERT_VERSION
+        ? DBI_INSERT_BATCH_SIZE : 1;
 
     /* We should now have a proper session set up.
      * Let's start logging */
@@ -879,6 +890,7 @@ gnc_dbi_mysql_session_begin( QofBackend* qbe, QofSession *session,
         be->sql_be.conn = create_dbi_connection( GNC_DBI_PROVIDER_MYSQL, qbe, be->conn );
     }
     be->sql_be.timespec_format = MYSQL_TIMESPEC_STR_FORMAT;
+    be->sql_be.insert_batch_size = DBI_INSERT_BATCH_SIZE;
 
     /* We should now have a proper session set up.
      * Let's start logging */
@@ -1146,6 +1158,9 @@ gnc_dbi_postgres_session_begin( QofBackend *qbe, QofSession *session,
             gnc_sql_connection_dispose( be->sql_be.conn );
         }
         be->sql_be.conn = create_dbi_connection( GNC_DBI_PROVIDER_PGSQL, qbe, be->conn );
+        be->sql_be.insert_batch_size =
+            dbi_conn_get_engine_version( be->conn ) >= PGSQL_MULTIROW_INSERT_VERSION
+            ? DBI_INSERT_BATCH_SIZE : 1;
     }
     be->sql_be.timespec_format = PGSQL_TIMESPEC_STR_FORMAT;
 
@@ -1873,18 +1888,21 @@ row_dispose( /*@ only @*/ GncSqlRow* row )
     g_free( dbi_row );
 }
 
-static /*@ null @*/ const GValue*
-row_get_value_at_col_name( GncSqlRow* row, const gchar* col_name )
+/* Convert one field of the current row of 'result'.  The main connection
+   switches LC_NUMERIC around the decimal conversions; a clone runs with
+   its own thread locale already set to "C" (see conn_execute_select_statement)
+   and must leave the process-global locale alone. */
+static /*@ null @*/ GValue*
+field_to_gvalue( dbi_result result, const gchar* col_name, gboolean push_locale )
 {
-    GncDbiSqlRow* dbi_row = (GncDbiSqlRow*)row;
     gushort type;
     guint attrs;
     GValue* value;
     time_t time;
     struct tm tm_struct;
 
-    type = dbi_result_get_field_type( dbi_row->result, col_name );
-    attrs = dbi_result_get_field_attribs( dbi_row->result, col_name );
+    type = dbi_result_get_field_type( result, col_name );
+    attrs = dbi_result_get_field_attribs( result, col_name );
     value = g_new0( GValue, 1 );
     g_assert( value != NULL );
 
@@ -1892,38 +1910,45 @@ row_get_value_at_col_name( GncSqlRow* row, const gchar* col_name )
     {
     case DBI_TYPE_INTEGER:
         (void)g_value_init( value, G_TYPE_INT64 );
-        g_value_set_int64( value, dbi_result_get_longlong( dbi_row->result, col_name ) );
+        g_value_set_int64( value, dbi_result_get_longlong( result, col_name ) );
         break;
     case DBI_TYPE_DECIMAL:
-        gnc_push_locale( LC_NUMERIC, "C" );
+        if ( push_locale )
+        {
+            gnc_push_locale( LC_NUMERIC, "C" );
+        }
         if ( (attrs & DBI_DECIMAL_SIZEMASK) == DBI_DECIMAL_SIZE4 )
         {
             (void)g_value_init( value, G_TYPE_FLOAT );
-            g_value_set_float( value, dbi_result_get_float( dbi_row->result, col_name ) );
+            g_value_set_float( value, dbi_result_get_float( result, col_name ) );
         }
         else if ( (attrs & DBI_DECIMAL_SIZEMASK) == DBI_DECIMAL_SIZE8 )
         {
             (void)g_value_init( value, G_TYPE_DOUBLE );
-            g_value_set_double( value, dbi_result_get_double( dbi_row->result, col_name ) );
+            g_value_set_double( value, dbi_result_get_double( result, col_name ) );
         }
         else
         {
             PERR( "Field %s: strange decimal length attrs=%d\n", col_name, attrs );
         }
-        gnc_pop_locale( LC_NUMERIC );
+        if ( push_locale )
+        {
+            gnc_pop_locale( LC_NUMERIC );
+        }
         break;
     case DBI_TYPE_STRING:
         (void)g_value_init( value, G_TYPE_STRING );
-        g_value_take_string( value, dbi_result_get_string_copy( dbi_row->result, col_name ) );
+        g_value_take_string( value, dbi_result_get_string_copy( result, col_name ) );
         break;
     case DBI_TYPE_DATETIME:
-        if ( dbi_result_field_is_null( dbi_row->result, col_name ) )
+        if ( dbi_result_field_is_null( result, col_name ) )
         {
+            g_free( value );
             return NULL;
         }
         else
         {
-            time = dbi_result_get_datetime( dbi_row->result, col_name );
+            time = dbi_result_get_datetime( result, col_name );
             (void)gmtime_r( &time, &tm_struct );
             (void)g_value_init( value, G_TYPE_STRING );
             g_value_take_string( value,
@@ -1938,6 +1963,31 @@ row_get_value_at_col_name( GncSqlRow* row, const gchar* col_name )
         return NULL;
     }
 
+    return value;
+}
+
+static void
+gvalue_free( /*@ only @*/ GValue* value )
+{
+    if ( G_IS_VALUE(value) && G_VALUE_HOLDS_STRING(value) )
+    {
+        g_free( (gpointer)g_value_get_string( value ) );
+    }
+    g_free( value );
+}
+
+static /*@ null @*/ const GValue*
+row_get_value_at_col_name( GncSqlRow* row, const gchar* col_name )
+{
+    GncDbiSqlRow* dbi_row = (GncDbiSqlRow*)row;
+    GValue* value;
+
+    value = field_to_gvalue( dbi_row->result, col_name, TRUE );
+    if ( value == NULL )
+    {
+        return NULL;
+    }
+
     dbi_row->gvalue_list = g_list_prepend( dbi_row->gvalue_list, value );
     return value;
 }
@@ -1981,9 +2031,7 @@ result_dispose( /*@ only @*/ GncSqlResult* result )
     }
     if ( dbi_result->result != NULL )
     {
-        gint status;
-
-        status = dbi_result_free( dbi_result->result );
+        gint status = dbi_result_free( dbi_result->result );
         if ( status < 0 )
         {
             PERR( "Error in dbi_result_free() result\n" );
@@ -2077,6 +2125,187 @@ create_dbi_result( /*@ observer @*/ GncDbiSqlConnection* dbi_conn, /*@ owned @*/
     return (GncSqlResult*)dbi_result;
 }
 /* --------------------------------------------------------- */
+/* Results of a clone's SELECTs.  A clone's query runs on a worker thread
+ * while the main thread keeps using libdbi, and the result is handed over
+ * to the main thread afterwards.  libdbi isn't safe to use on one
+ * connection from two threads at once, so the worker reads every row into
+ * GValues and frees the dbi_result before handing over; the main thread
+ * never touches libdbi for these. */
+typedef struct
+{
+    GncSqlRow base;
+
+    /*@ observer @*/
+    GHashTable* columns;
+    /*@ observer @*/
+    GValue** values;
+} GncDbiBufferedSqlRow;
+
+typedef struct
+{
+    GncSqlResult base;
+
+    GHashTable* columns;    /* column name -> index + 1 */
+    guint num_columns;
+    GPtrArray* rows;        /* GValue* array per row, NULL for SQL NULL */
+    guint cur_row;
+    /*@ null @*/
+    GncSqlRow* row;
+} GncDbiBufferedSqlResult;
+
+static void
+buffered_row_dispose( /*@ only @*/ GncSqlRow* row )
+{
+    g_free( row );
+}
+
+static /*@ null @*/ const GValue*
+buffered_row_get_value_at_col_name( GncSqlRow* row, const gchar* col_name )
+{
+    GncDbiBufferedSqlRow* buf_row = (GncDbiBufferedSqlRow*)row;
+    guint index = GPOINTER_TO_UINT(g_hash_table_lookup( buf_row->columns, col_name ));
+
+    if ( index == 0 )
+    {
+        PERR( "Field %s: not in the result\n", col_name );
+        return NULL;
+    }
+    return buf_row->values[index - 1];
+}
+
+static void
+buffered_result_dispose( /*@ only @*/ GncSqlResult* result )
+{
+    GncDbiBufferedSqlResult* buf_result = (GncDbiBufferedSqlResult*)result;
+    guint r, c;
+
+    if ( buf_result->row != NULL )
+    {
+        gnc_sql_row_dispose( buf_result->row );
+    }
+    for ( r = 0; r < buf_result->rows->len; r++ )
+    {
+        GValue** values = g_ptr_array_index( buf_result->rows, r );
+        for ( c = 0; c < buf_result->num_columns; c++ )
+        {
+            if ( values[c] != NULL )
+            {
+                gvalue_free( values[c] );
+            }
+        }
+        g_free( values );
+    }
+    (void)g_ptr_array_free( buf_result->rows, TRUE );
+    g_hash_table_destroy( buf_result->columns );
+    g_free( result );
+}
+
+static guint
+buffered_result_get_num_rows( GncSqlResult* result )
+{
+    GncDbiBufferedSqlResult* buf_result = (GncDbiBufferedSqlResult*)result;
+
+    return buf_result->rows->len;
+}
+
+static /*@ null @*/ GncSqlRow*
+buffered_result_get_next_row( GncSqlResult* result )
+{
+    GncDbiBufferedSqlResult* buf_result = (GncDbiBufferedSqlResult*)result;
+    GncDbiBufferedSqlRow* row;
+
+    if ( buf_result->row != NULL )
+    {
+        gnc_sql_row_dispose( buf_result->row );
+        buf_result->row = NULL;
+    }
+    if ( buf_result->cur_row >= buf_result->rows->len )
+    {
+        return NULL;
+    }
+
+    row = g_new0( GncDbiBufferedSqlRow, 1 );
+    g_assert( row != NULL );
+    row->base.getValueAtColName = buffered_row_get_value_at_col_name;
+    row->base.dispose = buffered_row_dispose;
+    row->columns = buf_result->columns;
+    row->values = g_ptr_array_index( buf_result->rows, buf_result->cur_row );
+    buf_result->cur_row++;
+    buf_result->row = (GncSqlRow*)row;
+    return buf_result->row;
+}
+
+static /*@ null @*/ GncSqlRow*
+buffered_result_get_first_row( GncSqlResult* result )
+{
+    GncDbiBufferedSqlResult* buf_result = (GncDbiBufferedSqlResult*)result;
+
+    buf_result->cur_row = 0;
+    return buffered_result_get_next_row( result );
+}
+
+/* Read all of 'result' into memory and free it.  Runs on the thread that
+   ran the query. */
+static GncSqlResult*
+create_buffered_dbi_result( /*@ only @*/ dbi_result result )
+{
+    GncDbiBufferedSqlResult* buf_result;
+    guint num_rows;
+    guint r, c;
+
+    buf_result = g_new0( GncDbiBufferedSqlResult, 1 );
+    g_assert( buf_result != NULL );
+
+    buf_result->base.dispose = buffered_result_dispose;
+    buf_result->base.getNumRows = buffered_result_get_num_rows;
+    buf_result->base.getFirstRow = buffered_result_get_first_row;
+    buf_result->base.getNextRow = buffered_result_get_next_row;
+    buf_result->columns = g_hash_table_new_full( g_str_hash, g_str_equal, g_free, NULL );
+    buf_result->num_columns = dbi_result_get_numfields( result );
+    if ( buf_result->num_columns == DBI_FIELD_ERROR )
+    {
+        buf_result->num_columns = 0;
+    }
+    for ( c = 0; c < buf_result->num_columns; c++ )
+    {
+        const gchar* name = dbi_result_get_field_name( result, c + 1 );
+        if ( name != NULL )
+        {
+            g_hash_table_insert( buf_result->columns, g_strdup( name ), GUINT_TO_POINTER(c + 1) );
+        }
+    }
+
+    num_rows = (guint)dbi_result_get_numrows( result );
+    buf_result->rows = g_ptr_array_sized_new( num_rows );
+    for ( r = 0; r < num_rows; r++ )
+    {
+        GValue** values;
+
+        if ( dbi_result_next_row( result ) == 0 )
+        {
+            PERR( "Error in dbi_result_next_row()\n" );
+            break;
+        }
+        values = g_new0( GValue*, buf_result->num_columns + 1 );
+        for ( c = 0; c < buf_result->num_columns; c++ )
+        {
+            const gchar* name = dbi_result_get_field_name( result, c + 1 );
+            if ( name != NULL )
+            {
+                values[c] = field_to_gvalue( result, name, FALSE );
+            }
+        }
+        g_ptr_array_add( buf_result->rows, values );
+    }
+
+    if ( dbi_result_free( result ) < 0 )
+    {
+        PERR( "Error in dbi_result_free() result\n" );
+    }
+
+    return (GncSqlResult*)buf_result;
+}
+/* --------------------------------------------------------- */
 typedef struct
 {
     GncSqlStatement base;
@@ -2142,8 +2371,15 @@ create_dbi_statement( /*@ observer @*/ GncSqlConnection* conn, const gchar* sql
 static void
 conn_dispose( /*@ only @*/ GncSqlConnection* conn )
 {
-    //GncDbiSqlConnection* dbi_conn = (GncDbiSqlConnection*)conn;
+    GncDbiSqlConnection* dbi_conn = (GncDbiSqlConnection*)conn;
 
+    if ( dbi_conn->is_clone )
+    {
+        dbi_conn_close( dbi_conn->conn );
+#ifdef HAVE_USELOCALE
+        freelocale( dbi_conn->c_locale );
+#endif
+    }
     g_free( conn );
 }
 
@@ -2153,9 +2389,27 @@ conn_execute_select_statement( GncSqlConnection* conn, GncSqlStatement* stmt )
     GncDbiSqlConnection* dbi_conn = (GncDbiSqlConnection*)conn;
     GncDbiSqlStatement* dbi_stmt = (GncDbiSqlStatement*)stmt;
     dbi_result result;
+    GncSqlResult* sql_result = NULL;
+#ifdef HAVE_USELOCALE
+    locale_t old_locale = (locale_t)0;
+#endif
 
     DEBUG( "SQL: %s\n", dbi_stmt->sql->str );
-    gnc_push_locale( LC_NUMERIC, "C" );
+    /* libdbi converts the numbers in the result with the C library, so
+       LC_NUMERIC must be "C" while the rows are read.  The locale stack
+       isn't thread safe, so a clone (which only runs on a worker thread)
+       switches the locale of its own thread instead, and reads the whole
+       result before returning it. */
+#ifdef HAVE_USELOCALE
+    if ( dbi_conn->is_clone )
+    {
+        old_locale = uselocale( dbi_conn->c_locale );
+    }
+    else
+#endif
+    {
+        gnc_push_locale( LC_NUMERIC, "C" );
+    }
     do
     {
         gnc_dbi_init_error( dbi_conn );
@@ -2165,10 +2419,26 @@ conn_execute_select_statement( GncSqlConnection* conn, GncSqlStatement* stmt )
     if ( result == NULL )
     {
         PERR( "Error executing SQL %s\n", dbi_stmt->sql->str );
-        return NULL;
     }
-    gnc_pop_locale( LC_NUMERIC );
-    return create_dbi_result( dbi_conn, result );
+    else if ( dbi_conn->is_clone )
+    {
+        sql_result = create_buffered_dbi_result( result );
+    }
+    else
+    {
+        sql_result = create_dbi_result( dbi_conn, result );
+    }
+#ifdef HAVE_USELOCALE
+    if ( dbi_conn->is_clone )
+    {
+        (void)uselocale( old_locale );
+    }
+    else
+#endif
+    {
+        gnc_pop_locale( LC_NUMERIC );
+    }
+    return sql_result;
 }
 
 static gint
@@ -2974,6 +3244,75 @@ conn_test_dbi_library( dbi_conn conn )
 }
 
 
+/* Open a second connection to the same database with the same options.
+ * The clone gets no error handler: the handlers report through the
+ * backend's main connection and must not run from another thread.
+ * Without uselocale() a worker thread can't read numbers safely, so there
+ * are no clones.  Nor are there for MySQL: libmysqlclient wants
+ * mysql_thread_init() on every thread that uses it, and libdbi gives no
+ * way to call that, so its connections stay on the main thread. */
+static /*@ null @*/ GncSqlConnection*
+conn_clone( GncSqlConnection* conn )
+{
+#ifdef HAVE_USELOCALE
+    GncDbiSqlConnection* orig = (GncDbiSqlConnection*)conn;
+    GncDbiSqlConnection* clone;
+    dbi_conn new_conn;
+    const gchar* driver_name;
+    const gchar* key = NULL;
+    locale_t base_locale;
+    locale_t c_locale;
+
+    driver_name = dbi_driver_get_name( dbi_conn_get_driver( orig->conn ) );
+    if ( g_strcmp0( driver_name, "mysql" ) == 0 )
+    {
+        return NULL;
+    }
+    new_conn = dbi_conn_new( driver_name );
+    if ( new_conn == NULL )
+    {
+        PWARN( "Unable to create a second %s connection\n", driver_name );
+        return NULL;
+    }
+    while ( (key = dbi_conn_get_option_list( orig->conn, key )) != NULL )
+    {
+        const gchar* value = dbi_conn_get_option( orig->conn, key );
+        if ( value != NULL )
+        {
+            (void)dbi_conn_set_option( new_conn, key, value );
+        }
+        else
+        {
+            (void)dbi_conn_set_option_numeric( new_conn, key,
+                                               dbi_conn_get_option_numeric( orig->conn, key ) );
+        }
+    }
+    if ( dbi_conn_connect( new_conn ) < 0 )
+    {
+        PWARN( "Unable to open a second %s connection\n", driver_name );
+        dbi_conn_close( new_conn );
+        return NULL;
+    }
+    base_locale = duplocale( LC_GLOBAL_LOCALE );
+    c_locale = base_locale != (locale_t)0 ? newlocale( LC_NUMERIC_MASK, "C", base_locale ) : (locale_t)0;
+    if ( c_locale == (locale_t)0 )
+    {
+        PWARN( "Unable to create a \"C\" numeric locale\n" );
+        if ( base_locale != (locale_t)0 ) freelocale( base_locale );
+        dbi_conn_close( new_conn );
+        return NULL;
+    }
+
+    clone = (GncDbiSqlConnection*)create_dbi_connection( orig->provider,
+            orig->qbe, new_conn );
+    clone->is_clone = TRUE;
+    clone->c_locale = c_locale;
+    return (GncSqlConnection*)clone;
+#else
+    return NULL;
+#endif
+}
+
 static GncSqlConnection*
 create_dbi_connection( /*@ observer @*/ provider_functions_t* provider,
                                         /*@ observer @*/ QofBackend* qbe,
@@ -2996,6 +3335,7 @@ create_dbi_connection( /*@ observer @*/ provider_functions_t* provider,
     dbi_conn->base.createIndex = conn_create_index;
     dbi_conn->base.addColumnsToTable = conn_add_columns_to_table;
     dbi_conn->base.quoteString = conn_quote_string;
+    dbi_conn->base.clone = conn_clone;
     dbi_conn->qbe = qbe;
     dbi_conn->conn = conn;
     dbi_conn->provider = provider;
@@ -0,0 +1,347 @@
+/***************************************************************************
+ *            test-dbi-batch.c
+ *
+ *  Tests and benchmark for batched INSERTs when saving to a dbi/sqlite3 db.
+ ****************************************************************************/
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301, USA.
+ */
+/**
+ * @file test-dbi-batch.c
+ * @brief Save a book with and without multi-row INSERTs and compare.
+ *
+ * Run without arguments this is a quick check that a batched save
+ * reads back the same as the book that was saved, tax table included.  Give it transaction
+ * counts to get timings, e.g.
+ *
+ *   test-dbi-batch 1000 10000
+ *
+ * Each book is saved once with one INSERT per row and once batched.
+ * Then one transaction with as many splits is committed to the open
+ * database, which is the path an imported statement takes.
+ */
+
+#include "config.h"
+#include <glib/gstdio.h>
+#include "qof.h"
+#include "qofsession-p.h"
+#include "cashobjects.h"
+#include "test-engine-stuff.h"
+#include "test-stuff.h"
+#include "test-dbi-stuff.h"
+
+#include "TransLog.h"
+#include "Account.h"
+#include "Transaction.h"
+#include "Split.h"
+#include "gnc-commodity.h"
+#include "gncTaxTable.h"
+#include "gnc-transaction-sql.h"
+#include "../gnc-backend-dbi-priv.h"
+
+#define GNC_LIB_NAME "gncmod-backend-dbi"
+
+static Account*
+make_account( QofBook* book, Account* parent, const gchar* name,
+              GNCAccountType type, gnc_commodity* currency )
+{
+    Account* acct = xaccMallocAccount( book );
+
+    xaccAccountBeginEdit( acct );
+    xaccAccountSetType( acct, type );
+    xaccAccountSetName( acct, name );
+    xaccAccountSetCommodity( acct, currency );
+    xaccAccountCommitEdit( acct );
+    gnc_account_append_child( parent, acct );
+    return acct;
+}
+
+static void
+add_split( QofBook* book, Transaction* tx, Account* acct, gint64 amount )
+{
+    Split* split = xaccMallocSplit( book );
+
+    xaccSplitSetParent( split, tx );
+    xaccSplitSetAccount( split, acct );
+    xaccSplitSetAmount( split, gnc_numeric_create( amount, 100 ) );
+    xaccSplitSetValue( split, gnc_numeric_create( amount, 100 ) );
+    xaccSplitSetMemo( split, "memo" );
+}
+
+static void
+add_tax_table_entry( GncTaxTable* tt, Account* acct, GncAmountType type )
+{
+    GncTaxTableEntry* tte = gncTaxTableEntryCreate();
+
+    gncTaxTableEntrySetAccount( tte, acct );
+    gncTaxTableEntrySetType( tte, type );
+    gncTaxTableEntrySetAmount( tte, gnc_numeric_create( 5, 100 ) );
+    gncTaxTableAddEntry( tt, tte );
+}
+
+/* A book with two accounts, a tax table with two entries and 'n'
+   two-split transactions, each of which has a slot. */
+static QofSession*
+create_session( guint n )
+{
+    QofSession* session = qof_session_new();
+    QofBook* book = qof_session_get_book( session );
+    Account* root = gnc_book_get_root_account( book );
+    gnc_commodity* currency;
+    Account* bank;
+    Account* expense;
+    GncTaxTable* tt;
+    guint i;
+
+    currency = gnc_commodity_table_lookup( gnc_commodity_table_get_table( book ),
+                                           GNC_COMMODITY_NS_CURRENCY, "CAD" );
+    bank = make_account( book, root, "Bank", ACCT_TYPE_BANK, currency );
+    expense = make_account( book, root, "Expense", ACCT_TYPE_EXPENSE, currency );
+
+    tt = gncTaxTableCreate( book );
+    gncTaxTableBeginEdit( tt );
+    gncTaxTableSetName( tt, "Tax" );
+    add_tax_table_entry( tt, bank, GNC_AMT_TYPE_VALUE );
+    add_tax_table_entry( tt, expense, GNC_AMT_TYPE_PERCENT );
+    gncTaxTableCommitEdit( tt );
+
+    for ( i = 0; i < n; i++ )
+    {
+        Transaction* tx = xaccMallocTransaction( book );
+        gint64 amount = 100 + i;
+
+        xaccTransBeginEdit( tx );
+        xaccTransSetCurrency( tx, currency );
+        xaccTransSetDatePostedSecs( tx, 86400 * (time_t)(i % 3650) );
+        xaccTransSetDescription( tx, "Transaction" );
+        xaccTransSetNotes( tx, "Notes go in a slot" );
+        add_split( book, tx, bank, -amount );
+        add_split( book, tx, expense, amount );
+        xaccTransCommitEdit( tx );
+    }
+    return session;
+}
+
+/* Save-as the contents of 'session' to 'url' with up to 'batch_size'
+   rows per INSERT and return the time it took.  The data ends up back
+   in 'session'. */
+static gdouble
+save_as( QofSession* session, const gchar* url, gint batch_size )
+{
+    QofSession* session_2 = qof_session_new();
+    GncSqlBackend* be;
+    GTimer* timer;
+    gdouble secs;
+
+    qof_session_begin( session_2, url, FALSE, TRUE, TRUE );
+    if ( qof_session_get_error( session_2 ) != ERR_BACKEND_NO_ERR )
+    {
+        do_test( FALSE, "DB session creation failed" );
+        qof_session_destroy( session_2 );
+        return 0.0;
+    }
+    be = (GncSqlBackend*)qof_session_get_backend( session_2 );
+    be->insert_batch_size = batch_size;
+
+    qof_session_swap_data( session, session_2 );
+    timer = g_timer_new();
+    qof_session_save( session_2, NULL );
+    secs = g_timer_elapsed( timer, NULL );
+    g_timer_destroy( timer );
+    do_test( qof_session_get_error( session_2 ) == ERR_BACKEND_NO_ERR, "DB session save" );
+    qof_session_swap_data( session, session_2 );
+
+    qof_session_end( session_2 );
+    qof_session_destroy( session_2 );
+    return secs;
+}
+
+static void
+compare_single_tx( QofInstance* inst, gpointer user_data )
+{
+    CompareInfoStruct* info = (CompareInfoStruct*)user_data;
+    Transaction* tx_1 = GNC_TRANS(inst);
+    Transaction* tx_2 = xaccTransLookup( qof_instance_get_guid(inst), info->book_2 );
+
+    if ( !xaccTransEqual( tx_1, tx_2, TRUE, TRUE, TRUE, FALSE ) )
+    {
+        info->result = FALSE;
+    }
+}
+
+static void
+compare_single_taxtable( QofInstance* inst, gpointer user_data )
+{
+    CompareInfoStruct* info = (CompareInfoStruct*)user_data;
+    GncTaxTable* tt_1 = GNC_TAXTABLE(inst);
+    GncTaxTable* tt_2 = gncTaxTableLookup( info->book_2, qof_instance_get_guid(inst) );
+
+    if ( !gncTaxTableEqual( tt_1, tt_2 ) )
+    {
+        info->result = FALSE;
+    }
+}
+
+/* Commit one transaction with 'n' splits to the database at 'url' and
+   return the time the commit took. */
+static gdouble
+commit_big_tx( const gchar* url, guint n )
+{
+    QofSession* session = qof_session_new();
+    QofBook* book;
+    Account* root;
+    Account* bank;
+    Account* expense;
+    Transaction* tx;
+    GTimer* timer;
+    gdouble secs;
+    guint i;
+
+    qof_session_begin( session, url, TRUE, FALSE, FALSE );
+    qof_session_load( session, NULL );
+    book = qof_session_get_book( session );
+    root = gnc_book_get_root_account( book );
+    bank = gnc_account_lookup_by_name( root, "Bank" );
+    expense = gnc_account_lookup_by_name( root, "Expense" );
+
+    tx = xaccMallocTransaction( book );
+    xaccTransBeginEdit( tx );
+    xaccTransSetCurrency( tx, xaccAccountGetCommodity( bank ) );
+    xaccTransSetDescription( tx, "Imported statement" );
+    add_split( book, tx, bank, -(gint64)n );
+    for ( i = 1; i < n; i++ )
+    {
+        add_split( book, tx, expense, 1 );
+    }
+    add_split( book, tx, expense, 1 );
+
+    timer = g_timer_new();
+    xaccTransCommitEdit( tx );
+    secs = g_timer_elapsed( timer, NULL );
+    g_timer_destroy( timer );
+    do_test( qof_session_get_error( session ) == ERR_BACKEND_NO_ERR, "Commit big transaction" );
+
+    qof_session_end( session );
+    qof_session_destroy( session );
+    return secs;
+}
+
+/* Save a transaction that is already in the database at 'url' as if it
+   were new, so that its batched INSERT fails when the batch is sent.
+   The failure must be charged to the transaction, not to whatever was
+   being written when the batch went out. */
+static void
+check_failed_flush( const gchar* url )
+{
+    QofSession* session = qof_session_new();
+    QofBook* book;
+    GncSqlBackend* be;
+    Account* bank;
+    Transaction* tx;
+    gboolean save_ok;
+    gboolean batch_ok;
+
+    qof_session_begin( session, url, TRUE, FALSE, FALSE );
+    qof_session_load( session, NULL );
+    book = qof_session_get_book( session );
+    be = (GncSqlBackend*)qof_session_get_backend( session );
+    bank = gnc_account_lookup_by_name( gnc_book_get_root_account( book ), "Bank" );
+    tx = xaccSplitGetParent( xaccAccountGetSplitList( bank )->data );
+    qof_instance_mark_clean( QOF_INSTANCE(tx) );
+
+    be->insert_batch_size = 200;
+    be->is_pristine_db = TRUE;
+    gnc_sql_begin_write_batch( be );
+    save_ok = gnc_sql_save_transaction( be, QOF_INSTANCE(tx) );
+    batch_ok = gnc_sql_end_write_batch( be );
+    be->is_pristine_db = FALSE;
+
+    do_test( save_ok, "Batched save reports success before the batch is sent" );
+    do_test( !batch_ok, "Duplicate INSERT fails the batch" );
+    do_test( qof_instance_get_dirty_flag( tx ), "Duplicate INSERT leaves its transaction dirty" );
+
+    (void)qof_session_pop_error( session );
+    qof_session_end( session );
+    qof_session_destroy( session );
+}
+
+static void
+run_size( guint n, gboolean verbose )
+{
+    QofSession* session_1 = create_session( n );
+    QofSession* session_2;
+    gchar* plain_file = tempnam( "/tmp", "test-sqlite3-" );
+    gchar* batch_file = tempnam( "/tmp", "test-sqlite3-" );
+    gdouble t_plain, t_batch, t_commit;
+
+    t_plain = save_as( session_1, plain_file, 1 );
+    t_batch = save_as( session_1, batch_file, 200 );
+
+    session_2 = qof_session_new();
+    qof_session_begin( session_2, batch_file, TRUE, FALSE, FALSE );
+    qof_session_load( session_2, NULL );
+    do_test( qof_collection_count( qof_book_get_collection(
+                                       qof_session_get_book( session_2 ), GNC_ID_TRANS ) ) == n,
+             "Batched save reads back every transaction" );
+    do_compare( qof_session_get_book( session_1 ), qof_session_get_book( session_2 ),
+                GNC_ID_TRANS, compare_single_tx, "Batched save reads back the same transactions" );
+    do_compare( qof_session_get_book( session_1 ), qof_session_get_book( session_2 ),
+                GNC_ID_TAXTABLE, compare_single_taxtable, "Batched save reads back the same tax tables" );
+    qof_session_end( session_2 );
+    qof_session_destroy( session_2 );
+
+    t_commit = commit_big_tx( batch_file, n );
+    if ( !verbose )
+    {
+        check_failed_flush( batch_file );
+    }
+
+    if ( verbose )
+    {
+        printf( "%8u txs  save: unbatched %8.3fs  batched %8.3fs  commit %u splits %8.3fs\n",
+                n, t_plain, t_batch, n + 1, t_commit );
+    }
+
+    qof_session_end( session_1 );
+    qof_session_destroy( session_1 );
+    g_unlink( plain_file );
+    g_unlink( batch_file );
+    free( plain_file );
+    free( batch_file );
+}
+
+int main (int argc, char ** argv)
+{
+    int i;
+
+    qof_init();
+    cashobjects_register();
+    xaccLogDisable();
+    qof_load_backend_library ("../.libs/", GNC_LIB_NAME);
+
+    if ( argc < 2 )
+    {
+        run_size( 200, FALSE );
+    }
+    for ( i = 1; i < argc; i++ )
+    {
+        run_size( (guint)atoi( argv[i] ), TRUE );
+    }
+
+    print_test_results();
+    qof_close();
+    exit(get_rv());
+}
@@ -0,0 +1,268 @@
+/***************************************************************************
+ *            test-dbi-paging.c
+ *
+ *  Tests for loading older transactions on demand from a dbi/sqlite3 db.
+ ****************************************************************************/
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301, USA.
+ */
+/**
+ * @file test-dbi-paging.c
+ * @brief Open a book with GNC_SQL_LOAD_MONTHS set and page it in.
+ *
+ * The book has old transactions in two accounts and one recent
+ * transaction in each.  It is opened with only the recent ones loaded,
+ * one account is paged in by a query, and then everything is loaded.
+ * Balances must stay right throughout, and the last step must not load
+ * the transactions that were already in memory a second time.
+ */
+
+#include "config.h"
+#include <glib/gstdio.h>
+#include "qof.h"
+#include "qofsession-p.h"
+#include "cashobjects.h"
+#include "test-engine-stuff.h"
+#include "test-stuff.h"
+
+#include "TransLog.h"
+#include "Account.h"
+#include "Transaction.h"
+#include "Split.h"
+#include "Query.h"
+#include "gnc-commodity.h"
+#include "gnc-transaction-sql.h"
+#include "../gnc-backend-dbi-priv.h"
+
+#define GNC_LIB_NAME "gncmod-backend-dbi"
+#define N_OLD_TX 20
+#define DB_MEMO "changed in the database"
+
+static Account*
+make_account( QofBook* book, Account* parent, const gchar* name,
+              GNCAccountType type, gnc_commodity* currency )
+{
+    Account* acct = xaccMallocAccount( book );
+
+    xaccAccountBeginEdit( acct );
+    xaccAccountSetType( acct, type );
+    xaccAccountSetName( acct, name );
+    xaccAccountSetCommodity( acct, currency );
+    xaccAccountCommitEdit( acct );
+    gnc_account_append_child( parent, acct );
+    return acct;
+}
+
+static void
+add_tx( QofBook* book, gnc_commodity* currency, time_t date,
+        Account* from, Account* to, gint64 amount )
+{
+    Transaction* tx = xaccMallocTransaction( book );
+    Split* split;
+
+    xaccTransBeginEdit( tx );
+    xaccTransSetCurrency( tx, currency );
+    xaccTransSetDatePostedSecs( tx, date );
+    xaccTransSetDescription( tx, "Transaction" );
+
+    split = xaccMallocSplit( book );
+    xaccSplitSetParent( split, tx );
+    xaccSplitSetAccount( split, from );
+    xaccSplitSetAmount( split, gnc_numeric_create( -amount, 100 ) );
+    xaccSplitSetValue( split, gnc_numeric_create( -amount, 100 ) );
+    xaccSplitSetMemo( split, "memo" );
+
+    split = xaccMallocSplit( book );
+    xaccSplitSetParent( split, tx );
+    xaccSplitSetAccount( split, to );
+    xaccSplitSetAmount( split, gnc_numeric_create( amount, 100 ) );
+    xaccSplitSetValue( split, gnc_numeric_create( amount, 100 ) );
+    xaccSplitSetMemo( split, "memo" );
+
+    xaccTransCommitEdit( tx );
+}
+
+/* Bank and Savings each pay N_OLD_TX old transactions and one recent
+   one into Expense. */
+static QofSession*
+create_session( void )
+{
+    QofSession* session = qof_session_new();
+    QofBook* book = qof_session_get_book( session );
+    Account* root = gnc_book_get_root_account( book );
+    gnc_commodity* currency;
+    Account* bank;
+    Account* savings;
+    Account* expense;
+    time_t now = time( NULL );
+    gint i;
+
+    currency = gnc_commodity_table_lookup( gnc_commodity_table_get_table( book ),
+                                           GNC_COMMODITY_NS_CURRENCY, "CAD" );
+    bank = make_account( book, root, "Bank", ACCT_TYPE_BANK, currency );
+    savings = make_account( book, root, "Savings", ACCT_TYPE_BANK, currency );
+    expense = make_account( book, root, "Expense", ACCT_TYPE_EXPENSE, currency );
+
+    for ( i = 0; i < N_OLD_TX; i++ )
+    {
+        add_tx( book, currency, 86400 * (time_t)(i + 1), bank, expense, 100 + i );
+        add_tx( book, currency, 86400 * (time_t)(i + 1), savings, expense, 1000 + i );
+    }
+    add_tx( book, currency, now, bank, expense, 7 );
+    add_tx( book, currency, now, savings, expense, 11 );
+
+    return session;
+}
+
+static void
+save_as( QofSession* session, const gchar* url )
+{
+    QofSession* session_2 = qof_session_new();
+
+    qof_session_begin( session_2, url, FALSE, TRUE, TRUE );
+    if ( qof_session_get_error( session_2 ) != ERR_BACKEND_NO_ERR )
+    {
+        do_test( FALSE, "DB session creation failed" );
+        qof_session_destroy( session_2 );
+        return;
+    }
+    qof_session_swap_data( session, session_2 );
+    qof_session_save( session_2, NULL );
+    do_test( qof_session_get_error( session_2 ) == ERR_BACKEND_NO_ERR, "DB session save" );
+    qof_session_swap_data( session, session_2 );
+
+    qof_session_end( session_2 );
+    qof_session_destroy( session_2 );
+}
+
+static guint
+count_tx( QofBook* book )
+{
+    return qof_collection_count( qof_book_get_collection( book, GNC_ID_TRANS ) );
+}
+
+/* TRUE if every split of 'acct' posted before 'before' has memo 'memo' */
+static gboolean
+old_memos_are( Account* acct, time_t before, const gchar* memo )
+{
+    GList* node;
+
+    for ( node = xaccAccountGetSplitList( acct ); node != NULL; node = node->next )
+    {
+        Split* split = node->data;
+
+        if ( xaccTransGetDate( xaccSplitGetParent( split ) ) >= before ) continue;
+        if ( g_strcmp0( xaccSplitGetMemo( split ), memo ) != 0 ) return FALSE;
+    }
+    return TRUE;
+}
+
+static gboolean
+balance_is( QofBook* book, const gchar* name, gnc_numeric expected )
+{
+    Account* acct = gnc_account_lookup_by_name( gnc_book_get_root_account( book ), name );
+
+    return gnc_numeric_equal( xaccAccountGetBalance( acct ), expected );
+}
+
+static void
+check_balances( QofBook* book, gnc_numeric* expected, const gchar* msg )
+{
+    do_test( balance_is( book, "Bank", expected[0] )
+             && balance_is( book, "Savings", expected[1] )
+             && balance_is( book, "Expense", expected[2] ), msg );
+}
+
+static void
+test_page_in_then_load_all( void )
+{
+    QofSession* session_1 = create_session();
+    QofSession* session_2;
+    QofBook* book_1 = qof_session_get_book( session_1 );
+    QofBook* book_2;
+    Account* root;
+    Account* bank;
+    Account* savings;
+    GncSqlBackend* be;
+    QofQuery* query;
+    gchar* file = tempnam( "/tmp", "test-sqlite3-" );
+    gnc_numeric balances[3];
+    time_t before = 86400 * (N_OLD_TX + 1);
+
+    root = gnc_book_get_root_account( book_1 );
+    balances[0] = xaccAccountGetBalance( gnc_account_lookup_by_name( root, "Bank" ) );
+    balances[1] = xaccAccountGetBalance( gnc_account_lookup_by_name( root, "Savings" ) );
+    balances[2] = xaccAccountGetBalance( gnc_account_lookup_by_name( root, "Expense" ) );
+    save_as( session_1, file );
+
+    g_setenv( "GNC_SQL_LOAD_MONTHS", "1", TRUE );
+    session_2 = qof_session_new();
+    qof_session_begin( session_2, file, TRUE, FALSE, FALSE );
+    qof_session_load( session_2, NULL );
+    g_unsetenv( "GNC_SQL_LOAD_MONTHS" );
+    book_2 = qof_session_get_book( session_2 );
+    be = (GncSqlBackend*)qof_session_get_backend( session_2 );
+    root = gnc_book_get_root_account( book_2 );
+    bank = gnc_account_lookup_by_name( root, "Bank" );
+    savings = gnc_account_lookup_by_name( root, "Savings" );
+
+    do_test( count_tx( book_2 ) == 2, "Only the recent transactions are loaded" );
+    check_balances( book_2, balances, "Balances are right before paging" );
+
+    /* Page in Bank the way a register does */
+    query = qof_query_create_for( GNC_ID_SPLIT );
+    qof_query_set_book( query, book_2 );
+    xaccQueryAddSingleAccountMatch( query, bank, QOF_QUERY_AND );
+    (void)qof_query_run( query );
+    qof_query_destroy( query );
+
+    do_test( count_tx( book_2 ) == 2 + N_OLD_TX, "Paging in Bank loads its transactions" );
+    check_balances( book_2, balances, "Balances are right after paging in Bank" );
+
+    /* Anything read again from the database now shows up */
+    do_test( gnc_sql_execute_nonselect_sql( be, "UPDATE splits SET memo='" DB_MEMO "'" ) > 0,
+             "Memos changed in the database" );
+
+    gnc_sql_transaction_load_all_tx( be );
+
+    do_test( count_tx( book_2 ) == 2 + 2 * N_OLD_TX, "Load-all loads the remaining transactions" );
+    check_balances( book_2, balances, "Balances are right after load-all" );
+    do_test( old_memos_are( bank, before, "memo" ),
+             "Load-all doesn't reload the splits of transactions in memory" );
+    do_test( old_memos_are( savings, before, DB_MEMO ),
+             "Load-all loads the splits of the other transactions" );
+
+    qof_session_end( session_2 );
+    qof_session_destroy( session_2 );
+    qof_session_end( session_1 );
+    qof_session_destroy( session_1 );
+    g_unlink( file );
+    free( file );
+}
+
+int main (int argc, char ** argv)
+{
+    qof_init();
+    cashobjects_register();
+    xaccLogDisable();
+    qof_load_backend_library ("../.libs/", GNC_LIB_NAME);
+
+    test_page_in_then_load_all();
+
+    print_test_results();
+    qof_close();
+    exit(get_rv());
+}
@@ -306,6 +306,7 @@ load_all_accounts( GncSqlBackend* be )
         }
         if ( bal_slist != NULL )
         {
+            g_slist_foreach( bal_slist, (GFunc)g_free, NULL );
             g_slist_free( bal_slist );
         }
     }
@@ -27,6 +27,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include "config.h"
 
 #include <errno.h>
@@ -85,8 +86,13 @@ static const gchar* convert_search_obj( QofIdType objType );
 #endif
 static void gnc_sql_init_object_handlers( void );
 static void update_progress( GncSqlBackend* be );
+static void update_progress_message( GncSqlBackend* be, const gchar* message );
 static void finish_progress( GncSqlBackend* be );
 static void register_standard_col_type_handlers( void );
+static gboolean flush_write_batch( GncSqlBackend* be );
+static void add_to_write_batch( GncSqlBackend* be, const gchar* table_name,
+                                QofIdTypeConst obj_name, gpointer pObject,
+                                const GncSqlColumnTableEntry* table );
 static gboolean reset_version_info( GncSqlBackend* be );
 /*@ null @*/
 static GncSqlStatement* build_insert_statement( GncSqlBackend* be,
@@ -213,6 +219,320 @@ initial_load_cb( const gchar* type, gpointer data_p, gpointer be_p )
     }
 }
 
+/* ================================================================= */
+/* Parallel initial load
+ *
+ * Most of an initial load from a remote server is spent waiting for the
+ * big tables to come over the wire.  If GNC_SQL_PARALLEL_LOAD is set to a
+ * number of connections, gnc_sql_load() opens that many extra connections
+ * and a worker thread on each runs the loaders' SELECTs ahead of time,
+ * biggest tables first, leaving the results in memory.  The loaders still
+ * build the engine objects on the main thread in the usual dependency
+ * order; when one of them issues a query that has been prefetched it
+ * gets the waiting result instead of going to the server.  A query no
+ * worker has started yet is run by the main thread as usual, so nothing
+ * ever waits on the queue.
+ *
+ * The SQL below must match what the loaders build, character for
+ * character.  A query that doesn't match is only wasted work.
+ *
+ * A connection that can't be used from another thread returns no clone,
+ * and then the load runs on the main connection alone.
+ */
+
+#define PARALLEL_LOAD_ENV "GNC_SQL_PARALLEL_LOAD"
+#define PARALLEL_LOAD_MAX_CONNECTIONS 8
+
+typedef struct
+{
+    const gchar* label;
+    /*@ owned @*/
+    gchar* sql;
+    /*@ null @*/
+    GncSqlResult* result;
+    gdouble seconds;
+    gboolean done;
+} ParallelLoadJob;
+
+struct GncSqlParallelLoad
+{
+    GMutex* lock;
+    GCond* job_done;
+    GHashTable* jobs;       /* sql -> ParallelLoadJob, until taken */
+    GQueue* pending;        /* jobs no worker has started */
+    GSList* threads;
+    GSList* conns;
+};
+
+typedef struct
+{
+    GncSqlParallelLoad* pl;
+    GncSqlConnection* conn;
+} ParallelLoadWorker;
+
+static void
+parallel_load_job_free( gpointer data )
+{
+    ParallelLoadJob* job = data;
+
+    if ( job->result != NULL )
+    {
+        gnc_sql_result_dispose( job->result );
+    }
+    g_free( job->sql );
+    g_free( job );
+}
+
+static void
+parallel_load_add_job( GncSqlParallelLoad* pl, const gchar* label, /*@ only @*/ gchar* sql )
+{
+    ParallelLoadJob* job = g_new0( ParallelLoadJob, 1 );
+
+    job->label = label;
+    job->sql = sql;
+    g_hash_table_insert( pl->jobs, job->sql, job );
+    g_queue_push_tail( pl->pending, job );
+}
+
+static void
+parallel_load_add_table( GncSqlParallelLoad* pl, const gchar* table, gboolean with_slots )
+{
+    parallel_load_add_job( pl, table, g_strdup_printf( "SELECT * FROM %s", table ) );
+    if ( with_slots )
+    {
+        parallel_load_add_job( pl, "slots",
+                               g_strdup_printf( "SELECT * FROM slots WHERE obj_guid IN (SELECT DISTINCT guid FROM %s)", table ) );
+    }
+}
+
+/* The queue, biggest tables first.  See load_tx_from_tables() and the
+   initial_load functions of the individual object backends.  When only
+   recent transactions are loaded the transaction queries don't match
+   these, so they are left out. */
+static void
+parallel_load_queue_jobs( GncSqlParallelLoad* pl, gboolean all_tx )
+{
+    const gchar* split_subquery =
+        "SELECT DISTINCT guid FROM splits WHERE tx_guid IN (SELECT DISTINCT guid FROM transactions)";
+
+    if ( all_tx )
+    {
+        parallel_load_add_job( pl, "splits",
+                               g_strdup( "SELECT * FROM splits WHERE tx_guid IN (SELECT DISTINCT guid FROM transactions)" ) );
+        parallel_load_add_job( pl, "slots",
+                               g_strdup_printf( "SELECT * FROM slots WHERE obj_guid IN (%s)", split_subquery ) );
+        parallel_load_add_table( pl, "transactions", TRUE );
+    }
+    parallel_load_add_table( pl, "prices", TRUE );
+    parallel_load_add_table( pl, "entries", FALSE );
+    parallel_load_add_table( pl, "invoices", FALSE );
+    parallel_load_add_table( pl, "lots", TRUE );
+    parallel_load_add_table( pl, "accounts", TRUE );
+    parallel_load_add_table( pl, "commodities", TRUE );
+    parallel_load_add_table( pl, "customers", FALSE );
+    parallel_load_add_table( pl, "vendors", FALSE );
+    parallel_load_add_table( pl, "employees", FALSE );
+    parallel_load_add_table( pl, "jobs", FALSE );
+    parallel_load_add_table( pl, "orders", FALSE );
+    parallel_load_add_table( pl, "billterms", FALSE );
+    parallel_load_add_table( pl, "taxtables", FALSE );
+    parallel_load_add_table( pl, "schedxactions", FALSE );
+    parallel_load_add_table( pl, "budgets", FALSE );
+    parallel_load_add_table( pl, "books", FALSE );
+}
+
+static gpointer
+parallel_load_worker( gpointer data )
+{
+    ParallelLoadWorker* worker = data;
+    GncSqlParallelLoad* pl = worker->pl;
+    GTimer* timer = g_timer_new();
+    ParallelLoadJob* job;
+
+    g_mutex_lock( pl->lock );
+    while ( (job = g_queue_pop_head( pl->pending )) != NULL )
+    {
+        GncSqlStatement* stmt;
+        GncSqlResult* result = NULL;
+
+        g_mutex_unlock( pl->lock );
+
+        g_timer_start( timer );
+        stmt = gnc_sql_connection_create_statement_from_sql( worker->conn, job->sql );
+        if ( stmt != NULL )
+        {
+            result = gnc_sql_connection_execute_select_statement( worker->conn, stmt );
+            gnc_sql_statement_dispose( stmt );
+        }
+
+        g_mutex_lock( pl->lock );
+        job->result = result;
+        job->seconds = g_timer_elapsed( timer, NULL );
+        job->done = TRUE;
+        g_cond_broadcast( pl->job_done );
+    }
+    g_mutex_unlock( pl->lock );
+
+    g_timer_destroy( timer );
+    g_free( worker );
+    return NULL;
+}
+
+static void
+parallel_load_start( GncSqlBackend* be )
+{
+    GncSqlParallelLoad* pl;
+    const gchar* env = g_getenv( PARALLEL_LOAD_ENV );
+    gint n_conns;
+    gint i;
+
+    if ( env == NULL || !g_thread_supported() ) return;
+    n_conns = MIN( atoi( env ), PARALLEL_LOAD_MAX_CONNECTIONS );
+    if ( n_conns <= 0 ) return;
+
+    pl = g_new0( GncSqlParallelLoad, 1 );
+    pl->lock = g_mutex_new();
+    pl->job_done = g_cond_new();
+    pl->jobs = g_hash_table_new_full( g_str_hash, g_str_equal, NULL, parallel_load_job_free );
+    pl->pending = g_queue_new();
+    parallel_load_queue_jobs( pl, be->tx_cutoff == 0 );
+
+    for ( i = 0; i < n_conns; i++ )
+    {
+        GncSqlConnection* conn = gnc_sql_connection_clone( be->conn );
+        ParallelLoadWorker* worker;
+        GThread* thread;
+
+        if ( conn == NULL ) break;
+        pl->conns = g_slist_prepend( pl->conns, conn );
+
+        worker = g_new0( ParallelLoadWorker, 1 );
+        worker->pl = pl;
+        worker->conn = conn;
+        thread = g_thread_create( parallel_load_worker, worker, TRUE, NULL );
+        if ( thread == NULL )
+        {
+            g_free( worker );
+            break;
+        }
+        pl->threads = g_slist_prepend( pl->threads, thread );
+    }
+    PINFO( "Parallel load on %d extra connections", g_slist_length( pl->threads ) );
+
+    be->parallel_load = pl;
+}
+
+/* Hand over the prefetched result of 'sql', waiting for the worker to
+   finish it if need be.  Returns NULL if the caller should run the query
+   itself: it wasn't queued, no worker has got to it, or it failed. */
+static /*@ null @*/ GncSqlResult*
+parallel_load_take( GncSqlBackend* be, const gchar* sql )
+{
+    GncSqlParallelLoad* pl = be->parallel_load;
+    ParallelLoadJob* job;
+    GncSqlResult* result = NULL;
+    gchar* message = NULL;
+
+    if ( pl == NULL || sql == NULL ) return NULL;
+
+    g_mutex_lock( pl->lock );
+    job = g_hash_table_lookup( pl->jobs, sql );
+    if ( job != NULL )
+    {
+        if ( job->done || g_queue_find( pl->pending, job ) == NULL )
+        {
+            while ( !job->done )
+            {
+                g_cond_wait( pl->job_done, pl->lock );
+            }
+            result = job->result;
+            job->result = NULL;
+            if ( result != NULL )
+            {
+                message = g_strdup_printf( _("Loaded %s in %.1f seconds"), job->label, job->seconds );
+            }
+        }
+        else
+        {
+            g_queue_remove( pl->pending, job );
+        }
+        g_hash_table_remove( pl->jobs, sql );
+    }
+    g_mutex_unlock( pl->lock );
+
+    if ( message != NULL )
+    {
+        PINFO( "%s", message );
+        update_progress_message( be, message );
+        g_free( message );
+    }
+    return result;
+}
+
+static void
+parallel_load_finish( GncSqlBackend* be )
+{
+    GncSqlParallelLoad* pl = be->parallel_load;
+    GSList* node;
+
+    if ( pl == NULL ) return;
+    be->parallel_load = NULL;
+
+    g_mutex_lock( pl->lock );
+    g_queue_clear( pl->pending );
+    g_mutex_unlock( pl->lock );
+
+    for ( node = pl->threads; node != NULL; node = node->next )
+    {
+        (void)g_thread_join( node->data );
+    }
+    g_slist_free( pl->threads );
+
+    /* Results nobody asked for still belong to their connections */
+    g_hash_table_destroy( pl->jobs );
+    for ( node = pl->conns; node != NULL; node = node->next )
+    {
+        gnc_sql_connection_dispose( node->data );
+    }
+    g_slist_free( pl->conns );
+
+    g_queue_free( pl->pending );
+    g_cond_free( pl->job_done );
+    g_mutex_free( pl->lock );
+    g_free( pl );
+}
+
+/* ================================================================= */
+/* Paged transaction loading
+ *
+ * With GNC_SQL_LOAD_MONTHS=n in the environment, the initial load only
+ * brings in the transactions posted since the start of the month n months
+ * back.  The account start balances are set to the totals of the splits
+ * left in the database, so balances are right from the start, and the
+ * older transactions of an account are loaded the first time a query
+ * (e.g. a register being opened) asks for the splits of that account.
+ * See gnc-transaction-sql.c.
+ */
+
+#define LOAD_MONTHS_ENV "GNC_SQL_LOAD_MONTHS"
+
+static time_t
+initial_load_cutoff( void )
+{
+    const gchar* env = g_getenv( LOAD_MONTHS_ENV );
+    struct tm tm;
+    gint months;
+
+    if ( env == NULL ) return 0;
+    months = atoi( env );
+    if ( months <= 0 ) return 0;
+
+    gnc_tm_get_today_start( &tm );
+    tm.tm_mday = 1;
+    tm.tm_mon -= months;
+    return mktime( &tm );
+}
+
 void
 gnc_sql_load( GncSqlBackend* be, /*@ dependent @*/ QofBook *book, QofBackendLoadType loadType )
 {
@@ -232,6 +552,9 @@ gnc_sql_load( GncSqlBackend* be, /*@ dependent @*/ QofBook *book, QofBackendLoad
         g_assert( be->primary_book == NULL );
         be->primary_book = book;
 
+        be->tx_cutoff = initial_load_cutoff();
+        parallel_load_start( be );
+
         /* Load any initial stuff. Some of this needs to happen in a certain order */
         for ( i = 0; fixed_load_order[i] != NULL; i++ )
         {
@@ -261,6 +584,8 @@ gnc_sql_load( GncSqlBackend* be, /*@ dependent @*/ QofBook *book, QofBackendLoad
         qof_object_foreach_backend( GNC_SQL_BACKEND, initial_load_cb, be );
 
         gnc_account_foreach_descendant( root, (AccountCb)xaccAccountCommitEdit, NULL );
+
+        parallel_load_finish( be );
     }
     else if ( loadType == LOAD_TYPE_LOAD_ALL )
     {
@@ -472,9 +797,15 @@ write_cb( const gchar* type, gpointer data_p, gpointer be_p )
 
 static void
 update_progress( GncSqlBackend* be )
+{
+    update_progress_message( be, NULL );
+}
+
+static void
+update_progress_message( GncSqlBackend* be, const gchar* message )
 {
     if ( be->be.percentage != NULL )
-        (be->be.percentage)( NULL, 101.0 );
+        (be->be.percentage)( message, 101.0 );
 }
 
 static void
@@ -510,6 +841,7 @@ gnc_sql_sync_all( GncSqlBackend* be, /*@ dependent @*/ QofBook *book )
     be->operations_done = 0;
 
     is_ok = gnc_sql_connection_begin_transaction( be->conn );
+    gnc_sql_begin_write_batch( be );
 
     // FIXME: should write the set of commodities that are used
     //write_commodities( be, book );
@@ -537,6 +869,10 @@ gnc_sql_sync_all( GncSqlBackend* be, /*@ dependent @*/ QofBook *book )
     {
         qof_object_foreach_backend( GNC_SQL_BACKEND, write_cb, be );
     }
+    if ( !gnc_sql_end_write_batch( be ) )
+    {
+        is_ok = FALSE;
+    }
     if ( is_ok )
     {
         is_ok = gnc_sql_connection_commit_transaction( be->conn );
@@ -664,7 +1000,12 @@ gnc_sql_commit_edit( GncSqlBackend *be, QofInstance *inst )
     be_data.inst = inst;
     be_data.is_ok = TRUE;
 
+    gnc_sql_begin_write_batch( be );
     qof_object_foreach_backend( GNC_SQL_BACKEND, commit_cb, &be_data );
+    if ( !gnc_sql_end_write_batch( be ) )
+    {
+        be_data.is_ok = FALSE;
+    }
 
     if ( !be_data.is_known )
     {
@@ -1952,16 +2293,16 @@ load_timespec( const GncSqlBackend* be, GncSqlRow* row,
             const gchar* s = g_value_get_string( val );
             if ( s != NULL )
             {
-                gchar* buf;
-                buf = g_strdup_printf( "%c%c%c%c-%c%c-%c%c %c%c:%c%c:%c%c",
-                                       s[0], s[1], s[2], s[3],
-                                       s[4], s[5],
-                                       s[6], s[7],
-                                       s[8], s[9],
-                                       s[10], s[11],
-                                       s[12], s[13] );
+                /* "YYYYMMDDHHMMSS" to "YYYY-MM-DD HH:MM:SS", on the stack
+                   since it is done for every timestamp loaded. */
+                gchar buf[] = "YYYY-MM-DD HH:MM:SS";
+                memcpy( buf, s, 4 );
+                memcpy( buf + 5, s + 4, 2 );
+                memcpy( buf + 8, s + 6, 2 );
+                memcpy( buf + 11, s + 8, 2 );
+                memcpy( buf + 14, s + 10, 2 );
+                memcpy( buf + 17, s + 12, 2 );
                 ts = gnc_iso8601_to_timespec_gmt( buf );
-                g_free( buf );
                 isOK = TRUE;
             }
 
@@ -2520,6 +2861,12 @@ gnc_sql_execute_select_statement( GncSqlBackend* be, GncSqlStatement* stmt )
     g_return_val_if_fail( be != NULL, NULL );
     g_return_val_if_fail( stmt != NULL, NULL );
 
+    (void)flush_write_batch( be );
+    result = parallel_load_take( be, gnc_sql_statement_to_sql( stmt ) );
+    if ( result != NULL )
+    {
+        return result;
+    }
     result = gnc_sql_connection_execute_select_statement( be->conn, stmt );
     if ( result == NULL )
     {
@@ -2557,6 +2904,12 @@ gnc_sql_execute_select_sql( GncSqlBackend* be, const gchar* sql )
     g_return_val_if_fail( be != NULL, NULL );
     g_return_val_if_fail( sql != NULL, NULL );
 
+    (void)flush_write_batch( be );
+    result = parallel_load_take( be, sql );
+    if ( result != NULL )
+    {
+        return result;
+    }
     stmt = gnc_sql_create_statement_from_sql( be, sql );
     if ( stmt == NULL )
     {
@@ -2582,6 +2935,7 @@ gnc_sql_execute_nonselect_sql( GncSqlBackend* be, const gchar* sql )
     g_return_val_if_fail( be != NULL, 0 );
     g_return_val_if_fail( sql != NULL, 0 );
 
+    (void)flush_write_batch( be );
     stmt = gnc_sql_create_statement_from_sql( be, sql );
     if ( stmt == NULL )
     {
@@ -2696,6 +3050,13 @@ gnc_sql_do_db_operation( GncSqlBackend* be,
     g_return_val_if_fail( pObject != NULL, FALSE );
     g_return_val_if_fail( table != NULL, FALSE );
 
+    if ( op == OP_DB_INSERT && be->write_batch != NULL && be->insert_batch_size > 1 )
+    {
+        add_to_write_batch( be, table_name, obj_name, pObject, table );
+        return TRUE;
+    }
+    (void)flush_write_batch( be );
+
     if ( op == OP_DB_INSERT )
     {
         stmt = build_insert_statement( be, table_name, obj_name, pObject, table );
@@ -2840,39 +3201,79 @@ free_gvalue_list( GSList* list )
     g_slist_free( list );
 }
 
-/*@ null @*/ static GncSqlStatement*
-build_insert_statement( GncSqlBackend* be,
-                        const gchar* table_name,
-                        QofIdTypeConst obj_name, gpointer pObject,
-                        const GncSqlColumnTableEntry* table )
+/* ================================================================= */
+/* Statement templates and write batching
+ *
+ * The column list of a table's INSERT and UPDATE statements depends only
+ * on the table and its column table, so it is worked out once and kept.
+ * Only the values are formatted for each row.
+ *
+ * While a write batch is open (see gnc_sql_begin_write_batch()), INSERTs
+ * into the same table are coalesced into multi-row INSERTs of up to
+ * be->insert_batch_size rows.  Any other statement sent through this file
+ * flushes the pending rows first, so the database still sees everything
+ * in the order it was issued.
+ *
+ * A held back INSERT is only known to have failed when the batch is sent,
+ * which may be while some other object is being saved.  So the batch keeps
+ * the instances whose rows it holds, and a failed flush is charged to them:
+ * they are logged and marked dirty again, and the batch as a whole fails
+ * (see gnc_sql_end_write_batch()).  The statement that triggered the flush
+ * still runs and reports only its own result.
+ */
+
+#define WRITE_BATCH_MAX_SQL_LENGTH (256 * 1024)
+
+typedef struct
 {
-    GncSqlStatement* stmt;
+    gchar* insert_prefix;       /* "INSERT INTO table(col,...) VALUES" */
+    gchar* update_prefix;       /* "UPDATE table SET " */
+    GPtrArray* colnames;
+} GncSqlStatementTemplate;
+
+struct GncSqlWriteBatch
+{
+    gint depth;
+    gboolean is_ok;
+    /*@ dependent @*/ /*@ null @*/
+    const GncSqlStatementTemplate* tmpl;
     GString* sql;
-    GSList* values;
-    GSList* node;
-    gchar* sqlbuf;
+    gint n_rows;
+    GSList* pending;            /* referenced instances with a row in sql */
+};
+
+/* table name and column table -> GncSqlStatementTemplate, never freed */
+static /*@ null @*//*@ only @*/ GHashTable* g_statementTemplates = NULL;
+
+static const GncSqlStatementTemplate*
+get_statement_template( const gchar* table_name, const GncSqlColumnTableEntry* table )
+{
+    GncSqlStatementTemplate* tmpl;
+    const GncSqlColumnTableEntry* table_row;
     GList* colnames = NULL;
     GList* colname;
-    const GncSqlColumnTableEntry* table_row;
-
-    g_return_val_if_fail( be != NULL, NULL );
-    g_return_val_if_fail( table_name != NULL, NULL );
-    g_return_val_if_fail( obj_name != NULL, NULL );
-    g_return_val_if_fail( pObject != NULL, NULL );
-    g_return_val_if_fail( table != NULL, NULL );
+    GString* sql;
+    gchar* key;
 
-    sqlbuf = g_strdup_printf( "INSERT INTO %s(", table_name );
-    sql = g_string_new( sqlbuf );
-    g_free( sqlbuf );
+    if ( g_statementTemplates == NULL )
+    {
+        g_statementTemplates = g_hash_table_new( g_str_hash, g_str_equal );
+    }
+    key = g_strdup_printf( "%s/%p", table_name, table );
+    tmpl = g_hash_table_lookup( g_statementTemplates, key );
+    if ( tmpl != NULL )
+    {
+        g_free( key );
+        return tmpl;
+    }
 
-    // Get all col names and all values
+    // Get all col names
     for ( table_row = table; table_row->col_name != NULL; table_row++ )
     {
         if (( table_row->flags & COL_AUTOINC ) == 0 )
         {
             GncSqlColumnTypeHandler* pHandler;
 
-            // Add col names to the list
             pHandler = get_handler( table_row );
             g_assert( pHandler != NULL );
             pHandler->add_colname_to_list_fn( table_row, &colnames );
@@ -2880,18 +3281,38 @@ build_insert_statement( GncSqlBackend* be,
     }
     g_assert( colnames != NULL );
 
+    tmpl = g_new0( GncSqlStatementTemplate, 1 );
+    tmpl->colnames = g_ptr_array_new();
+    sql = g_string_new( NULL );
+    g_string_printf( sql, "INSERT INTO %s(", table_name );
     for ( colname = colnames; colname != NULL; colname = colname->next )
     {
         if ( colname != colnames )
         {
-            g_string_append( sql, "," );
+            (void)g_string_append( sql, "," );
         }
-        g_string_append( sql, (gchar*)colname->data );
-        g_free( colname->data );
+        (void)g_string_append( sql, (gchar*)colname->data );
+        g_ptr_array_add( tmpl->colnames, colname->data );
     }
     g_list_free( colnames );
+    (void)g_string_append( sql, ") VALUES" );
+    tmpl->insert_prefix = g_string_free( sql, FALSE );
+    tmpl->update_prefix = g_strdup_printf( "UPDATE %s SET ", table_name );
+
+    g_hash_table_insert( g_statementTemplates, key, tmpl );
+    return tmpl;
+}
 
-    g_string_append( sql, ") VALUES(" );
+/* Appends "(value,...)" for one object */
+static void
+append_values_row( GncSqlBackend* be, GString* sql,
+                   QofIdTypeConst obj_name, gpointer pObject,
+                   const GncSqlColumnTableEntry* table )
+{
+    GSList* values;
+    GSList* node;
+
+    (void)g_string_append( sql, "(" );
     values = create_gslist_from_values( be, obj_name, pObject, table );
     for ( node = values; node != NULL; node = node->next )
     {
@@ -2904,10 +3325,28 @@ build_insert_statement( GncSqlBackend* be,
         value_str = gnc_sql_get_sql_value( be->conn, value );
         (void)g_string_append( sql, value_str );
         g_free( value_str );
-        (void)g_value_reset( value );
     }
     free_gvalue_list( values );
     (void)g_string_append( sql, ")" );
+}
+
+/*@ null @*/ static GncSqlStatement*
+build_insert_statement( GncSqlBackend* be,
+                        const gchar* table_name,
+                        QofIdTypeConst obj_name, gpointer pObject,
+                        const GncSqlColumnTableEntry* table )
+{
+    GncSqlStatement* stmt;
+    GString* sql;
+
+    g_return_val_if_fail( be != NULL, NULL );
+    g_return_val_if_fail( table_name != NULL, NULL );
+    g_return_val_if_fail( obj_name != NULL, NULL );
+    g_return_val_if_fail( pObject != NULL, NULL );
+    g_return_val_if_fail( table != NULL, NULL );
+
+    sql = g_string_new( get_statement_template( table_name, table )->insert_prefix );
+    append_values_row( be, sql, obj_name, pObject, table );
 
     stmt = gnc_sql_connection_create_statement_from_sql( be->conn, sql->str );
     (void)g_string_free( sql, TRUE );
@@ -2921,15 +3360,12 @@ build_update_statement( GncSqlBackend* be,
                         QofIdTypeConst obj_name, gpointer pObject,
                         const GncSqlColumnTableEntry* table )
 {
+    const GncSqlStatementTemplate* tmpl;
     GncSqlStatement* stmt;
     GString* sql;
     GSList* values;
-    GList* colnames = NULL;
     GSList* value;
-    GList* colname;
-    gboolean firstCol;
-    const GncSqlColumnTableEntry* table_row;
-    gchar* sqlbuf;
+    guint col;
 
     g_return_val_if_fail( be != NULL, NULL );
     g_return_val_if_fail( table_name != NULL, NULL );
@@ -2937,50 +3373,27 @@ build_update_statement( GncSqlBackend* be,
     g_return_val_if_fail( pObject != NULL, NULL );
     g_return_val_if_fail( table != NULL, NULL );
 
-    // Get all col names and all values
-    for ( table_row = table; table_row->col_name != NULL; table_row++ )
-    {
-        if (( table_row->flags & COL_AUTOINC ) == 0 )
-        {
-            GncSqlColumnTypeHandler* pHandler;
-
-            // Add col names to the list
-            pHandler = get_handler( table_row );
-            g_assert( pHandler != NULL );
-            pHandler->add_colname_to_list_fn( table_row, &colnames );
-        }
-    }
-    g_assert( colnames != NULL );
+    tmpl = get_statement_template( table_name, table );
     values = create_gslist_from_values( be, obj_name, pObject, table );
 
-    // Create the SQL statement
-    sqlbuf = g_strdup_printf( "UPDATE %s SET ", table_name );
-    sql = g_string_new( sqlbuf );
-    g_free( sqlbuf );
-
-    firstCol = TRUE;
-    for ( colname = colnames->next, value = values->next;
-            colname != NULL && value != NULL;
-            colname = colname->next, value = value->next )
+    // Create the SQL statement.  The first column is the key.
+    sql = g_string_new( tmpl->update_prefix );
+    for ( col = 1, value = values->next;
+            col < tmpl->colnames->len && value != NULL;
+            col++, value = value->next )
     {
         gchar* value_str;
-        if ( !firstCol )
+        if ( col != 1 )
         {
             (void)g_string_append( sql, "," );
         }
-        (void)g_string_append( sql, (gchar*)colname->data );
+        (void)g_string_append( sql, g_ptr_array_index( tmpl->colnames, col ) );
         (void)g_string_append( sql, "=" );
         value_str = gnc_sql_get_sql_value( be->conn, (GValue*)(value->data) );
         (void)g_string_append( sql, value_str );
         g_free( value_str );
-        firstCol = FALSE;
     }
-    for ( colname = colnames; colname != NULL; colname = colname->next )
-    {
-        g_free( colname->data );
-    }
-    g_list_free( colnames );
-    if ( value != NULL || colname != NULL )
+    if ( value != NULL || col < tmpl->colnames->len )
     {
         PERR( "Mismatch in number of column names and values" );
     }
@@ -2993,6 +3406,125 @@ build_update_statement( GncSqlBackend* be,
     return stmt;
 }
 
+void
+gnc_sql_begin_write_batch( GncSqlBackend* be )
+{
+    g_return_if_fail( be != NULL );
+
+    if ( be->write_batch == NULL )
+    {
+        be->write_batch = g_new0( GncSqlWriteBatch, 1 );
+        be->write_batch->is_ok = TRUE;
+        be->write_batch->sql = g_string_new( NULL );
+    }
+    be->write_batch->depth++;
+}
+
+gboolean
+gnc_sql_end_write_batch( GncSqlBackend* be )
+{
+    GncSqlWriteBatch* batch;
+    gboolean is_ok;
+
+    g_return_val_if_fail( be != NULL, FALSE );
+    g_return_val_if_fail( be->write_batch != NULL, FALSE );
+
+    batch = be->write_batch;
+    is_ok = flush_write_batch( be ) && batch->is_ok;
+    if ( --batch->depth > 0 )
+    {
+        return is_ok;
+    }
+
+    be->write_batch = NULL;
+    (void)g_string_free( batch->sql, TRUE );
+    g_free( batch );
+    return is_ok;
+}
+
+/* Sends the pending rows, if any.  Returns FALSE if that failed. */
+static gboolean
+flush_write_batch( GncSqlBackend* be )
+{
+    GncSqlWriteBatch* batch = be->write_batch;
+    GncSqlStatement* stmt;
+    GSList* node;
+    gint result = -1;
+
+    if ( batch == NULL || batch->n_rows == 0 ) return TRUE;
+
+    DEBUG( "Flushing %d rows\n", batch->n_rows );
+    stmt = gnc_sql_connection_create_statement_from_sql( be->conn, batch->sql->str );
+    if ( stmt != NULL )
+    {
+        result = gnc_sql_connection_execute_nonselect_statement( be->conn, stmt );
+        gnc_sql_statement_dispose( stmt );
+    }
+    if ( result == -1 )
+    {
+        PERR( "SQL error: %s\n", batch->sql->str );
+        qof_backend_set_error( &be->be, ERR_BACKEND_SERVER_ERR );
+        batch->is_ok = FALSE;
+    }
+    for ( node = batch->pending; node != NULL; node = node->next )
+    {
+        QofInstance* inst = QOF_INSTANCE(node->data);
+
+        if ( result == -1 )
+        {
+            gchar guid_buf[GUID_ENCODING_LENGTH+1];
+
+            (void)guid_to_string_buff( qof_instance_get_guid( inst ), guid_buf );
+            PERR( "%s %s was not saved\n", inst->e_type, guid_buf );
+            qof_instance_set_dirty( inst );
+        }
+        g_object_unref( inst );
+    }
+    g_slist_free( batch->pending );
+    batch->pending = NULL;
+
+    batch->tmpl = NULL;
+    batch->n_rows = 0;
+    g_string_truncate( batch->sql, 0 );
+    return result != -1;
+}
+
+/* Queues the row.  Whether it was written is only known when the batch is
+   flushed, so this can't fail. */
+static void
+add_to_write_batch( GncSqlBackend* be, const gchar* table_name,
+                    QofIdTypeConst obj_name, gpointer pObject,
+                    const GncSqlColumnTableEntry* table )
+{
+    GncSqlWriteBatch* batch = be->write_batch;
+    const GncSqlStatementTemplate* tmpl = get_statement_template( table_name, table );
+
+    if ( batch->tmpl != tmpl || batch->n_rows >= be->insert_batch_size
+            || batch->sql->len >= WRITE_BATCH_MAX_SQL_LENGTH )
+    {
+        (void)flush_write_batch( be );
+    }
+    if ( batch->n_rows == 0 )
+    {
+        (void)g_string_assign( batch->sql, tmpl->insert_prefix );
+        batch->tmpl = tmpl;
+    }
+    else
+    {
+        (void)g_string_append( batch->sql, "," );
+    }
+    append_values_row( be, batch->sql, obj_name, pObject, table );
+    batch->n_rows++;
+
+    /* Slots, recurrences, tax table entries and the like aren't
+       instances and are saved under their table name; their owner is
+       saved in the same batch. */
+    if ( qof_object_lookup( obj_name ) != NULL && QOF_IS_INSTANCE(pObject) )
+    {
+        batch->pending = g_slist_prepend( batch->pending, g_object_ref( pObject ) );
+    }
+}
+
 /*@ null @*/ static GncSqlStatement*
 build_delete_statement( GncSqlBackend* be,
                         const gchar* table_name,
@@ -44,6 +44,8 @@
 #include <gmodule.h>
 
 typedef struct GncSqlConnection GncSqlConnection;
+typedef struct GncSqlParallelLoad GncSqlParallelLoad;
+typedef struct GncSqlWriteBatch GncSqlWriteBatch;
 
 /**
  * @struct GncSqlBackend
@@ -63,6 +65,12 @@ struct GncSqlBackend
     gint operations_done;			/**< Number of operations (save/load) done */
     GHashTable* versions;			/**< Version number for each table */
     const gchar* timespec_format;	/**< Format string for SQL for timespec values */
+    /*@ null @*/
+    GncSqlParallelLoad* parallel_load;	/**< Tables being fetched ahead during the initial load */
+    gint insert_batch_size;			/**< Max rows in a multi-row INSERT, 0 or 1 if not supported */
+    /*@ null @*/
+    GncSqlWriteBatch* write_batch;	/**< INSERTs waiting to be sent */
+    time_t tx_cutoff;				/**< Transactions posted before this aren't loaded yet, 0 if all are */
 };
 typedef struct GncSqlBackend GncSqlBackend;
 
@@ -160,6 +168,8 @@ struct GncSqlConnection
     gboolean (*createIndex)( GncSqlConnection*, const gchar*, const gchar*, const GncSqlColumnTableEntry* ); /**< Returns TRUE if successful, FALSE if error */
     gboolean (*addColumnsToTable)( GncSqlConnection*, const gchar* table, GList* ); /**< Returns TRUE if successful, FALSE if error */
     gchar* (*quoteString)( const GncSqlConnection*, gchar* );
+    /*@ null @*/
+    GncSqlConnection* (*clone)( GncSqlConnection* ); /**< Returns a new connection to the same database, NULL if error or not supported.  Its SELECTs run on another thread, so their results must be complete in memory when returned */
 };
 #define gnc_sql_connection_dispose(CONN) (CONN)->dispose(CONN)
 #define gnc_sql_connection_execute_select_statement(CONN,STMT) \
@@ -184,6 +194,8 @@ struct GncSqlConnection
 		(CONN)->addColumnsToTable(CONN,TABLENAME,COLLIST)
 #define gnc_sql_connection_quote_string(CONN,STR) \
 		(CONN)->quoteString(CONN,STR)
+#define gnc_sql_connection_clone(CONN) \
+		((CONN)->clone != NULL ? (CONN)->clone(CONN) : NULL)
 
 /**
  * @struct GncSqlRow
@@ -430,10 +442,13 @@ void gnc_sql_add_colname_to_list( const GncSqlColumnTableEntry* table_row, GList
  * @param be SQL backend struct
  * @param op Operation type
  * @param table_name SQL table name
- * @param obj_name QOF object type name
+ * @param obj_name QOF object type name, or the table name for rows that
+ * aren't instances
  * @param pObject Gnucash object
  * @param table DB table description
- * @return TRUE if successful, FALSE if not
+ * @return TRUE if successful, FALSE if not.  An INSERT held back by a write
+ * batch returns TRUE; if it later fails, gnc_sql_end_write_batch() returns
+ * FALSE and the object is marked dirty again.
  */
 gboolean gnc_sql_do_db_operation( GncSqlBackend* be,
                                   E_DB_OPERATION op,
@@ -442,6 +457,25 @@ gboolean gnc_sql_do_db_operation( GncSqlBackend* be,
                                   gpointer pObject,
                                   const GncSqlColumnTableEntry* table );
 
+/**
+ * Starts a write batch.  Until the matching gnc_sql_end_write_batch(),
+ * INSERTs done by gnc_sql_do_db_operation() may be held back and sent as
+ * multi-row INSERTs.  Any other statement sends the held rows first.
+ * Batches nest.
+ *
+ * @param be SQL backend struct
+ */
+void gnc_sql_begin_write_batch( GncSqlBackend* be );
+
+/**
+ * Ends a write batch, sending any rows still held back.
+ *
+ * @param be SQL backend struct
+ * @return TRUE if all batched rows were written, FALSE if not.  Instances
+ * whose rows failed are logged and marked dirty again.
+ */
+gboolean gnc_sql_end_write_batch( GncSqlBackend* be );
+
 /**
  * Executes an SQL SELECT statement and returns the result rows.  If an error
  * occurs, an entry is added to the log, an error status is returned to qof and
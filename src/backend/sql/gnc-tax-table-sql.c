@@ -442,10 +442,11 @@ save_tt_entries( GncSqlBackend* be, const GncGUID* guid, GList* entries )
     for ( entry = entries; entry != NULL && is_ok; entry = entry->next )
     {
         GncTaxTableEntry* e = (GncTaxTableEntry*)entry->data;
+        /* Entries aren't instances, so they mustn't pass as tax tables */
         is_ok = gnc_sql_do_db_operation( be,
                                          OP_DB_INSERT,
                                          TTENTRIES_TABLE_NAME,
-                                         GNC_ID_TAXTABLE, e,
+                                         TTENTRIES_TABLE_NAME, e,
                                          ttentries_col_table );
     }
 
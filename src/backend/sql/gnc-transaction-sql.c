@@ -53,9 +53,6 @@
 #include "splint-defs.h"
 #endif
 
-#define SIMPLE_QUERY_COMPILATION 1
-#define LOAD_TRANSACTIONS_AS_NEEDED 0
-
 static QofLogModule log_module = G_LOG_DOMAIN;
 
 #define TRANSACTION_TABLE "transactions"
@@ -63,6 +60,9 @@ static QofLogModule log_module = G_LOG_DOMAIN;
 #define SPLIT_TABLE "splits"
 #define SPLIT_TABLE_VERSION 4
 
+/* Book data key for the accounts whose older transactions are loaded */
+#define PAGED_ACCOUNTS_KEY "gnc-sql-paged-accounts"
+
 typedef struct
 {
     /*@ dependent @*/ GncSqlBackend* be;
@@ -303,66 +303,102 @@ load_single_tx( GncSqlBackend* be, GncSqlRow* row )
 }
 
 /**
- * Structure to hold start/end balances for each account.  The values are
- * saved before splits are loaded, and then used to adjust the start balances
- * so that the end balances (which are calculated and correct on initial load)
- * are unchanged.
- */
-typedef struct
-{
-    /*@ dependent @*/ Account* acc;
-    gnc_numeric start_bal;
-    gnc_numeric end_bal;
-    gnc_numeric start_cleared_bal;
-    gnc_numeric end_cleared_bal;
-    gnc_numeric start_reconciled_bal;
-    gnc_numeric end_reconciled_bal;
-} full_acct_balances_t;
-
-/**
- * Saves the start/end balances for an account.
+ * Takes loaded splits back out of their accounts' starting balances.
+ *
+ * While transactions are paged (be->tx_cutoff != 0), the starting balance
+ * of each account is the total of its splits posted before the cutoff,
+ * none of which were loaded at startup (see
+ * gnc_sql_get_account_balances_slist()).  When some of those transactions
+ * are loaded later, their splits have to come back out of the starting
+ * balances or they would be counted twice.
  *
- * @param acc Account
- * @param pData Pointer to balances info list
+ * @param be SQL backend
+ * @param tx_list List of newly loaded transactions
  */
 static void
-save_account_balances( Account* acc, gpointer pData )
+uncount_older_splits( GncSqlBackend* be, GList* tx_list )
 {
-    GSList** pBal_list = (GSList**)pData;
-    full_acct_balances_t* newbal;
-    gnc_numeric* pstart;
-    gnc_numeric* pend;
-    gnc_numeric* pstart_c;
-    gnc_numeric* pend_c;
-    gnc_numeric* pstart_r;
-    gnc_numeric* pend_r;
-
-    newbal = g_malloc( (gsize)sizeof( full_acct_balances_t ) );
-    g_assert( newbal != NULL );
-
-    newbal->acc = acc;
-    g_object_get( acc,
-                  "start-balance", &pstart,
-                  "end-balance", &pend,
-                  "start-cleared-balance", &pstart_c,
-                  "end-cleared-balance", &pend_c,
-                  "start-reconciled-balance", &pstart_r,
-                  "end-reconciled-balance", &pend_r,
-                  NULL );
-    newbal->start_bal = *pstart;
-    newbal->end_bal = *pend;
-    newbal->start_cleared_bal = *pstart_c;
-    newbal->end_cleared_bal = *pend_c;
-    newbal->start_reconciled_bal = *pstart_r;
-    newbal->end_reconciled_bal = *pend_r;
-    *pBal_list = g_slist_append( *pBal_list, newbal );
-
-    g_free( pstart );
-    g_free( pend );
-    g_free( pstart_c );
-    g_free( pend_c );
-    g_free( pstart_r );
-    g_free( pend_r );
+    GHashTable* adjustments;
+    GHashTableIter iter;
+    gpointer value;
+    GList* node;
+
+    if ( be->tx_cutoff == 0 ) return;
+
+    adjustments = g_hash_table_new_full( g_direct_hash, g_direct_equal, NULL, g_free );
+    for ( node = tx_list; node != NULL; node = node->next )
+    {
+        Transaction* tx = GNC_TRANSACTION(node->data);
+        GList* split_node;
+
+        if ( xaccTransGetDate( tx ) >= be->tx_cutoff ) continue;
+
+        for ( split_node = xaccTransGetSplitList( tx ); split_node != NULL; split_node = split_node->next )
+        {
+            Split* split = split_node->data;
+            Account* acc = xaccSplitGetAccount( split );
+            gnc_numeric amount = xaccSplitGetAmount( split );
+            char state = xaccSplitGetReconcile( split );
+            acct_balances_t* adj;
+
+            if ( acc == NULL ) continue;
+            adj = g_hash_table_lookup( adjustments, acc );
+            if ( adj == NULL )
+            {
+                adj = g_new0( acct_balances_t, 1 );
+                adj->acct = acc;
+                adj->balance = gnc_numeric_zero();
+                adj->cleared_balance = gnc_numeric_zero();
+                adj->reconciled_balance = gnc_numeric_zero();
+                g_hash_table_insert( adjustments, acc, adj );
+            }
+            adj->balance = gnc_numeric_add( adj->balance, amount,
+                                            GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD );
+            if ( state != NREC )
+            {
+                adj->cleared_balance = gnc_numeric_add( adj->cleared_balance, amount,
+                                                        GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD );
+            }
+            if ( state == YREC || state == FREC )
+            {
+                adj->reconciled_balance = gnc_numeric_add( adj->reconciled_balance, amount,
+                                          GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD );
+            }
+        }
+    }
+
+    g_hash_table_iter_init( &iter, adjustments );
+    while ( g_hash_table_iter_next( &iter, NULL, &value ) )
+    {
+        acct_balances_t* adj = value;
+        gnc_numeric* pstart;
+        gnc_numeric* pstart_c;
+        gnc_numeric* pstart_r;
+        gnc_numeric start;
+        gnc_numeric start_c;
+        gnc_numeric start_r;
+
+        g_object_get( adj->acct,
+                      "start-balance", &pstart,
+                      "start-cleared-balance", &pstart_c,
+                      "start-reconciled-balance", &pstart_r,
+                      NULL );
+        start = gnc_numeric_sub( *pstart, adj->balance,
+                                 GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD );
+        start_c = gnc_numeric_sub( *pstart_c, adj->cleared_balance,
+                                   GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD );
+        start_r = gnc_numeric_sub( *pstart_r, adj->reconciled_balance,
+                                   GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD );
+        g_object_set( adj->acct,
+                      "start-balance", &start,
+                      "start-cleared-balance", &start_c,
+                      "start-reconciled-balance", &start_r,
+                      NULL );
+        g_free( pstart );
+        g_free( pstart_c );
+        g_free( pstart_r );
+    }
+    g_hash_table_destroy( adjustments );
 }
 
 /**
@@ -387,20 +423,6 @@ query_transactions( GncSqlBackend* be, GncSqlStatement* stmt )
         GList* node;
         GncSqlRow* row;
         Transaction* tx;
-        GSList* bal_list = NULL;
-        GSList* nextbal;
-        Account* root = gnc_book_get_root_account( be->primary_book );
-
-#if LOAD_TRANSACTIONS_AS_NEEDED
-        qof_event_suspend();
-        xaccAccountBeginEdit( root );
-
-        // Save the start/ending balances (balance, cleared and reconciled) for
-        // every account.
-        gnc_account_foreach_descendant( gnc_book_get_root_account( be->primary_book ),
-                                        save_account_balances,
-                                        &bal_list );
-#endif
 
         // Load the transactions
         row = gnc_sql_result_get_first_row( result );
@@ -428,65 +450,8 @@ query_transactions( GncSqlBackend* be, GncSqlStatement* stmt )
             Transaction* pTx = GNC_TRANSACTION(node->data);
             xaccTransCommitEdit( pTx );
         }
+        uncount_older_splits( be, tx_list );
         g_list_free( tx_list );
-
-#if LOAD_TRANSACTIONS_AS_NEEDED
-        // Update the account balances based on the loaded splits.  If the end
-        // balance has changed, update the start balance so that the end
-        // balance is the same as it was before the splits were loaded.
-        // Repeat for cleared and reconciled balances.
-        for ( nextbal = bal_list; nextbal != NULL; nextbal = nextbal->next )
-        {
-            full_acct_balances_t* balns = (full_acct_balances_t*)nextbal->data;
-            gnc_numeric* pnew_end_bal;
-            gnc_numeric* pnew_end_c_bal;
-            gnc_numeric* pnew_end_r_bal;
-            gnc_numeric adj;
-
-            g_object_get( balns->acc,
-                          "end-balance", &pnew_end_bal,
-                          "end-cleared-balance", &pnew_end_c_bal,
-                          "end-reconciled-balance", &pnew_end_r_bal,
-                          NULL );
-
-            if ( !gnc_numeric_eq( *pnew_end_bal, balns->end_bal ) )
-            {
-                adj = gnc_numeric_sub( balns->end_bal, *pnew_end_bal,
-                                       GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD );
-                balns->start_bal = gnc_numeric_add( balns->start_bal, adj,
-                                                    GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD );
-                g_object_set( balns->acc, "start-balance", &balns->start_bal, NULL );
-            }
-            if ( !gnc_numeric_eq( *pnew_end_c_bal, balns->end_cleared_bal ) )
-            {
-                adj = gnc_numeric_sub( balns->end_cleared_bal, *pnew_end_c_bal,
-                                       GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD );
-                balns->start_cleared_bal = gnc_numeric_add( balns->start_cleared_bal, adj,
-                                           GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD );
-                g_object_set( balns->acc, "start-cleared-balance", &balns->start_cleared_bal, NULL );
-            }
-            if ( !gnc_numeric_eq( *pnew_end_r_bal, balns->end_reconciled_bal ) )
-            {
-                adj = gnc_numeric_sub( balns->end_reconciled_bal, *pnew_end_r_bal,
-                                       GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD );
-                balns->start_reconciled_bal = gnc_numeric_add( balns->start_reconciled_bal, adj,
-                                              GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD );
-                g_object_set( balns->acc, "start-reconciled-balance", &balns->start_reconciled_bal, NULL );
-            }
-            xaccAccountRecomputeBalance( balns->acc );
-            g_free( pnew_end_bal );
-            g_free( pnew_end_c_bal );
-            g_free( pnew_end_r_bal );
-            g_free( balns );
-        }
-        if ( bal_list != NULL )
-        {
-            g_slist_free( bal_list );
-        }
-
-        xaccAccountCommitEdit( root );
-        qof_event_resume();
-#endif
     }
 }
 
@@ -880,6 +845,180 @@ void gnc_sql_transaction_load_tx_for_account( GncSqlBackend* be, Account* accoun
     }
 }
 
+/* Ends the edits load_single_tx() started and frees 'tx_list' */
+static void
+commit_loaded_tx( GncSqlBackend* be, /*@ only @*/ GList* tx_list )
+{
+    GList* node;
+
+    for ( node = tx_list; node != NULL; node = node->next )
+    {
+        xaccTransCommitEdit( GNC_TRANSACTION(node->data) );
+    }
+    uncount_older_splits( be, tx_list );
+    g_list_free( tx_list );
+}
+
+/**
+ * Loads the transactions matching a condition on the transactions table,
+ * or every transaction.  The splits and slots are fetched with subqueries
+ * rather than with IN lists naming every transaction, so the SQL stays
+ * small however many transactions there are, and matches what
+ * gnc_sql_load() prefetches during a parallel load.  If some of the
+ * matching transactions are already in memory (older transactions of
+ * accounts that have been paged in) the subqueries would reload their
+ * splits and slots too, so then the transactions just loaded are named
+ * instead.
+ *
+ * @param be SQL backend
+ * @param where Condition on the transactions table, or NULL for all
+ */
+static void
+load_tx_from_tables( GncSqlBackend* be, /*@ null @*/ const gchar* where )
+{
+    gchar* sql;
+    gchar* subquery;
+    GncSqlResult* result;
+    GncSqlRow* row;
+    GList* tx_list = NULL;
+    gboolean some_loaded = FALSE;
+
+    if ( where != NULL )
+    {
+        sql = g_strdup_printf( "SELECT * FROM %s WHERE %s", TRANSACTION_TABLE, where );
+        subquery = g_strdup_printf( "SELECT DISTINCT guid FROM %s WHERE %s", TRANSACTION_TABLE, where );
+    }
+    else
+    {
+        sql = g_strdup_printf( "SELECT * FROM %s", TRANSACTION_TABLE );
+        subquery = g_strdup_printf( "SELECT DISTINCT guid FROM %s", TRANSACTION_TABLE );
+    }
+    result = gnc_sql_execute_select_sql( be, sql );
+    g_free( sql );
+    if ( result == NULL )
+    {
+        g_free( subquery );
+        return;
+    }
+
+    row = gnc_sql_result_get_first_row( result );
+    while ( row != NULL )
+    {
+        Transaction* tx = load_single_tx( be, row );
+        if ( tx != NULL )
+        {
+            tx_list = g_list_prepend( tx_list, tx );
+        }
+        else
+        {
+            some_loaded = TRUE;
+        }
+        row = gnc_sql_result_get_next_row( result );
+    }
+    gnc_sql_result_dispose( result );
+    if ( tx_list == NULL )
+    {
+        g_free( subquery );
+        return;
+    }
+
+    if ( some_loaded )
+    {
+        gnc_sql_slots_load_for_list( be, tx_list );
+        load_splits_for_tx_list( be, tx_list );
+        commit_loaded_tx( be, tx_list );
+        g_free( subquery );
+        return;
+    }
+
+    gnc_sql_slots_load_for_sql_subquery( be, subquery, (BookLookupFn)xaccTransLookup );
+
+    sql = g_strdup_printf( "SELECT * FROM %s WHERE %s IN (%s)",
+                           SPLIT_TABLE, tx_guid_col_table[0].col_name, subquery );
+    result = gnc_sql_execute_select_sql( be, sql );
+    g_free( sql );
+    if ( result != NULL )
+    {
+        row = gnc_sql_result_get_first_row( result );
+        while ( row != NULL )
+        {
+            (void)load_single_split( be, row );
+            row = gnc_sql_result_get_next_row( result );
+        }
+        gnc_sql_result_dispose( result );
+
+        sql = g_strdup_printf( "SELECT DISTINCT guid FROM %s WHERE %s IN (%s)",
+                               SPLIT_TABLE, tx_guid_col_table[0].col_name, subquery );
+        gnc_sql_slots_load_for_sql_subquery( be, sql, (BookLookupFn)xaccSplitLookup );
+        g_free( sql );
+    }
+    g_free( subquery );
+
+    commit_loaded_tx( be, tx_list );
+}
+
+/* Returns "post_date <op> '<cutoff>'", to be freed by the caller. */
+static gchar*
+cutoff_condition( GncSqlBackend* be, const gchar* prefix, const gchar* op )
+{
+    Timespec ts;
+    gchar* datebuf;
+    gchar* cond;
+
+    ts.tv_sec = be->tx_cutoff;
+    ts.tv_nsec = 0;
+    datebuf = gnc_sql_convert_timespec_to_string( be, ts );
+    cond = g_strdup_printf( "%spost_date %s '%s'", prefix, op, datebuf );
+    g_free( datebuf );
+    return cond;
+}
+
+static void
+free_paged_accounts( QofBook* book, gpointer key, gpointer data )
+{
+    g_hash_table_destroy( (GHashTable*)data );
+}
+
+/* Accounts whose transactions before the cutoff have all been loaded */
+static GHashTable*
+get_paged_accounts( GncSqlBackend* be )
+{
+    GHashTable* paged = qof_book_get_data( be->primary_book, PAGED_ACCOUNTS_KEY );
+
+    if ( paged == NULL )
+    {
+        paged = g_hash_table_new_full( guid_hash_to_guint, guid_g_hash_table_equal,
+                                       (GDestroyNotify)guid_free, NULL );
+        qof_book_set_data_fin( be->primary_book, PAGED_ACCOUNTS_KEY, paged,
+                               (QofBookFinalCB)free_paged_accounts );
+    }
+    return paged;
+}
+
+/**
+ * Loads the transactions for the start of a session.  If paging is on
+ * (be->tx_cutoff != 0) that is only those posted since the cutoff.
+ *
+ * @param be SQL backend
+ */
+static void
+load_initial_tx( GncSqlBackend* be )
+{
+    gchar* where;
+
+    g_return_if_fail( be != NULL );
+
+    if ( be->tx_cutoff == 0 )
+    {
+        gnc_sql_transaction_load_all_tx( be );
+        return;
+    }
+
+    where = cutoff_condition( be, "", ">=" );
+    load_tx_from_tables( be, where );
+    g_free( where );
+}
+
 /**
  * Loads all transactions.  This might be used during a save-as operation to ensure that
  * all data is in memory and ready to be saved.
@@ -893,6 +1032,22 @@ void gnc_sql_transaction_load_all_tx( GncSqlBackend* be )
 
     g_return_if_fail( be != NULL );
 
+    /* Transactions are paged: fetch everything older than what is loaded */
+    if ( be->tx_cutoff != 0 )
+    {
+        gchar* where = cutoff_condition( be, "", "<" );
+        load_tx_from_tables( be, where );
+        g_free( where );
+        be->tx_cutoff = 0;
+        return;
+    }
+
+    if ( qof_collection_count( qof_book_get_collection( be->primary_book, GNC_ID_TRANS ) ) == 0 )
+    {
+        load_tx_from_tables( be, NULL );
+        return;
+    }
+
     query_sql = g_strdup_printf( "SELECT * FROM %s", TRANSACTION_TABLE );
     stmt = gnc_sql_create_statement_from_sql( be, query_sql );
     g_free( query_sql );
@@ -1124,168 +1279,103 @@ convert_query_term_to_sql( const GncSqlBackend* be, const gchar* fieldName, QofQ
     }
 }
 
+/*
+ * A compiled split query.  The engine runs split queries against what is
+ * in memory, so all the backend has to do is make sure the transactions
+ * the query can match have been loaded.  Everything since the cutoff is
+ * loaded at startup, so that means the older transactions of the accounts
+ * named in the query.  A query which doesn't restrict every one of its OR
+ * terms to a set of accounts could match anything, and loads everything.
+ */
 typedef struct
 {
-    GncSqlStatement* stmt;
+    /*@ null @*/ gchar* where;      /* OR of the account conditions, NULL if unrestricted */
+    /*@ null @*/ GList* accounts;   /* GUIDs of the accounts, NULL if not a plain list */
     gboolean has_been_run;
 } split_query_info_t;
 
+/* Returns the term of an AND list restricting the split's account, or NULL */
+static /*@ null @*/ QofQueryTerm*
+find_account_term( GList* andterms )
+{
+    GList* andTerm;
+
+    for ( andTerm = andterms; andTerm != NULL; andTerm = andTerm->next )
+    {
+        QofQueryTerm* term = (QofQueryTerm*)andTerm->data;
+        GSList* paramPath = qof_query_term_get_param_path( term );
+
+        if ( strcmp( paramPath->data, SPLIT_ACCOUNT ) == 0
+                && paramPath->next != NULL
+                && strcmp( paramPath->next->data, QOF_PARAM_GUID ) == 0
+                && safe_strcmp( qof_query_term_get_pred_data( term )->type_name,
+                                QOF_TYPE_GUID ) == 0 )
+        {
+            return term;
+        }
+    }
+    return NULL;
+}
+
 static /*@ null @*/ gpointer
 compile_split_query( GncSqlBackend* be, QofQuery* query )
 {
-    const GncGUID* acct_guid;
-    gchar guid_buf[GUID_ENCODING_LENGTH+1];
     split_query_info_t* query_info = NULL;
-    gchar* query_sql;
+    GList* orTerm;
+    GString* sql;
+    gboolean plain_list = TRUE;
 
     g_return_val_if_fail( be != NULL, NULL );
     g_return_val_if_fail( query != NULL, NULL );
 
-    query_info = g_malloc( (gsize)sizeof(split_query_info_t) );
+    query_info = g_malloc0( (gsize)sizeof(split_query_info_t) );
     g_assert( query_info != NULL );
-    query_info->has_been_run = FALSE;
 
-    if ( qof_query_has_terms( query ) )
+    if ( !qof_query_has_terms( query ) ) return query_info;
+
+    sql = g_string_new( "" );
+    for ( orTerm = qof_query_get_terms( query ); orTerm != NULL; orTerm = orTerm->next )
     {
-        GList* orterms = qof_query_get_terms( query );
-        GList* orTerm;
-        GString* sql = g_string_new( "" );
-        gboolean need_OR = FALSE;
+        QofQueryTerm* term = find_account_term( (GList*)orTerm->data );
+        query_guid_t guid_data;
+        GList* guid_entry;
 
-        for ( orTerm = orterms; orTerm != NULL; orTerm = orTerm->next )
+        if ( term == NULL )
         {
-            GList* andterms = (GList*)orTerm->data;
-            GList* andTerm;
-            gboolean need_AND = FALSE;
-            gboolean has_tx_guid_check = FALSE;
-
-            if ( need_OR )
-            {
-                g_string_append( sql, " OR " );
-            }
-            g_string_append( sql, "(" );
-            for ( andTerm = andterms; andTerm != NULL; andTerm = andTerm->next )
-            {
-                QofQueryTerm* term;
-                GSList* paramPath;
-                gboolean unknownPath = FALSE;
-
-                term = (QofQueryTerm*)andTerm->data;
-                paramPath = qof_query_term_get_param_path( term );
-
-                if ( strcmp( paramPath->data, QOF_PARAM_BOOK ) == 0 ) continue;
-
-#if SIMPLE_QUERY_COMPILATION
-                if ( strcmp( paramPath->data, SPLIT_ACCOUNT ) != 0
-                        || strcmp( paramPath->next->data, QOF_PARAM_GUID ) != 0 ) continue;
-#endif
-
-                if ( need_AND ) g_string_append( sql, " AND " );
-
-                if ( strcmp( paramPath->data, SPLIT_ACCOUNT ) == 0
-                        && strcmp( paramPath->next->data, QOF_PARAM_GUID ) == 0 )
-                {
-                    convert_query_term_to_sql( be, "s.account_guid", term, sql );
-#if SIMPLE_QUERY_COMPILATION
-                    goto done_compiling_query;
-#endif
-
-                }
-                else if ( strcmp( paramPath->data, SPLIT_RECONCILE ) == 0 )
-                {
-                    convert_query_term_to_sql( be, "s.reconcile_state", term, sql );
-
-                }
-                else if ( strcmp( paramPath->data, SPLIT_TRANS ) == 0 )
-                {
-#if 0
-                    if ( !has_tx_guid_check )
-                    {
-                        g_string_append( sql, "(splits.tx_guid = transactions.guid) AND " );
-                        has_tx_guid_check = TRUE;
-                    }
-#endif
-                    if ( strcmp( paramPath->next->data, TRANS_DATE_POSTED ) == 0 )
-                    {
-                        convert_query_term_to_sql( be, "t.post_date", term, sql );
-                    }
-                    else if ( strcmp( paramPath->next->data, TRANS_DESCRIPTION ) == 0 )
-                    {
-                        convert_query_term_to_sql( be, "t.description", term, sql );
-                    }
-                    else
-                    {
-                        unknownPath = TRUE;
-                    }
-
-                }
-                else if ( strcmp( paramPath->data, SPLIT_VALUE ) == 0 )
-                {
-                    convert_query_term_to_sql( be, "s.value_num/s.value_denom", term, sql );
-
-                }
-                else
-                {
-                    unknownPath = TRUE;
-                }
-
-                if ( unknownPath )
-                {
-                    GString* name = g_string_new( (gchar*)paramPath->data );
-                    while ( paramPath->next != NULL )
-                    {
-                        g_string_append( name, "." );
-                        g_string_append( name, paramPath->next->data );
-                        paramPath = paramPath->next;
-                    }
-                    PERR( "Unknown SPLIT query field: %s\n", name->str );
-                    g_string_free( name, TRUE );
-                }
-                need_AND = TRUE;
-            }
-
-            /* If the last char in the string is a '(', then for some reason, there were
-               no terms added to the SQL.  If so, remove it and ignore the OR term. */
-            if ( sql->str[sql->len-1] == '(' )
-            {
-                g_string_truncate( sql, sql->len - 1 );
-                need_OR = FALSE;
-            }
-            else
-            {
-                g_string_append( sql, ")" );
-                need_OR = TRUE;
-            }
+            g_string_free( sql, TRUE );
+            g_list_foreach( query_info->accounts, (GFunc)guid_free, NULL );
+            g_list_free( query_info->accounts );
+            query_info->accounts = NULL;
+            return query_info;
         }
 
-#if SIMPLE_QUERY_COMPILATION
-done_compiling_query:
-#endif
-        if ( sql->len != 0 )
+        if ( sql->len != 0 ) g_string_append( sql, " OR " );
+        convert_query_term_to_sql( be, "s.account_guid", term, sql );
+
+        guid_data = (query_guid_t)qof_query_term_get_pred_data( term );
+        if ( guid_data->options != QOF_GUID_MATCH_ANY
+                || qof_query_term_is_inverted( term ) )
         {
-#if SIMPLE_QUERY_COMPILATION
-            g_string_append( sql, ")" );
-#endif
-            query_sql = g_strdup_printf(
-                            "SELECT DISTINCT t.* FROM %s AS t, %s AS s WHERE s.tx_guid=t.guid AND %s",
-                            TRANSACTION_TABLE, SPLIT_TABLE, sql->str );
+            plain_list = FALSE;
         }
-        else
+        if ( plain_list )
         {
-            query_sql = g_strdup_printf( "SELECT * FROM %s", TRANSACTION_TABLE );
-        }
-        query_info->stmt = gnc_sql_create_statement_from_sql( be, query_sql );
-
-        g_string_free( sql, TRUE );
-        g_free( query_sql );
+            for ( guid_entry = guid_data->guids; guid_entry != NULL; guid_entry = guid_entry->next )
+            {
+                GncGUID* guid = guid_malloc();
 
+                *guid = *(GncGUID*)guid_entry->data;
+                query_info->accounts = g_list_prepend( query_info->accounts, guid );
+            }
+        }
     }
-    else
+    if ( !plain_list )
     {
-        query_sql = g_strdup_printf( "SELECT * FROM %s", TRANSACTION_TABLE );
-        query_info->stmt = gnc_sql_create_statement_from_sql( be, query_sql );
-        g_free( query_sql );
+        g_list_foreach( query_info->accounts, (GFunc)guid_free, NULL );
+        g_list_free( query_info->accounts );
+        query_info->accounts = NULL;
     }
+    query_info->where = g_string_free( sql, FALSE );
 
     return query_info;
 }
@@ -1294,26 +1384,70 @@ static void
 run_split_query( GncSqlBackend* be, gpointer pQuery )
 {
     split_query_info_t* query_info = (split_query_info_t*)pQuery;
+    GHashTable* paged;
+    GList* node;
+    gboolean all_paged;
+    gchar* cutoff;
+    gchar* query_sql;
+    GncSqlStatement* stmt;
 
     g_return_if_fail( be != NULL );
     g_return_if_fail( pQuery != NULL );
 
-    if ( !query_info->has_been_run )
+    if ( query_info->has_been_run ) return;
+    query_info->has_been_run = TRUE;
+
+    /* Nothing is being held back */
+    if ( be->tx_cutoff == 0 ) return;
+
+    if ( query_info->where == NULL )
+    {
+        gnc_sql_transaction_load_all_tx( be );
+        return;
+    }
+
+    paged = get_paged_accounts( be );
+    all_paged = ( query_info->accounts != NULL );
+    for ( node = query_info->accounts; node != NULL && all_paged; node = node->next )
+    {
+        all_paged = ( g_hash_table_lookup( paged, node->data ) != NULL );
+    }
+    if ( all_paged ) return;
+
+    cutoff = cutoff_condition( be, "t.", "<" );
+    query_sql = g_strdup_printf(
+                    "SELECT DISTINCT t.* FROM %s AS t, %s AS s WHERE s.tx_guid=t.guid AND %s AND (%s)",
+                    TRANSACTION_TABLE, SPLIT_TABLE, cutoff, query_info->where );
+    g_free( cutoff );
+    stmt = gnc_sql_create_statement_from_sql( be, query_sql );
+    g_free( query_sql );
+    if ( stmt != NULL )
     {
-        query_transactions( be, query_info->stmt );
-        query_info->has_been_run = TRUE;
-        gnc_sql_statement_dispose( query_info->stmt );
-        query_info->stmt = NULL;
+        query_transactions( be, stmt );
+        gnc_sql_statement_dispose( stmt );
+    }
+
+    for ( node = query_info->accounts; node != NULL; node = node->next )
+    {
+        GncGUID* guid = guid_malloc();
+
+        *guid = *(GncGUID*)node->data;
+        g_hash_table_insert( paged, guid, GINT_TO_POINTER(TRUE) );
     }
 }
 
 static void
 free_split_query( GncSqlBackend* be, gpointer pQuery )
 {
+    split_query_info_t* query_info = (split_query_info_t*)pQuery;
+
     g_return_if_fail( be != NULL );
     g_return_if_fail( pQuery != NULL );
 
-    g_free( pQuery );
+    g_free( query_info->where );
+    g_list_foreach( query_info->accounts, (GFunc)guid_free, NULL );
+    g_list_free( query_info->accounts );
+    g_free( query_info );
 }
 
 /* ----------------------------------------------------------------- */
@@ -1390,16 +1524,21 @@ load_single_acct_balances( const GncSqlBackend* be, GncSqlRow* row )
 /*@ null @*/ GSList*
 gnc_sql_get_account_balances_slist( GncSqlBackend* be )
 {
-#if LOAD_TRANSACTIONS_AS_NEEDED
     GncSqlResult* result;
     GncSqlStatement* stmt;
     gchar* buf;
+    gchar* cutoff;
     GSList* bal_slist = NULL;
 
     g_return_val_if_fail( be != NULL, NULL );
 
-    buf = g_strdup_printf( "SELECT account_guid, reconcile_state, sum(quantity_num) as quantity_num, quantity_denom FROM %s GROUP BY account_guid, reconcile_state, quantity_denom ORDER BY account_guid, reconcile_state",
-                           SPLIT_TABLE );
+    /* Only the splits which aren't loaded count towards the start balances */
+    if ( be->tx_cutoff == 0 ) return NULL;
+
+    cutoff = cutoff_condition( be, "t.", "<" );
+    buf = g_strdup_printf( "SELECT s.account_guid AS account_guid, s.reconcile_state AS reconcile_state, sum(s.quantity_num) as quantity_num, s.quantity_denom AS quantity_denom FROM %s AS s, %s AS t WHERE s.tx_guid=t.guid AND %s GROUP BY s.account_guid, s.reconcile_state, s.quantity_denom ORDER BY s.account_guid, s.reconcile_state",
+                           SPLIT_TABLE, TRANSACTION_TABLE, cutoff );
+    g_free( cutoff );
     stmt = gnc_sql_create_statement_from_sql( be, buf );
     g_assert( stmt != NULL );
     g_free( buf );
@@ -1443,16 +1582,16 @@ gnc_sql_get_account_balances_slist( GncSqlBackend* be )
                     bal->balance = gnc_numeric_add( bal->balance, single_bal->balance,
                                                     GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD );
                 }
-                else if ( single_bal->reconcile_state == 'c' )
-                {
-                    bal->cleared_balance = gnc_numeric_add( bal->cleared_balance, single_bal->balance,
-                                                            GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD );
-                }
-                else if ( single_bal->reconcile_state == 'y' )
+                else if ( single_bal->reconcile_state == 'y' || single_bal->reconcile_state == 'f' )
                 {
                     bal->reconciled_balance = gnc_numeric_add( bal->reconciled_balance, single_bal->balance,
                                               GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD );
                 }
+                else
+                {
+                    bal->cleared_balance = gnc_numeric_add( bal->cleared_balance, single_bal->balance,
+                                                            GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD );
+                }
                 g_free( single_bal );
             }
             row = gnc_sql_result_get_next_row( result );
@@ -1471,9 +1610,6 @@ gnc_sql_get_account_balances_slist( GncSqlBackend* be )
     }
 
     return bal_slist;
-#else
-    return NULL;
-#endif
 }
 
 /* ----------------------------------------------------------------- */
@@ -1544,11 +1680,7 @@ gnc_sql_init_transaction_handler( void )
         GNC_SQL_BACKEND_VERSION,
         GNC_ID_TRANS,
         commit_transaction,          /* commit */
-#if LOAD_TRANSACTIONS_AS_NEEDED
-        NULL,                        /* initial load */
-#else
-        gnc_sql_transaction_load_all_tx,
-#endif
+        load_initial_tx,             /* initial load */
         create_transaction_tables,   /* create tables */
         NULL,                        /* compile_query */
         NULL,                        /* run_query */
@@ -1562,15 +1694,9 @@ gnc_sql_init_transaction_handler( void )
         commit_split,                /* commit */
         NULL,                        /* initial_load */
         NULL,                        /* create tables */
-#if LOAD_TRANSACTIONS_AS_NEEDED
-        compile_split_query,
-        run_split_query,
-        free_split_query,
-#else
-        NULL,                        /* compile_query */
-        NULL,                        /* run_query */
-        NULL,                        /* free_query */
-#endif
+        compile_split_query,         /* compile_query */
+        run_split_query,             /* run_query */
+        free_split_query,            /* free_query */
         NULL                         /* write */
     };
 
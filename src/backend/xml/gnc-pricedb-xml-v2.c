@@ -228,12 +228,170 @@ cleanup_gnc_price(sixtp_child_result *result)
     if (result->data) gnc_price_unref((GNCPrice *) result->data);
 }
 
+/* The streaming version of the above: the price is filled in as its
+   elements are read, with the same rules. */
+
+struct price_stream_data
+{
+    GNCPrice *price;
+    QofBook *book;
+    gboolean has_children;
+    Timespec ts;
+    gchar *cmdty_space;
+    gchar *cmdty_id;
+};
+
+static gpointer
+price_stream_begin(gpointer global_data, const gchar *tag, gchar **attrs)
+{
+    gxpf_data *gdata = global_data;
+    struct price_stream_data *sd;
+
+    sd = g_new0(struct price_stream_data, 1);
+    sd->book = gdata->bookdata;
+    sd->price = gnc_price_create(sd->book);
+    if (!sd->price)
+    {
+        g_free(sd);
+        return NULL;
+    }
+    gnc_price_begin_edit(sd->price);
+    return sd;
+}
+
+static gboolean
+price_stream_start(gpointer data, guint depth, const gchar *tag, gchar **attrs)
+{
+    struct price_stream_data *sd = data;
+
+    if (depth != 1) return TRUE;
+
+    sd->has_children = TRUE;
+    if (safe_strcmp("price:id", tag) == 0)
+    {
+        return sixtp_attrs_are_guid(attrs);
+    }
+    else if (safe_strcmp("price:time", tag) == 0)
+    {
+        sd->ts.tv_sec = 0;
+        sd->ts.tv_nsec = 0;
+    }
+    return TRUE;
+}
+
+static gboolean
+price_stream_end(gpointer data, guint depth, const gchar *tag, const gchar *text)
+{
+    struct price_stream_data *sd = data;
+    GNCPrice *p = sd->price;
+
+    if (depth > 1)
+    {
+        if (safe_strcmp("ts:date", tag) == 0)
+        {
+            if (!string_to_timespec_secs(text, &sd->ts))
+                sd->ts.tv_sec = sd->ts.tv_nsec = 0;
+        }
+        else if (safe_strcmp("ts:ns", tag) == 0)
+        {
+            if (!string_to_timespec_nsecs(text, &sd->ts))
+                sd->ts.tv_sec = sd->ts.tv_nsec = 0;
+        }
+        else if (safe_strcmp("cmdty:space", tag) == 0)
+        {
+            g_free(sd->cmdty_space);
+            sd->cmdty_space = g_strdup(text);
+        }
+        else if (safe_strcmp("cmdty:id", tag) == 0)
+        {
+            g_free(sd->cmdty_id);
+            sd->cmdty_id = g_strdup(text);
+        }
+        return TRUE;
+    }
+
+    if (safe_strcmp("price:id", tag) == 0)
+    {
+        GncGUID guid;
+        if (!string_to_guid(text, &guid)) return FALSE;
+        gnc_price_set_guid(p, &guid);
+    }
+    else if (safe_strcmp("price:commodity", tag) == 0
+             || safe_strcmp("price:currency", tag) == 0)
+    {
+        gnc_commodity *c = sixtp_lookup_commodity_ref(sd->book, sd->cmdty_space,
+                           sd->cmdty_id);
+        g_free(sd->cmdty_space);
+        g_free(sd->cmdty_id);
+        sd->cmdty_space = sd->cmdty_id = NULL;
+        if (!c) return FALSE;
+        if (safe_strcmp("price:commodity", tag) == 0)
+            gnc_price_set_commodity(p, c);
+        else
+            gnc_price_set_currency(p, c);
+    }
+    else if (safe_strcmp("price:time", tag) == 0)
+    {
+        if (!dom_tree_valid_timespec(&sd->ts, BAD_CAST tag)) return FALSE;
+        gnc_price_set_time(p, sd->ts);
+    }
+    else if (safe_strcmp("price:source", tag) == 0)
+    {
+        gnc_price_set_source(p, text);
+    }
+    else if (safe_strcmp("price:type", tag) == 0)
+    {
+        gnc_price_set_typestr(p, text);
+    }
+    else if (safe_strcmp("price:value", tag) == 0)
+    {
+        gnc_numeric value;
+        if (!string_to_gnc_numeric(text, &value)) return FALSE;
+        gnc_price_set_value(p, value);
+    }
+    return TRUE;
+}
+
+static gboolean
+price_stream_finish(gpointer data, gpointer global_data, const gchar *tag,
+                    gboolean ok, gpointer *result)
+{
+    struct price_stream_data *sd = data;
+    GNCPrice *p = sd->price;
+
+    ok = ok && sd->has_children;
+    g_free(sd->cmdty_space);
+    g_free(sd->cmdty_id);
+    g_free(sd);
+
+    gnc_price_commit_edit(p);
+    if (!ok)
+    {
+        gnc_price_unref(p);
+        *result = NULL;
+        return FALSE;
+    }
+    *result = p;
+    return TRUE;
+}
+
+static const sixtp_stream_handlers price_stream_handlers =
+{
+    price_stream_begin,
+    price_stream_start,
+    price_stream_end,
+    price_stream_finish
+};
+
 static sixtp *
 gnc_price_parser_new (void)
 {
-    return sixtp_dom_parser_new(price_parse_xml_end_handler,
-                                cleanup_gnc_price,
-                                cleanup_gnc_price);
+    if (sixtp_use_dom_parsers())
+        return sixtp_dom_parser_new(price_parse_xml_end_handler,
+                                    cleanup_gnc_price,
+                                    cleanup_gnc_price);
+    return sixtp_stream_parser_new("price", &price_stream_handlers,
+                                   cleanup_gnc_price, cleanup_gnc_price);
 }
 
 
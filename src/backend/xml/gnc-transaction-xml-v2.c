@@ -47,6 +47,8 @@
 #include "gnc-lot.h"
 #include "gnc-lot-p.h"
 
+static QofLogModule log_module = GNC_MOD_IO;
+
 const gchar *transaction_version_string = "2.0.0";
 
 static void
@@ -642,8 +644,371 @@ dom_tree_to_transaction( xmlNodePtr node, QofBook *book )
     return trn;
 }
 
+/***********************************************************************/
+/* Streaming <gnc:transaction>
+
+   The same transaction as dom_tree_to_transaction() builds, filled in
+   from the elements as they are read.  Depth 1 is the transaction's
+   own fields, 2 the <trn:split>s and 3 the fields of a split; slots
+   are handed to a sixtp_kvp_builder. */
+
+enum
+{
+    TRN_ID            = 1 << 0,
+    TRN_DATE_POSTED   = 1 << 1,
+    TRN_DATE_ENTERED  = 1 << 2,
+    TRN_SPLITS        = 1 << 3,
+    TRN_REQUIRED      = TRN_ID | TRN_DATE_POSTED | TRN_DATE_ENTERED | TRN_SPLITS
+};
+
+enum
+{
+    SPL_ID            = 1 << 0,
+    SPL_RECONCILED    = 1 << 1,
+    SPL_VALUE         = 1 << 2,
+    SPL_QUANTITY      = 1 << 3,
+    SPL_ACCOUNT       = 1 << 4,
+    SPL_REQUIRED      = SPL_ID | SPL_RECONCILED | SPL_VALUE | SPL_QUANTITY | SPL_ACCOUNT
+};
+
+struct trans_stream_data
+{
+    Transaction *trans;
+    Split *split;                   /* split being read */
+    gboolean in_splits;             /* inside trn:splits */
+    QofBook *book;
+    guint trn_gotten;
+    guint spl_gotten;
+    sixtp_kvp_builder *slots;       /* while inside trn:slots or split:slots */
+    guint slots_depth;
+    Timespec ts;
+    gboolean ts_ok;
+    gchar *cmdty_space;
+    gchar *cmdty_id;
+};
+
+static gpointer
+trn_stream_begin(gpointer global_data, const gchar *tag, gchar **attrs)
+{
+    gxpf_data *gdata = global_data;
+    struct trans_stream_data *sd;
+
+    g_return_val_if_fail(gdata->bookdata, NULL);
+
+    sd = g_new0(struct trans_stream_data, 1);
+    sd->book = gdata->bookdata;
+    sd->trans = xaccMallocTransaction(sd->book);
+    xaccTransBeginEdit(sd->trans);
+    return sd;
+}
+
+static gboolean
+trn_stream_start(gpointer data, guint depth, const gchar *tag, gchar **attrs)
+{
+    struct trans_stream_data *sd = data;
+
+    if (sd->slots)
+        return sixtp_kvp_builder_start(sd->slots, tag, attrs);
+
+    if (depth == 2 && sd->in_splits)
+    {
+        if (strcmp(tag, "trn:split") != 0)
+        {
+            PERR("Unexpected tag %s in trn:splits", tag);
+            return FALSE;
+        }
+        sd->split = xaccMallocSplit(sd->book);
+        sd->spl_gotten = 0;
+        return TRUE;
+    }
+
+    if (strcmp(tag, "trn:splits") == 0)
+    {
+        sd->in_splits = TRUE;
+    }
+    else if (strcmp(tag, "trn:slots") == 0)
+    {
+        sd->slots = sixtp_kvp_builder_new(xaccTransGetSlots(sd->trans));
+        sd->slots_depth = depth;
+    }
+    else if (strcmp(tag, "split:slots") == 0)
+    {
+        sd->slots = sixtp_kvp_builder_new(xaccSplitGetSlots(sd->split));
+        sd->slots_depth = depth;
+    }
+    else if (strcmp(tag, "trn:id") == 0 || strcmp(tag, "split:id") == 0
+             || strcmp(tag, "split:account") == 0 || strcmp(tag, "split:lot") == 0)
+    {
+        return sixtp_attrs_are_guid(attrs);
+    }
+    else if (strcmp(tag, "trn:date-posted") == 0 || strcmp(tag, "trn:date-entered") == 0
+             || strcmp(tag, "split:reconcile-date") == 0)
+    {
+        sd->ts.tv_sec = 0;
+        sd->ts.tv_nsec = 0;
+        sd->ts_ok = FALSE;
+    }
+    return TRUE;
+}
+
+/* Returns FALSE if the element spoils the split, as the DOM handlers
+   would. */
+static gboolean
+trn_stream_split_end(struct trans_stream_data *sd, const gchar *tag,
+                     const gchar *text, gboolean *known)
+{
+    Split *split = sd->split;
+    GncGUID guid;
+    gnc_numeric num;
+
+    *known = TRUE;
+    if (strcmp(tag, "split:id") == 0)
+    {
+        (void)string_to_guid(text, &guid);
+        xaccSplitSetGUID(split, &guid);
+        sd->spl_gotten |= SPL_ID;
+    }
+    else if (strcmp(tag, "split:memo") == 0)
+    {
+        xaccSplitSetMemo(split, text);
+    }
+    else if (strcmp(tag, "split:action") == 0)
+    {
+        xaccSplitSetAction(split, text);
+    }
+    else if (strcmp(tag, "split:reconciled-state") == 0)
+    {
+        xaccSplitSetReconcile(split, text[0]);
+        sd->spl_gotten |= SPL_RECONCILED;
+    }
+    else if (strcmp(tag, "split:reconcile-date") == 0)
+    {
+        if (!dom_tree_valid_timespec(&sd->ts, BAD_CAST tag))
+            return FALSE;
+        xaccSplitSetDateReconciledTS(split, &sd->ts);
+    }
+    else if (strcmp(tag, "split:value") == 0)
+    {
+        if (string_to_gnc_numeric(text, &num))
+            xaccSplitSetValue(split, num);
+        sd->spl_gotten |= SPL_VALUE;
+    }
+    else if (strcmp(tag, "split:quantity") == 0)
+    {
+        if (string_to_gnc_numeric(text, &num))
+            xaccSplitSetAmount(split, num);
+        sd->spl_gotten |= SPL_QUANTITY;
+    }
+    else if (strcmp(tag, "split:account") == 0)
+    {
+        Account *account;
+
+        (void)string_to_guid(text, &guid);
+        account = xaccAccountLookup(&guid, sd->book);
+        if (!account && gnc_transaction_xml_v2_testing &&
+                !guid_equal(&guid, guid_null()))
+        {
+            account = xaccMallocAccount(sd->book);
+            xaccAccountSetGUID(account, &guid);
+            xaccAccountSetCommoditySCU(account, xaccSplitGetAmount(split).denom);
+        }
+        xaccAccountInsertSplit(account, split);
+        sd->spl_gotten |= SPL_ACCOUNT;
+    }
+    else if (strcmp(tag, "split:lot") == 0)
+    {
+        GNCLot *lot;
+
+        (void)string_to_guid(text, &guid);
+        lot = gnc_lot_lookup(&guid, sd->book);
+        if (!lot && gnc_transaction_xml_v2_testing &&
+                !guid_equal(&guid, guid_null()))
+        {
+            lot = gnc_lot_new(sd->book);
+            gnc_lot_set_guid(lot, guid);
+        }
+        gnc_lot_add_split(lot, split);
+    }
+    else if (strcmp(tag, "split:slots") != 0)
+    {
+        *known = FALSE;
+    }
+    return TRUE;
+}
+
+/* Returns FALSE if the element spoils the transaction, as the DOM
+   handlers would. */
+static gboolean
+trn_stream_trans_end(struct trans_stream_data *sd, const gchar *tag,
+                     const gchar *text, gboolean *known)
+{
+    Transaction *trn = sd->trans;
+    GncGUID guid;
+
+    *known = TRUE;
+    if (strcmp(tag, "trn:id") == 0)
+    {
+        (void)string_to_guid(text, &guid);
+        xaccTransSetGUID(trn, &guid);
+        sd->trn_gotten |= TRN_ID;
+    }
+    else if (strcmp(tag, "trn:currency") == 0)
+    {
+        xaccTransSetCurrency(trn, sixtp_lookup_commodity_ref(sd->book, sd->cmdty_space,
+                             sd->cmdty_id));
+        g_free(sd->cmdty_space);
+        g_free(sd->cmdty_id);
+        sd->cmdty_space = sd->cmdty_id = NULL;
+    }
+    else if (strcmp(tag, "trn:num") == 0)
+    {
+        xaccTransSetNum(trn, text);
+    }
+    else if (strcmp(tag, "trn:date-posted") == 0)
+    {
+        if (!dom_tree_valid_timespec(&sd->ts, BAD_CAST tag))
+            return FALSE;
+        xaccTransSetDatePostedTS(trn, &sd->ts);
+        sd->trn_gotten |= TRN_DATE_POSTED;
+    }
+    else if (strcmp(tag, "trn:date-entered") == 0)
+    {
+        if (!dom_tree_valid_timespec(&sd->ts, BAD_CAST tag))
+            return FALSE;
+        xaccTransSetDateEnteredTS(trn, &sd->ts);
+        sd->trn_gotten |= TRN_DATE_ENTERED;
+    }
+    else if (strcmp(tag, "trn:description") == 0)
+    {
+        xaccTransSetDescription(trn, text);
+    }
+    else if (strcmp(tag, "trn:splits") == 0)
+    {
+        sd->in_splits = FALSE;
+        sd->trn_gotten |= TRN_SPLITS;
+    }
+    else if (strcmp(tag, "trn:slots") != 0)
+    {
+        *known = FALSE;
+    }
+    return TRUE;
+}
+
+static gboolean
+trn_stream_end(gpointer data, guint depth, const gchar *tag, const gchar *text)
+{
+    struct trans_stream_data *sd = data;
+    gboolean known = TRUE;
+
+    if (sd->slots)
+    {
+        if (depth > sd->slots_depth)
+            return sixtp_kvp_builder_end(sd->slots, tag, text);
+        sixtp_kvp_builder_destroy(sd->slots);
+        sd->slots = NULL;
+    }
+
+    if (depth == 1)
+    {
+        if (!trn_stream_trans_end(sd, tag, text, &known))
+            return FALSE;
+    }
+    else if (depth == 2 && sd->in_splits)
+    {
+        if ((sd->spl_gotten & SPL_REQUIRED) != SPL_REQUIRED)
+        {
+            PERR("Split is missing required fields");
+            xaccSplitDestroy(sd->split);
+            sd->split = NULL;
+            return FALSE;
+        }
+        xaccTransAppendSplit(sd->trans, sd->split);
+        sd->split = NULL;
+    }
+    else if (depth == 3 && sd->in_splits)
+    {
+        if (!trn_stream_split_end(sd, tag, text, &known))
+            return FALSE;
+    }
+    else
+    {
+        /* the pieces of a timespec or commodity reference */
+        if (strcmp(tag, "ts:date") == 0)
+        {
+            sd->ts_ok = string_to_timespec_secs(text, &sd->ts);
+            if (!sd->ts_ok) sd->ts.tv_sec = sd->ts.tv_nsec = 0;
+        }
+        else if (strcmp(tag, "ts:ns") == 0)
+        {
+            if (sd->ts_ok && !string_to_timespec_nsecs(text, &sd->ts))
+                sd->ts.tv_sec = sd->ts.tv_nsec = 0;
+        }
+        else if (strcmp(tag, "cmdty:space") == 0)
+        {
+            g_free(sd->cmdty_space);
+            sd->cmdty_space = g_strdup(text);
+        }
+        else if (strcmp(tag, "cmdty:id") == 0)
+        {
+            g_free(sd->cmdty_id);
+            sd->cmdty_id = g_strdup(text);
+        }
+    }
+
+    if (!known)
+    {
+        PERR("Unhandled tag: %s", tag);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static gboolean
+trn_stream_finish(gpointer data, gpointer global_data, const gchar *tag,
+                  gboolean ok, gpointer *result)
+{
+    struct trans_stream_data *sd = data;
+    gxpf_data *gdata = global_data;
+    Transaction *trn = sd->trans;
+
+    if (ok && (sd->trn_gotten & TRN_REQUIRED) != TRN_REQUIRED)
+    {
+        PERR("didn't find all of the expected tags in the input");
+        ok = FALSE;
+    }
+
+    sixtp_kvp_builder_destroy(sd->slots);
+    if (sd->split) xaccSplitDestroy(sd->split);
+    g_free(sd->cmdty_space);
+    g_free(sd->cmdty_id);
+    g_free(sd);
+
+    xaccTransCommitEdit(trn);
+    if (!ok)
+    {
+        xaccTransBeginEdit(trn);
+        xaccTransDestroy(trn);
+        xaccTransCommitEdit(trn);
+        return FALSE;
+    }
+
+    gdata->cb(tag, gdata->parsedata, trn);
+    return TRUE;
+}
+
+static const sixtp_stream_handlers trn_stream_handlers =
+{
+    trn_stream_begin,
+    trn_stream_start,
+    trn_stream_end,
+    trn_stream_finish
+};
+
 sixtp*
 gnc_transaction_sixtp_parser_create(void)
 {
-    return sixtp_dom_parser_new(gnc_transaction_end_handler, NULL, NULL);
+    if (sixtp_use_dom_parsers())
+        return sixtp_dom_parser_new(gnc_transaction_end_handler, NULL, NULL);
+    return sixtp_stream_parser_new("gnc:transaction", &trn_stream_handlers,
+                                   NULL, NULL);
 }
@@ -24,6 +24,7 @@
 #include <glib.h>
 #include <glib/gstdio.h>
 #include <fcntl.h>
+#include <stdlib.h>
 #include <string.h>
 #ifdef HAVE_UNISTD_H
 # include <unistd.h>
@@ -82,6 +83,9 @@ typedef struct
     gboolean compress;
 } gz_thread_params_t;
 
+typedef struct save_pipeline save_pipeline;
+typedef struct save_chunk save_chunk;
+
 /* Callback structure */
 struct file_backend
 {
@@ -92,8 +96,15 @@ struct file_backend
     sixtp         * parser;
     FILE          * out;
     QofBook       * book;
+    save_pipeline * pipeline;   /* NULL unless saving through the pool */
+    save_chunk    * chunk;      /* trees not yet handed to the pool */
 };
 
+static gboolean save_pipeline_sync (save_pipeline *pl, FILE *out);
+static gboolean save_pipeline_add_node (save_pipeline *pl, save_chunk **chunk,
+                                        gint level, xmlNodePtr node);
+static gboolean save_pipeline_flush (save_pipeline *pl, save_chunk **chunk);
+
 #define GNC_V2_STRING "gnc-v2"
 extern const gchar *gnc_v2_book_version_string;        /* see gnc-book-xml-v2 */
 
@@ -356,6 +367,18 @@ do_counter_cb (const char *type, gpointer data_p, gpointer be_data_p)
     /* XXX: should we do anything with this counter? */
 }
 
+/* Size the collection of 'type' in 'book' for the 'count' entities the
+ * file says are coming, so that it doesn't grow while they are loaded. */
+static void
+reserve_collection (QofBook *book, QofIdTypeConst type, gint64 count)
+{
+    if (count <= 0 || count > G_MAXUINT / 2)
+        return;
+
+    qof_collection_reserve (qof_book_get_collection (book, type),
+                            (guint) count);
+}
+
 static gboolean
 gnc_counter_end_handler(gpointer data_for_children,
                         GSList* data_from_children, GSList* sibling_data,
@@ -395,10 +418,15 @@ gnc_counter_end_handler(gpointer data_for_children,
     else if (safe_strcmp(type, "transaction") == 0)
     {
         sixdata->counter.transactions_total = val;
+        reserve_collection (sixdata->book, GNC_ID_TRANS, val);
+        /* The file doesn't count splits, but there are at least two
+         * in almost every transaction. */
+        reserve_collection (sixdata->book, GNC_ID_SPLIT, 2 * val);
     }
     else if (safe_strcmp(type, "account") == 0)
     {
         sixdata->counter.accounts_total = val;
+        reserve_collection (sixdata->book, GNC_ID_ACCOUNT, val);
     }
     else if (safe_strcmp(type, "book") == 0)
     {
@@ -901,8 +929,10 @@ compare_commodity_ids(gconstpointer a, gconstpointer b)
                        gnc_commodity_get_mnemonic(cb)));
 }
 
-static gboolean write_pricedb (FILE *out, QofBook *book, sixtp_gdv2 *gd);
-static gboolean write_transactions (FILE *out, QofBook *book, sixtp_gdv2 *gd);
+static gboolean write_pricedb (FILE *out, QofBook *book, sixtp_gdv2 *gd,
+                               save_pipeline *pl);
+static gboolean write_transactions (FILE *out, QofBook *book, sixtp_gdv2 *gd,
+                                    save_pipeline *pl);
 static gboolean write_template_transaction_data (FILE *out, QofBook *book, sixtp_gdv2 *gd);
 static gboolean write_schedXactions(FILE *out, QofBook *book, sixtp_gdv2 *gd);
 static void write_budget (QofInstance *ent, gpointer data);
@@ -936,7 +966,7 @@ write_data_cb (const char *type, gpointer data_p, gpointer be_data_p)
 }
 
 static gboolean
-write_book(FILE *out, QofBook *book, sixtp_gdv2 *gd)
+write_book(FILE *out, QofBook *book, sixtp_gdv2 *gd, save_pipeline *pl)
 {
     struct file_backend be_data;
 
@@ -995,9 +1025,9 @@ write_book(FILE *out, QofBook *book, sixtp_gdv2 *gd)
 
     if (ferror(out)
             || !write_commodities(out, book, gd)
-            || !write_pricedb(out, book, gd)
+            || !write_pricedb(out, book, gd, pl)
             || !write_accounts(out, book, gd)
-            || !write_transactions(out, book, gd)
+            || !write_transactions(out, book, gd, pl)
             || !write_template_transaction_data(out, book, gd)
             || !write_schedXactions(out, book, gd))
 
@@ -1068,10 +1098,49 @@ write_commodities(FILE *out, QofBook *book, sixtp_gdv2 *gd)
     return success;
 }
 
+/* Print the <gnc:pricedb> tags the way xmlElemDump would and hand the
+ * prices in between to the pool.  Its only attribute is the version. */
 static gboolean
-write_pricedb(FILE *out, QofBook *book, sixtp_gdv2 *gd)
+write_pricedb_pipelined(FILE *out, xmlNodePtr node, save_pipeline *pl)
+{
+    save_chunk *chunk = NULL;
+    xmlAttrPtr attr;
+    xmlNodePtr child;
+    gboolean success = TRUE;
+
+    if (fprintf(out, "<%s", (const char *)node->name) < 0)
+        return FALSE;
+    for (attr = node->properties; attr; attr = attr->next)
+    {
+        xmlChar *value = xmlGetProp(node, attr->name);
+
+        if (fprintf(out, " %s=\"%s\"", (const char *)attr->name,
+                    (const char *)value) < 0)
+            success = FALSE;
+        xmlFree(value);
+    }
+    if (!success || fprintf(out, ">\n") < 0 || !save_pipeline_sync(pl, out))
+        return FALSE;
+
+    while (success && (child = node->children) != NULL)
+    {
+        xmlUnlinkNode(child);
+        success = save_pipeline_add_node(pl, &chunk, 1, child);
+    }
+    if (!save_pipeline_flush(pl, &chunk))
+        success = FALSE;
+
+    if (!success || fprintf(out, "</%s>\n", (const char *)node->name) < 0)
+        return FALSE;
+
+    return TRUE;
+}
+
+static gboolean
+write_pricedb(FILE *out, QofBook *book, sixtp_gdv2 *gd, save_pipeline *pl)
 {
     xmlNodePtr node;
+    gboolean success;
 
     node = gnc_pricedb_dom_tree_create(gnc_pricedb_get_db(book));
 
@@ -1080,6 +1149,13 @@ write_pricedb(FILE *out, QofBook *book, sixtp_gdv2 *gd)
         return TRUE;
     }
 
+    if (pl)
+    {
+        success = write_pricedb_pipelined(out, node, pl);
+        xmlFreeNode(node);
+        return success && !ferror(out);
+    }
+
     xmlElemDump(out, NULL, node);
     xmlFreeNode(node);
 
@@ -1097,11 +1173,19 @@ xml_add_trn_data(Transaction *t, gpointer data)
 
     node = gnc_transaction_dom_tree_create(t);
 
-    xmlElemDump(be_data->out, NULL, node);
-    xmlFreeNode(node);
+    if (be_data->pipeline)
+    {
+        if (!save_pipeline_add_node(be_data->pipeline, &be_data->chunk, 0, node))
+            return -1;
+    }
+    else
+    {
+        xmlElemDump(be_data->out, NULL, node);
+        xmlFreeNode(node);
 
-    if (ferror(be_data->out) || fprintf(be_data->out, "\n") < 0)
-        return -1;
+        if (ferror(be_data->out) || fprintf(be_data->out, "\n") < 0)
+            return -1;
+    }
 
     be_data->gd->counter.transactions_loaded++;
     run_callback(be_data->gd, "transaction");
@@ -1109,16 +1193,25 @@ xml_add_trn_data(Transaction *t, gpointer data)
 }
 
 static gboolean
-write_transactions(FILE *out, QofBook *book, sixtp_gdv2 *gd)
+write_transactions(FILE *out, QofBook *book, sixtp_gdv2 *gd, save_pipeline *pl)
 {
     struct file_backend be_data;
+    gboolean success;
 
     be_data.out = out;
     be_data.gd = gd;
-    return 0 ==
-           xaccAccountTreeForEachTransaction(gnc_book_get_root_account(book),
-                   xml_add_trn_data,
-                   (gpointer) &be_data);
+    be_data.pipeline = pl;
+    be_data.chunk = NULL;
+    if (pl && !save_pipeline_sync(pl, out))
+        return FALSE;
+
+    success = 0 ==
+              xaccAccountTreeForEachTransaction(gnc_book_get_root_account(book),
+                      xml_add_trn_data,
+                      (gpointer) &be_data);
+    if (pl && !save_pipeline_flush(pl, &be_data.chunk))
+        success = FALSE;
+    return success;
 }
 
 static gboolean
@@ -1129,6 +1222,7 @@ write_template_transaction_data( FILE *out, QofBook *book, sixtp_gdv2 *gd )
 
     be_data.out = out;
     be_data.gd = gd;
+    be_data.pipeline = NULL;
 
     ra = gnc_book_get_template_root(book);
     if ( gnc_account_n_descendants(ra) > 0 )
@@ -1247,8 +1341,8 @@ write_v2_header (FILE *out)
     return TRUE;
 }
 
-gboolean
-gnc_book_write_to_xml_filehandle_v2(QofBook *book, FILE *out)
+static gboolean
+write_book_to_filehandle(QofBook *book, FILE *out, save_pipeline *pl)
 {
     QofBackend *be;
     sixtp_gdv2 *gd;
@@ -1272,7 +1366,7 @@ gnc_book_write_to_xml_filehandle_v2(QofBook *book, FILE *out)
     gd->counter.budgets_total = qof_collection_count(
                                     qof_book_get_collection(book, GNC_ID_BUDGET));
 
-    if (!write_book(out, book, gd)
+    if (!write_book(out, book, gd, pl)
             || fprintf(out, "</" GNC_V2_STRING ">\n\n") < 0)
         success = FALSE;
 
@@ -1280,6 +1374,12 @@ gnc_book_write_to_xml_filehandle_v2(QofBook *book, FILE *out)
     return success;
 }
 
+gboolean
+gnc_book_write_to_xml_filehandle_v2(QofBook *book, FILE *out)
+{
+    return write_book_to_filehandle(book, out, NULL);
+}
+
 /*
  * This function is called by the "export" code.
  */
@@ -1527,6 +1627,439 @@ wait_for_gzip(FILE *file)
     return retval;
 }
 
+/* Pipelined saving
+ *
+ * The file is written as a sequence of chunks.  Whatever the writers
+ * print to the FILE* goes down a pipe to a collector thread which cuts it
+ * into chunks, while transactions and prices are handed over as DOM
+ * trees.  The engine isn't thread safe, so the trees are still built on
+ * the calling thread, but a pool of workers dumps them to text and
+ * deflates every chunk into a gzip member of its own.  Whichever worker
+ * finishes the next chunk in sequence writes it, along with any finished
+ * chunks queued behind it.  gzread() reads concatenated members as one
+ * stream, so readers see exactly what a single gzFile would have given
+ * them.
+ *
+ * A NUL byte, which can't occur in the XML, tells the collector to end
+ * its chunk so that trees handed over next are written after it.
+ *
+ * GNC_XML_SAVE_THREADS sets the number of workers; 0 saves the old way.
+ */
+#define SAVE_THREADS_ENV "GNC_XML_SAVE_THREADS"
+#define SAVE_CHUNK_TEXT (256 * 1024)    /* bytes of text per chunk */
+#define SAVE_CHUNK_NODES 512            /* trees per chunk */
+#define SAVE_QUEUED_PER_THREAD 4        /* unwritten chunks per worker */
+
+struct save_chunk
+{
+    guint seq;
+    GString *text;
+    GPtrArray *nodes;       /* trees still to be dumped */
+    gint level;             /* depth of the trees in the document */
+    gchar *data;            /* what goes into the file */
+    gsize len;
+};
+
+struct save_pipeline
+{
+    FILE *file;
+    gboolean compress;
+    gint fd;                /* read end of the pipe */
+    GThread *collector;
+    GThreadPool *pool;
+    GMutex *lock;
+    GCond *cond;
+    GHashTable *finished;   /* seq -> chunk waiting for its turn */
+    guint next_seq;
+    guint next_write;
+    guint queued;           /* chunks handed out and not yet written */
+    guint max_queued;
+    guint syncs_wanted;
+    guint syncs_done;
+    gboolean writing;
+    gboolean failed;
+};
+
+static save_chunk *
+save_chunk_new(gint level)
+{
+    save_chunk *chunk = g_new0(save_chunk, 1);
+
+    chunk->level = level;
+    if (level < 0)
+        chunk->text = g_string_sized_new(SAVE_CHUNK_TEXT + BUFLEN);
+    else
+        chunk->nodes = g_ptr_array_sized_new(SAVE_CHUNK_NODES);
+    return chunk;
+}
+
+static void
+save_chunk_free(save_chunk *chunk)
+{
+    guint i;
+
+    if (chunk->nodes)
+    {
+        for (i = 0; i < chunk->nodes->len; i++)
+            xmlFreeNode(g_ptr_array_index(chunk->nodes, i));
+        g_ptr_array_free(chunk->nodes, TRUE);
+    }
+    if (chunk->text)
+        g_string_free(chunk->text, TRUE);
+    g_free(chunk->data);
+    g_free(chunk);
+}
+
+/* Dump the trees as xmlElemDump would, or as their parent would have
+ * dumped them if they are nested. */
+static void
+save_chunk_render(save_chunk *chunk)
+{
+    xmlBufferPtr buf;
+    guint i;
+    gint l;
+
+    if (!chunk->nodes)
+        return;
+
+    buf = xmlBufferCreate();
+    for (i = 0; i < chunk->nodes->len; i++)
+    {
+        xmlNodePtr node = g_ptr_array_index(chunk->nodes, i);
+
+        if (xmlIndentTreeOutput)
+            for (l = 0; l < chunk->level; l++)
+                xmlBufferCat(buf, BAD_CAST xmlTreeIndentString);
+        xmlNodeDump(buf, NULL, node, chunk->level, 1);
+        xmlBufferAdd(buf, BAD_CAST "\n", 1);
+        xmlFreeNode(node);
+    }
+    g_ptr_array_free(chunk->nodes, TRUE);
+    chunk->nodes = NULL;
+
+    chunk->text = g_string_new_len((const gchar *)xmlBufferContent(buf),
+                                   xmlBufferLength(buf));
+    xmlBufferFree(buf);
+}
+
+static gboolean
+save_chunk_deflate(save_chunk *chunk)
+{
+    z_stream zs;
+    gsize bound;
+    gint zval;
+
+    memset(&zs, 0, sizeof(zs));
+    /* 16 + MAX_WBITS asks for a gzip header and trailer */
+    if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS,
+                     8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return FALSE;
+
+    /* deflateBound() in older zlibs leaves no room for the gzip header */
+    bound = deflateBound(&zs, chunk->text->len) + 32;
+    chunk->data = g_malloc(bound);
+
+    zs.next_in = (Bytef *)chunk->text->str;
+    zs.avail_in = chunk->text->len;
+    zs.next_out = (Bytef *)chunk->data;
+    zs.avail_out = bound;
+    zval = deflate(&zs, Z_FINISH);
+    chunk->len = bound - zs.avail_out;
+    deflateEnd(&zs);
+
+    if (zval != Z_STREAM_END)
+    {
+        g_warning("Could not compress a chunk of the file (%d)", zval);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static void
+save_chunk_func(gpointer data, gpointer user_data)
+{
+    save_chunk *chunk = data;
+    save_pipeline *pl = user_data;
+    gboolean ok = TRUE;
+
+    save_chunk_render(chunk);
+    if (pl->compress)
+    {
+        ok = save_chunk_deflate(chunk);
+    }
+    else
+    {
+        chunk->len = chunk->text->len;
+        chunk->data = g_string_free(chunk->text, FALSE);
+        chunk->text = NULL;
+    }
+
+    g_mutex_lock(pl->lock);
+    if (!ok)
+        pl->failed = TRUE;
+    g_hash_table_insert(pl->finished, GUINT_TO_POINTER(chunk->seq), chunk);
+
+    if (!pl->writing)
+    {
+        pl->writing = TRUE;
+        while ((chunk = g_hash_table_lookup(pl->finished,
+                                            GUINT_TO_POINTER(pl->next_write))))
+        {
+            g_hash_table_remove(pl->finished, GUINT_TO_POINTER(pl->next_write));
+            g_mutex_unlock(pl->lock);
+
+            ok = fwrite(chunk->data, 1, chunk->len, pl->file) == chunk->len;
+            if (!ok)
+                g_warning("Could not write to the file. The error is '%s' (%d)",
+                          g_strerror(errno) ? g_strerror(errno) : "", errno);
+            save_chunk_free(chunk);
+
+            g_mutex_lock(pl->lock);
+            if (!ok)
+                pl->failed = TRUE;
+            pl->next_write++;
+            pl->queued--;
+            g_cond_broadcast(pl->cond);
+        }
+        pl->writing = FALSE;
+    }
+    g_mutex_unlock(pl->lock);
+}
+
+/* Give the chunk a place in the file and queue it for the workers,
+ * waiting if too many are unwritten. */
+static gboolean
+save_pipeline_submit(save_pipeline *pl, save_chunk *chunk)
+{
+    gboolean ok;
+
+    g_mutex_lock(pl->lock);
+    while (pl->queued >= pl->max_queued)
+        g_cond_wait(pl->cond, pl->lock);
+    chunk->seq = pl->next_seq++;
+    pl->queued++;
+    ok = !pl->failed;
+    g_mutex_unlock(pl->lock);
+
+    g_thread_pool_push(pl->pool, chunk, NULL);
+    return ok;
+}
+
+static save_chunk *
+save_collect_cut(save_pipeline *pl, save_chunk *chunk)
+{
+    if (chunk->text->len == 0)
+        return chunk;
+
+    save_pipeline_submit(pl, chunk);
+    return save_chunk_new(-1);
+}
+
+static gpointer
+save_collect_func(save_pipeline *pl)
+{
+    gchar buffer[BUFLEN];
+    save_chunk *chunk = save_chunk_new(-1);
+    gssize bytes;
+
+    while ((bytes = read(pl->fd, buffer, BUFLEN)) != 0)
+    {
+        gchar *p = buffer, *end, *mark;
+
+        if (bytes < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            g_warning("Could not read from pipe. The error is '%s' (errno %d)",
+                      g_strerror(errno) ? g_strerror(errno) : "", errno);
+            g_mutex_lock(pl->lock);
+            pl->failed = TRUE;
+            g_cond_broadcast(pl->cond);
+            g_mutex_unlock(pl->lock);
+            break;
+        }
+
+        for (end = buffer + bytes; p < end; p = mark + 1)
+        {
+            mark = memchr(p, '\0', end - p);
+            g_string_append_len(chunk->text, p, (mark ? mark : end) - p);
+            if (!mark)
+                break;
+
+            chunk = save_collect_cut(pl, chunk);
+            g_mutex_lock(pl->lock);
+            pl->syncs_done++;
+            g_cond_broadcast(pl->cond);
+            g_mutex_unlock(pl->lock);
+        }
+
+        if (chunk->text->len >= SAVE_CHUNK_TEXT)
+            chunk = save_collect_cut(pl, chunk);
+    }
+
+    save_chunk_free(save_collect_cut(pl, chunk));
+    close(pl->fd);
+    return NULL;
+}
+
+/* End the collector's chunk, so that what is handed over next follows
+ * everything printed to 'out' so far. */
+static gboolean
+save_pipeline_sync(save_pipeline *pl, FILE *out)
+{
+    gboolean ok;
+
+    if (fputc('\0', out) == EOF || fflush(out) != 0)
+        return FALSE;
+
+    g_mutex_lock(pl->lock);
+    pl->syncs_wanted++;
+    while (pl->syncs_done < pl->syncs_wanted && !pl->failed)
+        g_cond_wait(pl->cond, pl->lock);
+    ok = !pl->failed;
+    g_mutex_unlock(pl->lock);
+    return ok;
+}
+
+/* Queue a tree which sits 'level' elements deep; the pipeline frees it */
+static gboolean
+save_pipeline_add_node(save_pipeline *pl, save_chunk **chunk, gint level,
+                       xmlNodePtr node)
+{
+    if (!*chunk)
+        *chunk = save_chunk_new(level);
+    g_ptr_array_add((*chunk)->nodes, node);
+
+    if ((*chunk)->nodes->len < SAVE_CHUNK_NODES)
+        return TRUE;
+    return save_pipeline_flush(pl, chunk);
+}
+
+static gboolean
+save_pipeline_flush(save_pipeline *pl, save_chunk **chunk)
+{
+    save_chunk *to_submit = *chunk;
+
+    *chunk = NULL;
+    if (!to_submit)
+        return TRUE;
+    return save_pipeline_submit(pl, to_submit);
+}
+
+static gint
+save_pipeline_threads(void)
+{
+    const gchar *env = g_getenv(SAVE_THREADS_ENV);
+
+    if (env)
+        return atoi(env);
+#ifdef _SC_NPROCESSORS_ONLN
+    return MAX((gint)sysconf(_SC_NPROCESSORS_ONLN), 1);
+#else
+    return 2;
+#endif
+}
+
+static gboolean save_pipeline_finish(save_pipeline *pl, FILE *out);
+
+/* Open 'filename' for a pipelined save and return the stream the book
+ * should be written to in 'out', or NULL if the old way has to do. */
+static save_pipeline *
+save_pipeline_new(const char *filename, gboolean compress, FILE **out)
+{
+    save_pipeline *pl;
+    gint n_threads = save_pipeline_threads();
+    int filedes[2];
+    GError *error = NULL;
+
+    if (n_threads <= 0 || !g_thread_supported())
+        return NULL;
+    xmlInitParser();
+
+    if (strstr(filename, ".gz.") != NULL) /* its got a temp extension */
+        compress = TRUE;
+
+#ifdef G_OS_WIN32
+    if (_pipe(filedes, 4096, _O_BINARY) < 0)
+#else
+    if (pipe(filedes) < 0)
+#endif
+    {
+        g_warning("Pipe call failed. Saving without the pipeline.");
+        return NULL;
+    }
+
+    pl = g_new0(save_pipeline, 1);
+    /* Text mode for plain XML, as without the pipeline, so that line
+     * endings don't change on Windows; the pipe itself is binary. */
+    pl->file = g_fopen(filename, compress ? "wb" : "w");
+    if (!pl->file)
+    {
+        close(filedes[0]);
+        close(filedes[1]);
+        g_free(pl);
+        return NULL;
+    }
+    pl->compress = compress;
+    pl->fd = filedes[0];
+    pl->lock = g_mutex_new();
+    pl->cond = g_cond_new();
+    pl->finished = g_hash_table_new(g_direct_hash, g_direct_equal);
+    pl->max_queued = SAVE_QUEUED_PER_THREAD * n_threads;
+
+    pl->pool = g_thread_pool_new(save_chunk_func, pl, n_threads, FALSE, &error);
+    if (pl->pool)
+        pl->collector = g_thread_create((GThreadFunc) save_collect_func, pl,
+                                        TRUE, &error);
+    if (!pl->collector)
+    {
+        g_warning("Could not create threads for saving: %s", error->message);
+        g_error_free(error);
+        if (pl->pool)
+            g_thread_pool_free(pl->pool, TRUE, TRUE);
+        close(filedes[0]);
+        close(filedes[1]);
+        fclose(pl->file);
+        g_hash_table_destroy(pl->finished);
+        g_cond_free(pl->cond);
+        g_mutex_free(pl->lock);
+        g_free(pl);
+        return NULL;
+    }
+
+    *out = fdopen(filedes[1], "wb");
+    if (!*out)
+    {
+        close(filedes[1]);
+        save_pipeline_finish(pl, NULL);
+        return NULL;
+    }
+
+    PINFO("Saving %s with %d threads", filename, n_threads);
+    return pl;
+}
+
+/* Close 'out', wait for every chunk to reach the file and close it */
+static gboolean
+save_pipeline_finish(save_pipeline *pl, FILE *out)
+{
+    gboolean success = TRUE;
+
+    if (out && fclose(out))
+        success = FALSE;
+    g_thread_join(pl->collector);
+    g_thread_pool_free(pl->pool, FALSE, TRUE);
+
+    if (pl->failed || fclose(pl->file))
+        success = FALSE;
+
+    g_hash_table_destroy(pl->finished);
+    g_cond_free(pl->cond);
+    g_mutex_free(pl->lock);
+    g_free(pl);
+    return success;
+}
+
 gboolean
 gnc_book_write_to_xml_file_v2(
     QofBook *book,
@@ -1534,8 +2067,22 @@ gnc_book_write_to_xml_file_v2(
     gboolean compress)
 {
     FILE *out;
+    save_pipeline *pl;
     gboolean success = TRUE;
 
+    pl = save_pipeline_new(filename, compress, &out);
+    if (pl)
+    {
+        if (!write_book_to_filehandle(book, out, pl)
+                || !write_emacs_trailer(out))
+            success = FALSE;
+
+        if (!save_pipeline_finish(pl, out))
+            success = FALSE;
+
+        return success;
+    }
+
     out = try_gz_open(filename, "w", compress, TRUE);
 
     /* Try to write as much as possible */
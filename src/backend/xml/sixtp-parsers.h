@@ -35,4 +35,54 @@ sixtp* sixtp_dom_parser_new(sixtp_end_handler ender,
                             sixtp_result_handler cleanup_result_by_default_func,
                             sixtp_result_handler cleanup_result_on_fail_func);
 
+/* Handlers for a parser that streams a sub-tree to its owner instead
+   of building a DOM tree.  'begin' is called at the opening tag of the
+   element itself and returns the object being built, which is handed
+   to the other handlers.  'start' and 'end' are called at the opening
+   and closing tags of every element inside it, with depth 1 for its
+   children; 'end' also gets the text directly inside the element,
+   which is only meaningful for leaves.  'finish' is called at the
+   closing tag, or when the parse is abandoned, with ok FALSE if any
+   handler failed.  It may leave a result in *result.  The handlers
+   are kept for the element's tag, which the parser must be registered
+   under.
+*/
+typedef struct
+{
+    gpointer (*begin)(gpointer global_data, const gchar *tag, gchar **attrs);
+    gboolean (*start)(gpointer data, guint depth, const gchar *tag,
+                      gchar **attrs);
+    gboolean (*end)(gpointer data, guint depth, const gchar *tag,
+                    const gchar *text);
+    gboolean (*finish)(gpointer data, gpointer global_data, const gchar *tag,
+                       gboolean ok, gpointer *result);
+} sixtp_stream_handlers;
+
+sixtp* sixtp_stream_parser_new(const gchar *tag,
+                               const sixtp_stream_handlers *handlers,
+                               sixtp_result_handler cleanup_result_by_default_func,
+                               sixtp_result_handler cleanup_result_on_fail_func);
+
+/* TRUE if GNC_XML_DOM_PARSER is set in the environment, in which case
+   the object parsers that can stream go through a DOM tree instead. */
+gboolean sixtp_use_dom_parsers(void);
+
+/* Fills a kvp_frame from the stream events of a <slots> element.  Feed
+   it every start and end inside the element, not the element itself. */
+typedef struct sixtp_kvp_builder sixtp_kvp_builder;
+
+sixtp_kvp_builder* sixtp_kvp_builder_new(kvp_frame *frame);
+gboolean sixtp_kvp_builder_start(sixtp_kvp_builder *builder, const gchar *tag,
+                                 gchar **attrs);
+gboolean sixtp_kvp_builder_end(sixtp_kvp_builder *builder, const gchar *tag,
+                               const gchar *text);
+void sixtp_kvp_builder_destroy(sixtp_kvp_builder *builder);
+
+/* TRUE if attrs has type="guid" (or "new"), as an id element must. */
+gboolean sixtp_attrs_are_guid(gchar **attrs);
+
+/* Look up the commodity named by <cmdty:space> and <cmdty:id> text. */
+gnc_commodity* sixtp_lookup_commodity_ref(QofBook *book, gchar *space,
+        gchar *id);
+
 #endif /* _SIXTP_PARSERS_H_ */
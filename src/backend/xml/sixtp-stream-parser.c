@@ -0,0 +1,531 @@
+/********************************************************************
+ * sixtp-stream-parser.c -- build objects straight from SAX events  *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+ *                                                                  *
+ ********************************************************************/
+
+/* The DOM parser (sixtp-to-dom-parser.c) builds an xmlNode for every
+   element of an object and converts the tree when the object is
+   closed.  For the objects there are most of in a book -- transactions,
+   their splits and slots, and prices -- that tree is pure overhead.
+   The stream parser hands the elements to the object's handlers as
+   they go by instead, with the text of each leaf, so the object is
+   filled in as the file is read and nothing is left to free. */
+
+#include "config.h"
+
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sixtp-parsers.h"
+#include "sixtp-utils.h"
+#include "sixtp-dom-parsers.h"
+
+static QofLogModule log_module = GNC_MOD_IO;
+
+#define DOM_PARSERS_ENV "GNC_XML_DOM_PARSER"
+
+/* The parse state of one object, shared by the frames of its elements */
+typedef struct
+{
+    const sixtp_stream_handlers *handlers;
+    gpointer data;
+    GString *text;
+    guint depth;
+    gboolean ok;
+} sixtp_stream_state;
+
+/* tag -> sixtp_stream_handlers */
+static GHashTable *stream_handlers = NULL;
+
+gboolean
+sixtp_use_dom_parsers(void)
+{
+    return g_getenv(DOM_PARSERS_ENV) != NULL;
+}
+
+/***********************************************************************/
+
+static sixtp_stream_state*
+stream_state_new(gpointer global_data, const gchar *tag, gchar **attrs)
+{
+    const sixtp_stream_handlers *handlers;
+    sixtp_stream_state *state;
+
+    handlers = g_hash_table_lookup(stream_handlers, tag);
+    if (!handlers)
+    {
+        PERR("No stream handlers for <%s>", tag);
+        return NULL;
+    }
+
+    state = g_new0(sixtp_stream_state, 1);
+    state->handlers = handlers;
+    state->text = g_string_sized_new(64);
+    state->data = handlers->begin(global_data, tag, attrs);
+    state->ok = (state->data != NULL);
+    return state;
+}
+
+static gboolean
+stream_state_finish(sixtp_stream_state *state, gpointer global_data,
+                    const gchar *tag, gboolean ok, gpointer *result)
+{
+    gboolean ret = FALSE;
+
+    if (state->data)
+    {
+        ret = state->handlers->finish(state->data, global_data, tag,
+                                      ok && state->ok, result);
+    }
+    g_string_free(state->text, TRUE);
+    g_free(state);
+    return ret && ok;
+}
+
+/* The parser is its own catcher, like the DOM parser, so this is called
+   for the object's element (no state yet) and for everything inside it.
+   Used as the top-level parser of a file it is first called for the
+   file itself, with no tag. */
+static gboolean
+stream_start_handler(GSList* sibling_data, gpointer parent_data,
+                     gpointer global_data, gpointer *data_for_children,
+                     gpointer *result, const gchar *tag, gchar **attrs)
+{
+    sixtp_stream_state *state = parent_data;
+
+    *result = NULL;
+    *data_for_children = NULL;
+    if (!tag) return TRUE;
+
+    if (!state)
+    {
+        state = stream_state_new(global_data, tag, attrs);
+        *data_for_children = state;
+        return state != NULL && state->ok;
+    }
+
+    *data_for_children = state;
+    state->depth++;
+    g_string_truncate(state->text, 0);
+    if (state->ok && !state->handlers->start(state->data, state->depth, tag, attrs))
+        state->ok = FALSE;
+    return state->ok;
+}
+
+static gboolean
+stream_chars_handler(GSList *sibling_data, gpointer parent_data,
+                     gpointer global_data, gpointer *result,
+                     const char *text, int length)
+{
+    sixtp_stream_state *state = parent_data;
+
+    *result = NULL;
+    if (state && length > 0)
+        g_string_append_len(state->text, text, length);
+    return TRUE;
+}
+
+static gboolean
+stream_end_handler(gpointer data_for_children, GSList* data_from_children,
+                   GSList* sibling_data, gpointer parent_data,
+                   gpointer global_data, gpointer *result, const gchar *tag)
+{
+    sixtp_stream_state *state = data_for_children;
+
+    if (!state || !tag) return TRUE;
+
+    if (state->depth == 0)
+        return stream_state_finish(state, global_data, tag, TRUE, result);
+
+    if (state->ok && !state->handlers->end(state->data, state->depth, tag,
+                                           state->text->str))
+        state->ok = FALSE;
+    state->depth--;
+    g_string_truncate(state->text, 0);
+    return state->ok;
+}
+
+static void
+stream_fail_handler(gpointer data_for_children, GSList* data_from_children,
+                    GSList* sibling_data, gpointer parent_data,
+                    gpointer global_data, gpointer *result, const gchar *tag)
+{
+    sixtp_stream_state *state = data_for_children;
+
+    if (!state) return;
+
+    /* The frames are cleaned up innermost first; the object's own frame
+       is the one which owns the state. */
+    if (state->depth > 0)
+    {
+        state->depth--;
+        return;
+    }
+    stream_state_finish(state, global_data, tag, FALSE, result);
+    *result = NULL;
+}
+
+sixtp *
+sixtp_stream_parser_new(const gchar *tag,
+                        const sixtp_stream_handlers *handlers,
+                        sixtp_result_handler cleanup_result_by_default_func,
+                        sixtp_result_handler cleanup_result_on_fail_func)
+{
+    sixtp *top_level;
+
+    g_return_val_if_fail(tag, NULL);
+    g_return_val_if_fail(handlers, NULL);
+
+    if (!stream_handlers)
+        stream_handlers = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                g_free, NULL);
+    g_hash_table_replace(stream_handlers, g_strdup(tag), (gpointer)handlers);
+
+    if (!(top_level =
+                sixtp_set_any(sixtp_new(), FALSE,
+                              SIXTP_START_HANDLER_ID, stream_start_handler,
+                              SIXTP_CHARACTERS_HANDLER_ID, stream_chars_handler,
+                              SIXTP_END_HANDLER_ID, stream_end_handler,
+                              SIXTP_FAIL_HANDLER_ID, stream_fail_handler,
+                              SIXTP_NO_MORE_HANDLERS)))
+    {
+        return NULL;
+    }
+
+    if (cleanup_result_by_default_func)
+    {
+        sixtp_set_cleanup_result(top_level, cleanup_result_by_default_func);
+    }
+
+    if (cleanup_result_on_fail_func)
+    {
+        sixtp_set_result_fail(top_level, cleanup_result_on_fail_func);
+    }
+
+    if (!sixtp_add_sub_parser(top_level, SIXTP_MAGIC_CATCHER, top_level))
+    {
+        sixtp_destroy(top_level);
+        return NULL;
+    }
+
+    return top_level;
+}
+
+/***********************************************************************/
+/* Helpers for the stream handlers */
+
+gboolean
+sixtp_attrs_are_guid(gchar **attrs)
+{
+    gchar **atptr;
+
+    for (atptr = attrs; atptr && *atptr; atptr += 2)
+    {
+        if (strcmp(atptr[0], "type") == 0)
+        {
+            if (safe_strcmp(atptr[1], "guid") == 0
+                    || safe_strcmp(atptr[1], "new") == 0)
+                return TRUE;
+            PERR("Unknown type %s for attribute type", atptr[1]);
+            return FALSE;
+        }
+        PERR("Unknown attribute for id tag: %s", atptr[0]);
+        return FALSE;
+    }
+    return FALSE;
+}
+
+gnc_commodity*
+sixtp_lookup_commodity_ref(QofBook *book, gchar *space, gchar *id)
+{
+    gnc_commodity *ret;
+
+    if (!space || !id) return NULL;
+
+    ret = gnc_commodity_table_lookup(gnc_commodity_table_get_table(book),
+                                     g_strstrip(space), g_strstrip(id));
+    if (!ret)
+        PERR("Unknown commodity %s:%s", space, id);
+    return ret;
+}
+
+static const gchar*
+attrs_get_type(gchar **attrs)
+{
+    gchar **atptr;
+
+    for (atptr = attrs; atptr && *atptr; atptr += 2)
+    {
+        if (strcmp(atptr[0], "type") == 0)
+            return atptr[1];
+    }
+    return NULL;
+}
+
+/***********************************************************************/
+/* Slots
+
+   <slot>
+     <slot:key>notes</slot:key>
+     <slot:value type="string">...</slot:value>
+   </slot>
+
+   A value of type "frame" holds more slots, one of type "list" holds
+   bare <slot:value>s.  Each of those opens a level; leaf values are
+   built from their text when they close and handed to the innermost
+   level.
+*/
+
+typedef struct
+{
+    kvp_frame *frame;       /* NULL for a list */
+    GList *list;            /* reversed */
+    guint depth;            /* of the <slot:value> which opened it */
+    gchar *key;             /* of the <slot> being read */
+    kvp_value *value;
+} kvp_level;
+
+struct sixtp_kvp_builder
+{
+    GSList *levels;
+    guint depth;
+    gchar *type;            /* of the leaf <slot:value> being read */
+    Timespec ts;
+    gboolean seen_ts;
+    GDate date;
+};
+
+static void
+kvp_level_free(kvp_level *level, gboolean owned)
+{
+    GList *node;
+
+    g_free(level->key);
+    if (level->value) kvp_value_delete(level->value);
+    for (node = level->list; node; node = node->next)
+        kvp_value_delete(node->data);
+    g_list_free(level->list);
+    if (owned && level->frame) kvp_frame_delete(level->frame);
+    g_free(level);
+}
+
+sixtp_kvp_builder*
+sixtp_kvp_builder_new(kvp_frame *frame)
+{
+    sixtp_kvp_builder *builder = g_new0(sixtp_kvp_builder, 1);
+    kvp_level *base = g_new0(kvp_level, 1);
+
+    base->frame = frame;
+    builder->levels = g_slist_prepend(NULL, base);
+    return builder;
+}
+
+void
+sixtp_kvp_builder_destroy(sixtp_kvp_builder *builder)
+{
+    GSList *node;
+
+    if (!builder) return;
+    for (node = builder->levels; node; node = node->next)
+    {
+        kvp_level *level = node->data;
+        kvp_level_free(level, level->depth != 0);
+    }
+    g_slist_free(builder->levels);
+    g_free(builder->type);
+    g_free(builder);
+}
+
+gboolean
+sixtp_kvp_builder_start(sixtp_kvp_builder *builder, const gchar *tag,
+                        gchar **attrs)
+{
+    kvp_level *top = builder->levels->data;
+
+    builder->depth++;
+    if (strcmp(tag, "slot") == 0)
+    {
+        g_free(top->key);
+        top->key = NULL;
+        if (top->value) kvp_value_delete(top->value);
+        top->value = NULL;
+    }
+    else if (strcmp(tag, "slot:value") == 0)
+    {
+        const gchar *type = attrs_get_type(attrs);
+
+        if (safe_strcmp(type, "frame") == 0 || safe_strcmp(type, "list") == 0)
+        {
+            kvp_level *level = g_new0(kvp_level, 1);
+
+            if (type[0] == 'f') level->frame = kvp_frame_new();
+            level->depth = builder->depth;
+            builder->levels = g_slist_prepend(builder->levels, level);
+        }
+        else
+        {
+            g_free(builder->type);
+            builder->type = g_strdup(type);
+            builder->ts.tv_sec = 0;
+            builder->ts.tv_nsec = 0;
+            builder->seen_ts = FALSE;
+            g_date_clear(&builder->date, 1);
+        }
+    }
+    return TRUE;
+}
+
+/* Same conversions as dom_tree_to_kvp_value() */
+static kvp_value*
+leaf_kvp_value(sixtp_kvp_builder *builder, const gchar *text)
+{
+    const gchar *type = builder->type;
+
+    if (!type)
+    {
+        return NULL;
+    }
+    else if (strcmp(type, "integer") == 0)
+    {
+        gint64 i;
+        if (string_to_gint64(text, &i)) return kvp_value_new_gint64(i);
+    }
+    else if (strcmp(type, "double") == 0)
+    {
+        double d;
+        if (string_to_double(text, &d)) return kvp_value_new_double(d);
+    }
+    else if (strcmp(type, "numeric") == 0)
+    {
+        gnc_numeric n;
+        if (string_to_gnc_numeric(text, &n)) return kvp_value_new_gnc_numeric(n);
+    }
+    else if (strcmp(type, "string") == 0)
+    {
+        return kvp_value_new_string(text);
+    }
+    else if (strcmp(type, "guid") == 0)
+    {
+        GncGUID guid;
+        if (string_to_guid(text, &guid)) return kvp_value_new_guid(&guid);
+    }
+    else if (strcmp(type, "timespec") == 0)
+    {
+        if (!builder->seen_ts)
+            PERR("no ts:date node found.");
+        else if (builder->ts.tv_sec || builder->ts.tv_nsec)
+            return kvp_value_new_timespec(builder->ts);
+    }
+    else if (strcmp(type, "gdate") == 0)
+    {
+        if (g_date_valid(&builder->date)) return kvp_value_new_gdate(builder->date);
+        PWARN("invalid date");
+    }
+    else if (strcmp(type, "binary") == 0)
+    {
+        void *val;
+        guint64 len;
+        if (string_to_binary(text, &val, &len)) return kvp_value_new_binary_nc(val, len);
+        PERR("string_to_binary returned false");
+    }
+    return NULL;
+}
+
+gboolean
+sixtp_kvp_builder_end(sixtp_kvp_builder *builder, const gchar *tag,
+                      const gchar *text)
+{
+    kvp_level *top = builder->levels->data;
+
+    if (strcmp(tag, "slot:key") == 0)
+    {
+        g_free(top->key);
+        top->key = g_strdup(text);
+    }
+    else if (strcmp(tag, "ts:date") == 0)
+    {
+        builder->seen_ts = string_to_timespec_secs(text, &builder->ts);
+    }
+    else if (strcmp(tag, "ts:ns") == 0)
+    {
+        (void)string_to_timespec_nsecs(text, &builder->ts);
+    }
+    else if (strcmp(tag, "gdate") == 0)
+    {
+        gint year, month, day;
+        if (sscanf(text, "%d-%d-%d", &year, &month, &day) == 3
+                && g_date_valid_dmy(day, month, year))
+            g_date_set_dmy(&builder->date, day, month, year);
+    }
+    else if (strcmp(tag, "slot:value") == 0)
+    {
+        kvp_value *value;
+
+        if (top->depth == builder->depth)
+        {
+            /* the end of a frame or list */
+            builder->levels = g_slist_delete_link(builder->levels, builder->levels);
+            if (top->frame)
+            {
+                value = kvp_value_new_frame_nc(top->frame);
+            }
+            else
+            {
+                value = kvp_value_new_glist_nc(g_list_reverse(top->list));
+            }
+            top->frame = NULL;
+            top->list = NULL;
+            kvp_level_free(top, TRUE);
+            top = builder->levels->data;
+        }
+        else
+        {
+            value = leaf_kvp_value(builder, text);
+            g_free(builder->type);
+            builder->type = NULL;
+        }
+
+        if (value)
+        {
+            if (top->frame)
+            {
+                if (top->value) kvp_value_delete(top->value);
+                top->value = value;
+            }
+            else
+            {
+                top->list = g_list_prepend(top->list, value);
+            }
+        }
+    }
+    else if (strcmp(tag, "slot") == 0)
+    {
+        if (top->key && top->value)
+        {
+            kvp_frame_set_slot_nc(top->frame, top->key, top->value);
+            top->value = NULL;
+        }
+        g_free(top->key);
+        top->key = NULL;
+    }
+    builder->depth--;
+    return TRUE;
+}
@@ -445,6 +445,61 @@ gnc_timegm (struct tm *tm)
    all goes well, returns the Timespec* as the result.
 */
 
+/* Read exactly 'n' decimal digits. */
+static gboolean
+read_digits (const gchar **str, int n, int *value)
+{
+    const gchar *s = *str;
+    int i;
+
+    *value = 0;
+    for (i = 0; i < n; i++)
+    {
+        if (s[i] < '0' || s[i] > '9')
+            return FALSE;
+        *value = *value * 10 + (s[i] - '0');
+    }
+    *str = s + n;
+    return TRUE;
+}
+
+/* The strings timespec_secs_to_given_string() writes,
+   "YYYY-MM-DD HH:MM:SS +hhmm", read without strptime() and sscanf().
+   Anything else is left to them. */
+static gboolean
+string_to_timespec_secs_fast(const gchar *str, struct tm *parsed_time,
+                             long int *gmtoff)
+{
+    int tz_hour, tz_min;
+    gchar sign;
+
+    if (!read_digits(&str, 4, &parsed_time->tm_year) || *str++ != '-'
+            || !read_digits(&str, 2, &parsed_time->tm_mon) || *str++ != '-'
+            || !read_digits(&str, 2, &parsed_time->tm_mday) || *str++ != ' '
+            || !read_digits(&str, 2, &parsed_time->tm_hour) || *str++ != ':'
+            || !read_digits(&str, 2, &parsed_time->tm_min) || *str++ != ':'
+            || !read_digits(&str, 2, &parsed_time->tm_sec) || *str++ != ' ')
+        return FALSE;
+
+    sign = *str++;
+    if ((sign != '+') && (sign != '-')) return FALSE;
+    if (!read_digits(&str, 2, &tz_hour) || !read_digits(&str, 2, &tz_min))
+        return FALSE;
+    if (!isspace_str(str, -1)) return FALSE;
+
+    if (parsed_time->tm_mon < 1 || parsed_time->tm_mon > 12
+            || parsed_time->tm_mday < 1 || parsed_time->tm_mday > 31
+            || parsed_time->tm_hour > 23 || parsed_time->tm_min > 59
+            || parsed_time->tm_sec > 59)
+        return FALSE;
+
+    parsed_time->tm_year -= 1900;
+    parsed_time->tm_mon -= 1;
+    *gmtoff = tz_hour * 60 * 60 + tz_min * 60;
+    if (sign == '-') *gmtoff = - *gmtoff;
+    return TRUE;
+}
+
 gboolean
 string_to_timespec_secs(const gchar *str, Timespec *ts)
 {
@@ -458,6 +513,16 @@ string_to_timespec_secs(const gchar *str, Timespec *ts)
 
     memset(&parsed_time, 0, sizeof(struct tm));
 
+    if (string_to_timespec_secs_fast(str, &parsed_time, &gmtoff))
+    {
+        parsed_time.tm_isdst = -1;
+        parsed_secs = gnc_timegm(&parsed_time);
+        if (parsed_secs == (time_t) - 1) return(FALSE);
+        ts->tv_sec = parsed_secs - gmtoff;
+        return(TRUE);
+    }
+    memset(&parsed_time, 0, sizeof(struct tm));
+
     /* If you change this, make sure you also change the output code, if
        necessary. */
     /*fprintf(stderr, "parsing (%s)\n", str);*/
@@ -514,6 +579,20 @@ string_to_timespec_nsecs(const gchar *str, Timespec *ts)
 
     if (!str || !ts) return FALSE;
 
+    /* Plain digits, as they are written out, need no sscanf(). */
+    nanosecs = 0;
+    for (charcount = 0; charcount < 9; charcount++)
+    {
+        if (!isdigit(((unsigned char*)str)[charcount]))
+            break;
+        nanosecs = nanosecs * 10 + (str[charcount] - '0');
+    }
+    if (charcount > 0 && str[charcount] == '\0')
+    {
+        ts->tv_nsec = nanosecs;
+        return(TRUE);
+    }
+
     /* The '%n' doesn't count as a conversion. */
     if (1 != sscanf(str, " %ld%n", &nanosecs, &charcount))
         return FALSE;
@@ -529,6 +608,20 @@ string_to_timespec_nsecs(const gchar *str, Timespec *ts)
     return(TRUE);
 }
 
+/* Write 'value' as exactly 'n' decimal digits. */
+static void
+write_digits (gchar **str, int value, int n)
+{
+    int i;
+
+    for (i = n - 1; i >= 0; i--)
+    {
+        (*str)[i] = '0' + value % 10;
+        value /= 10;
+    }
+    *str += n;
+}
+
 gboolean
 timespec_secs_to_given_string (const Timespec *ts, gchar *str)
 {
@@ -545,16 +638,9 @@ timespec_secs_to_given_string (const Timespec *ts, gchar *str)
 
     tmp_time = ts->tv_sec;
 
-    if (!localtime_r(&tmp_time, &parsed_time))
-        return FALSE;
-
-    num_chars = qof_strftime(str, TIMESPEC_SEC_FORMAT_MAX,
-                             TIMESPEC_TIME_FORMAT, &parsed_time);
-    if (num_chars == 0)
+    if (!gnc_localtime_r(&tmp_time, &parsed_time))
         return FALSE;
 
-    str += num_chars;
-
     tz = gnc_timezone (&parsed_time);
 
     /* gnc_timezone is seconds west of UTC */
@@ -564,6 +650,37 @@ timespec_secs_to_given_string (const Timespec *ts, gchar *str)
     hours = minutes / 60;
     minutes -= hours * 60;
 
+    /* TIMESPEC_TIME_FORMAT written out by hand, for the years it gives
+       four digits for. */
+    if (parsed_time.tm_year + 1900 >= 1000
+            && parsed_time.tm_year + 1900 <= 9999 && hours < 100)
+    {
+        write_digits(&str, parsed_time.tm_year + 1900, 4);
+        *str++ = '-';
+        write_digits(&str, parsed_time.tm_mon + 1, 2);
+        *str++ = '-';
+        write_digits(&str, parsed_time.tm_mday, 2);
+        *str++ = ' ';
+        write_digits(&str, parsed_time.tm_hour, 2);
+        *str++ = ':';
+        write_digits(&str, parsed_time.tm_min, 2);
+        *str++ = ':';
+        write_digits(&str, parsed_time.tm_sec, 2);
+        *str++ = ' ';
+        *str++ = (sign > 0) ? '+' : '-';
+        write_digits(&str, hours, 2);
+        write_digits(&str, minutes, 2);
+        *str = '\0';
+        return TRUE;
+    }
+
+    num_chars = qof_strftime(str, TIMESPEC_SEC_FORMAT_MAX,
+                             TIMESPEC_TIME_FORMAT, &parsed_time);
+    if (num_chars == 0)
+        return FALSE;
+
+    str += num_chars;
+
     g_snprintf (str, TIMESPEC_SEC_FORMAT_MAX - num_chars,
                 " %c%02d%02d", (sign > 0) ? '+' : '-', hours, minutes);
 
@@ -63,6 +63,29 @@ main(int argc, char **argv)
         g_free(sec_str);
         g_free(nsec_str);
     }
+
+    /* Strings not written the usual way still read the same. */
+    {
+        Timespec spec1, spec2;
+
+        if (!string_to_timespec_secs("2001-02-03 04:05:06 -0530", &spec1)
+                || !string_to_timespec_secs(" 2001-2-3 4:5:6  -0530\n", &spec2)
+                || spec1.tv_sec != 981192906 || spec2.tv_sec != spec1.tv_sec)
+            failure_args("timespec_secs", __FILE__, __LINE__,
+                         "irregular string read differently");
+        else if (!string_to_timespec_nsecs("658864000", &spec1)
+                 || !string_to_timespec_nsecs(" 658864000 ", &spec2)
+                 || spec1.tv_nsec != 658864000
+                 || spec2.tv_nsec != spec1.tv_nsec)
+            failure_args("timespec_nsecs", __FILE__, __LINE__,
+                         "irregular string read differently");
+        else if (string_to_timespec_secs("2001-02-03 04:05:06", &spec1)
+                 || string_to_timespec_nsecs("6588x", &spec1))
+            failure_args("timespec", __FILE__, __LINE__,
+                         "bad string read");
+        else
+            success("irregular timespec strings");
+    }
     print_test_results();
     exit(get_rv());
 }
@@ -24,22 +24,41 @@
 
 /* @file test-load-xml2.c
  * @brief test the loading of a version-2 gnucash XML file
+ *
+ * Each file is loaded twice, once with transactions and prices streamed
+ * into the engine and once through DOM trees (GNC_XML_DOM_PARSER), and
+ * the two books are compared.  Given any argument, e.g.
+ *
+ *   test-load-xml2 bench
+ *
+ * it also prints the load times and peak resident set size of each; the
+ * DOM load runs second, so its peak includes the streamed book that is
+ * still open.
+ *
+ * The book is then saved with and without the save pipeline, and once
+ * compressed, and the contents of the files compared.
  */
 
 #include "config.h"
+#include <stdio.h>
 #include <stdlib.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <dirent.h>
 #include <string.h>
+#ifdef HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#endif
 #include <glib.h>
 #include <glib-object.h>
 #include <glib/gstdio.h>
+#include <zlib.h>
 
 #include "cashobjects.h"
 #include "TransLog.h"
 #include "gnc-engine.h"
+#include "Transaction.h"
 #include "gnc-backend-xml.h"
 #include "io-gncxml-v2.h"
 
@@ -72,13 +91,32 @@ remove_locks(const char *filename)
     remove_files_pattern(filename, ".LCK");
 }
 
-static void
-test_load_file(const char *filename)
+/* Peak resident set size in kB, or 0 if it isn't available */
+static glong
+peak_rss_kb(void)
+{
+#ifdef HAVE_SYS_RESOURCE_H
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        return usage.ru_maxrss;
+#endif
+    return 0;
+}
+
+static QofSession *
+load_file(const char *filename, gboolean use_dom, gdouble *secs)
 {
     QofSession *session;
     QofBook *book;
     Account *root;
     gboolean ignore_lock;
+    GTimer *timer;
+
+    if (use_dom)
+        g_setenv("GNC_XML_DOM_PARSER", "1", TRUE);
+    else
+        g_unsetenv("GNC_XML_DOM_PARSER");
 
     session = qof_session_new();
 
@@ -87,7 +125,10 @@ test_load_file(const char *filename)
     ignore_lock = (safe_strcmp(g_getenv("SRCDIR"), ".") != 0);
     qof_session_begin(session, filename, ignore_lock, FALSE, TRUE);
 
+    timer = g_timer_new();
     qof_session_load(session, NULL);
+    *secs = g_timer_elapsed(timer, NULL);
+    g_timer_destroy(timer);
     book = qof_session_get_book (session);
 
     root = gnc_book_get_root_account(book);
@@ -98,6 +139,149 @@ test_load_file(const char *filename)
                  "session load xml2", __FILE__, __LINE__,
                  "qof error=%d for file [%s]",
                  qof_session_get_error(session), filename);
+    return session;
+}
+
+static void
+compare_tx(QofInstance *inst, gpointer data)
+{
+    QofBook *other = data;
+    Transaction *trans = GNC_TRANSACTION(inst);
+    Transaction *other_trans = xaccTransLookup(qof_instance_get_guid(inst), other);
+
+    do_test_args(xaccTransEqual(trans, other_trans, TRUE, TRUE, TRUE, FALSE),
+                 "streamed transaction matches DOM", __FILE__, __LINE__,
+                 "%s", xaccTransGetDescription(trans));
+}
+
+/* Contents of a file, gzipped or not */
+static GString *
+read_file(const char *filename)
+{
+    GString *contents = g_string_new(NULL);
+    gchar buffer[4096];
+    gzFile file = gzopen(filename, "rb");
+    int bytes;
+
+    if (!file)
+        return contents;
+    while ((bytes = gzread(file, buffer, sizeof(buffer))) > 0)
+        g_string_append_len(contents, buffer, bytes);
+    gzclose(file);
+    return contents;
+}
+
+/* Save the book in 'session' to 'filename' with 'threads' save workers */
+static void
+save_copy(QofSession *session, const char *filename, const char *threads)
+{
+    QofSession *copy = qof_session_new();
+
+    g_unlink(filename);
+    g_setenv("GNC_XML_SAVE_THREADS", threads, TRUE);
+    qof_session_begin(copy, filename, TRUE, TRUE, TRUE);
+    qof_session_swap_data(session, copy);
+    qof_session_save(copy, NULL);
+    do_test_args(qof_session_get_error(copy) == ERR_BACKEND_NO_ERR,
+                 "session save xml2", __FILE__, __LINE__,
+                 "qof error=%d for file [%s]",
+                 qof_session_get_error(copy), filename);
+    qof_session_swap_data(session, copy);
+    qof_session_end(copy);
+    qof_session_destroy(copy);
+    g_unsetenv("GNC_XML_SAVE_THREADS");
+}
+
+static void
+test_save_pipeline(QofSession *session)
+{
+    QofBook *book = qof_session_get_book(session);
+    gchar *plain = g_build_filename(g_get_tmp_dir(), "test-load-xml2-plain.xml", NULL);
+    gchar *piped = g_build_filename(g_get_tmp_dir(), "test-load-xml2-piped.xml", NULL);
+    /* A ".gz." in the name forces compression */
+    gchar *gz = g_build_filename(g_get_tmp_dir(), "test-load-xml2.gz.xml", NULL);
+    GString *plain_text, *piped_text, *gz_text;
+    QofSession *reload;
+    gboolean ignore_lock;
+
+    save_copy(session, plain, "0");
+    save_copy(session, piped, "4");
+    save_copy(session, gz, "4");
+
+    plain_text = read_file(plain);
+    piped_text = read_file(piped);
+    gz_text = read_file(gz);
+    do_test(plain_text->len > 0, "book was saved");
+    do_test(g_string_equal(plain_text, piped_text),
+            "pipelined save writes the same file");
+    do_test(g_string_equal(plain_text, gz_text),
+            "compressed pipelined save has the same contents");
+
+    reload = qof_session_new();
+    ignore_lock = (safe_strcmp(g_getenv("SRCDIR"), ".") != 0);
+    qof_session_begin(reload, gz, ignore_lock, FALSE, TRUE);
+    qof_session_load(reload, NULL);
+    do_test(qof_session_get_error(reload) == ERR_BACKEND_NO_ERR,
+            "load compressed pipelined save");
+    do_test(qof_collection_count(qof_book_get_collection(
+                                     qof_session_get_book(reload), GNC_ID_TRANS)) ==
+            qof_collection_count(qof_book_get_collection(book, GNC_ID_TRANS)),
+            "compressed pipelined save reads back every transaction");
+    qof_session_end(reload);
+    qof_session_destroy(reload);
+
+    g_string_free(plain_text, TRUE);
+    g_string_free(piped_text, TRUE);
+    g_string_free(gz_text, TRUE);
+    g_unlink(plain);
+    g_unlink(piped);
+    g_unlink(gz);
+    g_free(plain);
+    g_free(piped);
+    g_free(gz);
+}
+
+static gboolean benchmark = FALSE;
+
+static void
+test_load_file(const char *filename)
+{
+    QofSession *session;
+    QofSession *dom_session;
+    QofBook *book;
+    QofBook *dom_book;
+    gdouble secs, dom_secs;
+    glong rss, dom_rss;
+
+    session = load_file(filename, FALSE, &secs);
+    rss = peak_rss_kb();
+    book = qof_session_get_book(session);
+
+    dom_session = load_file(filename, TRUE, &dom_secs);
+    dom_rss = peak_rss_kb();
+    dom_book = qof_session_get_book(dom_session);
+    g_unsetenv("GNC_XML_DOM_PARSER");
+
+    do_test(qof_collection_count(qof_book_get_collection(book, GNC_ID_TRANS)) ==
+            qof_collection_count(qof_book_get_collection(dom_book, GNC_ID_TRANS)),
+            "streamed and DOM loads have the same transactions");
+    do_test(qof_collection_count(qof_book_get_collection(book, GNC_ID_PRICE)) ==
+            qof_collection_count(qof_book_get_collection(dom_book, GNC_ID_PRICE)),
+            "streamed and DOM loads have the same prices");
+    qof_collection_foreach(qof_book_get_collection(book, GNC_ID_TRANS),
+                           compare_tx, dom_book);
+
+    if (benchmark)
+    {
+        printf("%s: stream %.3fs, DOM %.3fs; peak RSS %ld kB, %ld kB\n",
+               filename, secs, dom_secs, rss, dom_rss);
+    }
+
+    qof_session_end(dom_session);
+    qof_session_destroy(dom_session);
+
+    test_save_pipeline(session);
+
     /* Uncomment the line below to generate corrected files */
     qof_session_save( session, NULL );
     qof_session_end(session);
@@ -111,6 +295,7 @@ main (int argc, char ** argv)
 
     g_type_init();
     qof_init();
+    benchmark = (argc > 1);
     cashobjects_register();
     do_test(qof_load_backend_library ("../.libs/", GNC_LIB_NAME),
             " loading gnc-backend-xml GModule failed");
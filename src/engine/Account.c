@@ -38,6 +38,10 @@
 #include "gnc-glib-utils.h"
 #include "gnc-lot.h"
 #include "gnc-pricedb.h"
+#include "gnc-split-index.h"
+#include "Query.h"
+#include "qofbackend-p.h"
+#include "qofquerycore-p.h"
 
 #define GNC_ID_ROOT_ACCOUNT        "RootAccount"
 
@@ -143,11 +147,15 @@ typedef struct AccountPrivate
     gnc_numeric reconciled_balance;
 
     gboolean balance_dirty;     /* balances in splits incorrect */
+    Split *balance_dirty_from;  /* only balances from here on are stale */
 
-    GList *splits;              /* list of split pointers */
+    GncSplitIndex *split_index; /* ordered list of split pointers */
     gboolean sort_dirty;        /* sort order of splits is bad */
 
     LotList   *lots;		/* list of lot pointers */
+    GHashTable *lot_ages;       /* lot -> position in lots, newest highest */
+    GHashTable *open_lots;      /* lot -> age, for lots that may be open */
+    guint      lot_age;         /* age of the newest lot */
     GNCPolicy *policy;		/* Cached pointer to policy method */
 
     /* The "mark" flag can be used by the user to mark this account
@@ -309,6 +317,9 @@ gnc_account_init(Account* acc)
 
     priv->policy = xaccGetFIFOPolicy();
     priv->lots = NULL;
+    priv->lot_ages = g_hash_table_new (g_direct_hash, g_direct_equal);
+    priv->open_lots = g_hash_table_new (g_direct_hash, g_direct_equal);
+    priv->lot_age = 0;
 
     priv->commodity = NULL;
     priv->commodity_scu = 0;
@@ -321,8 +332,9 @@ gnc_account_init(Account* acc)
     priv->starting_cleared_balance = gnc_numeric_zero();
     priv->starting_reconciled_balance = gnc_numeric_zero();
     priv->balance_dirty = FALSE;
+    priv->balance_dirty_from = NULL;
 
-    priv->splits = NULL;
+    priv->split_index = gnc_split_index_new ((GCompareFunc)xaccSplitOrder);
     priv->sort_dirty = FALSE;
 }
 
@@ -335,6 +347,13 @@ gnc_account_dispose (GObject *acctp)
 static void
 gnc_account_finalize(GObject* acctp)
 {
+    AccountPrivate *priv = GET_PRIVATE(acctp);
+
+    gnc_split_index_destroy(priv->split_index);
+    priv->split_index = NULL;
+    g_hash_table_destroy(priv->lot_ages);
+    g_hash_table_destroy(priv->open_lots);
+
     G_OBJECT_CLASS(gnc_account_parent_class)->finalize(acctp);
 }
 
@@ -1114,13 +1133,15 @@ xaccFreeAccount (Account *acc)
         }
         g_list_free (priv->lots);
         priv->lots = NULL;
+        g_hash_table_remove_all (priv->lot_ages);
+        g_hash_table_remove_all (priv->open_lots);
     }
 
     /* Next, clean up the splits */
     /* NB there shouldn't be any splits by now ... they should
      * have been all been freed by CommitEdit().  We can remove this
      * check once we know the warning isn't occurring any more. */
-    if (priv->splits)
+    if (gnc_split_index_get_list(priv->split_index))
     {
         GList *slist;
         PERR (" instead of calling xaccFreeAccount(), please call \n"
@@ -1128,7 +1149,7 @@ xaccFreeAccount (Account *acc)
 
         qof_instance_reset_editlevel(acc);
 
-        slist = g_list_copy(priv->splits);
+        slist = g_list_copy(gnc_split_index_get_list(priv->split_index));
         for (lp = slist; lp; lp = lp->next)
         {
             Split *s = (Split *) lp->data;
@@ -1136,7 +1157,7 @@ xaccFreeAccount (Account *acc)
             xaccSplitDestroy (s);
         }
         g_list_free(slist);
-        g_assert(priv->splits == NULL);
+        g_assert(gnc_split_index_get_list(priv->split_index) == NULL);
     }
 
     CACHE_REPLACE(priv->accountName, NULL);
@@ -1158,6 +1179,7 @@ xaccFreeAccount (Account *acc)
     priv->commodity = NULL;
 
     priv->balance_dirty = FALSE;
+    priv->balance_dirty_from = NULL;
     priv->sort_dirty = FALSE;
 
     /* qof_instance_release (&acc->inst); */
@@ -1240,7 +1262,7 @@ xaccAccountCommitEdit (Account *acc)
            themselves will be destroyed by the transaction code */
         if (!qof_book_shutting_down(book))
         {
-            slist = g_list_copy(priv->splits);
+            slist = g_list_copy(gnc_split_index_get_list(priv->split_index));
             for (lp = slist; lp; lp = lp->next)
             {
                 Split *s = lp->data;
@@ -1250,8 +1272,8 @@ xaccAccountCommitEdit (Account *acc)
         }
         else
         {
-            g_list_free(priv->splits);
-            priv->splits = NULL;
+            gnc_split_index_clear(priv->split_index);
+            priv->balance_dirty_from = NULL;
         }
 
         /* It turns out there's a case where this assertion does not hold:
@@ -1259,7 +1281,7 @@ xaccAccountCommitEdit (Account *acc)
            deleting all the splits in it.  The splits will just get
            recreated and put right back into the same account!
 
-           g_assert(priv->splits == NULL || qof_book_shutting_down(acc->inst.book));
+           g_assert(gnc_split_index_get_list(priv->split_index) == NULL || qof_book_shutting_down(acc->inst.book));
         */
 
         if (!qof_book_shutting_down(book))
@@ -1276,6 +1298,8 @@ xaccAccountCommitEdit (Account *acc)
         }
         g_list_free(priv->lots);
         priv->lots = NULL;
+        g_hash_table_remove_all(priv->lot_ages);
+        g_hash_table_remove_all(priv->open_lots);
 
         qof_instance_set_dirty(&acc->inst);
         qof_instance_decrease_editlevel(acc);
@@ -1511,8 +1535,8 @@ xaccAccountEqual(const Account *aa, const Account *ab, gboolean check_guids)
     /* no parent; always compare downwards. */
 
     {
-        GList *la = priv_aa->splits;
-        GList *lb = priv_ab->splits;
+        GList *la = gnc_split_index_get_list(priv_aa->split_index);
+        GList *lb = gnc_split_index_get_list(priv_ab->split_index);
 
         if ((la && !lb) || (!la && lb))
         {
@@ -1600,6 +1624,55 @@ gnc_account_set_balance_dirty (Account *acc)
     priv->balance_dirty = TRUE;
 }
 
+void
+gnc_account_set_balance_dirty_from (Account *acc, Split *split)
+{
+    AccountPrivate *priv;
+
+    g_return_if_fail(GNC_IS_ACCOUNT(acc));
+
+    priv = GET_PRIVATE(acc);
+    if (priv->balance_dirty || priv->balance_dirty_from == split)
+        return;
+
+    /* A split that isn't in the list yet doesn't count towards any
+     * balance; inserting it will mark it. */
+    if (split && !gnc_split_index_lookup(priv->split_index, split))
+        return;
+
+    /* Keep track of a single starting point only.  Working out which
+     * of two splits comes first isn't reliable while the list may be
+     * out of order, and the common cases -- editing or appending one
+     * split -- only ever touch one. */
+    if (!split || priv->balance_dirty_from)
+    {
+        priv->balance_dirty = TRUE;
+        priv->balance_dirty_from = NULL;
+        return;
+    }
+    priv->balance_dirty_from = split;
+}
+
+void
+gnc_account_check_split_order (Account *acc, Split *split)
+{
+    AccountPrivate *priv;
+    GList *node;
+
+    g_return_if_fail(GNC_IS_ACCOUNT(acc));
+
+    priv = GET_PRIVATE(acc);
+    if (priv->sort_dirty || qof_instance_get_destroying(acc))
+        return;
+
+    node = gnc_split_index_lookup(priv->split_index, split);
+    if (!node)
+        return;
+    if ((node->prev && xaccSplitOrder(node->prev->data, split) > 0) ||
+            (node->next && xaccSplitOrder(split, node->next->data) > 0))
+        priv->sort_dirty = TRUE;
+}
+
 /********************************************************************\
 \********************************************************************/
 
@@ -1613,7 +1686,7 @@ gnc_account_find_split (Account *acc, Split *s)
     g_return_val_if_fail(GNC_IS_SPLIT(s), FALSE);
 
     priv = GET_PRIVATE(acc);
-    node = g_list_find(priv->splits, s);
+    node = gnc_split_index_lookup(priv->split_index, s);
     return node ? TRUE : FALSE;
 }
 
@@ -1627,27 +1700,25 @@ gnc_account_insert_split (Account *acc, Split *s)
     g_return_val_if_fail(GNC_IS_SPLIT(s), FALSE);
 
     priv = GET_PRIVATE(acc);
-    node = g_list_find(priv->splits, s);
-    if (node)
-        return FALSE;
-
     if (qof_instance_get_editlevel(acc) == 0)
     {
-        priv->splits = g_list_insert_sorted(priv->splits, s,
-                                            (GCompareFunc)xaccSplitOrder);
+        node = gnc_split_index_insert(priv->split_index, s);
     }
     else
     {
-        priv->splits = g_list_prepend(priv->splits, s);
-        priv->sort_dirty = TRUE;
+        node = gnc_split_index_prepend(priv->split_index, s);
+        if (node)
+            priv->sort_dirty = TRUE;
     }
+    if (!node)
+        return FALSE;
 
     //FIXME: find better event
     qof_event_gen (&acc->inst, QOF_EVENT_MODIFY, NULL);
     /* Also send an event based on the account */
     qof_event_gen(&acc->inst, GNC_EVENT_ITEM_ADDED, s);
 
-    priv->balance_dirty = TRUE;
+    gnc_account_set_balance_dirty_from(acc, s);
 //  DRH: Should the below be added? It is present in the delete path.
 //  xaccAccountRecomputeBalance(acc);
     return TRUE;
@@ -1658,22 +1729,31 @@ gnc_account_remove_split (Account *acc, Split *s)
 {
     AccountPrivate *priv;
     GList *node;
+    Split *neighbour;
 
     g_return_val_if_fail(GNC_IS_ACCOUNT(acc), FALSE);
     g_return_val_if_fail(GNC_IS_SPLIT(s), FALSE);
 
     priv = GET_PRIVATE(acc);
-    node = g_list_find(priv->splits, s);
+    node = gnc_split_index_lookup(priv->split_index, s);
     if (NULL == node)
         return FALSE;
 
-    priv->splits = g_list_delete_link(priv->splits, node);
+    /* Only the splits after this one need their running balances
+     * adjusting; if it was the last one, its predecessor now carries
+     * the account totals. */
+    neighbour = node->next ? node->next->data :
+                node->prev ? node->prev->data : NULL;
+    if (priv->balance_dirty_from == s)
+        priv->balance_dirty_from = NULL;
+    gnc_split_index_remove(priv->split_index, s);
+
     //FIXME: find better event type
     qof_event_gen(&acc->inst, QOF_EVENT_MODIFY, NULL);
     // And send the account-based event, too
     qof_event_gen(&acc->inst, GNC_EVENT_ITEM_REMOVED, s);
 
-    priv->balance_dirty = TRUE;
+    gnc_account_set_balance_dirty_from(acc, neighbour);
     xaccAccountRecomputeBalance(acc);
     return TRUE;
 }
@@ -1688,9 +1768,9 @@ xaccAccountSortSplits (Account *acc, gboolean force)
     priv = GET_PRIVATE(acc);
     if (!priv->sort_dirty || (!force && qof_instance_get_editlevel(acc) > 0))
         return;
-    priv->splits = g_list_sort(priv->splits, (GCompareFunc)xaccSplitOrder);
+    if (gnc_split_index_sort(priv->split_index))
+        priv->balance_dirty = TRUE;
     priv->sort_dirty = FALSE;
-    priv->balance_dirty = TRUE;
 }
 
 static void
@@ -1820,6 +1900,7 @@ xaccAccountRemoveLot (Account *acc, GNCLot *lot)
 
     ENTER ("(acc=%p, lot=%p)", acc, lot);
     priv->lots = g_list_remove(priv->lots, lot);
+    gnc_account_forget_lot (acc, lot);
     qof_event_gen (QOF_INSTANCE(lot), QOF_EVENT_REMOVE, NULL);
     qof_event_gen (&acc->inst, QOF_EVENT_MODIFY, NULL);
     LEAVE ("(acc=%p, lot=%p)", acc, lot);
@@ -1849,10 +1930,14 @@ xaccAccountInsertLot (Account *acc, GNCLot *lot)
         old_acc = lot_account;
         opriv = GET_PRIVATE(old_acc);
         opriv->lots = g_list_remove(opriv->lots, lot);
+        gnc_account_forget_lot (old_acc, lot);
     }
 
     priv = GET_PRIVATE(acc);
     priv->lots = g_list_prepend(priv->lots, lot);
+    priv->lot_age++;
+    g_hash_table_insert (priv->lot_ages, lot, GUINT_TO_POINTER(priv->lot_age));
+    g_hash_table_insert (priv->open_lots, lot, GUINT_TO_POINTER(priv->lot_age));
     gnc_lot_set_account(lot, acc);
 
     /* Don't move the splits to the new account.  The caller will do this
@@ -1897,7 +1982,7 @@ xaccAccountMoveAllSplits (Account *accfrom, Account *accto)
     /* optimizations */
     from_priv = GET_PRIVATE(accfrom);
     to_priv = GET_PRIVATE(accto);
-    if (!from_priv->splits || accfrom == accto)
+    if (!gnc_split_index_get_list(from_priv->split_index) || accfrom == accto)
         return;
 
     /* check for book mix-up */
@@ -1907,7 +1992,8 @@ xaccAccountMoveAllSplits (Account *accfrom, Account *accto)
     xaccAccountBeginEdit(accfrom);
     xaccAccountBeginEdit(accto);
     /* Begin editing both accounts and all transactions in accfrom. */
-    g_list_foreach(from_priv->splits, (GFunc)xaccPreSplitMove, NULL);
+    g_list_foreach(gnc_split_index_get_list(from_priv->split_index),
+                   (GFunc)xaccPreSplitMove, NULL);
 
     /* Concatenate accfrom's lists of splits and lots to accto's lists. */
     //to_priv->splits = g_list_concat(to_priv->splits, from_priv->splits);
@@ -1924,10 +2010,11 @@ xaccAccountMoveAllSplits (Account *accfrom, Account *accto)
      * Convert each split's amount to accto's commodity.
      * Commit to editing each transaction.
      */
-    g_list_foreach(from_priv->splits, (GFunc)xaccPostSplitMove, (gpointer)accto);
+    g_list_foreach(gnc_split_index_get_list(from_priv->split_index),
+                   (GFunc)xaccPostSplitMove, (gpointer)accto);
 
     /* Finally empty accfrom. */
-    g_assert(from_priv->splits == NULL);
+    g_assert(gnc_split_index_get_list(from_priv->split_index) == NULL);
     g_assert(from_priv->lots == NULL);
     xaccAccountCommitEdit(accfrom);
     xaccAccountCommitEdit(accto);
@@ -1964,31 +2051,34 @@ xaccAccountMoveAllSplits (Account *accfrom, Account *accto)
  * Return: void                                                     *
 \********************************************************************/
 
-void
-xaccAccountRecomputeBalance (Account * acc)
+/* Recompute the running balances of the splits from 'lp' to the end
+ * of the list, starting from the balances of the split before 'lp'.
+ * Passing the head of the list recomputes everything. */
+static void
+account_recompute_from (AccountPrivate *priv, GList *lp)
 {
-    AccountPrivate *priv;
     gnc_numeric  balance;
     gnc_numeric  cleared_balance;
     gnc_numeric  reconciled_balance;
-    Split *last_split = NULL;
-    GList *lp;
-
-    if (NULL == acc) return;
 
-    priv = GET_PRIVATE(acc);
-    if (qof_instance_get_editlevel(acc) > 0) return;
-    if (!priv->balance_dirty) return;
-    if (qof_instance_get_destroying(acc)) return;
-    if (qof_book_shutting_down(qof_instance_get_book(acc))) return;
+    if (lp && lp->prev)
+    {
+        Split *prev = (Split *) lp->prev->data;
 
-    balance            = priv->starting_balance;
-    cleared_balance    = priv->starting_cleared_balance;
-    reconciled_balance = priv->starting_reconciled_balance;
+        balance            = prev->balance;
+        cleared_balance    = prev->cleared_balance;
+        reconciled_balance = prev->reconciled_balance;
+    }
+    else
+    {
+        balance            = priv->starting_balance;
+        cleared_balance    = priv->starting_cleared_balance;
+        reconciled_balance = priv->starting_reconciled_balance;
+    }
 
     PINFO ("acct=%s starting baln=%" G_GINT64_FORMAT "/%" G_GINT64_FORMAT,
            priv->accountName, balance.num, balance.denom);
-    for (lp = priv->splits; lp; lp = lp->next)
+    for (; lp; lp = lp->next)
     {
         Split *split = (Split *) lp->data;
         gnc_numeric amt = xaccSplitGetAmount (split);
@@ -2010,14 +2100,90 @@ xaccAccountRecomputeBalance (Account * acc)
         split->balance = balance;
         split->cleared_balance = cleared_balance;
         split->reconciled_balance = reconciled_balance;
-
-        last_split = split;
     }
 
     priv->balance = balance;
     priv->cleared_balance = cleared_balance;
     priv->reconciled_balance = reconciled_balance;
+}
+
+/* Setting GNC_VERIFY_BALANCES in the environment makes every partial
+ * recompute check itself against a full one.  This is slow, and is
+ * meant for chasing down bookkeeping bugs in the dirty tracking. */
+static gboolean
+verify_balances (void)
+{
+    static gint verify = -1;
+
+    if (verify < 0)
+        verify = (g_getenv("GNC_VERIFY_BALANCES") != NULL);
+    return verify;
+}
+
+static gboolean
+account_balances_match_full (AccountPrivate *priv)
+{
+    gnc_numeric  balance            = priv->starting_balance;
+    gnc_numeric  cleared_balance    = priv->starting_cleared_balance;
+    gnc_numeric  reconciled_balance = priv->starting_reconciled_balance;
+    GList *lp;
+
+    for (lp = gnc_split_index_get_list(priv->split_index); lp; lp = lp->next)
+    {
+        Split *split = (Split *) lp->data;
+        gnc_numeric amt = xaccSplitGetAmount (split);
+
+        balance = gnc_numeric_add_fixed(balance, amt);
+        if (NREC != split->reconciled)
+            cleared_balance = gnc_numeric_add_fixed(cleared_balance, amt);
+        if (YREC == split->reconciled || FREC == split->reconciled)
+            reconciled_balance = gnc_numeric_add_fixed(reconciled_balance, amt);
+
+        if (!gnc_numeric_equal(balance, split->balance) ||
+                !gnc_numeric_equal(cleared_balance, split->cleared_balance) ||
+                !gnc_numeric_equal(reconciled_balance, split->reconciled_balance))
+            return FALSE;
+    }
+
+    return gnc_numeric_equal(balance, priv->balance) &&
+           gnc_numeric_equal(cleared_balance, priv->cleared_balance) &&
+           gnc_numeric_equal(reconciled_balance, priv->reconciled_balance);
+}
+
+void
+xaccAccountRecomputeBalance (Account * acc)
+{
+    AccountPrivate *priv;
+    GList *lp = NULL;
+
+    if (NULL == acc) return;
+
+    priv = GET_PRIVATE(acc);
+    if (qof_instance_get_editlevel(acc) > 0) return;
+    if (!priv->balance_dirty && !priv->balance_dirty_from) return;
+    if (qof_instance_get_destroying(acc)) return;
+    if (qof_book_shutting_down(qof_instance_get_book(acc))) return;
+
+    if (!priv->balance_dirty)
+        lp = gnc_split_index_lookup(priv->split_index, priv->balance_dirty_from);
+
+    if (lp)
+    {
+        account_recompute_from(priv, lp);
+        if (verify_balances() && !account_balances_match_full(priv))
+        {
+            PERR ("partial balance recompute of account %s disagrees "
+                  "with a full one", priv->accountName);
+            account_recompute_from(priv, gnc_split_index_get_list(priv->split_index));
+        }
+    }
+    else
+    {
+        account_recompute_from(priv, gnc_split_index_get_list(priv->split_index));
+    }
+
     priv->balance_dirty = FALSE;
+    priv->balance_dirty_from = NULL;
 }
 
 /********************************************************************\
@@ -2278,7 +2444,7 @@ xaccAccountSetCommodity (Account * acc, gnc_commodity * com)
     priv->non_standard_scu = FALSE;
 
     /* iterate over splits */
-    for (lp = priv->splits; lp; lp = lp->next)
+    for (lp = gnc_split_index_get_list(priv->split_index); lp; lp = lp->next)
     {
         Split *s = (Split *) lp->data;
         Transaction *trans = xaccSplitGetParent (s);
@@ -3130,7 +3296,7 @@ xaccAccountGetProjectedMinimumBalance (const Account *acc)
 
     priv = GET_PRIVATE(acc);
     today = gnc_timet_get_today_end();
-    for (node = g_list_last(priv->splits); node; node = node->prev)
+    for (node = gnc_split_index_get_last(priv->split_index); node; node = node->prev)
     {
         Split *split = node->data;
 
@@ -3155,85 +3321,358 @@ xaccAccountGetProjectedMinimumBalance (const Account *acc)
 /********************************************************************\
 \********************************************************************/
 
+/* Search keys for gnc_split_index_search().  The split list is
+ * sorted by posting date first, so "posted before some date" is
+ * monotonic along the list and the index can find the last such
+ * split without walking the list. */
+static gint
+split_posted_before (gconstpointer a, gconstpointer b)
+{
+    const Timespec *ts = b;
+    Timespec trans_ts;
+
+    xaccTransGetDatePostedTS (xaccSplitGetParent ((Split *) a), &trans_ts);
+    return (timespec_cmp (&trans_ts, ts) < 0) ? -1 : 1;
+}
+
+static gint
+split_posted_by (gconstpointer a, gconstpointer b)
+{
+    const time_t *when = b;
+
+    return (xaccTransGetDate (xaccSplitGetParent ((Split *) a)) <= *when) ?
+           -1 : 1;
+}
+
+/* The balance as of 'date' is the running balance of the last split
+ * posted before it.  Callers must have sorted the splits and brought
+ * the running balances up to date. */
+static gnc_numeric
+account_balance_as_of (AccountPrivate *priv, time_t date)
+{
+    Timespec ts;
+    GList *lp;
+
+    ts.tv_sec = date;
+    ts.tv_nsec = 0;
+
+    lp = gnc_split_index_search (priv->split_index, split_posted_before, &ts);
+    if (lp)
+        return xaccSplitGetBalance ((Split *)lp->data);
+
+    /* AsOf date must be before any entries, return zero. */
+    if (gnc_split_index_get_list (priv->split_index))
+        return gnc_numeric_zero ();
+
+    /* No splits at all, so the account balance is good enough. */
+    return priv->balance;
+}
+
 gnc_numeric
 xaccAccountGetBalanceAsOfDate (Account *acc, time_t date)
 {
-    /* Ideally this could use xaccAccountForEachSplit, but
-     * it doesn't exist yet and I'm uncertain of exactly how
-     * it would work at this time, since it differs from
-     * xaccAccountForEachTransaction by using gpointer return
-     * values rather than gints.
-     */
-    AccountPrivate *priv;
-    GList   *lp;
-    Timespec ts, trans_ts;
-    gboolean found = FALSE;
-    gnc_numeric balance;
-
     g_return_val_if_fail(GNC_IS_ACCOUNT(acc), gnc_numeric_zero());
 
     xaccAccountSortSplits (acc, TRUE); /* just in case, normally a noop */
     xaccAccountRecomputeBalance (acc); /* just in case, normally a noop */
 
+    return account_balance_as_of (GET_PRIVATE(acc), date);
+}
+
+void
+xaccAccountGetBalancesAsOfDates (Account *acc, const time_t *dates,
+                                 guint n_dates, gnc_numeric *balances)
+{
+    AccountPrivate *priv;
+    guint i;
+
+    g_return_if_fail(GNC_IS_ACCOUNT(acc));
+    g_return_if_fail(n_dates == 0 || (dates && balances));
+
+    xaccAccountSortSplits (acc, TRUE);
+    xaccAccountRecomputeBalance (acc);
+
     priv = GET_PRIVATE(acc);
-    balance = priv->balance;
-
-    /* Since transaction post times are stored as a Timespec,
-     * convert date into a Timespec as well rather than converting
-     * each transaction's Timespec into a time_t.
-     *
-     * FIXME: CAS: I think this comment is a bogus justification for
-     * using xaccTransGetDatePostedTS.  There's no benefit to using
-     * Timespec when the input argument is time_t, and it's hard to
-     * imagine that casting long long to long and comparing two longs is
-     * worse than comparing two long longs every time.  IMO,
-     * xaccAccountGetPresentBalance gets this right, and its algorithm
-     * should be used here.
-     */
-    ts.tv_sec = date;
-    ts.tv_nsec = 0;
+    for (i = 0; i < n_dates; i++)
+        balances[i] = account_balance_as_of (priv, dates[i]);
+}
+
+/* The rows an account adds to a balance matrix, before they are
+ * merged into the rows of the accounts asked for. */
+typedef struct
+{
+    gnc_commodity *commodity;
+    Timespec first_posted;
+    gnc_numeric *balances;      /* one per date */
+} BalanceRow;
+
+static gint
+compare_date_index (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+    const Timespec *dates = user_data;
+
+    return timespec_cmp (&dates[*(const guint *)a], &dates[*(const guint *)b]);
+}
+
+static BalanceRow *
+balance_row_for (GArray *rows, gnc_commodity *commodity,
+                 const Timespec *first_posted, guint n_dates)
+{
+    BalanceRow row;
+    guint i;
 
-    lp = priv->splits;
-    while ( lp && !found )
+    for (i = 0; i < rows->len; i++)
     {
-        xaccTransGetDatePostedTS( xaccSplitGetParent( (Split *)lp->data ),
-                                  &trans_ts );
-        if ( timespec_cmp( &trans_ts, &ts ) >= 0 )
-            found = TRUE;
-        else
-            lp = lp->next;
+        BalanceRow *r = &g_array_index (rows, BalanceRow, i);
+        if (gnc_commodity_equal (r->commodity, commodity))
+            return r;
     }
 
-    if ( lp )
+    row.commodity = commodity;
+    row.first_posted = *first_posted;
+    row.balances = g_new (gnc_numeric, n_dates);
+    for (i = 0; i < n_dates; i++)
+        row.balances[i] = gnc_numeric_zero ();
+    g_array_append_val (rows, row);
+    return &g_array_index (rows, BalanceRow, rows->len - 1);
+}
+
+/* Work out the balances of 'acc' at 'dates' in one walk over its
+ * splits, visiting the dates in the order given by 'order'.  Returns
+ * an array of BalanceRow, one per commodity. */
+static GArray *
+account_balance_rows (Account *acc, const Timespec *dates,
+                      const guint *order, guint n_dates, gboolean use_value)
+{
+    GArray *rows = g_array_new (FALSE, FALSE, sizeof (BalanceRow));
+    GArray *sums = g_array_new (FALSE, FALSE, sizeof (GncNumericAccum));
+    Split *last = NULL;
+    GList *node;
+    guint d, i;
+
+    xaccAccountSortSplits (acc, TRUE); /* just in case, normally a noop */
+    xaccAccountRecomputeBalance (acc); /* just in case, normally a noop */
+
+    node = gnc_split_index_get_list (GET_PRIVATE(acc)->split_index);
+    for (d = 0; d < n_dates; d++)
     {
-        if ( lp->prev )
+        const Timespec *date = &dates[order[d]];
+
+        for (; node; node = node->next)
         {
-            /* Since lp is now pointing to a split which was past the reconcile
-             * date, get the running balance of the previous split.
-             */
-            balance = xaccSplitGetBalance( (Split *)lp->prev->data );
+            Split *split = node->data;
+            Transaction *trans = xaccSplitGetParent (split);
+            Timespec posted;
+
+            xaccTransGetDatePostedTS (trans, &posted);
+            if (timespec_cmp (&posted, date) > 0)
+                break;
+
+            if (use_value)
+            {
+                BalanceRow *row = balance_row_for (rows,
+                                                   xaccTransGetCurrency (trans),
+                                                   &posted, n_dates);
+                GncNumericAccum *sum;
+
+                i = row - (BalanceRow *) rows->data;
+                if (i == sums->len)
+                {
+                    g_array_set_size (sums, i + 1);
+                    gnc_numeric_accum_init (&g_array_index (sums,
+                                                            GncNumericAccum, i));
+                }
+                sum = &g_array_index (sums, GncNumericAccum, i);
+                gnc_numeric_accum_add (sum, xaccSplitGetValue (split));
+            }
+            else if (!last)
+            {
+                balance_row_for (rows, xaccAccountGetCommodity (acc),
+                                 &posted, n_dates);
+            }
+            last = split;
         }
-        else
+
+        /* The amount balance is the running balance of the last split
+         * by the date; values are summed per currency. */
+        for (i = 0; i < rows->len; i++)
         {
-            /* AsOf date must be before any entries, return zero. */
-            balance = gnc_numeric_zero();
+            BalanceRow *row = &g_array_index (rows, BalanceRow, i);
+            row->balances[order[d]] = use_value ?
+                                      gnc_numeric_accum_total
+                                      (&g_array_index (sums, GncNumericAccum, i),
+                                       GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD) :
+                                      xaccSplitGetBalance (last);
         }
     }
 
-    /* Otherwise there were no splits posted after the given date,
-     * so the latest account balance should be good enough.
-     */
+    g_array_free (sums, TRUE);
+    return rows;
+}
+
+static void
+balance_rows_free (gpointer data)
+{
+    GArray *rows = data;
+    guint i;
 
-    return( balance );
+    for (i = 0; i < rows->len; i++)
+        g_free (g_array_index (rows, BalanceRow, i).balances);
+    g_array_free (rows, TRUE);
+}
+
+void
+gnc_account_list_load_splits (AccountList *accounts, gboolean include_children)
+{
+    GList *all = NULL, *node;
+    QofBook *book = NULL;
+    QofBackend *be;
+    QofQuery *q;
+
+    for (node = accounts; node; node = node->next)
+    {
+        Account *acc = node->data;
+
+        if (!GNC_IS_ACCOUNT (acc)) continue;
+        book = gnc_account_get_book (acc);
+        if (include_children)
+            all = g_list_concat (gnc_account_get_descendants (acc), all);
+        all = g_list_prepend (all, acc);
+    }
+
+    /* Only a backend that runs queries can be holding splits back */
+    be = book ? qof_book_get_backend (book) : NULL;
+    if (be && be->run_query)
+    {
+        q = qof_query_create_for (GNC_ID_SPLIT);
+        qof_query_set_book (q, book);
+        qof_query_set_max_results (q, 0);
+        xaccQueryAddAccountMatch (q, all, QOF_GUID_MATCH_ANY, QOF_QUERY_AND);
+        qof_query_run (q);
+        qof_query_destroy (q);
+    }
+    g_list_free (all);
+}
+
+GncBalanceMatrix *
+xaccAccountsGetBalanceMatrix (GList *accounts, const Timespec *dates,
+                              guint n_dates, gboolean use_value,
+                              gboolean include_children)
+{
+    GncBalanceMatrix *matrix;
+    GHashTable *account_rows;
+    GArray *row_accounts, *row_index, *row_commodities, *row_first;
+    GArray *balances, *merged;
+    guint *order;
+    GList *node;
+    guint i, j, k, n;
+
+    g_return_val_if_fail (n_dates == 0 || dates, NULL);
+
+    gnc_account_list_load_splits (accounts, include_children);
+
+    order = g_new (guint, n_dates);
+    for (i = 0; i < n_dates; i++)
+        order[i] = i;
+    g_qsort_with_data (order, n_dates, sizeof (guint), compare_date_index,
+                       (gpointer) dates);
+
+    /* Each account is walked once, however many of the accounts asked
+     * for it is a descendant of. */
+    account_rows = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                          NULL, balance_rows_free);
+    row_accounts = g_array_new (FALSE, FALSE, sizeof (Account *));
+    row_index = g_array_new (FALSE, FALSE, sizeof (guint));
+    row_commodities = g_array_new (FALSE, FALSE, sizeof (gnc_commodity *));
+    row_first = g_array_new (FALSE, FALSE, sizeof (Timespec));
+    balances = g_array_new (FALSE, FALSE, sizeof (gnc_numeric));
+    merged = g_array_new (FALSE, FALSE, sizeof (BalanceRow));
+
+    for (node = accounts, n = 0; node; node = node->next, n++)
+    {
+        Account *acc = node->data;
+        GList *sources, *snode;
+
+        if (!GNC_IS_ACCOUNT (acc)) continue;
+
+        sources = include_children ? gnc_account_get_descendants (acc) : NULL;
+        sources = g_list_prepend (sources, acc);
+
+        for (snode = sources; snode; snode = snode->next)
+        {
+            GArray *rows = g_hash_table_lookup (account_rows, snode->data);
+
+            if (!rows)
+            {
+                rows = account_balance_rows (snode->data, dates, order,
+                                             n_dates, use_value);
+                g_hash_table_insert (account_rows, snode->data, rows);
+            }
+
+            for (j = 0; j < rows->len; j++)
+            {
+                BalanceRow *row = &g_array_index (rows, BalanceRow, j);
+                BalanceRow *into = balance_row_for (merged, row->commodity,
+                                                    &row->first_posted, n_dates);
+
+                if (timespec_cmp (&row->first_posted, &into->first_posted) < 0)
+                    into->first_posted = row->first_posted;
+                for (k = 0; k < n_dates; k++)
+                    into->balances[k] = gnc_numeric_add (into->balances[k],
+                                                         row->balances[k],
+                                                         GNC_DENOM_AUTO,
+                                                         GNC_HOW_DENOM_LCD);
+            }
+        }
+        g_list_free (sources);
+
+        for (j = 0; j < merged->len; j++)
+        {
+            BalanceRow *row = &g_array_index (merged, BalanceRow, j);
+
+            g_array_append_val (row_accounts, acc);
+            g_array_append_val (row_index, n);
+            g_array_append_val (row_commodities, row->commodity);
+            g_array_append_val (row_first, row->first_posted);
+            g_array_append_vals (balances, row->balances, n_dates);
+            g_free (row->balances);
+        }
+        g_array_set_size (merged, 0);
+    }
+
+    matrix = g_new (GncBalanceMatrix, 1);
+    matrix->n_rows = row_accounts->len;
+    matrix->n_dates = n_dates;
+    matrix->accounts = (Account **) g_array_free (row_accounts, FALSE);
+    matrix->account_index = (guint *) g_array_free (row_index, FALSE);
+    matrix->commodities = (gnc_commodity **) g_array_free (row_commodities, FALSE);
+    matrix->first_posted = (Timespec *) g_array_free (row_first, FALSE);
+    matrix->balances = (gnc_numeric *) g_array_free (balances, FALSE);
+
+    g_array_free (merged, TRUE);
+    g_hash_table_destroy (account_rows);
+    g_free (order);
+    return matrix;
+}
+
+void
+gnc_balance_matrix_free (GncBalanceMatrix *matrix)
+{
+    if (!matrix) return;
+
+    g_free (matrix->accounts);
+    g_free (matrix->account_index);
+    g_free (matrix->commodities);
+    g_free (matrix->first_posted);
+    g_free (matrix->balances);
+    g_free (matrix);
 }
 
 /*
  * Originally gsr_account_present_balance in gnc-split-reg.c
  *
- * How does this routine compare to xaccAccountGetBalanceAsOfDate just
- * above?  These two routines should eventually be collapsed into one.
- * Perhaps the startup logic from that one, and the logic from this
- * one that walks from the tail of the split list.
+ * This finds the last split posted up to the end of today, which
+ * may be followed by any number of future-dated splits.
  */
 gnc_numeric
 xaccAccountGetPresentBalance (const Account *acc)
@@ -3244,15 +3683,15 @@ xaccAccountGetPresentBalance (const Account *acc)
 
     g_return_val_if_fail(GNC_IS_ACCOUNT(acc), gnc_numeric_zero());
 
+    /* The search needs the splits in order and their balances right. */
+    xaccAccountSortSplits ((Account *)acc, TRUE); /* normally a noop */
+    xaccAccountRecomputeBalance ((Account *)acc); /* normally a noop */
+
     priv = GET_PRIVATE(acc);
     today = gnc_timet_get_today_end();
-    for (node = g_list_last(priv->splits); node; node = node->prev)
-    {
-        Split *split = node->data;
-
-        if (xaccTransGetDate (xaccSplitGetParent (split)) <= today)
-            return xaccSplitGetBalance (split);
-    }
+    node = gnc_split_index_search (priv->split_index, split_posted_by, &today);
+    if (node)
+        return xaccSplitGetBalance ((Split *)node->data);
 
     return gnc_numeric_zero ();
 }
@@ -3589,7 +4028,7 @@ xaccAccountGetSplitList (const Account *acc)
 {
     g_return_val_if_fail(GNC_IS_ACCOUNT(acc), NULL);
     xaccAccountSortSplits((Account*)acc, FALSE);  // normally a noop
-    return GET_PRIVATE(acc)->splits;
+    return gnc_split_index_get_list(GET_PRIVATE(acc)->split_index);
 }
 
 LotList *
@@ -3599,6 +4038,81 @@ xaccAccountGetLotList (const Account *acc)
     return g_list_copy(GET_PRIVATE(acc)->lots);
 }
 
+void
+gnc_account_recheck_lot (Account *acc, GNCLot *lot)
+{
+    AccountPrivate *priv;
+    gpointer age;
+
+    g_return_if_fail(GNC_IS_ACCOUNT(acc));
+
+    priv = GET_PRIVATE(acc);
+    if (g_hash_table_lookup_extended (priv->lot_ages, lot, NULL, &age))
+        g_hash_table_insert (priv->open_lots, lot, age);
+}
+
+void
+gnc_account_forget_lot (Account *acc, GNCLot *lot)
+{
+    AccountPrivate *priv;
+
+    g_return_if_fail(GNC_IS_ACCOUNT(acc));
+
+    priv = GET_PRIVATE(acc);
+    g_hash_table_remove (priv->lot_ages, lot);
+    g_hash_table_remove (priv->open_lots, lot);
+}
+
+typedef struct
+{
+    GNCLot *lot;
+    guint age;
+} LotAge;
+
+static gint
+lot_age_newest_first (gconstpointer a, gconstpointer b)
+{
+    guint age_a = ((const LotAge *)a)->age;
+    guint age_b = ((const LotAge *)b)->age;
+    return (age_a < age_b) ? 1 : (age_a > age_b) ? -1 : 0;
+}
+
+/* Return the open lots of the account, in the order of the lot list.
+ * The lots found to be closed are dropped from open_lots until one of
+ * their splits changes. */
+static LotList *
+gnc_account_get_open_lots (AccountPrivate *priv)
+{
+    GHashTableIter iter;
+    gpointer lot, age;
+    GArray *open;
+    LotList *retval = NULL;
+    guint i;
+
+    open = g_array_sized_new (FALSE, FALSE, sizeof (LotAge),
+                              g_hash_table_size (priv->open_lots));
+    g_hash_table_iter_init (&iter, priv->open_lots);
+    while (g_hash_table_iter_next (&iter, &lot, &age))
+    {
+        LotAge entry;
+
+        if (gnc_lot_is_closed (lot))
+        {
+            g_hash_table_iter_remove (&iter);
+            continue;
+        }
+        entry.lot = lot;
+        entry.age = GPOINTER_TO_UINT (age);
+        g_array_append_val (open, entry);
+    }
+    g_array_sort (open, lot_age_newest_first);
+
+    for (i = open->len; i > 0; i--)
+        retval = g_list_prepend (retval, g_array_index (open, LotAge, i - 1).lot);
+    g_array_free (open, TRUE);
+    return retval;
+}
+
 LotList *
 xaccAccountFindOpenLots (const Account *acc,
                          gboolean (*match_func)(GNCLot *lot,
@@ -3606,20 +4120,17 @@ xaccAccountFindOpenLots (const Account *acc,
                          gpointer user_data, GCompareFunc sort_func)
 {
     AccountPrivate *priv;
-    GList *lot_list;
+    GList *lot_list, *lots;
     GList *retval = NULL;
 
     g_return_val_if_fail(GNC_IS_ACCOUNT(acc), NULL);
 
     priv = GET_PRIVATE(acc);
-    for (lot_list = priv->lots; lot_list; lot_list = lot_list->next)
+    lots = gnc_account_get_open_lots (priv);
+    for (lot_list = lots; lot_list; lot_list = lot_list->next)
     {
         GNCLot *lot = lot_list->data;
 
-        /* If this lot is closed, then ignore it */
-        if (gnc_lot_is_closed (lot))
-            continue;
-
         if (match_func && !(match_func)(lot, user_data))
             continue;
 
@@ -3629,6 +4140,7 @@ xaccAccountFindOpenLots (const Account *acc,
         else
             retval = g_list_prepend (retval, lot);
     }
+    g_list_free (lots);
 
     return retval;
 }
@@ -3652,6 +4164,25 @@ xaccAccountForEachLot(const Account *acc,
     return result;
 }
 
+gpointer
+xaccAccountForEachOpenLot(const Account *acc,
+                          gpointer (*proc)(GNCLot *lot, void *data), void *data)
+{
+    LotList *lots, *node;
+    gpointer result = NULL;
+
+    g_return_val_if_fail(GNC_IS_ACCOUNT(acc), NULL);
+    g_return_val_if_fail(proc, NULL);
+
+    lots = gnc_account_get_open_lots (GET_PRIVATE(acc));
+    for (node = lots; node; node = node->next)
+        if ((result = proc((GNCLot *)node->data, data)))
+            break;
+    g_list_free (lots);
+
+    return result;
+}
+
 /********************************************************************\
 \********************************************************************/
 
@@ -4453,7 +4984,7 @@ finder_help_function(const Account *acc, const char *description,
      * list is in date order, and the most recent matches should be
      * returned!?  */
     priv = GET_PRIVATE(acc);
-    for (slp = g_list_last(priv->splits); slp; slp = slp->prev)
+    for (slp = gnc_split_index_get_last(priv->split_index); slp; slp = slp->prev)
     {
         Split *lsplit = slp->data;
         Transaction *ltrans = xaccSplitGetParent(lsplit);
@@ -4576,7 +5107,7 @@ void
 gnc_account_merge_children (Account *parent)
 {
     AccountPrivate *ppriv, *priv_a, *priv_b;
-    GList *node_a, *node_b, *work, *worker;
+    GList *node_a, *node_b, *work, *worker, *slist;
 
     g_return_if_fail(GNC_IS_ACCOUNT(parent));
 
@@ -4624,8 +5155,8 @@ gnc_account_merge_children (Account *parent)
             gnc_account_merge_children (acc_a);
 
             /* consolidate transactions */
-            while (priv_b->splits)
-                xaccSplitSetAccount (priv_b->splits->data, acc_a);
+            while ((slist = gnc_split_index_get_list(priv_b->split_index)))
+                xaccSplitSetAccount (slist->data, acc_a);
 
             /* move back one before removal. next iteration around the loop
              * will get the node after node_b */
@@ -4667,7 +5198,8 @@ xaccAccountBeginStagedTransactionTraversals (const Account *account)
     if (!account)
         return;
     priv = GET_PRIVATE(account);
-    xaccSplitsBeginStagedTransactionTraversals(priv->splits);
+    xaccSplitsBeginStagedTransactionTraversals(
+        gnc_split_index_get_list(priv->split_index));
 }
 
 gboolean
@@ -4701,7 +5233,8 @@ static void do_one_split (Split *s, gpointer data)
 static void do_one_account (Account *account, gpointer data)
 {
     AccountPrivate *priv = GET_PRIVATE(account);
-    g_list_foreach(priv->splits, (GFunc)do_one_split, NULL);
+    g_list_foreach(gnc_split_index_get_list(priv->split_index),
+                   (GFunc)do_one_split, NULL);
 }
 
 /* Replacement for xaccGroupBeginStagedTransactionTraversals */
@@ -4731,7 +5264,7 @@ xaccAccountStagedTransactionTraversal (const Account *acc,
     if (!acc) return 0;
 
     priv = GET_PRIVATE(acc);
-    for (split_p = priv->splits; split_p; split_p = next)
+    for (split_p = gnc_split_index_get_list(priv->split_index); split_p; split_p = next)
     {
         /* Get the next element in the split list now, just in case some
          * naughty thunk destroys the one we're using. This reduces, but
@@ -4779,7 +5312,7 @@ gnc_account_tree_staged_transaction_traversal (const Account *acc,
     }
 
     /* Now this account */
-    for (split_p = priv->splits; split_p; split_p = g_list_next(split_p))
+    for (split_p = gnc_split_index_get_list(priv->split_index); split_p; split_p = g_list_next(split_p))
     {
         s = split_p->data;
         trans = s->parent;
@@ -4833,6 +5366,69 @@ gnc_account_book_end(QofBook* book)
     xaccAccountDestroy(root_account);
 }
 
+/* Query index for splits by account.  A split only joins its account's
+ * list when its transaction is committed, so the splits of open
+ * transactions are offered as well. */
+static gint64
+split_account_index_estimate (QofBook *book, QofQueryPredData *pdata)
+{
+    const query_guid_def *pguid = (const query_guid_def *) pdata;
+    GList *node;
+    gint64 n = 0;
+
+    if (safe_strcmp (pdata->type_name, QOF_TYPE_GUID) ||
+            pguid->options != QOF_GUID_MATCH_ANY)
+        return -1;
+
+    for (node = pguid->guids; node; node = node->next)
+    {
+        Account *acc = xaccAccountLookup (node->data, book);
+        if (acc)
+            n += gnc_split_index_size (GET_PRIVATE (acc)->split_index);
+    }
+    return n + 2 * xaccTransForeachOpen (book, NULL, NULL);
+}
+
+typedef struct
+{
+    QofInstanceForeachCB cb;
+    gpointer user_data;
+} SplitAccountCB;
+
+static void
+open_trans_splits_cb (QofInstance *inst, gpointer data)
+{
+    SplitAccountCB *sacb = data;
+    Transaction *trans = GNC_TRANS (inst);
+    GList *node;
+
+    for (node = xaccTransGetSplitList (trans); node; node = node->next)
+        sacb->cb (QOF_INSTANCE (node->data), sacb->user_data);
+}
+
+static void
+split_account_index_foreach (QofBook *book, QofQueryPredData *pdata,
+                             QofInstanceForeachCB cb, gpointer user_data)
+{
+    const query_guid_def *pguid = (const query_guid_def *) pdata;
+    SplitAccountCB sacb;
+    GList *node, *snode;
+
+    for (node = pguid->guids; node; node = node->next)
+    {
+        Account *acc = xaccAccountLookup (node->data, book);
+        if (!acc)
+            continue;
+        for (snode = gnc_split_index_get_list (GET_PRIVATE (acc)->split_index);
+                snode; snode = snode->next)
+            cb (QOF_INSTANCE (snode->data), user_data);
+    }
+
+    sacb.cb = cb;
+    sacb.user_data = user_data;
+    xaccTransForeachOpen (book, open_trans_splits_cb, &sacb);
+}
+
 #ifdef _MSC_VER
 /* MSVC compiler doesn't have C99 "designated initializers"
  * so we wrap them in a macro that is empty on MSVC. */
@@ -4945,6 +5541,11 @@ gboolean xaccAccountRegister (void)
     };
 
     qof_class_register (GNC_ID_ACCOUNT, (QofSortFunc) qof_xaccAccountOrder, params);
+    qof_query_register_index (GNC_ID_SPLIT, "split-by-account",
+                              qof_query_build_param_list (SPLIT_ACCOUNT,
+                                      QOF_PARAM_GUID, NULL),
+                              split_account_index_estimate,
+                              split_account_index_foreach);
 
     return qof_object_register (&account_object_def);
 }
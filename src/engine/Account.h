@@ -563,6 +563,60 @@ gnc_numeric xaccAccountGetProjectedMinimumBalance (const Account *account);
 gnc_numeric xaccAccountGetBalanceAsOfDate (Account *account,
         time_t date);
 
+/** Get the balance of the account as of each of the @a n_dates dates
+    in @a dates, storing them in the corresponding slots of @a balances.
+    This is equivalent to calling xaccAccountGetBalanceAsOfDate() once
+    per date, but only sorts and recomputes the account once.  Each
+    date is found with a logarithmic search over the split list, so
+    this is the cheap way for reports to get per-period balances. */
+void xaccAccountGetBalancesAsOfDates (Account *account,
+                                      const time_t *dates, guint n_dates,
+                                      gnc_numeric *balances);
+
+/** Make sure all the splits of the accounts in @a accounts, and of
+    their descendants if @a include_children is TRUE, are in memory.  A
+    backend that loads older transactions on demand is asked for them
+    with a split query on the accounts, the way a register asks. */
+void gnc_account_list_load_splits (AccountList *accounts, gboolean include_children);
+
+/** The balances of a set of accounts at a set of dates, as built by
+    xaccAccountsGetBalanceMatrix().  There is a row for each account and
+    commodity the account has a balance in, and a column for each date.
+    The cell of row r and date d is balances[r * n_dates + d]. */
+typedef struct
+{
+    guint n_rows;
+    guint n_dates;
+    Account **accounts;          /**< The account of each row */
+    guint *account_index;        /**< Its position in the account list */
+    gnc_commodity **commodities; /**< The commodity of each row */
+    /** When the first split counted in each row was posted.  Cells for
+        earlier dates are zero because the row had no splits yet. */
+    Timespec *first_posted;
+    gnc_numeric *balances;
+} GncBalanceMatrix;
+
+/** Get the balances of each of @a accounts as of each of the @a n_dates
+    @a dates, counting the splits posted on or before the date.  The
+    splits of every account are walked once for all the dates.
+
+    If @a use_value is FALSE the balance is the amount of the account,
+    in its commodity.  If it is TRUE the split values are summed
+    instead, with a row for each transaction currency.  If @a
+    include_children is TRUE the balances of the descendants of each
+    account are added to its rows.
+
+    The rows come in the order of @a accounts.  An account without
+    splits by the last date has no rows.  The splits of the accounts
+    are loaded first; see gnc_account_list_load_splits().  Free the
+    result with gnc_balance_matrix_free(). */
+GncBalanceMatrix *xaccAccountsGetBalanceMatrix (GList *accounts,
+        const Timespec *dates, guint n_dates,
+        gboolean use_value, gboolean include_children);
+
+/** Free a matrix returned by xaccAccountsGetBalanceMatrix(). */
+void gnc_balance_matrix_free (GncBalanceMatrix *matrix);
+
 /* These two functions convert a given balance from one commodity to
    another.  The account argument is only used to get the Book, and
    may have nothing to do with the supplied balance.  Likewise, the
@@ -1104,6 +1158,16 @@ gpointer xaccAccountForEachLot(
     const Account *acc,
     gpointer (*proc)(GNCLot *lot, gpointer user_data), /*@ null @*/ gpointer user_data);
 
+/** The xaccAccountForEachOpenLot() method is like
+ *    xaccAccountForEachLot(), but only visits the lots that are open,
+ *    in the order xaccAccountForEachLot() would.  The account keeps
+ *    track of the lots that may be open, so this doesn't have to look
+ *    at all the closed lots of an account with a long history.
+ */
+gpointer xaccAccountForEachOpenLot(
+    const Account *acc,
+    gpointer (*proc)(GNCLot *lot, gpointer user_data), /*@ null @*/ gpointer user_data);
+
 
 /** Find a list of open lots that match the match_func.  Sort according
  * to sort_func.  If match_func is NULL, then all open lots are returned.
@@ -60,6 +60,33 @@ struct account_s
  * call this on an existing account! */
 void xaccAccountSetGUID (Account *account, const GncGUID *guid);
 
+/* Mark the running balances of 'split' and of every split after it
+ * in the account as needing to be recomputed.  This is cheaper than
+ * gnc_account_set_balance_dirty() when a single split changes, since
+ * xaccAccountRecomputeBalance() then only has to walk forward from
+ * that split; an appended split costs O(1).  Marking a second,
+ * different split before the next recompute falls back to a full
+ * recompute.  Splits not (yet) in the account are ignored; a NULL
+ * split dirties the whole account. */
+void gnc_account_set_balance_dirty_from (Account *acc, Split *split);
+
+/* The account keeps a set of the lots that may be open, which
+ * xaccAccountForEachOpenLot() and xaccAccountFindOpenLots() look at
+ * instead of all lots.  A lot leaves the set when it is found to be
+ * closed; gnc_account_recheck_lot() puts it back when its balance may
+ * have changed.  gnc_account_forget_lot() drops a lot that is going
+ * away. */
+void gnc_account_recheck_lot (Account *acc, GNCLot *lot);
+void gnc_account_forget_lot (Account *acc, GNCLot *lot);
+
+/* Mark the account sort-dirty if 'split' is out of order with the
+ * splits either side of it.  Called whenever a split's sort key may
+ * have changed; since every such change is checked as it happens, the
+ * rest of the list is known to be in order, and the neighbours are
+ * all that need looking at.  An append that lands in order leaves the
+ * account clean, so the next read doesn't have to scan the list. */
+void gnc_account_check_split_order (Account *acc, Split *split);
+
 /* Register Accounts with the engine */
 gboolean xaccAccountRegister (void);
 
@@ -151,6 +151,7 @@ gnc_book_insert_trans (QofBook *book, Transaction *trans)
     xaccTransBeginEdit (trans);
 
     col = qof_book_get_collection (book, GNC_ID_TRANS);
+    xaccTransIndexSetBook (trans, book);
     qof_instance_set_book(trans, book);
     qof_collection_insert_entity (col, &trans->inst);
 
@@ -502,7 +502,8 @@ void mark_split (Split *s)
 {
     if (s->acc)
     {
-        g_object_set(s->acc, "sort-dirty", TRUE, "balance-dirty", TRUE, NULL);
+        gnc_account_check_split_order(s->acc, s);
+        gnc_account_set_balance_dirty_from(s->acc, s);
     }
 
     /* set dirty flag on lot too. */
@@ -722,6 +723,7 @@ void
 xaccSplitCommitEdit(Split *s)
 {
     Account *acc, *orig_acc;
+    gboolean destroying;
 
     g_return_if_fail(s);
     if (!qof_instance_is_dirty(QOF_INSTANCE(s)))
@@ -778,13 +780,20 @@ xaccSplitCommitEdit(Split *s)
        original and new transactions, for the _next_ begin/commit cycle. */
     s->orig_acc = s->acc;
     s->orig_parent = s->parent;
+    destroying = qof_instance_get_destroying(s);
     if (!qof_commit_edit_part2(QOF_INSTANCE(s), commit_err, NULL,
                                (void (*) (QofInstance *)) xaccFreeSplit))
         return;
 
     if (acc)
     {
-        g_object_set(acc, "sort-dirty", TRUE, "balance-dirty", TRUE, NULL);
+        /* A destroyed split has been freed by now; removing it from
+           the account already dirtied the balances after it. */
+        if (!destroying)
+        {
+            gnc_account_check_split_order(acc, s);
+            gnc_account_set_balance_dirty_from(acc, s);
+        }
         xaccAccountRecomputeBalance(acc);
     }
 }
@@ -57,8 +57,10 @@ struct timeval
 #include "gnc-engine.h"
 #include "gnc-lot.h"
 #include "gnc-event.h"
+#include "gnc-split-index.h"
 
 #include "qofbackend-p.h"
+#include "qofquerycore-p.h"
 
 /* Notes about xaccTransBeginEdit(), xaccTransCommitEdit(), and
  *  xaccTransRollback():
@@ -419,6 +421,215 @@ gnc_transaction_class_init(TransactionClass* klass)
                         G_PARAM_READWRITE));
 }
 
+/********************************************************************\
+ * Per-book transaction index
+ *
+ * Queries on the date posted find their transactions here instead of
+ * checking every one in the book.  A transaction is kept in date order
+ * while it is closed.  One that is open for editing may be getting a
+ * new date, or moving splits to new accounts, so it is kept aside and
+ * offered to every indexed query until it is committed or rolled back.
+ * The date order is only built the first time a query asks for it.
+\********************************************************************/
+
+#define TRANS_INDEX_KEY "gnc-transaction-index"
+
+typedef struct
+{
+    Timespec      date;         /* date_posted when it was placed */
+    Transaction * trans;
+} TransDateEntry;
+
+typedef struct
+{
+    GHashTable *    open;       /* transactions being edited */
+    GncSplitIndex * by_date;    /* TransDateEntry, NULL until first used */
+    GHashTable *    entries;    /* Transaction -> TransDateEntry */
+} TransIndex;
+
+static gint
+trans_date_entry_order (gconstpointer a, gconstpointer b)
+{
+    const TransDateEntry *ea = a, *eb = b;
+    gint retval = timespec_cmp (&ea->date, &eb->date);
+
+    if (retval) return retval;
+    /* Any fixed order will do for the same date; the GUID can change
+     * while the transaction is being loaded, its address can't. */
+    if (ea->trans == eb->trans) return 0;
+    return ea->trans < eb->trans ? -1 : 1;
+}
+
+static void
+trans_index_free (QofBook *book, gpointer key, gpointer data)
+{
+    TransIndex *ti = data;
+
+    g_hash_table_destroy (ti->open);
+    if (ti->by_date)
+    {
+        gnc_split_index_destroy (ti->by_date);
+        g_hash_table_destroy (ti->entries);
+    }
+    g_free (ti);
+
+    /* The book's transactions are destroyed after its finalizers run */
+    qof_book_set_data (book, key, NULL);
+}
+
+static TransIndex *
+trans_index_get (QofBook *book, gboolean create)
+{
+    TransIndex *ti;
+
+    if (!book) return NULL;
+    ti = qof_book_get_data (book, TRANS_INDEX_KEY);
+    if (!ti && create && !qof_book_shutting_down (book))
+    {
+        ti = g_new0 (TransIndex, 1);
+        ti->open = g_hash_table_new (g_direct_hash, g_direct_equal);
+        qof_book_set_data_fin (book, TRANS_INDEX_KEY, ti, trans_index_free);
+    }
+    return ti;
+}
+
+/* Put a closed transaction where its date says it belongs */
+static void
+trans_index_place (TransIndex *ti, Transaction *trans)
+{
+    TransDateEntry *entry = g_hash_table_lookup (ti->entries, trans);
+
+    if (entry)
+    {
+        if (timespec_equal (&entry->date, &trans->date_posted))
+            return;
+        gnc_split_index_remove (ti->by_date, entry);
+    }
+    else
+    {
+        entry = g_new (TransDateEntry, 1);
+        entry->trans = trans;
+        g_hash_table_insert (ti->entries, trans, entry);
+    }
+    entry->date = trans->date_posted;
+    gnc_split_index_insert (ti->by_date, entry);
+}
+
+static void
+trans_index_build_cb (QofInstance *inst, gpointer data)
+{
+    TransIndex *ti = data;
+    Transaction *trans = GNC_TRANS (inst);
+    TransDateEntry *entry;
+
+    if (g_hash_table_lookup (ti->open, trans))
+        return;
+    entry = g_new (TransDateEntry, 1);
+    entry->trans = trans;
+    entry->date = trans->date_posted;
+    g_hash_table_insert (ti->entries, trans, entry);
+    gnc_split_index_prepend (ti->by_date, entry);
+}
+
+/* The book's closed transactions in date order */
+static GncSplitIndex *
+trans_index_by_date (QofBook *book)
+{
+    TransIndex *ti = trans_index_get (book, TRUE);
+
+    if (!ti) return NULL;
+    if (!ti->by_date)
+    {
+        ti->by_date = gnc_split_index_new (trans_date_entry_order);
+        ti->entries = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                             NULL, g_free);
+        qof_collection_foreach (qof_book_get_collection (book, GNC_ID_TRANS),
+                                trans_index_build_cb, ti);
+        gnc_split_index_sort (ti->by_date);
+    }
+    return ti->by_date;
+}
+
+static void
+trans_index_added (Transaction *trans)
+{
+    TransIndex *ti = trans_index_get (qof_instance_get_book (trans), FALSE);
+
+    if (ti && ti->by_date && !g_hash_table_lookup (ti->open, trans))
+        trans_index_place (ti, trans);
+}
+
+static void
+trans_index_opened (Transaction *trans)
+{
+    TransIndex *ti = trans_index_get (qof_instance_get_book (trans), TRUE);
+
+    if (ti)
+        g_hash_table_insert (ti->open, trans, trans);
+}
+
+static void
+trans_index_closed (Transaction *trans)
+{
+    TransIndex *ti = trans_index_get (qof_instance_get_book (trans), FALSE);
+
+    if (!ti) return;
+    g_hash_table_remove (ti->open, trans);
+    if (ti->by_date)
+        trans_index_place (ti, trans);
+}
+
+static void
+trans_index_removed (Transaction *trans)
+{
+    TransIndex *ti = trans_index_get (qof_instance_get_book (trans), FALSE);
+    TransDateEntry *entry;
+
+    if (!ti) return;
+    g_hash_table_remove (ti->open, trans);
+    if (ti->by_date && (entry = g_hash_table_lookup (ti->entries, trans)))
+    {
+        gnc_split_index_remove (ti->by_date, entry);
+        g_hash_table_remove (ti->entries, trans);
+    }
+}
+
+void
+xaccTransIndexSetBook (Transaction *trans, QofBook *book)
+{
+    if (!trans || !book) return;
+    trans_index_removed (trans);
+    if (xaccTransIsOpen (trans))
+    {
+        TransIndex *ti = trans_index_get (book, TRUE);
+        if (ti)
+            g_hash_table_insert (ti->open, trans, trans);
+    }
+    else
+    {
+        TransIndex *ti = trans_index_get (book, FALSE);
+        if (ti && ti->by_date)
+            trans_index_place (ti, trans);
+    }
+}
+
+guint
+xaccTransForeachOpen (QofBook *book, QofInstanceForeachCB cb, gpointer data)
+{
+    TransIndex *ti = trans_index_get (book, FALSE);
+    GHashTableIter iter;
+    gpointer trans;
+
+    if (!ti) return 0;
+    if (cb)
+    {
+        g_hash_table_iter_init (&iter, ti->open);
+        while (g_hash_table_iter_next (&iter, &trans, NULL))
+            cb (trans, data);
+    }
+    return g_hash_table_size (ti->open);
+}
+
 /********************************************************************\
  * xaccInitTransaction
  * Initialize a transaction structure
@@ -429,6 +640,7 @@ xaccInitTransaction (Transaction * trans, QofBook *book)
 {
     ENTER ("trans=%p", trans);
     qof_instance_init_data (&trans->inst, GNC_ID_TRANS, book);
+    trans_index_added (trans);
     LEAVE (" ");
 }
 
@@ -852,14 +1064,16 @@ gnc_numeric
 xaccTransGetImbalanceValue (const Transaction * trans)
 {
     gnc_numeric imbal = gnc_numeric_zero();
+    GncNumericAccum accum;
     if (!trans) return imbal;
 
     ENTER("(trans=%p)", trans);
     /* Could use xaccSplitsComputeValue, except that we want to use
        GNC_HOW_DENOM_EXACT */
-    FOR_EACH_SPLIT(trans, imbal =
-                       gnc_numeric_add(imbal, xaccSplitGetValue(s),
-                                       GNC_DENOM_AUTO, GNC_HOW_DENOM_EXACT));
+    gnc_numeric_accum_init (&accum);
+    FOR_EACH_SPLIT(trans, gnc_numeric_accum_add (&accum, xaccSplitGetValue(s)));
+    imbal = gnc_numeric_accum_total (&accum, GNC_DENOM_AUTO,
+                                     GNC_HOW_DENOM_EXACT);
     LEAVE("(trans=%p) imbal=%s", trans, gnc_num_dbg_to_string(imbal));
     return imbal;
 }
@@ -1118,6 +1332,7 @@ xaccTransBeginEdit (Transaction *trans)
 {
     if (!trans) return;
     if (!qof_begin_edit(&trans->inst)) return;
+    trans_index_opened (trans);
 
     if (qof_book_shutting_down(qof_instance_get_book(trans))) return;
 
@@ -1172,6 +1387,8 @@ do_destroy (Transaction *trans)
     SplitList *node;
     gboolean shutting_down = qof_book_shutting_down(qof_instance_get_book(trans));
 
+    trans_index_removed (trans);
+
     /* If there are capital-gains transactions associated with this,
      * they need to be destroyed too.  */
     destroy_gains (trans);
@@ -1301,6 +1518,7 @@ static void trans_cleanup_commit(Transaction *trans)
     /* Put back to zero. */
     qof_instance_decrease_editlevel(trans);
     g_assert(qof_instance_get_editlevel(trans) == 0);
+    trans_index_closed (trans);
 
     gen_event_trans (trans); //TODO: could be conditional
     qof_event_gen (&trans->inst, QOF_EVENT_MODIFY, NULL);
@@ -1468,6 +1686,10 @@ xaccTransRollbackEdit (Transaction *trans)
     g_list_free(orig->splits);
     orig->splits = NULL;
 
+    /* The restored dates, number and memos may put splits back out of
+       the places they were sorted into. */
+    FOR_EACH_SPLIT(trans, if (s->acc) gnc_account_check_split_order(s->acc, s));
+
     /* Now that the engine copy is back to its original version,
      * get the backend to fix it in the database */
     be = qof_book_get_backend(qof_instance_get_book(trans));
@@ -1519,6 +1741,8 @@ xaccTransRollbackEdit (Transaction *trans)
 
     /* Put back to zero. */
     qof_instance_decrease_editlevel(trans);
+    if (!xaccTransIsOpen (trans))
+        trans_index_closed (trans);
     /* FIXME: The register code seems to depend on the engine to
        generate an event during rollback, even though the state is just
        reverting to what it was. */
@@ -1648,9 +1872,11 @@ qofTransSetDatePosted (Transaction *trans, Timespec ts)
     if (!trans) return;
     if ((ts.tv_nsec == 0) && (ts.tv_sec == 0)) return;
     if (!qof_begin_edit(&trans->inst)) return;
+    trans_index_opened (trans);
     xaccTransSetDateInternal(trans, &trans->date_posted, ts);
     set_gains_date_dirty(trans);
     qof_commit_edit(&trans->inst);
+    trans_index_closed (trans);
 }
 
 void
@@ -1776,6 +2002,8 @@ xaccTransSetDescription (Transaction *trans, const char *desc)
 
     CACHE_REPLACE(trans->description, desc);
     qof_instance_set_dirty(QOF_INSTANCE(trans));
+    /* The description is a sort key of the splits. */
+    FOR_EACH_SPLIT(trans, if (s->acc) gnc_account_check_split_order(s->acc, s));
     xaccTransCommitEdit(trans);
 }
 
@@ -2320,6 +2548,156 @@ destroy_tx_on_book_close(QofInstance *ent, gpointer data)
  *
  * @param book Book being closed
  */
+/* Query indexes on the date posted.  The bounds are inclusive and a
+ * day wider than asked for when the match ignores the time of day;
+ * the query checks the dates again anyway. */
+static gboolean
+trans_date_range (const QofQueryPredData *pdata, Timespec *lo, Timespec *hi,
+                  gboolean *has_lo, gboolean *has_hi)
+{
+    const query_date_def *pdate = (const query_date_def *) pdata;
+    time_t slop = pdate->options == QOF_DATE_MATCH_DAY ? SECS_PER_DAY : 0;
+
+    if (safe_strcmp (pdata->type_name, QOF_TYPE_DATE))
+        return FALSE;
+
+    *has_lo = *has_hi = FALSE;
+    *lo = *hi = pdate->date;
+    lo->tv_sec -= slop;
+    hi->tv_sec += slop;
+    switch (pdata->how)
+    {
+    case QOF_COMPARE_LT:
+    case QOF_COMPARE_LTE:
+        *has_hi = TRUE;
+        break;
+    case QOF_COMPARE_GT:
+    case QOF_COMPARE_GTE:
+        *has_lo = TRUE;
+        break;
+    case QOF_COMPARE_EQUAL:
+        *has_lo = *has_hi = TRUE;
+        break;
+    default:
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static gint
+trans_date_entry_before (gconstpointer item, gconstpointer key)
+{
+    const TransDateEntry *entry = item;
+    return timespec_cmp (&entry->date, key) < 0 ? -1 : 1;
+}
+
+static gint64
+trans_date_index_estimate (QofBook *book, QofQueryPredData *pdata)
+{
+    GncSplitIndex *by_date;
+    Timespec lo, hi, first, last;
+    gboolean has_lo, has_hi;
+    double span, want;
+    guint n;
+
+    if (!trans_date_range (pdata, &lo, &hi, &has_lo, &has_hi))
+        return -1;
+    by_date = trans_index_by_date (book);
+    if (!by_date)
+        return -1;
+
+    /* Assume the dates are spread evenly between the first and last */
+    n = gnc_split_index_size (by_date);
+    if (n > 0)
+    {
+        first = ((TransDateEntry *) gnc_split_index_get_list (by_date)->data)->date;
+        last = ((TransDateEntry *) gnc_split_index_get_last (by_date)->data)->date;
+        if (!has_lo || timespec_cmp (&lo, &first) < 0) lo = first;
+        if (!has_hi || timespec_cmp (&hi, &last) > 0) hi = last;
+
+        span = (double) last.tv_sec - (double) first.tv_sec;
+        want = (double) hi.tv_sec - (double) lo.tv_sec;
+        if (timespec_cmp (&lo, &hi) > 0)
+            n = 0;
+        else if (span > 0)
+            n = (guint) (n * (want / span)) + 1;
+    }
+    return (gint64) n + xaccTransForeachOpen (book, NULL, NULL);
+}
+
+static void
+trans_date_index_foreach (QofBook *book, QofQueryPredData *pdata,
+                          QofInstanceForeachCB cb, gpointer user_data)
+{
+    GncSplitIndex *by_date;
+    Timespec lo, hi;
+    gboolean has_lo, has_hi;
+    GList *node;
+
+    if (!trans_date_range (pdata, &lo, &hi, &has_lo, &has_hi))
+        return;
+    by_date = trans_index_by_date (book);
+    if (!by_date)
+        return;
+
+    node = has_lo ? gnc_split_index_search (by_date, trans_date_entry_before,
+                                            &lo) : NULL;
+    node = node ? node->next : gnc_split_index_get_list (by_date);
+    for (; node; node = node->next)
+    {
+        TransDateEntry *entry = node->data;
+        if (has_hi && timespec_cmp (&entry->date, &hi) > 0)
+            break;
+        cb (QOF_INSTANCE (entry->trans), user_data);
+    }
+    xaccTransForeachOpen (book, cb, user_data);
+}
+
+typedef struct
+{
+    QofInstanceForeachCB cb;
+    gpointer user_data;
+} TransSplitsCB;
+
+static void
+trans_splits_cb (QofInstance *inst, gpointer data)
+{
+    TransSplitsCB *tscb = data;
+    Transaction *trans = GNC_TRANS (inst);
+    GList *node;
+
+    for (node = trans->splits; node; node = node->next)
+    {
+        Split *s = node->data;
+        if (s->parent == trans)
+            tscb->cb (QOF_INSTANCE (s), tscb->user_data);
+    }
+}
+
+/* The same index, for split queries on the parent's date */
+static gint64
+split_date_index_estimate (QofBook *book, QofQueryPredData *pdata)
+{
+    gint64 n = trans_date_index_estimate (book, pdata);
+    guint n_trans = qof_collection_count (qof_book_get_collection (book, GNC_ID_TRANS));
+    guint n_splits = qof_collection_count (qof_book_get_collection (book, GNC_ID_SPLIT));
+
+    if (n < 0 || n_trans == 0)
+        return n;
+    return n * n_splits / n_trans + 1;
+}
+
+static void
+split_date_index_foreach (QofBook *book, QofQueryPredData *pdata,
+                          QofInstanceForeachCB cb, gpointer user_data)
+{
+    TransSplitsCB tscb;
+
+    tscb.cb = cb;
+    tscb.user_data = user_data;
+    trans_date_index_foreach (book, pdata, trans_splits_cb, &tscb);
+}
+
 static void
 gnc_transaction_book_end(QofBook* book)
 {
@@ -2442,6 +2820,13 @@ gboolean xaccTransRegister (void)
     };
 
     qof_class_register (GNC_ID_TRANS, (QofSortFunc)xaccTransOrder, params);
+    qof_query_register_index (GNC_ID_TRANS, "transaction-by-date",
+                              qof_query_build_param_list (TRANS_DATE_POSTED, NULL),
+                              trans_date_index_estimate, trans_date_index_foreach);
+    qof_query_register_index (GNC_ID_SPLIT, "split-by-transaction-date",
+                              qof_query_build_param_list (SPLIT_TRANS,
+                                      TRANS_DATE_POSTED, NULL),
+                              split_date_index_estimate, split_date_index_foreach);
 
     return qof_object_register (&trans_object_def);
 }
@@ -171,6 +171,16 @@ void xaccDisableDataScrubbing(void);
  *    */
 #define xaccTransSetSlots_nc(T,F) qof_instance_set_slots(QOF_INSTANCE(T),F)
 
+/* Every book keeps track of its transactions that are open for
+ * editing, and the query indexes keep its transactions in date order.
+ * xaccTransIndexSetBook() moves the transaction to the indexes of
+ * 'book'; call it before the transaction is moved there.
+ * xaccTransForeachOpen() calls 'cb', if it isn't NULL, on each open
+ * transaction in the book and returns how many there are. */
+void xaccTransIndexSetBook (Transaction *trans, QofBook *book);
+guint xaccTransForeachOpen (QofBook *book, QofInstanceForeachCB cb,
+                            gpointer data);
+
 void xaccTransRemoveSplit (Transaction *trans, const Split *split);
 G_INLINE_FUNC void check_open (const Transaction *trans);
 
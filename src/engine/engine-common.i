@@ -24,6 +24,10 @@ AccountList * gnc_account_get_descendants_sorted (const Account *account);
 %ignore gnc_account_get_children_sorted;
 %ignore gnc_account_get_descendants;
 %ignore gnc_account_get_descendants_sorted;
+%ignore xaccAccountGetBalancesAsOfDates;
+%ignore xaccAccountsGetBalanceMatrix;
+%ignore gnc_balance_matrix_free;
+%ignore GncBalanceMatrix;
 %include <Account.h>
 
 %include <Transaction.h>
@@ -33,6 +33,7 @@
 #include "glib-helpers.h"
 #include "gnc-date.h"
 #include "gnc-engine.h"
+#include "gnc-exchange-totals.h"
 #include "guile-mappings.h"
 #include "qof.h"
 /** \todo Code dependent on the private query headers
@@ -2439,3 +2440,170 @@ qof_session_to_scm (const QofSession *session)
 {
     return gnc_generic_to_scm(session, "_p_QofSession");
 }
+
+/* The balances of 'account' at each of the timepairs in 'dates'; see
+ * xaccAccountGetBalancesAsOfDates(). */
+SCM
+gnc_account_get_balances_as_of_dates (Account *account, SCM dates)
+{
+    time_t *date_array;
+    gnc_numeric *balances;
+    guint n_dates, d;
+    SCM result = SCM_EOL;
+    SCM scm;
+
+    if (!account || scm_ilength (dates) < 0)
+        return SCM_BOOL_F;
+    n_dates = scm_ilength (dates);
+
+    date_array = g_new (time_t, n_dates);
+    balances = g_new (gnc_numeric, n_dates);
+    for (d = 0, scm = dates; d < n_dates; d++, scm = SCM_CDR (scm))
+        date_array[d] = gnc_timepair2timespec (SCM_CAR (scm)).tv_sec;
+
+    xaccAccountGetBalancesAsOfDates (account, date_array, n_dates, balances);
+
+    for (d = n_dates; d > 0; d--)
+        result = scm_cons (gnc_numeric_to_scm (balances[d - 1]), result);
+
+    g_free (balances);
+    g_free (date_array);
+    return result;
+}
+
+/* For each account in 'accounts', a list with an entry for each date
+ * in 'dates'.  Each entry is a list of the (commodity . balance) pairs
+ * of the account at that date.  See xaccAccountsGetBalanceMatrix(). */
+SCM
+gnc_accounts_get_balance_matrix (SCM accounts, SCM dates,
+                                 gboolean use_value,
+                                 gboolean include_children)
+{
+    GncBalanceMatrix *matrix;
+    GList *acc_list = NULL, *node;
+    Timespec *date_array;
+    guint n_dates, n, d, r;
+    SCM result = SCM_EOL;
+    SCM scm;
+
+    if (scm_ilength (dates) < 0 || scm_ilength (accounts) < 0)
+        return SCM_BOOL_F;
+    n_dates = scm_ilength (dates);
+
+    for (scm = accounts; scm_is_pair (scm); scm = SCM_CDR (scm))
+    {
+        Account *acc = gnc_scm_to_generic (SCM_CAR (scm), "_p_Account");
+
+        if (!acc)
+        {
+            g_list_free (acc_list);
+            return SCM_BOOL_F;
+        }
+        acc_list = g_list_prepend (acc_list, acc);
+    }
+    acc_list = g_list_reverse (acc_list);
+
+    date_array = g_new (Timespec, MAX (n_dates, 1));
+    for (d = 0, scm = dates; d < n_dates; d++, scm = SCM_CDR (scm))
+        date_array[d] = gnc_timepair2timespec (SCM_CAR (scm));
+
+    matrix = xaccAccountsGetBalanceMatrix (acc_list, date_array, n_dates,
+                                           use_value, include_children);
+    if (!matrix)
+    {
+        g_list_free (acc_list);
+        g_free (date_array);
+        return SCM_BOOL_F;
+    }
+
+    /* The rows of each account follow one another, in the order of
+     * the accounts. */
+    r = 0;
+    for (node = acc_list, n = 0; node; node = node->next, n++)
+    {
+        SCM acc_scm = SCM_EOL;
+        guint first = r;
+
+        while (r < matrix->n_rows && matrix->account_index[r] == n)
+            r++;
+
+        for (d = n_dates; d > 0; d--)
+        {
+            SCM cell = SCM_EOL;
+            guint i;
+
+            for (i = r; i > first; i--)
+            {
+                if (timespec_cmp (&matrix->first_posted[i - 1],
+                                  &date_array[d - 1]) > 0)
+                    continue;
+                cell = scm_cons (scm_cons (gnc_commodity_to_scm (matrix->commodities[i - 1]),
+                                           gnc_numeric_to_scm (matrix->balances[(i - 1) * n_dates + d - 1])),
+                                 cell);
+            }
+            acc_scm = scm_cons (cell, acc_scm);
+        }
+        result = scm_cons (acc_scm, result);
+    }
+
+    gnc_balance_matrix_free (matrix);
+    g_list_free (acc_list);
+    g_free (date_array);
+    return scm_reverse (result);
+}
+
+/* For each timepair in 'dates', the exchange totals of 'book' at that
+ * date: a list with an element (commodity ((other foreign . domestic)
+ * ...)) for each group.  See gnc_book_get_exchange_totals(). */
+SCM
+gnc_book_get_exchange_totals_scm (QofBook *book,
+                                  gnc_commodity *report_commodity,
+                                  SCM dates, gboolean cost)
+{
+    const GncExchangeTotals **totals;
+    Timespec *date_array;
+    guint n_dates, d, g, p;
+    SCM result = SCM_EOL;
+    SCM scm;
+
+    if (!book || scm_ilength (dates) < 0)
+        return SCM_BOOL_F;
+    n_dates = scm_ilength (dates);
+
+    date_array = g_new (Timespec, MAX (n_dates, 1));
+    for (d = 0, scm = dates; d < n_dates; d++, scm = SCM_CDR (scm))
+        date_array[d] = gnc_timepair2timespec (SCM_CAR (scm));
+
+    totals = gnc_book_get_exchange_totals (book, report_commodity,
+                                           date_array, n_dates, cost);
+
+    for (d = n_dates; d > 0; d--)
+    {
+        const GncExchangeTotals *at = totals[d - 1];
+        SCM groups = SCM_EOL;
+
+        for (g = at->n_groups; g > 0; g--)
+        {
+            const GncExchangeGroup *group = &at->groups[g - 1];
+            SCM pairs = SCM_EOL;
+
+            for (p = group->n_pairs; p > 0; p--)
+            {
+                const GncExchangePair *pair = &group->pairs[p - 1];
+
+                pairs = scm_cons (scm_list_2 (gnc_commodity_to_scm (pair->commodity),
+                                              scm_cons (gnc_numeric_to_scm (pair->foreign),
+                                                        gnc_numeric_to_scm (pair->domestic))),
+                                  pairs);
+            }
+            groups = scm_cons (scm_list_2 (gnc_commodity_to_scm (group->commodity),
+                                           pairs),
+                               groups);
+        }
+        result = scm_cons (groups, result);
+    }
+
+    g_free (totals);
+    g_free (date_array);
+    return result;
+}
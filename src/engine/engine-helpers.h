@@ -75,4 +75,29 @@ SCM gnc_commodity_to_scm (const gnc_commodity *commodity);
 SCM gnc_book_to_scm (const QofBook *book);
 SCM qof_session_to_scm (const QofSession *session);
 
+/** Get the balance of 'account' at each of the timepairs in the list
+ * 'dates'; see xaccAccountGetBalancesAsOfDates().  Returns a list of
+ * the balances, in the order of the dates. */
+SCM gnc_account_get_balances_as_of_dates (Account *account, SCM dates);
+
+/** Get the balances of the accounts in the list 'accounts' at each of
+ * the timepairs in the list 'dates'; see xaccAccountsGetBalanceMatrix().
+ * Returns a list with an element for each account, which is a list
+ * with an element for each date: the list of (commodity . balance)
+ * pairs the account has at that date.  Returns #f if 'accounts' or
+ * 'dates' isn't a list or an element of 'accounts' isn't an account. */
+SCM gnc_accounts_get_balance_matrix (SCM accounts, SCM dates,
+                                     gboolean use_value,
+                                     gboolean include_children);
+
+/** Get the exchange totals of 'book' for 'report_commodity' at each of
+ * the timepairs in the list 'dates'; see gnc_book_get_exchange_totals().
+ * Returns a list with an element for each date, which is a list of
+ * the groups of that date.  A group is a list of its commodity and of
+ * the list of its pairs, and a pair is a list of the other commodity
+ * and of the (foreign . domestic) totals. */
+SCM gnc_book_get_exchange_totals_scm (QofBook *book,
+                                      gnc_commodity *report_commodity,
+                                      SCM dates, gboolean cost);
+
 #endif
@@ -78,6 +78,7 @@ functions. */
 }
 
 %include <engine-helpers.h>
+%ignore gnc_pricedb_convert_balances_nearest_price;
 %include <gnc-pricedb.h>
 
 QofSession * qof_session_new (void);
@@ -0,0 +1,506 @@
+/********************************************************************\
+ * gnc-exchange-totals.c -- exchange totals harvested from splits   *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+\********************************************************************/
+
+/*
+ * FILE:
+ * gnc-exchange-totals.c
+ *
+ * FUNCTION:
+ * The book keeps the splits that exchange two commodities as a flat
+ * array of records, in the order a split query returns them.  A
+ * request for a series of dates sorts the dates, walks the records
+ * once and takes a copy of the running totals at each date.  Those
+ * copies are kept by (report commodity, kind, date) until the next
+ * change to a transaction or an account of the book.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "gnc-exchange-totals.h"
+#include "gnc-engine.h"
+#include "gnc-event.h"
+#include "Account.h"
+#include "Split.h"
+#include "Transaction.h"
+
+static QofLogModule log_module = GNC_MOD_ENGINE;
+
+#define EXCHANGE_TOTALS_KEY "gnc-exchange-totals"
+
+/* What the totals need to know of one split */
+typedef struct
+{
+    Timespec posted;
+    gnc_commodity *acc_comm;
+    gnc_commodity *trans_comm;
+    gnc_numeric amount;
+    gnc_numeric value;
+} ExchangeRecord;
+
+typedef struct
+{
+    gnc_commodity *commodity;
+    gboolean cost;
+    Timespec date;
+} ExchangeKey;
+
+typedef struct
+{
+    QofBook *book;
+    ExchangeRecord *records;    /* NULL until needed */
+    guint n_records;
+    GHashTable *totals;         /* ExchangeKey* -> GncExchangeTotals* */
+    gint listener;
+} ExchangeCache;
+
+/* A group while the records are walked.  The stamp says when a pair
+ * was last added to it, which is where the report code used to move
+ * the group to the front of its list. */
+typedef struct
+{
+    gnc_commodity *commodity;
+    guint stamp;
+    GArray *pairs;              /* GncExchangePair, oldest first */
+} SweepGroup;
+
+/* ============================================================== */
+
+static guint
+exchange_key_hash (gconstpointer data)
+{
+    const ExchangeKey *key = data;
+
+    return g_direct_hash (key->commodity) ^ (guint)key->date.tv_sec
+           ^ ((guint)key->date.tv_nsec << 1) ^ (key->cost ? 1 : 0);
+}
+
+static gboolean
+exchange_key_equal (gconstpointer a, gconstpointer b)
+{
+    const ExchangeKey *ka = a, *kb = b;
+
+    return ka->commodity == kb->commodity && !ka->cost == !kb->cost
+           && timespec_equal (&ka->date, &kb->date);
+}
+
+static void
+exchange_totals_free (gpointer data)
+{
+    GncExchangeTotals *totals = data;
+    guint i;
+
+    for (i = 0; i < totals->n_groups; i++)
+        g_free (totals->groups[i].pairs);
+    g_free (totals->groups);
+    g_free (totals);
+}
+
+static void
+exchange_cache_clear (ExchangeCache *cache)
+{
+    g_free (cache->records);
+    cache->records = NULL;
+    cache->n_records = 0;
+    g_hash_table_remove_all (cache->totals);
+}
+
+static void
+listen_for_changes (QofInstance *entity, QofEventId event_type,
+                    gpointer user_data, gpointer event_data)
+{
+    ExchangeCache *cache = user_data;
+
+    if (!GNC_IS_TRANS (entity) && !GNC_IS_SPLIT (entity)
+            && !GNC_IS_ACCOUNT (entity))
+        return;
+    if (0 == (event_type & (QOF_EVENT_MODIFY | QOF_EVENT_DESTROY)))
+        return;
+    if (qof_instance_get_book (entity) != cache->book)
+        return;
+
+    if (cache->records || g_hash_table_size (cache->totals) > 0)
+        exchange_cache_clear (cache);
+}
+
+static void
+exchange_cache_destroy (QofBook *book, gpointer key, gpointer user_data)
+{
+    ExchangeCache *cache = user_data;
+
+    qof_event_unregister_handler (cache->listener);
+    g_free (cache->records);
+    g_hash_table_destroy (cache->totals);
+    g_free (cache);
+}
+
+static ExchangeCache *
+exchange_cache_get (QofBook *book)
+{
+    ExchangeCache *cache = qof_book_get_data (book, EXCHANGE_TOTALS_KEY);
+
+    if (cache)
+        return cache;
+
+    cache = g_new0 (ExchangeCache, 1);
+    cache->book = book;
+    cache->totals = g_hash_table_new_full (exchange_key_hash,
+                                           exchange_key_equal, g_free,
+                                           exchange_totals_free);
+    cache->listener = qof_event_register_handler (listen_for_changes, cache);
+    qof_book_set_data_fin (book, EXCHANGE_TOTALS_KEY, cache,
+                           exchange_cache_destroy);
+    return cache;
+}
+
+/* ============================================================== */
+
+typedef struct
+{
+    Account *root;
+    GPtrArray *splits;
+} CollectData;
+
+/* The splits the report query used to match: in an account of the
+ * book's tree, not reconciled as voided (what
+ * gnc:query-set-match-non-voids-only! matches), and with an account
+ * commodity other than the transaction currency. */
+static void
+collect_split (QofInstance *inst, gpointer user_data)
+{
+    CollectData *data = user_data;
+    Split *split = (Split *) inst;
+    Account *acc = xaccSplitGetAccount (split);
+    Transaction *trans = xaccSplitGetParent (split);
+
+    if (!acc || !trans || acc == data->root)
+        return;
+    if (gnc_account_get_root (acc) != data->root)
+        return;
+    if (xaccSplitGetReconcile (split) == VREC)
+        return;
+    if (gnc_commodity_equiv (xaccTransGetCurrency (trans),
+                             xaccAccountGetCommodity (acc)))
+        return;
+
+    g_ptr_array_add (data->splits, split);
+}
+
+static gint
+compare_splits (gconstpointer a, gconstpointer b)
+{
+    return xaccSplitOrder (*(Split * const *) a, *(Split * const *) b);
+}
+
+static void
+exchange_cache_load (ExchangeCache *cache)
+{
+    CollectData data;
+    guint i;
+
+    data.root = gnc_book_get_root_account (cache->book);
+    data.splits = g_ptr_array_new ();
+    if (data.root)
+        qof_collection_foreach (qof_book_get_collection (cache->book,
+                                GNC_ID_SPLIT), collect_split, &data);
+
+    /* The order of a split query, which is by date posted first. */
+    g_ptr_array_sort (data.splits, compare_splits);
+
+    cache->n_records = data.splits->len;
+    cache->records = g_new (ExchangeRecord, MAX (data.splits->len, 1));
+    for (i = 0; i < data.splits->len; i++)
+    {
+        Split *split = g_ptr_array_index (data.splits, i);
+        Transaction *trans = xaccSplitGetParent (split);
+        ExchangeRecord *rec = &cache->records[i];
+
+        rec->posted = xaccTransRetDatePostedTS (trans);
+        rec->acc_comm = xaccAccountGetCommodity (xaccSplitGetAccount (split));
+        rec->trans_comm = xaccTransGetCurrency (trans);
+        rec->amount = xaccSplitGetAmount (split);
+        rec->value = xaccSplitGetValue (split);
+    }
+    g_ptr_array_free (data.splits, TRUE);
+
+    DEBUG ("%u splits exchange two commodities", cache->n_records);
+}
+
+/* ============================================================== */
+
+static SweepGroup *
+sweep_find_group (GPtrArray *groups, const gnc_commodity *commodity)
+{
+    guint i;
+
+    for (i = 0; i < groups->len; i++)
+    {
+        SweepGroup *group = g_ptr_array_index (groups, i);
+        if (group->commodity == commodity)
+            return group;
+    }
+    return NULL;
+}
+
+static SweepGroup *
+sweep_add_group (GPtrArray *groups, gnc_commodity *commodity, guint stamp)
+{
+    SweepGroup *group = g_new (SweepGroup, 1);
+
+    group->commodity = commodity;
+    group->stamp = stamp;
+    group->pairs = g_array_new (FALSE, FALSE, sizeof (GncExchangePair));
+    g_ptr_array_add (groups, group);
+    return group;
+}
+
+static GncExchangePair *
+sweep_add_pair (SweepGroup *group, gnc_commodity *commodity)
+{
+    GncExchangePair pair;
+
+    pair.commodity = commodity;
+    pair.foreign = gnc_numeric_zero ();
+    pair.domestic = gnc_numeric_zero ();
+    g_array_append_val (group->pairs, pair);
+    return &g_array_index (group->pairs, GncExchangePair,
+                           group->pairs->len - 1);
+}
+
+static void
+sweep_free_groups (GPtrArray *groups)
+{
+    guint i;
+
+    for (i = 0; i < groups->len; i++)
+    {
+        SweepGroup *group = g_ptr_array_index (groups, i);
+        g_array_free (group->pairs, TRUE);
+        g_free (group);
+    }
+    g_ptr_array_free (groups, TRUE);
+}
+
+/* Add one split to the running totals, just like the loops of
+ * gnc:get-exchange-totals and gnc:get-exchange-cost-totals did. */
+static void
+sweep_add_record (GPtrArray *groups, const ExchangeRecord *rec,
+                  gboolean cost, guint *stamp)
+{
+    SweepGroup *group;
+    GncExchangePair *pair = NULL;
+    gnc_commodity *other;
+    gnc_numeric shares, value, foreign, domestic;
+    guint i;
+
+    if (cost)
+    {
+        shares = rec->amount;
+        value = rec->value;
+    }
+    else
+    {
+        /* Without shares this is not a buy or sell; ignore it. */
+        if (gnc_numeric_zero_p (rec->amount))
+            return;
+        shares = gnc_numeric_abs (rec->amount);
+        value = gnc_numeric_abs (rec->value);
+    }
+
+    group = sweep_find_group (groups, rec->trans_comm);
+    if (!group)
+        group = sweep_find_group (groups, rec->acc_comm);
+
+    if (!group)
+    {
+        group = sweep_add_group (groups, rec->acc_comm, ++(*stamp));
+        other = rec->trans_comm;
+        foreign = value;
+        domestic = shares;
+    }
+    else if (gnc_commodity_equiv (rec->trans_comm, group->commodity))
+    {
+        other = rec->acc_comm;
+        foreign = shares;
+        domestic = value;
+    }
+    else
+    {
+        other = rec->trans_comm;
+        foreign = cost ? gnc_numeric_neg (value) : value;
+        domestic = cost ? gnc_numeric_neg (shares) : shares;
+    }
+
+    for (i = 0; i < group->pairs->len; i++)
+    {
+        GncExchangePair *p = &g_array_index (group->pairs, GncExchangePair, i);
+        if (p->commodity == other)
+        {
+            pair = p;
+            break;
+        }
+    }
+    if (!pair)
+    {
+        pair = sweep_add_pair (group, other);
+        group->stamp = ++(*stamp);
+    }
+
+    pair->foreign = gnc_numeric_add (pair->foreign, foreign,
+                                     GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD);
+    pair->domestic = gnc_numeric_add (pair->domestic, domestic,
+                                      GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD);
+}
+
+static gint
+compare_group_stamps (gconstpointer a, gconstpointer b)
+{
+    const SweepGroup *ga = *(SweepGroup * const *) a;
+    const SweepGroup *gb = *(SweepGroup * const *) b;
+
+    return (ga->stamp < gb->stamp) - (ga->stamp > gb->stamp);
+}
+
+static GncExchangeTotals *
+sweep_snapshot (GPtrArray *groups)
+{
+    GncExchangeTotals *totals = g_new (GncExchangeTotals, 1);
+    GPtrArray *order = g_ptr_array_sized_new (groups->len);
+    guint i, j;
+
+    for (i = 0; i < groups->len; i++)
+        g_ptr_array_add (order, g_ptr_array_index (groups, i));
+    g_ptr_array_sort (order, compare_group_stamps);
+
+    totals->n_groups = order->len;
+    totals->groups = g_new (GncExchangeGroup, order->len);
+    for (i = 0; i < order->len; i++)
+    {
+        SweepGroup *group = g_ptr_array_index (order, i);
+        GncExchangeGroup *out = &totals->groups[i];
+        guint n = group->pairs->len;
+
+        out->commodity = group->commodity;
+        out->n_pairs = n;
+        out->pairs = g_new (GncExchangePair, MAX (n, 1));
+        for (j = 0; j < n; j++)
+            out->pairs[j] = g_array_index (group->pairs, GncExchangePair,
+                                           n - 1 - j);
+    }
+
+    g_ptr_array_free (order, TRUE);
+    return totals;
+}
+
+/* ============================================================== */
+
+static gint
+compare_date_index (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+    const Timespec *dates = user_data;
+
+    return timespec_cmp (&dates[*(const guint *) a], &dates[*(const guint *) b]);
+}
+
+const GncExchangeTotals **
+gnc_book_get_exchange_totals (QofBook *book, gnc_commodity *report_commodity,
+                              const Timespec *end_dates, guint n_dates,
+                              gboolean cost)
+{
+    ExchangeCache *cache;
+    const GncExchangeTotals **result;
+    ExchangeKey key;
+    guint *missing;
+    guint n_missing = 0, d;
+
+    g_return_val_if_fail (book, NULL);
+    g_return_val_if_fail (end_dates || n_dates == 0, NULL);
+
+    cache = exchange_cache_get (book);
+
+    /* The splits are only read when the cache is empty, and then every
+     * account has to be in memory.  Loading them may clear the cache,
+     * so it is done before anything is looked up. */
+    if (!cache->records)
+    {
+        GList *accounts = g_list_prepend (NULL, gnc_book_get_root_account (book));
+
+        gnc_account_list_load_splits (accounts, TRUE);
+        g_list_free (accounts);
+    }
+
+    result = g_new0 (const GncExchangeTotals *, MAX (n_dates, 1));
+    missing = g_new (guint, MAX (n_dates, 1));
+
+    key.commodity = report_commodity;
+    key.cost = cost;
+    for (d = 0; d < n_dates; d++)
+    {
+        key.date = end_dates[d];
+        result[d] = g_hash_table_lookup (cache->totals, &key);
+        if (!result[d])
+            missing[n_missing++] = d;
+    }
+
+    if (n_missing > 0)
+    {
+        GPtrArray *groups = g_ptr_array_new ();
+        guint stamp = 0, r = 0, m;
+
+        if (!cache->records)
+            exchange_cache_load (cache);
+
+        g_qsort_with_data (missing, n_missing, sizeof (guint),
+                           compare_date_index, (gpointer) end_dates);
+
+        /* The report commodity has its group even with no pairs. */
+        sweep_add_group (groups, report_commodity, 0);
+
+        for (m = 0; m < n_missing; m++)
+        {
+            const Timespec *date = &end_dates[missing[m]];
+            GncExchangeTotals *totals;
+
+            for (; r < cache->n_records; r++)
+            {
+                if (timespec_cmp (&cache->records[r].posted, date) > 0)
+                    break;
+                sweep_add_record (groups, &cache->records[r], cost, &stamp);
+            }
+
+            key.date = *date;
+            totals = g_hash_table_lookup (cache->totals, &key);
+            if (!totals)
+            {
+                totals = sweep_snapshot (groups);
+                g_hash_table_insert (cache->totals,
+                                     g_memdup (&key, sizeof (key)), totals);
+            }
+            result[missing[m]] = totals;
+        }
+
+        sweep_free_groups (groups);
+    }
+
+    g_free (missing);
+    return result;
+}
@@ -0,0 +1,94 @@
+/********************************************************************\
+ * gnc-exchange-totals.h -- exchange totals harvested from splits   *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+\********************************************************************/
+
+/** @addtogroup Engine
+    @{ */
+/** @file gnc-exchange-totals.h
+ *  @brief The amounts exchanged between commodities in a book.
+ *
+ *  The "average cost" and "weighted average" price sources of the
+ *  reports price a commodity by the totals of all the splits up to a
+ *  date whose account commodity differs from the currency of their
+ *  transaction.  These functions add those totals up for the reports.
+ *
+ *  The splits with two commodities are collected and sorted once per
+ *  book.  The totals for a series of dates are then taken in one walk
+ *  over them, and kept by report commodity and date.  Everything is
+ *  dropped as soon as a transaction or an account of the book changes.
+ */
+
+#ifndef GNC_EXCHANGE_TOTALS_H
+#define GNC_EXCHANGE_TOTALS_H
+
+#include "qof.h"
+#include "gnc-commodity.h"
+
+/** The amounts exchanged between a group's commodity and one other
+ *  commodity. */
+typedef struct
+{
+    gnc_commodity *commodity;   /**< The other commodity */
+    gnc_numeric foreign;        /**< Total in 'commodity' */
+    gnc_numeric domestic;       /**< Total in the group's commodity */
+} GncExchangePair;
+
+/** All the commodities exchanged against one commodity. */
+typedef struct
+{
+    gnc_commodity *commodity;
+    guint n_pairs;
+    GncExchangePair *pairs;
+} GncExchangeGroup;
+
+/** The exchange totals at one date.
+ *
+ *  The splits are grouped the way gnc:get-exchange-totals always
+ *  grouped them: a split joins the group of its transaction currency
+ *  if there is one, else the group of its account commodity, else it
+ *  starts a new group for the account commodity.  The group of the
+ *  report commodity always exists.  Groups come most recently
+ *  extended first and the pairs of a group newest first, which is the
+ *  order the report code used to build them in. */
+typedef struct
+{
+    guint n_groups;
+    GncExchangeGroup *groups;
+} GncExchangeTotals;
+
+/** Get the exchange totals of 'book' for 'report_commodity' at each
+ *  of the 'n_dates' dates in 'end_dates'.  The dates need not be
+ *  sorted.  Voided transactions and those after a date do not count.
+ *
+ *  With 'cost' FALSE the absolute amounts of all splits with shares
+ *  are added up, which gives weighted average prices.  With 'cost'
+ *  TRUE the signed amounts of all splits are, which gives the average
+ *  cost of what is still held.
+ *
+ *  @return A newly allocated array of 'n_dates' pointers, one per
+ *  date, to be freed with g_free().  The totals themselves belong to
+ *  the book and are only good until the next change to the book's
+ *  transactions or accounts. */
+const GncExchangeTotals ** gnc_book_get_exchange_totals (QofBook *book,
+        gnc_commodity *report_commodity, const Timespec *end_dates,
+        guint n_dates, gboolean cost);
+
+#endif /* GNC_EXCHANGE_TOTALS_H */
+/** @} */
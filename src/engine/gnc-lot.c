@@ -155,6 +155,8 @@ gnc_lot_set_property(GObject* object, guint prop_id, const GValue* value, GParam
     {
     case PROP_IS_CLOSED:
         priv->is_closed = g_value_get_int(value);
+        if (priv->is_closed != TRUE && priv->account)
+            gnc_account_recheck_lot (priv->account, lot);
         break;
     case PROP_MARKER:
         priv->marker = g_value_get_int(value);
@@ -227,6 +229,9 @@ gnc_lot_free(GNCLot* lot)
     }
     g_list_free (priv->splits);
 
+    if (priv->account)
+        gnc_account_forget_lot (priv->account, lot);
+
     priv->account = NULL;
     priv->is_closed = TRUE;
     /* qof_instance_release (&lot->inst); */
@@ -350,6 +355,8 @@ gnc_lot_set_closed_unknown(GNCLot* lot)
     {
         priv = GET_PRIVATE(lot);
         priv->is_closed = LOT_CLOSED_UNKNOWN;
+        if (priv->account)
+            gnc_account_recheck_lot (priv->account, lot);
     }
 }
 
@@ -552,6 +559,8 @@ gnc_lot_add_split (GNCLot *lot, Split *split)
 
     /* for recomputation of is-closed */
     priv->is_closed = LOT_CLOSED_UNKNOWN;
+    if (priv->account)
+        gnc_account_recheck_lot (priv->account, lot);
     gnc_lot_commit_edit(lot);
 
     qof_event_gen (QOF_INSTANCE(lot), QOF_EVENT_MODIFY, NULL);
@@ -577,6 +586,10 @@ gnc_lot_remove_split (GNCLot *lot, Split *split)
         xaccAccountRemoveLot (priv->account, lot);
         priv->account = NULL;
     }
+    else if (priv->account)
+    {
+        gnc_account_recheck_lot (priv->account, lot);
+    }
     gnc_lot_commit_edit(lot);
     qof_event_gen (QOF_INSTANCE(lot), QOF_EVENT_MODIFY, NULL);
 }
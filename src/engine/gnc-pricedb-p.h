@@ -55,8 +55,9 @@ struct _GncPriceClass
 struct gnc_price_db_s
 {
     QofInstance inst;              /* globally unique object identifier */
-    GHashTable *commodity_hash;
+    GHashTable *commodity_hash;    /* commodity -> currency -> price series */
     gboolean bulk_update;		 /* TRUE while reading XML file, etc. */
+    GHashTable *rate_cache;        /* memoized balance conversions */
 };
 
 struct _GncPriceDBClass
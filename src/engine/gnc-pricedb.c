@@ -34,6 +34,7 @@ static QofLogModule log_module = GNC_MOD_PRICE;
 
 static gboolean add_price(GNCPriceDB *db, GNCPrice *p);
 static gboolean remove_price(GNCPriceDB *db, GNCPrice *p, gboolean cleanup);
+static void pricedb_rate_cache_clear(GNCPriceDB *db);
 
 enum
 {
@@ -473,6 +474,7 @@ gnc_price_set_value(GNCPrice *p, gnc_numeric value)
         p->value = value;
         gnc_price_set_dirty(p);
         gnc_price_commit_edit (p);
+        pricedb_rate_cache_clear (p->db);
     }
 }
 
@@ -638,7 +640,6 @@ gnc_price_list_insert(PriceList **prices, GNCPrice *p, gboolean check_dupl)
     gboolean isDupl;
 
     if (!prices || !p) return FALSE;
-    gnc_price_ref(p);
 
     if (check_dupl)
     {
@@ -649,12 +650,14 @@ gnc_price_list_insert(PriceList **prices, GNCPrice *p, gboolean check_dupl)
         isDupl = pStruct->isDupl;
         g_free( pStruct );
 
+        /* The list doesn't keep a duplicate, so it takes no reference. */
         if ( isDupl )
         {
             return TRUE;
         }
     }
 
+    gnc_price_ref(p);
     result_list = g_list_insert_sorted(*prices, p, compare_prices_by_date);
     if (!result_list) return FALSE;
     *prices = result_list;
@@ -719,15 +722,296 @@ gnc_price_list_equal(PriceList *prices1, PriceList *prices2)
     return TRUE;
 }
 
+/* ==================================================================== */
+/* price series
+
+   The prices for one (commodity, currency) pair are kept in two
+   parallel arrays, one holding the times and one the prices, in the
+   same most-recent-first order that compare_prices_by_date() gives a
+   price list.  The lookups only need the times, so they binary-search
+   a dense array of Timespecs instead of chasing list nodes and price
+   objects.  Values are read from the prices themselves, because
+   gnc_price_set_value() does not go through the database.
+
+   While the database is in bulk_update mode new prices are appended
+   without a duplicate check and the series is marked unsorted; it is
+   sorted once, on the next lookup or when bulk_update is turned off.
+ */
+
+typedef struct
+{
+    GArray *times;              /* Timespec, most recent first */
+    GArray *prices;             /* GNCPrice *, parallel to times */
+    gboolean sorted;
+} PriceSeries;
+
+#define SERIES_TIME(s,i)  g_array_index ((s)->times, Timespec, (i))
+#define SERIES_PRICE(s,i) g_array_index ((s)->prices, GNCPrice *, (i))
+
+/* Prices with the same canonical day are never further apart than
+ * this, whatever the timezone and daylight saving rules. */
+#define PRICE_DAY_WINDOW (2 * 24 * 60 * 60)
+
+static PriceSeries *
+price_series_new (void)
+{
+    PriceSeries *series = g_new0 (PriceSeries, 1);
+    series->times = g_array_new (FALSE, FALSE, sizeof (Timespec));
+    series->prices = g_array_new (FALSE, FALSE, sizeof (GNCPrice *));
+    series->sorted = TRUE;
+    return series;
+}
+
+static void
+price_series_free (PriceSeries *series)
+{
+    guint i;
+
+    if (!series) return;
+    for (i = 0; i < series->prices->len; i++)
+        gnc_price_unref (SERIES_PRICE (series, i));
+    g_array_free (series->times, TRUE);
+    g_array_free (series->prices, TRUE);
+    g_free (series);
+}
+
+static gint
+compare_price_ptrs_by_date (gconstpointer a, gconstpointer b)
+{
+    return compare_prices_by_date (*(GNCPrice * const *) a,
+                                   *(GNCPrice * const *) b);
+}
+
+static void
+price_series_sort (PriceSeries *series)
+{
+    guint i;
+
+    if (series->sorted) return;
+    g_array_sort (series->prices, compare_price_ptrs_by_date);
+    for (i = 0; i < series->prices->len; i++)
+        SERIES_TIME (series, i) = gnc_price_get_time (SERIES_PRICE (series, i));
+    series->sorted = TRUE;
+}
+
+/* Return the index of the first (most recent) price at or before t,
+ * or the length of the series if every price is after t. */
+static guint
+price_series_find_before (const PriceSeries *series, Timespec t)
+{
+    guint lo = 0, hi = series->times->len;
+
+    while (lo < hi)
+    {
+        guint mid = lo + (hi - lo) / 2;
+        if (timespec_cmp (&SERIES_TIME (series, mid), &t) > 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* Return the index at which g_list_insert_sorted() would have put p. */
+static guint
+price_series_find_slot (const PriceSeries *series, GNCPrice *p)
+{
+    guint lo = 0, hi = series->prices->len;
+
+    while (lo < hi)
+    {
+        guint mid = lo + (hi - lo) / 2;
+        if (compare_prices_by_date (p, SERIES_PRICE (series, mid)) > 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static gboolean
+price_series_has_duplicate (const PriceSeries *series, GNCPrice *p)
+{
+    PriceListIsDuplStruct dupl;
+    Timespec t = gnc_price_get_time (p);
+    Timespec first = t, last = t;
+    guint i;
+
+    first.tv_sec += PRICE_DAY_WINDOW;
+    last.tv_sec -= PRICE_DAY_WINDOW;
+    dupl.pPrice = p;
+    dupl.isDupl = FALSE;
+    for (i = price_series_find_before (series, first);
+            i < series->times->len && !dupl.isDupl; i++)
+    {
+        if (timespec_cmp (&SERIES_TIME (series, i), &last) < 0)
+            break;
+        price_list_is_duplicate (SERIES_PRICE (series, i), &dupl);
+    }
+    return dupl.isDupl;
+}
+
+/* Same contract as gnc_price_list_insert(): takes a reference to p,
+ * and quietly drops duplicates, without a reference, when check_dupl
+ * is set.  Returns FALSE if p was dropped. */
+static gboolean
+price_series_insert (PriceSeries *series, GNCPrice *p, gboolean check_dupl)
+{
+    Timespec t = gnc_price_get_time (p);
+    guint len = series->prices->len;
+    guint slot;
+
+    if (check_dupl)
+    {
+        price_series_sort (series);
+        if (price_series_has_duplicate (series, p))
+            return FALSE;
+    }
+    else if (len > 0 && series->sorted &&
+             compare_prices_by_date (SERIES_PRICE (series, len - 1), p) > 0)
+    {
+        /* The series is most recent first, so appending keeps it in
+         * order only while no price is newer than the one before it;
+         * leave the sort until the series is next read. */
+        series->sorted = FALSE;
+    }
+    gnc_price_ref (p);
+
+    if (!series->sorted || !check_dupl)
+    {
+        g_array_append_val (series->times, t);
+        g_array_append_val (series->prices, p);
+        return TRUE;
+    }
+
+    slot = price_series_find_slot (series, p);
+    g_array_insert_val (series->times, slot, t);
+    g_array_insert_val (series->prices, slot, p);
+    return TRUE;
+}
+
+/* Drop p from the series and return the reference the series held on
+ * it.  Returns FALSE if p is not in the series. */
+static gboolean
+price_series_remove (PriceSeries *series, GNCPrice *p)
+{
+    Timespec t = gnc_price_get_time (p);
+    guint i;
+
+    price_series_sort (series);
+    for (i = price_series_find_before (series, t);
+            i < series->prices->len &&
+            timespec_equal (&SERIES_TIME (series, i), &t); i++)
+        if (SERIES_PRICE (series, i) == p)
+            break;
+
+    /* The time was changed behind our back; fall back to a scan. */
+    if (i >= series->prices->len || SERIES_PRICE (series, i) != p)
+        for (i = 0; i < series->prices->len; i++)
+            if (SERIES_PRICE (series, i) == p)
+                break;
+    if (i >= series->prices->len)
+        return FALSE;
+
+    g_array_remove_index (series->times, i);
+    g_array_remove_index (series->prices, i);
+    gnc_price_unref (p);
+    return TRUE;
+}
+
+/* Return a price list of the series.  The caller owns the list, but
+ * not references to the prices in it. */
+static GList *
+price_series_to_list (PriceSeries *series)
+{
+    GList *result = NULL;
+    guint i;
+
+    price_series_sort (series);
+    for (i = series->prices->len; i > 0; i--)
+        result = g_list_prepend (result, SERIES_PRICE (series, i - 1));
+    return result;
+}
+
+/* Return the prices at time t, or on the same day as t if whole_day
+ * is set, in which case t must already be a canonical day time.  The
+ * list is oldest first and holds no references. */
+static GList *
+price_series_lookup (PriceSeries *series, Timespec t, gboolean whole_day)
+{
+    Timespec first = t, last = t;
+    GList *result = NULL;
+    guint i;
+
+    price_series_sort (series);
+    if (whole_day)
+    {
+        first.tv_sec += PRICE_DAY_WINDOW;
+        last.tv_sec -= PRICE_DAY_WINDOW;
+    }
+    for (i = price_series_find_before (series, first);
+            i < series->prices->len; i++)
+    {
+        Timespec price_time = SERIES_TIME (series, i);
+
+        if (timespec_cmp (&price_time, &last) < 0)
+            break;
+        if (whole_day)
+            price_time = timespecCanonicalDayTime (price_time);
+        if (timespec_equal (&price_time, &t))
+            result = g_list_prepend (result, SERIES_PRICE (series, i));
+    }
+    return result;
+}
+
+/* Return the price nearest to t.  On a tie the older price wins
+ * unless prefer_newer is set. */
+static GNCPrice *
+price_series_nearest (PriceSeries *series, Timespec t, gboolean prefer_newer)
+{
+    Timespec current_t, next_t, diff_current, diff_next;
+    Timespec abs_current, abs_next;
+    guint len = series->prices->len;
+    guint i;
+    gint cmp;
+
+    if (len == 0) return NULL;
+    price_series_sort (series);
+    i = price_series_find_before (series, t);
+    if (i == len) return SERIES_PRICE (series, len - 1);
+    if (i == 0) return SERIES_PRICE (series, 0);
+
+    current_t = SERIES_TIME (series, i - 1);
+    next_t = SERIES_TIME (series, i);
+    diff_current = timespec_diff (&current_t, &t);
+    diff_next = timespec_diff (&next_t, &t);
+    abs_current = timespec_abs (&diff_current);
+    abs_next = timespec_abs (&diff_next);
+    cmp = timespec_cmp (&abs_current, &abs_next);
+    if (cmp < 0 || (cmp == 0 && prefer_newer))
+        return SERIES_PRICE (series, i - 1);
+    return SERIES_PRICE (series, i);
+}
+
+/* Return the most recent price at or before t, or NULL. */
+static GNCPrice *
+price_series_latest_before (PriceSeries *series, Timespec t)
+{
+    guint i;
+
+    price_series_sort (series);
+    i = price_series_find_before (series, t);
+    return i < series->prices->len ? SERIES_PRICE (series, i) : NULL;
+}
+
 /* ==================================================================== */
 /* GNCPriceDB functions
 
    Structurally a GNCPriceDB contains a hash mapping price commodities
    (of type gnc_commodity*) to hashes mapping price currencies (of
-   type gnc_commodity*) to GNCPrice lists (see gnc-pricedb.h for a
-   description of GNCPrice lists).  The top-level key is the commodity
-   you want the prices for, and the second level key is the commodity
-   that the value is expressed in terms of.
+   type gnc_commodity*) to price series (see above).  The top-level
+   key is the commodity you want the prices for, and the second level
+   key is the commodity that the value is expressed in terms of.
  */
 
 /* GObject Initialization */
@@ -786,18 +1070,13 @@ destroy_pricedb_currency_hash_data(gpointer key,
                                    gpointer data,
                                    gpointer user_data)
 {
-    GList *price_list = (GList *) data;
-    GList *node;
-    GNCPrice *p;
+    PriceSeries *series = (PriceSeries *) data;
+    guint i;
 
-    for (node = price_list; node; node = node->next)
-    {
-        p = node->data;
-
-        p->db = NULL;
-    }
+    for (i = 0; i < series->prices->len; i++)
+        SERIES_PRICE (series, i)->db = NULL;
 
-    gnc_price_list_destroy(price_list);
+    price_series_free (series);
 }
 
 static void
@@ -825,14 +1104,37 @@ gnc_pricedb_destroy(GNCPriceDB *db)
     }
     g_hash_table_destroy (db->commodity_hash);
     db->commodity_hash = NULL;
+    if (db->rate_cache)
+        g_hash_table_destroy (db->rate_cache);
+    db->rate_cache = NULL;
     /* qof_instance_release (&db->inst); */
     g_object_unref(db);
 }
 
+static void
+sort_pricedb_currency_hash_data(gpointer key, gpointer data,
+                                gpointer user_data)
+{
+    price_series_sort ((PriceSeries *) data);
+}
+
+static void
+sort_pricedb_commodity_hash_data(gpointer key, gpointer data,
+                                 gpointer user_data)
+{
+    g_hash_table_foreach ((GHashTable *) data,
+                          sort_pricedb_currency_hash_data, NULL);
+}
+
 void
 gnc_pricedb_set_bulk_update(GNCPriceDB *db, gboolean bulk_update)
 {
     db->bulk_update = bulk_update;
+
+    /* Sort everything the bulk load appended in one go. */
+    if (!bulk_update && db->commodity_hash)
+        g_hash_table_foreach (db->commodity_hash,
+                              sort_pricedb_commodity_hash_data, NULL);
 }
 
 /* ==================================================================== */
@@ -907,7 +1209,7 @@ pricedb_equal_foreach_pricelist(gpointer key, gpointer val, gpointer user_data)
 {
     GNCPriceDBEqualData *equal_data = user_data;
     gnc_commodity *currency = key;
-    GList *price_list1 = val;
+    GList *price_list1 = price_series_to_list (val);
     GList *price_list2;
 
     price_list2 = gnc_pricedb_get_prices (equal_data->db2,
@@ -917,6 +1219,7 @@ pricedb_equal_foreach_pricelist(gpointer key, gpointer val, gpointer user_data)
     if (!gnc_price_list_equal (price_list1, price_list2))
         equal_data->equal = FALSE;
 
+    g_list_free (price_list1);
     gnc_price_list_destroy (price_list2);
 }
 
@@ -966,7 +1269,7 @@ add_price(GNCPriceDB *db, GNCPrice *p)
 {
     /* This function will use p, adding a ref, so treat p as read-only
        if this function succeeds. */
-    GList *price_list;
+    PriceSeries *series;
     gnc_commodity *commodity;
     gnc_commodity *currency;
     GHashTable *currency_hash;
@@ -1010,18 +1313,20 @@ add_price(GNCPriceDB *db, GNCPrice *p)
         g_hash_table_insert(db->commodity_hash, commodity, currency_hash);
     }
 
-    price_list = g_hash_table_lookup(currency_hash, currency);
-    if (!gnc_price_list_insert(&price_list, p, !db->bulk_update))
+    series = g_hash_table_lookup(currency_hash, currency);
+    if (!series)
     {
-        LEAVE ("gnc_price_list_insert failed");
-        return FALSE;
+        series = price_series_new ();
+        g_hash_table_insert(currency_hash, currency, series);
     }
-    if (!price_list)
+    if (!price_series_insert (series, p, !db->bulk_update))
     {
-        LEAVE (" no price list");
-        return FALSE;
+        /* The database already has this price, and holds no reference
+         * to the duplicate, so it mustn't claim it either. */
+        LEAVE ("duplicate price dropped");
+        return TRUE;
     }
-    g_hash_table_insert(currency_hash, currency, price_list);
+    pricedb_rate_cache_clear (db);
     p->db = db;
     qof_event_gen (&p->inst, QOF_EVENT_ADD, NULL);
 
@@ -1069,7 +1374,7 @@ gnc_pricedb_add_price(GNCPriceDB *db, GNCPrice *p)
 static gboolean
 remove_price(GNCPriceDB *db, GNCPrice *p, gboolean cleanup)
 {
-    GList *price_list;
+    PriceSeries *series;
     gnc_commodity *commodity;
     gnc_commodity *currency;
     GHashTable *currency_hash;
@@ -1105,24 +1410,22 @@ remove_price(GNCPriceDB *db, GNCPrice *p, gboolean cleanup)
     }
 
     qof_event_gen (&p->inst, QOF_EVENT_REMOVE, NULL);
-    price_list = g_hash_table_lookup(currency_hash, currency);
-    gnc_price_ref(p);
-    if (!gnc_price_list_remove(&price_list, p))
+    series = g_hash_table_lookup(currency_hash, currency);
+    if (!series)
     {
-        gnc_price_unref(p);
-        LEAVE (" cannot remove price list");
-        return FALSE;
+        LEAVE (" no price series");
+        return TRUE;
     }
+    gnc_price_ref(p);
+    price_series_remove (series, p);
+    pricedb_rate_cache_clear (db);
 
-    /* if the price list is empty, then remove this currency from the
+    /* if the price series is empty, then remove this currency from the
        commodity hash */
-    if (price_list)
-    {
-        g_hash_table_insert(currency_hash, currency, price_list);
-    }
-    else
+    if (series->prices->len == 0)
     {
         g_hash_table_remove(currency_hash, currency);
+        price_series_free (series);
 
         if (cleanup)
         {
@@ -1217,18 +1520,20 @@ pricedb_remove_foreach_pricelist (gpointer key,
                                   gpointer val,
                                   gpointer user_data)
 {
-    GList *price_list = (GList *) val;
-    GList *node = price_list;
+    PriceSeries *series = (PriceSeries *) val;
     remove_info *data = (remove_info *) user_data;
+    guint i = 0;
 
     ENTER("key %p, value %p, data %p", key, val, user_data);
 
-    /* The most recent price is the first in the list */
+    /* The most recent price is the first in the series */
+    price_series_sort (series);
     if (!data->delete_last)
-        node = g_list_next(node);
+        i = 1;
 
-    /* now check each item in the list */
-    g_list_foreach(node, (GFunc)check_one_price_date, data);
+    /* now check each item in the series */
+    for (; i < series->prices->len; i++)
+        check_one_price_date (SERIES_PRICE (series, i), data);
 
     LEAVE(" ");
 }
@@ -1297,7 +1602,7 @@ gnc_pricedb_lookup_latest(GNCPriceDB *db,
                           const gnc_commodity *commodity,
                           const gnc_commodity *currency)
 {
-    GList *price_list;
+    PriceSeries *series;
     GNCPrice *result;
     GHashTable *currency_hash;
     QofBook *book;
@@ -1326,17 +1631,18 @@ gnc_pricedb_lookup_latest(GNCPriceDB *db,
         return NULL;
     }
 
-    price_list = g_hash_table_lookup(currency_hash, currency);
-    if (!price_list)
+    series = g_hash_table_lookup(currency_hash, currency);
+    if (!series)
     {
         LEAVE (" no price list");
         return NULL;
     }
 
-    /* This works magically because prices are inserted in date-sorted
+    /* This works magically because prices are kept in date-sorted
      * order, and the latest date always comes first. So return the
-     * first in the list.  */
-    result = price_list->data;
+     * first in the series.  */
+    price_series_sort (series);
+    result = SERIES_PRICE (series, 0);
     gnc_price_ref(result);
     LEAVE(" ");
     return result;
@@ -1347,13 +1653,14 @@ static void
 lookup_latest(gpointer key, gpointer val, gpointer user_data)
 {
     //gnc_commodity *currency = (gnc_commodity *)key;
-    GList *price_list = (GList *)val;
+    PriceSeries *series = (PriceSeries *)val;
     GList **return_list = (GList **)user_data;
 
-    if (!price_list) return;
+    if (!series) return;
 
-    /* the latest price is the first in list */
-    gnc_price_list_insert(return_list, price_list->data, FALSE);
+    /* the latest price is the first in the series */
+    price_series_sort (series);
+    gnc_price_list_insert(return_list, SERIES_PRICE (series, 0), FALSE);
 }
 
 PriceList *
@@ -1408,7 +1715,7 @@ static void
 hash_values_helper(gpointer key, gpointer value, gpointer data)
 {
     GList ** l = data;
-    *l = g_list_concat(*l, g_list_copy (value));
+    *l = g_list_concat(*l, price_series_to_list (value));
 }
 
 gboolean
@@ -1416,7 +1723,7 @@ gnc_pricedb_has_prices(GNCPriceDB *db,
                        const gnc_commodity *commodity,
                        const gnc_commodity *currency)
 {
-    GList *price_list;
+    PriceSeries *series;
     GHashTable *currency_hash;
     gint size;
     QofBook *book;
@@ -1446,8 +1753,8 @@ gnc_pricedb_has_prices(GNCPriceDB *db,
 
     if (currency)
     {
-        price_list = g_hash_table_lookup(currency_hash, currency);
-        if (price_list)
+        series = g_hash_table_lookup(currency_hash, currency);
+        if (series)
         {
             LEAVE("yes");
             return TRUE;
@@ -1467,7 +1774,7 @@ gnc_pricedb_get_prices(GNCPriceDB *db,
                        const gnc_commodity *commodity,
                        const gnc_commodity *currency)
 {
-    GList *price_list;
+    PriceSeries *series;
     GList *result;
     GList *node;
     GHashTable *currency_hash;
@@ -1498,13 +1805,13 @@ gnc_pricedb_get_prices(GNCPriceDB *db,
 
     if (currency)
     {
-        price_list = g_hash_table_lookup(currency_hash, currency);
-        if (!price_list)
+        series = g_hash_table_lookup(currency_hash, currency);
+        if (!series)
         {
             LEAVE (" no price list");
             return NULL;
         }
-        result = g_list_copy (price_list);
+        result = price_series_to_list (series);
     }
     else
     {
@@ -1525,7 +1832,7 @@ gnc_pricedb_lookup_day(GNCPriceDB *db,
                        const gnc_commodity *currency,
                        Timespec t)
 {
-    GList *price_list;
+    PriceSeries *series;
     GList *result = NULL;
     GList *item = NULL;
     GHashTable *currency_hash;
@@ -1557,25 +1864,16 @@ gnc_pricedb_lookup_day(GNCPriceDB *db,
         return NULL;
     }
 
-    price_list = g_hash_table_lookup(currency_hash, currency);
-    if (!price_list)
+    series = g_hash_table_lookup(currency_hash, currency);
+    if (!series)
     {
         LEAVE (" no price list");
         return NULL;
     }
 
-    item = price_list;
-    while (item)
-    {
-        GNCPrice *p = item->data;
-        Timespec price_time = timespecCanonicalDayTime(gnc_price_get_time(p));
-        if (timespec_equal(&price_time, &t))
-        {
-            result = g_list_prepend(result, p);
-            gnc_price_ref(p);
-        }
-        item = item->next;
-    }
+    result = price_series_lookup (series, t, TRUE);
+    for (item = result; item; item = item->next)
+        gnc_price_ref (item->data);
     LEAVE (" ");
     return result;
 }
@@ -1585,23 +1883,15 @@ static void
 lookup_day(gpointer key, gpointer val, gpointer user_data)
 {
     //gnc_commodity *currency = (gnc_commodity *)key;
-    GList *price_list = (GList *)val;
-    GList *item = NULL;
+    PriceSeries *series = (PriceSeries *)val;
+    GList *found, *item;
     GNCPriceLookupHelper *lookup_helper = (GNCPriceLookupHelper *)user_data;
     GList **return_list = lookup_helper->return_list;
-    Timespec t = lookup_helper->time;
 
-    item = price_list;
-    while (item)
-    {
-        GNCPrice *p = item->data;
-        Timespec price_time = timespecCanonicalDayTime(gnc_price_get_time(p));
-        if (timespec_equal(&price_time, &t))
-        {
-            gnc_price_list_insert(return_list, item->data, FALSE);
-        }
-        item = item->next;
-    }
+    found = price_series_lookup (series, lookup_helper->time, TRUE);
+    for (item = found; item; item = item->next)
+        gnc_price_list_insert(return_list, item->data, FALSE);
+    g_list_free (found);
 }
 
 PriceList *
@@ -1663,7 +1953,7 @@ gnc_pricedb_lookup_at_time(GNCPriceDB *db,
                            const gnc_commodity *currency,
                            Timespec t)
 {
-    GList *price_list;
+    PriceSeries *series;
     GList *result = NULL;
     GList *item = NULL;
     GHashTable *currency_hash;
@@ -1693,25 +1983,16 @@ gnc_pricedb_lookup_at_time(GNCPriceDB *db,
         return NULL;
     }
 
-    price_list = g_hash_table_lookup(currency_hash, currency);
-    if (!price_list)
+    series = g_hash_table_lookup(currency_hash, currency);
+    if (!series)
     {
         LEAVE (" no price list");
         return NULL;
     }
 
-    item = price_list;
-    while (item)
-    {
-        GNCPrice *p = item->data;
-        Timespec price_time = gnc_price_get_time(p);
-        if (timespec_equal(&price_time, &t))
-        {
-            result = g_list_prepend(result, p);
-            gnc_price_ref(p);
-        }
-        item = item->next;
-    }
+    result = price_series_lookup (series, t, FALSE);
+    for (item = result; item; item = item->next)
+        gnc_price_ref (item->data);
     LEAVE (" ");
     return result;
 }
@@ -1720,23 +2001,15 @@ static void
 lookup_time(gpointer key, gpointer val, gpointer user_data)
 {
     //gnc_commodity *currency = (gnc_commodity *)key;
-    GList *price_list = (GList *)val;
-    GList *item = NULL;
+    PriceSeries *series = (PriceSeries *)val;
+    GList *found, *item;
     GNCPriceLookupHelper *lookup_helper = (GNCPriceLookupHelper *)user_data;
     GList **return_list = lookup_helper->return_list;
-    Timespec t = lookup_helper->time;
 
-    item = price_list;
-    while (item)
-    {
-        GNCPrice *p = item->data;
-        Timespec price_time = gnc_price_get_time(p);
-        if (timespec_equal(&price_time, &t))
-        {
-            gnc_price_list_insert(return_list, item->data, FALSE);
-        }
-        item = item->next;
-    }
+    found = price_series_lookup (series, lookup_helper->time, FALSE);
+    for (item = found; item; item = item->next)
+        gnc_price_list_insert(return_list, item->data, FALSE);
+    g_list_free (found);
 }
 
 PriceList *
@@ -1796,11 +2069,8 @@ gnc_pricedb_lookup_nearest_in_time(GNCPriceDB *db,
                                    const gnc_commodity *currency,
                                    Timespec t)
 {
-    GList *price_list;
-    GNCPrice *current_price = NULL;
-    GNCPrice *next_price = NULL;
-    GNCPrice *result = NULL;
-    GList *item = NULL;
+    PriceSeries *series;
+    GNCPrice *result;
     GHashTable *currency_hash;
     QofBook *book;
     QofBackend *be;
@@ -1828,62 +2098,17 @@ gnc_pricedb_lookup_nearest_in_time(GNCPriceDB *db,
         return NULL;
     }
 
-    price_list = g_hash_table_lookup(currency_hash, currency);
-    if (!price_list)
+    series = g_hash_table_lookup(currency_hash, currency);
+    if (!series)
     {
         LEAVE ("no price list");
         return NULL;
     }
 
-    item = price_list;
-
-    /* default answer */
-    current_price = item->data;
-
-    /* find the first candidate past the one we want.  Remember that
-       prices are in most-recent-first order. */
-    while (!next_price && item)
-    {
-        GNCPrice *p = item->data;
-        Timespec price_time = gnc_price_get_time(p);
-        if (timespec_cmp(&price_time, &t) <= 0)
-        {
-            next_price = item->data;
-            break;
-        }
-        current_price = item->data;
-        item = item->next;
-    }
-
-    if (current_price)
-    {
-        if (!next_price)
-        {
-            result = current_price;
-        }
-        else
-        {
-            Timespec current_t = gnc_price_get_time(current_price);
-            Timespec next_t = gnc_price_get_time(next_price);
-            Timespec diff_current = timespec_diff(&current_t, &t);
-            Timespec diff_next = timespec_diff(&next_t, &t);
-            Timespec abs_current = timespec_abs(&diff_current);
-            Timespec abs_next = timespec_abs(&diff_next);
-
-            /* Choose the price that is closest to the given time. In case of
-             * a tie, prefer the older price since it actually existed at the
-             * time. (This also fixes bug #541970.) */
-            if (timespec_cmp(&abs_current, &abs_next) < 0)
-            {
-                result = current_price;
-            }
-            else
-            {
-                result = next_price;
-            }
-        }
-    }
-
+    /* Choose the price that is closest to the given time. In case of
+     * a tie, prefer the older price since it actually existed at the
+     * time. (This also fixes bug #541970.) */
+    result = price_series_nearest (series, t, FALSE);
     gnc_price_ref(result);
     LEAVE (" ");
     return result;
@@ -1895,15 +2120,11 @@ gnc_pricedb_lookup_latest_before (GNCPriceDB *db,
                                   gnc_commodity *currency,
                                   Timespec t)
 {
-    GList *price_list;
-    GNCPrice *current_price = NULL;
-    /*  GNCPrice *next_price = NULL;
-        GNCPrice *result = NULL;*/
-    GList *item = NULL;
+    PriceSeries *series;
+    GNCPrice *current_price;
     GHashTable *currency_hash;
     QofBook *book;
     QofBackend *be;
-    Timespec price_time;
 
     if (!db || !c || !currency) return NULL;
     ENTER ("db=%p commodity=%p currency=%p", db, c, currency);
@@ -1928,22 +2149,14 @@ gnc_pricedb_lookup_latest_before (GNCPriceDB *db,
         return NULL;
     }
 
-    price_list = g_hash_table_lookup(currency_hash, currency);
-    if (!price_list)
+    series = g_hash_table_lookup(currency_hash, currency);
+    if (!series)
     {
         LEAVE ("no price list");
         return NULL;
     }
 
-    item = price_list;
-    do
-    {
-        price_time = gnc_price_get_time (item->data);
-        if (timespec_cmp(&price_time, &t) <= 0)
-            current_price = item->data;
-        item = item->next;
-    }
-    while (timespec_cmp(&price_time, &t) > 0 && item);
+    current_price = price_series_latest_before (series, t);
     gnc_price_ref(current_price);
     LEAVE (" ");
     return current_price;
@@ -1954,61 +2167,12 @@ static void
 lookup_nearest(gpointer key, gpointer val, gpointer user_data)
 {
     //gnc_commodity *currency = (gnc_commodity *)key;
-    GList *price_list = (GList *)val;
-    GNCPrice *current_price = NULL;
-    GNCPrice *next_price = NULL;
-    GNCPrice *result = NULL;
-    GList *item = NULL;
+    PriceSeries *series = (PriceSeries *)val;
     GNCPriceLookupHelper *lookup_helper = (GNCPriceLookupHelper *)user_data;
     GList **return_list = lookup_helper->return_list;
-    Timespec t = lookup_helper->time;
-
-    item = price_list;
-
-    /* default answer */
-    current_price = item->data;
-
-    /* find the first candidate past the one we want.  Remember that
-       prices are in most-recent-first order. */
-    while (!next_price && item)
-    {
-        GNCPrice *p = item->data;
-        Timespec price_time = gnc_price_get_time(p);
-        if (timespec_cmp(&price_time, &t) <= 0)
-        {
-            next_price = item->data;
-            break;
-        }
-        current_price = item->data;
-        item = item->next;
-    }
-
-    if (current_price)
-    {
-        if (!next_price)
-        {
-            result = current_price;
-        }
-        else
-        {
-            Timespec current_t = gnc_price_get_time(current_price);
-            Timespec next_t = gnc_price_get_time(next_price);
-            Timespec diff_current = timespec_diff(&current_t, &t);
-            Timespec diff_next = timespec_diff(&next_t, &t);
-            Timespec abs_current = timespec_abs(&diff_current);
-            Timespec abs_next = timespec_abs(&diff_next);
-
-            if (timespec_cmp(&abs_current, &abs_next) <= 0)
-            {
-                result = current_price;
-            }
-            else
-            {
-                result = next_price;
-            }
-        }
-    }
+    GNCPrice *result;
 
+    result = price_series_nearest (series, lookup_helper->time, TRUE);
     gnc_price_list_insert(return_list, result, FALSE);
 }
 
@@ -2017,28 +2181,13 @@ static void
 lookup_latest_before(gpointer key, gpointer val, gpointer user_data)
 {
     //gnc_commodity *currency = (gnc_commodity *)key;
-    GList *price_list = (GList *)val;
-    GNCPrice *current_price = NULL;
-    /*  GNCPrice *next_price = NULL;
-        GNCPrice *result = NULL;*/
-    GList *item = NULL;
+    PriceSeries *series = (PriceSeries *)val;
     GNCPriceLookupHelper *lookup_helper = (GNCPriceLookupHelper *)user_data;
     GList **return_list = lookup_helper->return_list;
-    Timespec t = lookup_helper->time;
-    Timespec price_time;
+    GNCPrice *current_price = NULL;
 
-    if (price_list)
-    {
-        item = price_list;
-        do
-        {
-            price_time = gnc_price_get_time (item->data);
-            if (timespec_cmp(&price_time, &t) <= 0)
-                current_price = item->data;
-            item = item->next;
-        }
-        while (timespec_cmp(&price_time, &t) > 0 && item);
-    }
+    if (series)
+        current_price = price_series_latest_before (series, lookup_helper->time);
 
     gnc_price_list_insert(return_list, current_price, FALSE);
 }
@@ -2146,155 +2295,155 @@ gnc_pricedb_lookup_latest_before_any_currency(GNCPriceDB *db,
 }
 
 
-/*
- * Convert a balance from one currency to another.
+/* ==================================================================== */
+/* balance conversion
+
+   Converting a balance looks for a direct price, then for the inverse
+   price, and finally for a two stage conversion through some other
+   currency.  Reports ask for the same conversions over and over, one
+   per account, so the outcome of that search is remembered in a cache
+   keyed by (from, to, kind of lookup, time).  A cached rate records
+   which path was taken and the price values along it, so the balance
+   arithmetic, and with it the rounding, is exactly what it would be
+   without the cache.  Adding or removing a price, or changing its
+   value, flushes the whole cache.
  */
-gnc_numeric
-gnc_pricedb_convert_balance_latest_price(GNCPriceDB *pdb,
-        gnc_numeric balance,
-        const gnc_commodity *balance_currency,
-        const gnc_commodity *new_currency)
+
+typedef enum
 {
-    GNCPrice *price, *currency_price;
-    GList *price_list, *list_helper;
-    gnc_numeric currency_price_value;
-    gnc_commodity *intermediate_currency;
+    CONVERT_LATEST,
+    CONVERT_NEAREST,
+    CONVERT_LATEST_BEFORE
+} PriceConvertType;
 
-    if (gnc_numeric_zero_p (balance) ||
-            gnc_commodity_equiv (balance_currency, new_currency))
-        return balance;
+typedef enum
+{
+    RATE_NONE,                  /* no path found */
+    RATE_DIRECT,                /* balance * rate */
+    RATE_INVERSE,               /* balance / rate */
+    RATE_TWO_HOP                /* balance * cross_rate * rate */
+} PriceRateKind;
 
-    /* Look for a direct price. */
-    price = gnc_pricedb_lookup_latest (pdb, balance_currency, new_currency);
-    if (price)
-    {
-        balance = gnc_numeric_mul (balance, gnc_price_get_value (price),
-                                   gnc_commodity_get_fraction (new_currency),
-                                   GNC_HOW_RND_ROUND_HALF_UP);
-        gnc_price_unref (price);
-        return balance;
-    }
+typedef struct
+{
+    const gnc_commodity *from;
+    const gnc_commodity *to;
+    Timespec t;
+    PriceConvertType type;
 
-    /* Look for a price of the new currency in the balance currency and use
-     * the reciprocal if we find it
-     */
-    price = gnc_pricedb_lookup_latest (pdb, new_currency, balance_currency);
-    if (price)
-    {
-        balance = gnc_numeric_div (balance, gnc_price_get_value (price),
-                                   gnc_commodity_get_fraction (new_currency),
-                                   GNC_HOW_RND_ROUND_HALF_UP);
-        gnc_price_unref (price);
-        return balance;
-    }
+    PriceRateKind kind;
+    gnc_numeric rate;
+    gnc_numeric cross_rate;
+} PriceRate;
 
-    /*
-     * no direct price found, try if we find a price in another currency
-     * and convert in two stages
-     */
-    price_list = gnc_pricedb_lookup_latest_any_currency(pdb, balance_currency);
-    if (!price_list)
-    {
-        balance =  gnc_numeric_zero ();
-        return balance;
-    }
+/* Flush the whole cache rather than let it grow without bound. */
+#define RATE_CACHE_MAX_ENTRIES 65536
 
-    list_helper = price_list;
-    currency_price_value = gnc_numeric_zero();
+static guint
+price_rate_hash (gconstpointer key)
+{
+    const PriceRate *r = key;
 
-    do
-    {
-        price = (GNCPrice *)(list_helper->data);
+    return g_direct_hash (r->from) ^ (g_direct_hash (r->to) * 31) ^
+           ((guint) r->t.tv_sec * 7) ^ (guint) r->type;
+}
 
-        intermediate_currency = gnc_price_get_currency(price);
-        currency_price = gnc_pricedb_lookup_latest(pdb, intermediate_currency,
-                         new_currency);
-        if (currency_price)
-        {
-            currency_price_value = gnc_price_get_value(currency_price);
-            gnc_price_unref(currency_price);
-        }
-        else
-        {
-            currency_price = gnc_pricedb_lookup_latest(pdb, new_currency,
-                             intermediate_currency);
-            if (currency_price)
-            {
-                /* here we need the reciprocal */
-                currency_price_value = gnc_numeric_div(gnc_numeric_create(1, 1),
-                                                       gnc_price_get_value(currency_price),
-                                                       GNC_DENOM_AUTO,
-                                                       GNC_HOW_DENOM_EXACT | GNC_HOW_RND_NEVER);
-                gnc_price_unref(currency_price);
-            }
-        }
+static gboolean
+price_rate_equal (gconstpointer a, gconstpointer b)
+{
+    const PriceRate *ra = a, *rb = b;
 
-        list_helper = list_helper->next;
-    }
-    while ((list_helper != NULL) &&
-            (gnc_numeric_zero_p(currency_price_value)));
+    return ra->from == rb->from && ra->to == rb->to &&
+           ra->type == rb->type && timespec_equal (&ra->t, &rb->t);
+}
 
-    balance = gnc_numeric_mul (balance, currency_price_value,
-                               GNC_DENOM_AUTO,
-                               GNC_HOW_DENOM_EXACT | GNC_HOW_RND_NEVER);
-    balance = gnc_numeric_mul (balance, gnc_price_get_value (price),
-                               gnc_commodity_get_fraction (new_currency),
-                               GNC_HOW_RND_ROUND_HALF_UP);
+static void
+price_rate_free (gpointer data)
+{
+    g_slice_free (PriceRate, data);
+}
 
-    gnc_price_list_destroy(price_list);
-    return balance;
+static void
+pricedb_rate_cache_clear (GNCPriceDB *db)
+{
+    if (db && db->rate_cache && g_hash_table_size (db->rate_cache) > 0)
+        g_hash_table_remove_all (db->rate_cache);
 }
 
-gnc_numeric
-gnc_pricedb_convert_balance_nearest_price(GNCPriceDB *pdb,
-        gnc_numeric balance,
-        const gnc_commodity *balance_currency,
-        const gnc_commodity *new_currency,
-        Timespec t)
+static GNCPrice *
+rate_lookup (GNCPriceDB *pdb, PriceConvertType type,
+             const gnc_commodity *c, const gnc_commodity *currency,
+             Timespec t)
+{
+    switch (type)
+    {
+    case CONVERT_LATEST:
+        return gnc_pricedb_lookup_latest (pdb, c, currency);
+    case CONVERT_NEAREST:
+        return gnc_pricedb_lookup_nearest_in_time (pdb, c, currency, t);
+    case CONVERT_LATEST_BEFORE:
+    default:
+        return gnc_pricedb_lookup_latest_before (pdb, (gnc_commodity *) c,
+                (gnc_commodity *) currency, t);
+    }
+}
+
+static PriceList *
+rate_lookup_any_currency (GNCPriceDB *pdb, PriceConvertType type,
+                          const gnc_commodity *c, Timespec t)
+{
+    switch (type)
+    {
+    case CONVERT_LATEST:
+        return gnc_pricedb_lookup_latest_any_currency (pdb, c);
+    case CONVERT_NEAREST:
+        return gnc_pricedb_lookup_nearest_in_time_any_currency (pdb, c, t);
+    case CONVERT_LATEST_BEFORE:
+    default:
+        return gnc_pricedb_lookup_latest_before_any_currency (pdb,
+                (gnc_commodity *) c, t);
+    }
+}
+
+static void
+price_rate_compute (GNCPriceDB *pdb, PriceRate *r)
 {
     GNCPrice *price, *currency_price;
     GList *price_list, *list_helper;
     gnc_numeric currency_price_value;
     gnc_commodity *intermediate_currency;
 
-    if (gnc_numeric_zero_p (balance) ||
-            gnc_commodity_equiv (balance_currency, new_currency))
-        return balance;
+    r->kind = RATE_NONE;
 
     /* Look for a direct price. */
-    price = gnc_pricedb_lookup_nearest_in_time (pdb, balance_currency, new_currency, t);
+    price = rate_lookup (pdb, r->type, r->from, r->to, r->t);
     if (price)
     {
-        balance = gnc_numeric_mul (balance, gnc_price_get_value (price),
-                                   gnc_commodity_get_fraction (new_currency),
-                                   GNC_HOW_RND_ROUND_HALF_UP);
+        r->kind = RATE_DIRECT;
+        r->rate = gnc_price_get_value (price);
         gnc_price_unref (price);
-        return balance;
+        return;
     }
 
     /* Look for a price of the new currency in the balance currency and use
      * the reciprocal if we find it
      */
-    price = gnc_pricedb_lookup_nearest_in_time (pdb, new_currency, balance_currency, t);
+    price = rate_lookup (pdb, r->type, r->to, r->from, r->t);
     if (price)
     {
-        balance = gnc_numeric_div (balance, gnc_price_get_value (price),
-                                   gnc_commodity_get_fraction (new_currency),
-                                   GNC_HOW_RND_ROUND_HALF_UP);
+        r->kind = RATE_INVERSE;
+        r->rate = gnc_price_get_value (price);
         gnc_price_unref (price);
-        return balance;
+        return;
     }
 
     /*
      * no direct price found, try if we find a price in another currency
      * and convert in two stages
      */
-    price_list = gnc_pricedb_lookup_nearest_in_time_any_currency(pdb, balance_currency, t);
+    price_list = rate_lookup_any_currency (pdb, r->type, r->from, r->t);
     if (!price_list)
-    {
-        balance =  gnc_numeric_zero ();
-        return balance;
-    }
+        return;
 
     list_helper = price_list;
     currency_price_value = gnc_numeric_zero();
@@ -2304,8 +2453,8 @@ gnc_pricedb_convert_balance_nearest_price(GNCPriceDB *pdb,
         price = (GNCPrice *)(list_helper->data);
 
         intermediate_currency = gnc_price_get_currency(price);
-        currency_price = gnc_pricedb_lookup_nearest_in_time(pdb, intermediate_currency,
-                         new_currency, t);
+        currency_price = rate_lookup (pdb, r->type, intermediate_currency,
+                                      r->to, r->t);
         if (currency_price)
         {
             currency_price_value = gnc_price_get_value(currency_price);
@@ -2313,15 +2462,27 @@ gnc_pricedb_convert_balance_nearest_price(GNCPriceDB *pdb,
         }
         else
         {
-            currency_price = gnc_pricedb_lookup_nearest_in_time(pdb, new_currency,
-                             intermediate_currency, t);
+            /* The latest-before conversion has always taken the
+             * reciprocal from the nearest price. */
+            currency_price = rate_lookup (pdb,
+                                          r->type == CONVERT_LATEST ?
+                                          CONVERT_LATEST : CONVERT_NEAREST,
+                                          r->to, intermediate_currency, r->t);
             if (currency_price)
             {
                 /* here we need the reciprocal */
-                currency_price_value = gnc_numeric_div(gnc_numeric_create(1, 1),
-                                                       gnc_price_get_value(currency_price),
-                                                       gnc_commodity_get_fraction (new_currency),
-                                                       GNC_HOW_RND_ROUND_HALF_UP);
+                if (r->type == CONVERT_LATEST)
+                    currency_price_value =
+                        gnc_numeric_div(gnc_numeric_create(1, 1),
+                                        gnc_price_get_value(currency_price),
+                                        GNC_DENOM_AUTO,
+                                        GNC_HOW_DENOM_EXACT | GNC_HOW_RND_NEVER);
+                else
+                    currency_price_value =
+                        gnc_numeric_div(gnc_numeric_create(1, 1),
+                                        gnc_price_get_value(currency_price),
+                                        gnc_commodity_get_fraction (r->to),
+                                        GNC_HOW_RND_ROUND_HALF_UP);
                 gnc_price_unref(currency_price);
             }
         }
@@ -2331,115 +2492,141 @@ gnc_pricedb_convert_balance_nearest_price(GNCPriceDB *pdb,
     while ((list_helper != NULL) &&
             (gnc_numeric_zero_p(currency_price_value)));
 
-    balance = gnc_numeric_mul (balance, currency_price_value,
-                               gnc_commodity_get_fraction (new_currency),
-                               GNC_HOW_RND_ROUND_HALF_UP);
-
-    balance = gnc_numeric_mul (balance, gnc_price_get_value (price),
-                               gnc_commodity_get_fraction (new_currency),
-                               GNC_HOW_RND_ROUND_HALF_UP);
+    r->kind = RATE_TWO_HOP;
+    r->cross_rate = currency_price_value;
+    r->rate = gnc_price_get_value (price);
 
     gnc_price_list_destroy(price_list);
-    return balance;
 }
 
-
-gnc_numeric
-gnc_pricedb_convert_balance_latest_before(GNCPriceDB *pdb,
-        gnc_numeric balance,
-        gnc_commodity *balance_currency,
-        gnc_commodity *new_currency,
-        Timespec t)
+/* Return the cached rate for the conversion, computing it if needed.
+ * The result belongs to the cache and is only good until the next
+ * change to the database. */
+static const PriceRate *
+pricedb_get_rate (GNCPriceDB *pdb, const gnc_commodity *from,
+                  const gnc_commodity *to, Timespec t,
+                  PriceConvertType type)
 {
-    GNCPrice *price, *currency_price;
-    GList *price_list, *list_helper;
-    gnc_numeric currency_price_value;
-    gnc_commodity *intermediate_currency;
+    PriceRate key, *r;
 
-    if (gnc_numeric_zero_p (balance) ||
-            gnc_commodity_equiv (balance_currency, new_currency))
-        return balance;
+    key.from = from;
+    key.to = to;
+    key.t = t;
+    key.type = type;
 
-    /* Look for a direct price. */
-    price = gnc_pricedb_lookup_latest_before (pdb, balance_currency, new_currency, t);
+    if (!pdb->rate_cache)
+        pdb->rate_cache = g_hash_table_new_full (price_rate_hash,
+                          price_rate_equal,
+                          price_rate_free, NULL);
 
-    if (price)
-    {
-        balance = gnc_numeric_mul (balance, gnc_price_get_value (price),
-                                   gnc_commodity_get_fraction (new_currency),
-                                   GNC_HOW_RND_ROUND_HALF_UP);
-        gnc_price_unref (price);
-        return balance;
-    }
+    r = g_hash_table_lookup (pdb->rate_cache, &key);
+    if (r) return r;
 
-    /* Look for a price of the new currency in the balance currency and use
-     * the reciprocal if we find it.
-     */
-    price = gnc_pricedb_lookup_latest_before (pdb, new_currency, balance_currency, t);
-    if (price)
-    {
-        balance = gnc_numeric_div (balance, gnc_price_get_value (price),
-                                   gnc_commodity_get_fraction (new_currency),
-                                   GNC_HOW_RND_ROUND_HALF_UP);
-        gnc_price_unref (price);
-        return balance;
-    }
+    if (g_hash_table_size (pdb->rate_cache) >= RATE_CACHE_MAX_ENTRIES)
+        g_hash_table_remove_all (pdb->rate_cache);
 
-    /*
-     * no direct price found, try if we find a price in another currency
-     * and convert in two stages
-     */
-    price_list = gnc_pricedb_lookup_latest_before_any_currency(pdb, balance_currency, t);
-    if (!price_list)
-    {
-        balance =  gnc_numeric_zero ();
+    r = g_slice_new (PriceRate);
+    *r = key;
+    price_rate_compute (pdb, r);
+    g_hash_table_insert (pdb->rate_cache, r, r);
+    return r;
+}
+
+static gnc_numeric
+convert_balance (GNCPriceDB *pdb, gnc_numeric balance,
+                 const gnc_commodity *balance_currency,
+                 const gnc_commodity *new_currency,
+                 Timespec t, PriceConvertType type)
+{
+    const PriceRate *r;
+    int fraction;
+
+    if (gnc_numeric_zero_p (balance) ||
+            gnc_commodity_equiv (balance_currency, new_currency))
         return balance;
+    if (!pdb)
+        return gnc_numeric_zero ();
+
+    r = pricedb_get_rate (pdb, balance_currency, new_currency, t, type);
+    fraction = gnc_commodity_get_fraction (new_currency);
+
+    switch (r->kind)
+    {
+    case RATE_DIRECT:
+        return gnc_numeric_mul (balance, r->rate, fraction,
+                                GNC_HOW_RND_ROUND_HALF_UP);
+    case RATE_INVERSE:
+        return gnc_numeric_div (balance, r->rate, fraction,
+                                GNC_HOW_RND_ROUND_HALF_UP);
+    case RATE_TWO_HOP:
+        if (type == CONVERT_LATEST)
+            balance = gnc_numeric_mul (balance, r->cross_rate,
+                                       GNC_DENOM_AUTO,
+                                       GNC_HOW_DENOM_EXACT | GNC_HOW_RND_NEVER);
+        else
+            balance = gnc_numeric_mul (balance, r->cross_rate, fraction,
+                                       GNC_HOW_RND_ROUND_HALF_UP);
+        return gnc_numeric_mul (balance, r->rate, fraction,
+                                GNC_HOW_RND_ROUND_HALF_UP);
+    case RATE_NONE:
+    default:
+        return gnc_numeric_zero ();
     }
+}
 
-    list_helper = price_list;
-    currency_price_value = gnc_numeric_zero();
+/*
+ * Convert a balance from one currency to another.
+ */
+gnc_numeric
+gnc_pricedb_convert_balance_latest_price(GNCPriceDB *pdb,
+        gnc_numeric balance,
+        const gnc_commodity *balance_currency,
+        const gnc_commodity *new_currency)
+{
+    Timespec t = {0, 0};
 
-    do
-    {
-        price = (GNCPrice *)(list_helper->data);
+    return convert_balance (pdb, balance, balance_currency, new_currency,
+                            t, CONVERT_LATEST);
+}
 
-        intermediate_currency = gnc_price_get_currency(price);
-        currency_price = gnc_pricedb_lookup_latest_before(pdb, intermediate_currency,
-                         new_currency, t);
-        if (currency_price)
-        {
-            currency_price_value = gnc_price_get_value(currency_price);
-            gnc_price_unref(currency_price);
-        }
-        else
-        {
-            currency_price = gnc_pricedb_lookup_nearest_in_time(pdb, new_currency,
-                             intermediate_currency, t);
-            if (currency_price)
-            {
-                /* here we need the reciprocal */
-                currency_price_value = gnc_numeric_div(gnc_numeric_create(1, 1),
-                                                       gnc_price_get_value(currency_price),
-                                                       gnc_commodity_get_fraction (new_currency),
-                                                       GNC_HOW_RND_ROUND_HALF_UP);
-                gnc_price_unref(currency_price);
-            }
-        }
+gnc_numeric
+gnc_pricedb_convert_balance_nearest_price(GNCPriceDB *pdb,
+        gnc_numeric balance,
+        const gnc_commodity *balance_currency,
+        const gnc_commodity *new_currency,
+        Timespec t)
+{
+    return convert_balance (pdb, balance, balance_currency, new_currency,
+                            t, CONVERT_NEAREST);
+}
 
-        list_helper = list_helper->next;
-    }
-    while ((list_helper != NULL) &&
-            (gnc_numeric_zero_p(currency_price_value)));
+gnc_numeric
+gnc_pricedb_convert_balance_latest_before(GNCPriceDB *pdb,
+        gnc_numeric balance,
+        gnc_commodity *balance_currency,
+        gnc_commodity *new_currency,
+        Timespec t)
+{
+    return convert_balance (pdb, balance, balance_currency, new_currency,
+                            t, CONVERT_LATEST_BEFORE);
+}
+
+void
+gnc_pricedb_convert_balances_nearest_price(GNCPriceDB *pdb,
+        guint n_balances,
+        const gnc_numeric *balances,
+        gnc_commodity **balance_currencies,
+        const Timespec *dates,
+        const gnc_commodity *new_currency,
+        gnc_numeric *results)
+{
+    guint i;
 
-    balance = gnc_numeric_mul (balance, currency_price_value,
-                               gnc_commodity_get_fraction (new_currency),
-                               GNC_HOW_RND_ROUND_HALF_UP);
-    balance = gnc_numeric_mul (balance, gnc_price_get_value (price),
-                               gnc_commodity_get_fraction (new_currency),
-                               GNC_HOW_RND_ROUND_HALF_UP);
+    g_return_if_fail (balances && balance_currencies && dates && results);
 
-    gnc_price_list_destroy(price_list);
-    return balance;
+    for (i = 0; i < n_balances; i++)
+        results[i] = convert_balance (pdb, balances[i], balance_currencies[i],
+                                      new_currency, dates[i], CONVERT_NEAREST);
 }
 
 
@@ -2458,16 +2645,16 @@ typedef struct
 static void
 pricedb_foreach_pricelist(gpointer key, gpointer val, gpointer user_data)
 {
-    GList *price_list = (GList *) val;
-    GList *node = price_list;
+    PriceSeries *series = (PriceSeries *) val;
     GNCPriceDBForeachData *foreach_data = (GNCPriceDBForeachData *) user_data;
+    guint i;
 
     /* stop traversal when func returns FALSE */
-    while (foreach_data->ok && node)
+    price_series_sort (series);
+    for (i = 0; foreach_data->ok && i < series->prices->len; i++)
     {
-        GNCPrice *p = (GNCPrice *) node->data;
+        GNCPrice *p = SERIES_PRICE (series, i);
         foreach_data->ok = foreach_data->func(p, foreach_data->user_data);
-        node = node->next;
     }
 }
 
@@ -2552,12 +2739,13 @@ stable_price_traversal(GNCPriceDB *db,
         for (j = price_lists; j; j = j->next)
         {
             GHashTableKVPair *pricelist_kvp = (GHashTableKVPair *) j->data;
-            GList *price_list = (GList *) pricelist_kvp->value;
-            GList *node;
+            PriceSeries *series = (PriceSeries *) pricelist_kvp->value;
+            guint k;
 
-            for (node = (GList *) price_list; node; node = node->next)
+            price_series_sort (series);
+            for (k = 0; k < series->prices->len; k++)
             {
-                GNCPrice *price = (GNCPrice *) node->data;
+                GNCPrice *price = SERIES_PRICE (series, k);
 
                 /* stop traversal when f returns FALSE */
                 if (FALSE == ok) break;
@@ -2779,16 +2967,13 @@ VoidGNCPriceDBForeachData;
 static void
 void_pricedb_foreach_pricelist(gpointer key, gpointer val, gpointer user_data)
 {
-    GList *price_list = (GList *) val;
-    GList *node = price_list;
+    PriceSeries *series = (PriceSeries *) val;
     VoidGNCPriceDBForeachData *foreach_data = (VoidGNCPriceDBForeachData *) user_data;
+    guint i;
 
-    while (node)
-    {
-        GNCPrice *p = (GNCPrice *) node->data;
-        foreach_data->func(p, foreach_data->user_data);
-        node = node->next;
-    }
+    price_series_sort (series);
+    for (i = 0; i < series->prices->len; i++)
+        foreach_data->func(SERIES_PRICE (series, i), foreach_data->user_data);
 }
 
 static void
@@ -422,6 +422,20 @@ gnc_pricedb_convert_balance_latest_before(GNCPriceDB *pdb,
         gnc_commodity *new_currency,
         Timespec t);
 
+/** gnc_pricedb_convert_balances_nearest_price - Convert n_balances
+    balances, each in its own commodity and as of its own date, to
+    new_currency.  Each one is converted as by
+    gnc_pricedb_convert_balance_nearest_price and the converted amount
+    is stored in the corresponding element of results. */
+void
+gnc_pricedb_convert_balances_nearest_price(GNCPriceDB *pdb,
+        guint n_balances,
+        const gnc_numeric *balances,
+        gnc_commodity **balance_currencies,
+        const Timespec *dates,
+        const gnc_commodity *new_currency,
+        gnc_numeric *results);
+
 
 /** gnc_pricedb_foreach_price - call f once for each price in db, until
      and unless f returns FALSE.  If stable_order is not FALSE, make
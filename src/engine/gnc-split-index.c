@@ -0,0 +1,419 @@
+/********************************************************************\
+ * gnc-split-index.c -- ordered index over an account's split list  *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+\********************************************************************/
+
+/*
+ * FILE:
+ * gnc-split-index.c
+ *
+ * FUNCTION:
+ * A skip list whose bottom level is the account's GList of splits.
+ * Every item has an entry in a hash table; roughly one item in four
+ * is also threaded onto one or more doubly linked "express lanes",
+ * with each lane holding about a quarter of the items of the lane
+ * below it.  Searches run along the top lane, drop down a lane when
+ * they would overshoot, and finish with a short walk along the GList.
+ *
+ * The express lanes are doubly linked so that an item can be
+ * unlinked without a search.  That matters because the engine lets
+ * split sort keys change while an account is sort-dirty; a search
+ * could then fail to find an item that is nevertheless present.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "gnc-split-index.h"
+
+/* With one item in four promoted to each next lane, twelve lanes
+ * comfortably cover sixteen million items. */
+#define SPLIT_INDEX_MAX_LANES 12
+
+typedef struct split_index_entry_s SplitIndexEntry;
+
+typedef struct
+{
+    SplitIndexEntry *next;
+    SplitIndexEntry *prev;
+} SplitIndexLane;
+
+struct split_index_entry_s
+{
+    GList *link;                /* node in the index's GList */
+    guint height;               /* number of express lanes used */
+    SplitIndexLane lanes[1];    /* really 'height' long */
+};
+
+struct gnc_split_index_s
+{
+    GList *list;
+    GList *last;
+    GHashTable *entries;        /* item -> SplitIndexEntry */
+    GCompareFunc order;
+
+    SplitIndexEntry *head;      /* sentinel on every lane */
+    guint lanes_used;
+    guint32 seed;
+};
+
+#define ENTRY_SIZE(h) \
+   (G_STRUCT_OFFSET(SplitIndexEntry, lanes) + (h) * sizeof(SplitIndexLane))
+
+/* ============================================================== */
+
+static SplitIndexEntry *
+entry_new (guint height)
+{
+    SplitIndexEntry *entry;
+
+    entry = g_slice_alloc0 (ENTRY_SIZE (MAX (height, 1)));
+    entry->height = height;
+    return entry;
+}
+
+static void
+entry_free (gpointer data)
+{
+    SplitIndexEntry *entry = data;
+    g_slice_free1 (ENTRY_SIZE (MAX (entry->height, 1)), entry);
+}
+
+/* Pick a lane count with P(h >= k) = 4^-k, using a private
+ * xorshift generator so that the index doesn't perturb g_random. */
+static guint
+random_height (GncSplitIndex *idx)
+{
+    guint32 r;
+    guint height = 0;
+
+    r = idx->seed;
+    r ^= r << 13;
+    r ^= r >> 17;
+    r ^= r << 5;
+    idx->seed = r;
+
+    while ((r & 3) == 0 && height < SPLIT_INDEX_MAX_LANES)
+    {
+        height++;
+        r >>= 2;
+    }
+    return height;
+}
+
+/* Walk down the express lanes towards 'key'.  With 'inclusive' the
+ * search passes items that compare equal to the key, otherwise it
+ * stops in front of them.  The last entry visited on each lane is
+ * stored in 'update', if given; the last entry overall is returned
+ * and may be the head sentinel. */
+static SplitIndexEntry *
+descend (const GncSplitIndex *idx, GCompareFunc cmp, gconstpointer key,
+         gboolean inclusive, SplitIndexEntry **update)
+{
+    SplitIndexEntry *x = idx->head;
+    gint i;
+
+    for (i = (gint)idx->lanes_used - 1; i >= 0; i--)
+    {
+        while (x->lanes[i].next)
+        {
+            gint rv = cmp (x->lanes[i].next->link->data, key);
+            if (rv > 0 || (rv == 0 && !inclusive))
+                break;
+            x = x->lanes[i].next;
+        }
+        if (update)
+            update[i] = x;
+    }
+    return x;
+}
+
+/* Finish a search along the GList, starting after the entry returned
+ * by descend().  Returns the last node that sorts before the key
+ * (NULL if none) and stores its successor in 'after'. */
+static GList *
+walk_list (const GncSplitIndex *idx, SplitIndexEntry *from,
+           GCompareFunc cmp, gconstpointer key, gboolean inclusive,
+           GList **after)
+{
+    GList *prev, *node;
+
+    prev = (from == idx->head) ? NULL : from->link;
+    node = prev ? prev->next : idx->list;
+    while (node)
+    {
+        gint rv = cmp (node->data, key);
+        if (rv > 0 || (rv == 0 && !inclusive))
+            break;
+        prev = node;
+        node = node->next;
+    }
+    if (after)
+        *after = node;
+    return prev;
+}
+
+static void
+link_lanes (GncSplitIndex *idx, SplitIndexEntry *entry,
+            SplitIndexEntry **update)
+{
+    guint i;
+
+    for (i = 0; i < entry->height; i++)
+    {
+        SplitIndexEntry *prev = (i < idx->lanes_used) ? update[i] : idx->head;
+
+        entry->lanes[i].prev = prev;
+        entry->lanes[i].next = prev->lanes[i].next;
+        if (entry->lanes[i].next)
+            entry->lanes[i].next->lanes[i].prev = entry;
+        prev->lanes[i].next = entry;
+    }
+    if (entry->height > idx->lanes_used)
+        idx->lanes_used = entry->height;
+}
+
+static void
+unlink_lanes (GncSplitIndex *idx, SplitIndexEntry *entry)
+{
+    guint i;
+
+    for (i = 0; i < entry->height; i++)
+    {
+        entry->lanes[i].prev->lanes[i].next = entry->lanes[i].next;
+        if (entry->lanes[i].next)
+            entry->lanes[i].next->lanes[i].prev = entry->lanes[i].prev;
+    }
+    while (idx->lanes_used > 0 &&
+            idx->head->lanes[idx->lanes_used - 1].next == NULL)
+        idx->lanes_used--;
+}
+
+/* ============================================================== */
+
+GncSplitIndex *
+gnc_split_index_new (GCompareFunc order)
+{
+    GncSplitIndex *idx;
+
+    g_return_val_if_fail (order, NULL);
+
+    idx = g_new0 (GncSplitIndex, 1);
+    idx->order = order;
+    idx->entries = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                          NULL, entry_free);
+    idx->head = entry_new (SPLIT_INDEX_MAX_LANES);
+    idx->lanes_used = 0;
+    idx->seed = 0x2545F491;
+    return idx;
+}
+
+void
+gnc_split_index_clear (GncSplitIndex *idx)
+{
+    guint i;
+
+    g_return_if_fail (idx);
+
+    g_list_free (idx->list);
+    idx->list = NULL;
+    idx->last = NULL;
+    g_hash_table_remove_all (idx->entries);
+    for (i = 0; i < SPLIT_INDEX_MAX_LANES; i++)
+        idx->head->lanes[i].next = NULL;
+    idx->lanes_used = 0;
+}
+
+void
+gnc_split_index_destroy (GncSplitIndex *idx)
+{
+    if (!idx) return;
+
+    g_list_free (idx->list);
+    g_hash_table_destroy (idx->entries);
+    entry_free (idx->head);
+    g_free (idx);
+}
+
+GList *
+gnc_split_index_get_list (const GncSplitIndex *idx)
+{
+    g_return_val_if_fail (idx, NULL);
+    return idx->list;
+}
+
+GList *
+gnc_split_index_get_last (const GncSplitIndex *idx)
+{
+    g_return_val_if_fail (idx, NULL);
+    return idx->last;
+}
+
+guint
+gnc_split_index_size (const GncSplitIndex *idx)
+{
+    g_return_val_if_fail (idx, 0);
+    return g_hash_table_size (idx->entries);
+}
+
+GList *
+gnc_split_index_lookup (const GncSplitIndex *idx, gconstpointer item)
+{
+    SplitIndexEntry *entry;
+
+    g_return_val_if_fail (idx, NULL);
+
+    entry = g_hash_table_lookup (idx->entries, item);
+    return entry ? entry->link : NULL;
+}
+
+GList *
+gnc_split_index_insert (GncSplitIndex *idx, gpointer item)
+{
+    SplitIndexEntry *update[SPLIT_INDEX_MAX_LANES];
+    SplitIndexEntry *entry, *x;
+    GList *prev, *next, *link;
+
+    g_return_val_if_fail (idx, NULL);
+    if (g_hash_table_lookup (idx->entries, item))
+        return NULL;
+
+    x = descend (idx, idx->order, item, FALSE, update);
+    prev = walk_list (idx, x, idx->order, item, FALSE, &next);
+
+    /* Splice the new node in by hand; g_list_insert_before() would
+     * walk the whole list when appending at the tail. */
+    link = g_list_alloc ();
+    link->data = item;
+    link->prev = prev;
+    link->next = next;
+    if (prev)
+        prev->next = link;
+    else
+        idx->list = link;
+    if (next)
+        next->prev = link;
+    else
+        idx->last = link;
+
+    entry = entry_new (random_height (idx));
+    entry->link = link;
+    link_lanes (idx, entry, update);
+    g_hash_table_insert (idx->entries, item, entry);
+    return link;
+}
+
+GList *
+gnc_split_index_prepend (GncSplitIndex *idx, gpointer item)
+{
+    SplitIndexEntry *update[SPLIT_INDEX_MAX_LANES];
+    SplitIndexEntry *entry;
+    guint i;
+
+    g_return_val_if_fail (idx, NULL);
+    if (g_hash_table_lookup (idx->entries, item))
+        return NULL;
+
+    idx->list = g_list_prepend (idx->list, item);
+    if (!idx->last)
+        idx->last = idx->list;
+
+    for (i = 0; i < SPLIT_INDEX_MAX_LANES; i++)
+        update[i] = idx->head;
+    entry = entry_new (random_height (idx));
+    entry->link = idx->list;
+    link_lanes (idx, entry, update);
+    g_hash_table_insert (idx->entries, item, entry);
+    return idx->list;
+}
+
+gboolean
+gnc_split_index_remove (GncSplitIndex *idx, gconstpointer item)
+{
+    SplitIndexEntry *entry;
+
+    g_return_val_if_fail (idx, FALSE);
+
+    entry = g_hash_table_lookup (idx->entries, item);
+    if (!entry)
+        return FALSE;
+
+    unlink_lanes (idx, entry);
+    if (entry->link == idx->last)
+        idx->last = entry->link->prev;
+    idx->list = g_list_delete_link (idx->list, entry->link);
+    g_hash_table_remove (idx->entries, item);
+    return TRUE;
+}
+
+gboolean
+gnc_split_index_sort (GncSplitIndex *idx)
+{
+    SplitIndexEntry *tails[SPLIT_INDEX_MAX_LANES];
+    GList *node;
+    guint i;
+
+    g_return_val_if_fail (idx, FALSE);
+
+    /* Most of the time nothing has moved; a linear check is a lot
+     * cheaper than a merge sort plus a rebuild. */
+    for (node = idx->list; node && node->next; node = node->next)
+        if (idx->order (node->data, node->next->data) > 0)
+            break;
+    if (!node || !node->next)
+        return FALSE;
+
+    /* g_list_sort() relinks the existing nodes, so the entries keep
+     * pointing at the right ones; only the lanes need rethreading. */
+    idx->list = g_list_sort (idx->list, idx->order);
+
+    for (i = 0; i < SPLIT_INDEX_MAX_LANES; i++)
+    {
+        idx->head->lanes[i].next = NULL;
+        tails[i] = idx->head;
+    }
+    for (node = idx->list; node; node = node->next)
+    {
+        SplitIndexEntry *entry = g_hash_table_lookup (idx->entries, node->data);
+
+        idx->last = node;
+        entry->link = node;
+        for (i = 0; i < entry->height; i++)
+        {
+            entry->lanes[i].prev = tails[i];
+            entry->lanes[i].next = NULL;
+            tails[i]->lanes[i].next = entry;
+            tails[i] = entry;
+        }
+    }
+    return TRUE;
+}
+
+GList *
+gnc_split_index_search (const GncSplitIndex *idx,
+                        GCompareFunc cmp, gconstpointer key)
+{
+    SplitIndexEntry *x;
+
+    g_return_val_if_fail (idx && cmp, NULL);
+
+    x = descend (idx, cmp, key, TRUE, NULL);
+    return walk_list (idx, x, cmp, key, TRUE, NULL);
+}
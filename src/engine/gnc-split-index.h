@@ -0,0 +1,102 @@
+/********************************************************************\
+ * gnc-split-index.h -- ordered index over an account's split list  *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+\********************************************************************/
+
+/** @file gnc-split-index.h
+ *  @brief Engine-private ordered container for the splits of an account.
+ *
+ *  The account keeps its splits in a sorted GList, because that list
+ *  is handed out by xaccAccountGetSplitList() and walked all over the
+ *  application.  Keeping a plain GList sorted makes every insert and
+ *  remove a linear scan, which turns bulk loads into quadratic work.
+ *
+ *  A GncSplitIndex owns that GList and layers a skip list on top of
+ *  it: the GList itself is level zero, and a random subset of its
+ *  nodes is threaded onto a small number of sparser express lanes.
+ *  A hash table maps each item to its GList node.  This gives
+ *  O(log n) expected time for ordered inserts and searches, and O(1)
+ *  for membership tests and removal, while the GList handed out to
+ *  callers stays exactly what it was before.
+ *
+ *  The index does not own the items themselves; it only orders them
+ *  with the compare function supplied at creation time.  Items whose
+ *  sort keys change after insertion leave the structure consistent
+ *  but out of order; call gnc_split_index_sort() to restore it.
+ *
+ *  No one outside of the engine should ever include this file.
+ */
+
+#ifndef GNC_SPLIT_INDEX_H
+#define GNC_SPLIT_INDEX_H
+
+#include <glib.h>
+
+typedef struct gnc_split_index_s GncSplitIndex;
+
+/** Create an empty index ordered by @a order. */
+GncSplitIndex * gnc_split_index_new (GCompareFunc order);
+
+/** Free the index and its GList.  The items are not touched. */
+void gnc_split_index_destroy (GncSplitIndex *idx);
+
+/** Drop every item from the index, freeing the GList. */
+void gnc_split_index_clear (GncSplitIndex *idx);
+
+/** Return the ordered list of items.  The list belongs to the index
+ *  and must not be modified or freed by the caller. */
+GList * gnc_split_index_get_list (const GncSplitIndex *idx);
+
+/** Return the last node of the ordered list, without a walk. */
+GList * gnc_split_index_get_last (const GncSplitIndex *idx);
+
+/** Return the number of items in the index. */
+guint gnc_split_index_size (const GncSplitIndex *idx);
+
+/** Return the GList node holding @a item, or NULL if the item is
+ *  not in the index.  O(1). */
+GList * gnc_split_index_lookup (const GncSplitIndex *idx, gconstpointer item);
+
+/** Insert @a item at its sorted position.  Returns the new GList
+ *  node, or NULL if the item was already present.  O(log n). */
+GList * gnc_split_index_insert (GncSplitIndex *idx, gpointer item);
+
+/** Put @a item at the head of the list without regard to ordering.
+ *  Used while the owner is being edited and sort keys may be in
+ *  flux; a later gnc_split_index_sort() puts it in place.  Returns
+ *  NULL if the item was already present. */
+GList * gnc_split_index_prepend (GncSplitIndex *idx, gpointer item);
+
+/** Remove @a item.  Returns FALSE if it was not in the index.  O(1). */
+gboolean gnc_split_index_remove (GncSplitIndex *idx, gconstpointer item);
+
+/** Re-sort the list with the index's compare function and rebuild
+ *  the express lanes.  Returns FALSE, without doing any work, if the
+ *  list was already in order. */
+gboolean gnc_split_index_sort (GncSplitIndex *idx);
+
+/** Return the last GList node whose item compares less than or
+ *  equal to @a key under @a cmp, or NULL if there is none.  @a cmp
+ *  is called as cmp(item, key) and must be consistent with the
+ *  ordering of the index, i.e. non-decreasing along the list.
+ *  O(log n). */
+GList * gnc_split_index_search (const GncSplitIndex *idx,
+                                GCompareFunc cmp, gconstpointer key);
+
+#endif /* GNC_SPLIT_INDEX_H */
@@ -0,0 +1,214 @@
+/***************************************************************************
+ *            test-balance-matrix.c
+ *
+ *  Tests and benchmark for xaccAccountsGetBalanceMatrix.
+ ****************************************************************************/
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301, USA.
+ */
+/**
+ * @file test-balance-matrix.c
+ * @brief Check account balance matrices against one-by-one balances.
+ *
+ * Run without arguments this is a quick correctness test.  Give it
+ * transaction counts to get timings, e.g.
+ *
+ *   test-balance-matrix 10000 100000
+ *
+ * Each run asks for the balances of a dozen accounts at 24 month ends,
+ * once as a matrix and once date by date.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <glib.h>
+#include "qof.h"
+#include "cashobjects.h"
+#include "Account.h"
+#include "Split.h"
+#include "Transaction.h"
+#include "TransLog.h"
+#include "test-stuff.h"
+#include "test-engine-stuff.h"
+
+#define N_ACCOUNTS 12
+#define N_DATES 24
+#define DAY 86400
+
+static Account *
+make_account (QofBook *book, Account *parent, gnc_commodity *commodity)
+{
+    Account *acc = xaccMallocAccount (book);
+
+    xaccAccountBeginEdit (acc);
+    xaccAccountSetType (acc, ACCT_TYPE_BANK);
+    xaccAccountSetCommodity (acc, commodity);
+    xaccAccountCommitEdit (acc);
+    gnc_account_append_child (parent, acc);
+    return acc;
+}
+
+/* 'n' transactions between random pairs of the accounts, posted at
+ * midnight on one of the first 730 days. */
+static void
+make_transactions (QofBook *book, Account **accounts, guint n_accounts,
+                   gnc_commodity *currency, guint n)
+{
+    guint i;
+
+    for (i = 0; i < n; i++)
+    {
+        Transaction *trans = xaccMallocTransaction (book);
+        Split *from = xaccMallocSplit (book);
+        Split *to = xaccMallocSplit (book);
+        gnc_numeric amount = gnc_numeric_create (rand () % 10000, 100);
+
+        xaccTransBeginEdit (trans);
+        xaccTransSetCurrency (trans, currency);
+        xaccTransSetDatePostedSecs (trans, DAY * (time_t)(rand () % 730));
+        xaccSplitSetParent (from, trans);
+        xaccSplitSetParent (to, trans);
+        xaccSplitSetAccount (from, accounts[rand () % n_accounts]);
+        xaccSplitSetAccount (to, accounts[rand () % n_accounts]);
+        xaccSplitSetAmount (from, gnc_numeric_neg (amount));
+        xaccSplitSetValue (from, gnc_numeric_neg (amount));
+        xaccSplitSetAmount (to, amount);
+        xaccSplitSetValue (to, amount);
+        xaccTransCommitEdit (trans);
+    }
+}
+
+static void
+run_size (QofBook *book, gnc_commodity *currency, guint n, gboolean verbose)
+{
+    Account *root = gnc_book_get_root_account (book);
+    Account *parent = make_account (book, root, currency);
+    Account *accounts[N_ACCOUNTS];
+    Timespec dates[N_DATES];
+    time_t times[N_DATES];
+    gnc_numeric balances[N_DATES];
+    GncBalanceMatrix *matrix;
+    GList *acc_list = NULL;
+    GTimer *timer = g_timer_new ();
+    gdouble t_matrix, t_dates;
+    gboolean same = TRUE;
+    guint i, d;
+
+    accounts[0] = parent;
+    for (i = 1; i < N_ACCOUNTS; i++)
+        accounts[i] = make_account (book, i < 4 ? parent : root, currency);
+    make_transactions (book, accounts, N_ACCOUNTS, currency, n);
+
+    /* Noon, so that no split is posted right at a date.  The dates go
+     * backwards to check they need not be sorted. */
+    for (d = 0; d < N_DATES; d++)
+    {
+        times[d] = DAY * (time_t)(30 * (N_DATES - d)) + DAY / 2;
+        dates[d].tv_sec = times[d];
+        dates[d].tv_nsec = 0;
+    }
+
+    for (i = N_ACCOUNTS; i > 0; i--)
+        acc_list = g_list_prepend (acc_list, accounts[i - 1]);
+
+    g_timer_start (timer);
+    matrix = xaccAccountsGetBalanceMatrix (acc_list, dates, N_DATES,
+                                           FALSE, FALSE);
+    t_matrix = g_timer_elapsed (timer, NULL);
+
+    do_test (matrix->n_dates == N_DATES, "matrix has a column per date");
+    do_test (matrix->n_rows <= N_ACCOUNTS, "at most a row per account");
+
+    g_timer_start (timer);
+    for (i = 0; i < matrix->n_rows; i++)
+    {
+        Account *acc = matrix->accounts[i];
+
+        if (acc != accounts[matrix->account_index[i]])
+            same = FALSE;
+        for (d = 0; d < N_DATES; d++)
+            balances[d] = xaccAccountGetBalanceAsOfDate (acc, times[d]);
+        for (d = 0; d < N_DATES; d++)
+            if (!gnc_numeric_equal (balances[d],
+                                    matrix->balances[i * N_DATES + d]))
+                same = FALSE;
+    }
+    t_dates = g_timer_elapsed (timer, NULL);
+    do_test (same, "matrix balances match the balances as of each date");
+    gnc_balance_matrix_free (matrix);
+
+    /* The children of the parent add up into its row, and its values
+     * are in the one currency. */
+    matrix = xaccAccountsGetBalanceMatrix (acc_list, dates, N_DATES,
+                                           TRUE, TRUE);
+    same = TRUE;
+    for (i = 0; i < matrix->n_rows && matrix->account_index[i] == 0; i++)
+    {
+        if (!gnc_commodity_equal (matrix->commodities[i], currency))
+            same = FALSE;
+        for (d = 0; d < N_DATES; d++)
+        {
+            gnc_numeric sum = gnc_numeric_zero ();
+            guint j;
+
+            for (j = 0; j < 4; j++)
+                sum = gnc_numeric_add (sum, xaccAccountGetBalanceAsOfDate
+                                       (accounts[j], times[d]),
+                                       GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD);
+            if (!gnc_numeric_equal (sum, matrix->balances[i * N_DATES + d]))
+                same = FALSE;
+        }
+    }
+    do_test (same && i <= 1, "values of the parent include its children");
+    gnc_balance_matrix_free (matrix);
+
+    if (verbose)
+        printf ("%8u txs  %d accounts x %d dates:  matrix %8.3fs  by date %8.3fs\n",
+                n, N_ACCOUNTS, N_DATES, t_matrix, t_dates);
+
+    g_list_free (acc_list);
+    g_timer_destroy (timer);
+}
+
+int
+main (int argc, char **argv)
+{
+    QofSession *session;
+    QofBook *book;
+    gnc_commodity *currency;
+    int i;
+
+    qof_init();
+    if (!cashobjects_register())
+        exit(1);
+    xaccLogDisable ();
+    srand(0);
+
+    session = qof_session_new ();
+    book = qof_session_get_book (session);
+    currency = get_random_commodity (book);
+
+    if (argc < 2)
+        run_size (book, currency, 500, FALSE);
+    for (i = 1; i < argc; i++)
+        run_size (book, currency, (guint)atoi (argv[i]), TRUE);
+
+    print_test_results();
+    qof_session_end (session);
+    qof_close();
+    return get_rv();
+}
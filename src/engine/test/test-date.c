@@ -5,6 +5,9 @@
 #include "config.h"
 #include <ctype.h>
 #include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #include "gnc-date.h"
@@ -109,6 +112,140 @@ check_conversion (const char * str, Timespec expected_ts)
     return TRUE;
 }
 
+/* gnc_timespec_to_iso8601_buff() as it was before it wrote the
+ * digits itself, to check it and time it against. */
+static char *
+reference_iso8601_buff (Timespec ts, char *buff)
+{
+    struct tm parsed;
+    time_t tmp = ts.tv_sec;
+    long int secs;
+    char cyn = '-';
+
+    localtime_r (&tmp, &parsed);
+    secs = gnc_timezone (&parsed);
+    if (0 > secs)
+    {
+        cyn = '+';
+        secs = -secs;
+    }
+    return buff + sprintf (buff, "%4d-%02d-%02d %02d:%02d:%02d.%06ld %c%02d%02d",
+                           parsed.tm_year + 1900, parsed.tm_mon + 1,
+                           parsed.tm_mday, parsed.tm_hour, parsed.tm_min,
+                           parsed.tm_sec, ts.tv_nsec / 1000, cyn,
+                           (int)(secs / 3600), (int)((secs % 3600) / 60));
+}
+
+static gboolean
+check_localtime (time_t secs)
+{
+    struct tm fast, slow;
+
+    gnc_localtime_r (&secs, &fast);
+    localtime_r (&secs, &slow);
+    if (fast.tm_year != slow.tm_year || fast.tm_mon != slow.tm_mon
+            || fast.tm_mday != slow.tm_mday || fast.tm_hour != slow.tm_hour
+            || fast.tm_min != slow.tm_min || fast.tm_sec != slow.tm_sec
+            || fast.tm_wday != slow.tm_wday || fast.tm_yday != slow.tm_yday
+            || fast.tm_isdst != slow.tm_isdst
+            || gnc_timezone (&fast) != gnc_timezone (&slow))
+    {
+        fprintf (stderr, "\nlocal time of %" G_GINT64_FORMAT " differs\n",
+                 (gint64) secs);
+        failure ("gnc_localtime_r differs from localtime_r");
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static gboolean
+check_format (Timespec ts)
+{
+    char str[128], expected[128];
+
+    ts.tv_nsec = ts.tv_nsec % 1000000000;
+    gnc_timespec_to_iso8601_buff (ts, str);
+    reference_iso8601_buff (ts, expected);
+    if (strcmp (str, expected) != 0)
+    {
+        fprintf (stderr, "\nwrote \"%s\", was expecting \"%s\"\n",
+                 str, expected);
+        failure ("iso8601 string differs");
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* The local times and strings of times close together, as the
+ * timestamps of a book are, and of times all over the place. */
+static void
+run_format_test (void)
+{
+    Timespec ts = *get_random_timespec ();
+    gboolean ok = TRUE;
+    int i;
+
+    for (i = 0; ok && i < 20000; i++)
+    {
+        ts.tv_sec += 1237;
+        ok = check_localtime (ts.tv_sec) && check_format (ts);
+    }
+    for (i = 0; ok && i < 20000; i++)
+    {
+        ts = *get_random_timespec ();
+        ok = check_localtime (ts.tv_sec) && check_format (ts);
+    }
+    /* Around a daylight saving change in most zones that have one. */
+    for (i = 0; ok && i < 2000; i++)
+        ok = check_localtime (1143943200 - 86400 + i * 97);
+    if (ok)
+        success ("local times and iso8601 strings match");
+}
+
+/* Time writing and reading back 'n' iso8601 strings an hour apart,
+ * against writing them the old way. */
+static void
+run_benchmark (int n)
+{
+    GTimer *timer = g_timer_new ();
+    gdouble t_reference, t_write, t_read;
+    char str[128];
+    Timespec ts;
+    int i;
+
+    g_timer_start (timer);
+    for (i = 0; i < n; i++)
+    {
+        ts.tv_sec = 1200000000 + (time_t) i * 3601;
+        ts.tv_nsec = 0;
+        reference_iso8601_buff (ts, str);
+    }
+    t_reference = g_timer_elapsed (timer, NULL);
+
+    g_timer_start (timer);
+    for (i = 0; i < n; i++)
+    {
+        ts.tv_sec = 1200000000 + (time_t) i * 3601;
+        ts.tv_nsec = 0;
+        gnc_timespec_to_iso8601_buff (ts, str);
+    }
+    t_write = g_timer_elapsed (timer, NULL);
+
+    g_timer_start (timer);
+    for (i = 0; i < n; i++)
+    {
+        ts.tv_sec = 1200000000 + (time_t) i * 3601;
+        ts.tv_nsec = 0;
+        gnc_timespec_to_iso8601_buff (ts, str);
+        ts = gnc_iso8601_to_timespec_gmt (str);
+    }
+    t_read = g_timer_elapsed (timer, NULL) - t_write;
+
+    printf ("%10d times:  sprintf %8.4fs  write %8.4fs  read %8.4fs\n",
+            n, t_reference, t_write, t_read);
+    g_timer_destroy (timer);
+}
+
 static void
 run_test (void)
 {
@@ -295,6 +432,17 @@ run_test (void)
     check_conversion ("2004-12-31 15:23:00.000000 -0837", ts);
     check_conversion ("2004-12-31 15:45:00.000000 -0815", ts);
 
+    /* The other forms the SQL backend and others use. */
+    check_conversion ("2005-01-01 00:00:00", ts);
+    check_conversion ("2005-01-01 08:00:00+08", ts);
+    check_conversion ("2004-12-31 19:00:00-0500", ts);
+    ts.tv_nsec = 680000000;
+    check_conversion ("2004-12-31 19:00:00.68-05", ts);
+    check_conversion ("2005-01-01 00:00:00.68", ts);
+    ts.tv_nsec = 123456789;
+    check_conversion ("2005-01-01 00:00:00.123456789 +0000", ts);
+    ts.tv_nsec = 0;
+
 
     /* Various leap-year days and near-leap times. */
     ts = gnc_iso8601_to_timespec_gmt ("1980-02-29 00:00:00.000000 -0000");
@@ -396,9 +544,17 @@ run_test (void)
 int
 main (int argc, char **argv)
 {
-    run_test ();
+    int i;
 
-    success ("dates seem to work");
+    /* Counts on the command line time the conversions instead. */
+    if (argc < 2)
+    {
+        run_test ();
+        run_format_test ();
+        success ("dates seem to work");
+    }
+    for (i = 1; i < argc; i++)
+        run_benchmark (atoi (argv[i]));
 
     print_test_results();
     exit(get_rv());
@@ -0,0 +1,243 @@
+/***************************************************************************
+ *            test-exchange-totals.c
+ *
+ *  Tests for gnc_book_get_exchange_totals.
+ ****************************************************************************/
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301, USA.
+ */
+/**
+ * @file test-exchange-totals.c
+ * @brief Check exchange totals against sums taken split by split.
+ *
+ * The book has a bank account in the report currency and one in a
+ * foreign commodity, with transfers between them in the report
+ * currency.  The totals of each date are compared with the sums of
+ * the foreign splits posted up to that date.
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <glib.h>
+#include "qof.h"
+#include "cashobjects.h"
+#include "Account.h"
+#include "Split.h"
+#include "Transaction.h"
+#include "TransLog.h"
+#include "gnc-exchange-totals.h"
+#include "test-stuff.h"
+#include "test-engine-stuff.h"
+
+#define N_TRANS 200
+#define N_DATES 12
+#define DAY 86400
+
+static Account *
+make_account (QofBook *book, gnc_commodity *commodity)
+{
+    Account *acc = xaccMallocAccount (book);
+
+    xaccAccountBeginEdit (acc);
+    xaccAccountSetType (acc, ACCT_TYPE_BANK);
+    xaccAccountSetCommodity (acc, commodity);
+    xaccAccountCommitEdit (acc);
+    gnc_account_append_child (gnc_book_get_root_account (book), acc);
+    return acc;
+}
+
+/* A transfer of 'value' in 'currency' from 'home' to 'away', where it
+ * buys 'amount' of the foreign commodity.  Returns the foreign split. */
+static Split *
+make_transfer (QofBook *book, Account *home, Account *away,
+               gnc_commodity *currency, time_t posted,
+               gnc_numeric amount, gnc_numeric value)
+{
+    Transaction *trans = xaccMallocTransaction (book);
+    Split *from = xaccMallocSplit (book);
+    Split *to = xaccMallocSplit (book);
+
+    xaccTransBeginEdit (trans);
+    xaccTransSetCurrency (trans, currency);
+    xaccTransSetDatePostedSecs (trans, posted);
+    xaccSplitSetParent (from, trans);
+    xaccSplitSetParent (to, trans);
+    xaccSplitSetAccount (from, home);
+    xaccSplitSetAccount (to, away);
+    xaccSplitSetAmount (from, gnc_numeric_neg (value));
+    xaccSplitSetValue (from, gnc_numeric_neg (value));
+    xaccSplitSetAmount (to, amount);
+    xaccSplitSetValue (to, value);
+    xaccTransCommitEdit (trans);
+    return to;
+}
+
+/* The sums of the foreign splits posted up to 'date' and not marked
+ * voided, absolute or signed, like the totals should have them. */
+static void
+sum_splits (Account *away, Timespec date, gboolean cost,
+            gnc_numeric *foreign, gnc_numeric *domestic)
+{
+    GList *node;
+
+    *foreign = gnc_numeric_zero ();
+    *domestic = gnc_numeric_zero ();
+    for (node = xaccAccountGetSplitList (away); node; node = node->next)
+    {
+        Split *split = node->data;
+        Timespec posted = xaccTransRetDatePostedTS (xaccSplitGetParent (split));
+        gnc_numeric amount = xaccSplitGetAmount (split);
+        gnc_numeric value = xaccSplitGetValue (split);
+
+        if (timespec_cmp (&posted, &date) > 0)
+            continue;
+        if (xaccSplitGetReconcile (split) == VREC)
+            continue;
+        if (!cost)
+        {
+            if (gnc_numeric_zero_p (amount))
+                continue;
+            amount = gnc_numeric_abs (amount);
+            value = gnc_numeric_abs (value);
+        }
+        *foreign = gnc_numeric_add (*foreign, amount,
+                                    GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD);
+        *domestic = gnc_numeric_add (*domestic, value,
+                                     GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD);
+    }
+}
+
+static gboolean
+check_totals (const GncExchangeTotals *totals, gnc_commodity *currency,
+              gnc_commodity *foreign_comm, gnc_numeric foreign,
+              gnc_numeric domestic)
+{
+    const GncExchangeGroup *group;
+
+    if (totals->n_groups != 1)
+        return FALSE;
+    group = &totals->groups[0];
+    if (group->commodity != currency)
+        return FALSE;
+    if (gnc_numeric_zero_p (domestic))
+        return group->n_pairs == 0;
+    return group->n_pairs == 1
+           && group->pairs[0].commodity == foreign_comm
+           && gnc_numeric_equal (group->pairs[0].foreign, foreign)
+           && gnc_numeric_equal (group->pairs[0].domestic, domestic);
+}
+
+static void
+run_test (QofBook *book)
+{
+    gnc_commodity *currency = get_random_commodity (book);
+    gnc_commodity *foreign_comm = get_random_commodity (book);
+    Account *home = make_account (book, currency);
+    Account *away = make_account (book, foreign_comm);
+    const GncExchangeTotals **totals, **again;
+    Timespec dates[N_DATES];
+    gnc_numeric foreign, domestic;
+    Split *split;
+    gboolean same;
+    gint cost;
+    guint i, d;
+
+    for (i = 0; i < N_TRANS; i++)
+    {
+        gnc_numeric value = gnc_numeric_create (rand () % 10000 + 1, 100);
+        gnc_numeric amount = gnc_numeric_create (rand () % 10000 + 1, 100);
+
+        /* A third are sales, and a few sell nothing. */
+        if (i % 3 == 0)
+            amount = gnc_numeric_neg (amount);
+        if (i % 17 == 0)
+            amount = gnc_numeric_zero ();
+        make_transfer (book, home, away, currency,
+                       DAY * (time_t)(rand () % 365), amount, value);
+    }
+
+    /* Noon, in no particular order, and one before any split. */
+    for (d = 0; d < N_DATES; d++)
+    {
+        dates[d].tv_sec = DAY * (time_t)((d * 7 % N_DATES) * 31) - DAY / 2;
+        dates[d].tv_nsec = 0;
+    }
+
+    for (cost = 0; cost < 2; cost++)
+    {
+        totals = gnc_book_get_exchange_totals (book, currency, dates,
+                                               N_DATES, cost);
+        same = TRUE;
+        for (d = 0; d < N_DATES; d++)
+        {
+            sum_splits (away, dates[d], cost, &foreign, &domestic);
+            if (!check_totals (totals[d], currency, foreign_comm,
+                               foreign, domestic))
+                same = FALSE;
+        }
+        do_test (same, cost ? "cost totals match the splits"
+                 : "average totals match the splits");
+
+        again = gnc_book_get_exchange_totals (book, currency, dates, 1, cost);
+        do_test (again[0] == totals[0], "totals of a date are kept");
+        g_free (again);
+        g_free (totals);
+    }
+
+    /* A new transaction must show up in the totals after it. */
+    make_transfer (book, home, away, currency, DAY * 400,
+                   gnc_numeric_create (100, 1), gnc_numeric_create (50, 1));
+    dates[0].tv_sec = DAY * 401;
+    totals = gnc_book_get_exchange_totals (book, currency, dates, 1, TRUE);
+    sum_splits (away, dates[0], TRUE, &foreign, &domestic);
+    do_test (check_totals (totals[0], currency, foreign_comm,
+                           foreign, domestic),
+             "totals follow a new transaction");
+    g_free (totals);
+
+    /* The reports matched splits by their reconcile state, not by the
+     * void status of the transaction. */
+    split = make_transfer (book, home, away, currency, DAY * 402,
+                           gnc_numeric_create (30, 1), gnc_numeric_create (20, 1));
+    xaccSplitSetReconcile (split, VREC);
+    dates[0].tv_sec = DAY * 403;
+    totals = gnc_book_get_exchange_totals (book, currency, dates, 1, TRUE);
+    sum_splits (away, dates[0], TRUE, &foreign, &domestic);
+    do_test (check_totals (totals[0], currency, foreign_comm,
+                           foreign, domestic),
+             "totals leave out splits marked voided");
+    g_free (totals);
+}
+
+int
+main (int argc, char **argv)
+{
+    QofSession *session;
+
+    qof_init();
+    if (!cashobjects_register())
+        exit(1);
+    xaccLogDisable ();
+    srand(0);
+
+    session = qof_session_new ();
+    run_test (qof_session_get_book (session));
+
+    print_test_results();
+    qof_session_end (session);
+    qof_close();
+    return get_rv();
+}
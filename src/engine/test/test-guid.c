@@ -24,10 +24,14 @@
 /* Test file created by Linas Vepstas <linas@linas.org>
  * Try to create duplicate GncGUID's, which should never happen.
  *
+ * Given entity counts, e.g. "test-guid 100000 1000000", it also times
+ * looking entities up in a collection against a GHashTable keyed the
+ * way collections used to be.
  */
 
 #include "config.h"
 #include <ctype.h>
+#include <stdlib.h>
 #include <glib.h>
 #include "cashobjects.h"
 #include "test-stuff.h"
@@ -85,14 +89,164 @@ run_test (void)
     qof_session_destroy(sess);
 }
 
+static QofInstance **
+make_entities (QofCollection *col, guint n)
+{
+    QofInstance **ents = g_new (QofInstance *, n);
+    GncGUID guid;
+    guint i;
+
+    for (i = 0; i < n; i++)
+    {
+        guid_new (&guid);
+        ents[i] = g_object_new (QOF_TYPE_INSTANCE, "guid", &guid, NULL);
+        ents[i]->e_type = qof_collection_get_type (col);
+        qof_collection_insert_entity (col, ents[i]);
+    }
+    return ents;
+}
+
+static void
+free_entities (QofInstance **ents, guint n)
+{
+    guint i;
+
+    /* Out of the collection first, so disposing of them leaves it be. */
+    for (i = 0; i < n; i++)
+    {
+        qof_collection_remove_entity (ents[i]);
+        g_object_unref (ents[i]);
+    }
+    g_free (ents);
+}
+
+static void
+count_cb (QofInstance *ent, gpointer user_data)
+{
+    (*(guint *) user_data)++;
+}
+
+static void
+remove_cb (QofInstance *ent, gpointer user_data)
+{
+    (*(guint *) user_data)++;
+    qof_collection_remove_entity (ent);
+}
+
+/* Entities come and go from a collection and are still found. */
+static void
+test_collection_table (void)
+{
+    QofCollection *col = qof_collection_new ("qwer");
+    QofInstance **ents;
+    guint n = 1000, i, count;
+    gboolean ok;
+
+    ents = make_entities (col, n);
+    do_test (qof_collection_count (col) == n, "collection count");
+
+    for (i = 0; i < n; i += 2)
+        qof_collection_remove_entity (ents[i]);
+    do_test (qof_collection_count (col) == n / 2, "count after removal");
+
+    ok = TRUE;
+    for (i = 0; i < n; i++)
+    {
+        QofInstance *found = qof_collection_lookup_entity
+                             (col, qof_instance_get_guid (ents[i]));
+        if (found != ((i % 2) ? ents[i] : NULL))
+            ok = FALSE;
+    }
+    do_test (ok, "lookup after removal");
+
+    count = 0;
+    qof_collection_foreach (col, count_cb, &count);
+    do_test (count == n / 2, "foreach after removal");
+
+    for (i = 0; i < n; i += 2)
+        qof_collection_insert_entity (col, ents[i]);
+    do_test (qof_collection_count (col) == n, "count after reinsertion");
+
+    ok = TRUE;
+    for (i = 0; i < n; i++)
+        if (qof_collection_lookup_entity (col, qof_instance_get_guid (ents[i]))
+                != ents[i])
+            ok = FALSE;
+    do_test (ok, "lookup after reinsertion");
+
+    count = 0;
+    qof_collection_foreach (col, remove_cb, &count);
+    do_test (count == n, "foreach visits every entity it removes");
+    do_test (qof_collection_count (col) == 0, "foreach removed every entity");
+
+    qof_collection_reserve (col, 10 * n);
+    for (i = 0; i < n; i++)
+        qof_collection_insert_entity (col, ents[i]);
+    do_test (qof_collection_lookup_entity (col, qof_instance_get_guid (ents[n - 1]))
+             == ents[n - 1], "lookup after reserve");
+
+    free_entities (ents, n);
+    qof_collection_destroy (col);
+}
+
+/* Time 'rounds' lookups of each of 'n' entities in a collection and in
+ * a GHashTable. */
+static void
+run_lookup_bench (guint n)
+{
+    QofCollection *col = qof_collection_new ("qwer");
+    GHashTable *hash = guid_hash_table_new ();
+    QofInstance **ents;
+    GTimer *timer;
+    gdouble t_col, t_hash;
+    guint rounds = 10, r, i, found = 0;
+
+    timer = g_timer_new ();
+    qof_collection_reserve (col, n);
+    ents = make_entities (col, n);
+    for (i = 0; i < n; i++)
+        g_hash_table_insert (hash, (gpointer) qof_instance_get_guid (ents[i]),
+                             ents[i]);
+
+    g_timer_start (timer);
+    for (r = 0; r < rounds; r++)
+        for (i = 0; i < n; i++)
+            if (qof_collection_lookup_entity (col, qof_instance_get_guid (ents[i])))
+                found++;
+    t_col = g_timer_elapsed (timer, NULL);
+    do_test (found == rounds * n, "benchmark collection lookups");
+
+    found = 0;
+    g_timer_start (timer);
+    for (r = 0; r < rounds; r++)
+        for (i = 0; i < n; i++)
+            if (g_hash_table_lookup (hash, qof_instance_get_guid (ents[i])))
+                found++;
+    t_hash = g_timer_elapsed (timer, NULL);
+    do_test (found == rounds * n, "benchmark hash table lookups");
+
+    printf ("%8u entities  %u lookups:  collection %8.3fs  GHashTable %8.3fs\n",
+            n, rounds * n, t_col, t_hash);
+
+    g_timer_destroy (timer);
+    g_hash_table_destroy (hash);
+    free_entities (ents, n);
+    qof_collection_destroy (col);
+}
+
 int
 main (int argc, char **argv)
 {
+    int i;
+
     qof_init();
     if (cashobjects_register())
     {
         test_null_guid();
         run_test ();
+        test_collection_table ();
+        for (i = 1; i < argc; i++)
+            run_lookup_bench ((guint) atoi (argv[i]));
         print_test_results();
     }
     qof_close();
@@ -23,14 +23,26 @@
  * @file test-lots.c
  * @brief Minimal test to see if automatic lot scrubbing works.
  * @author Linas Vepstas <linas@linas.org>
+ *
+ * Also checks the open lots an account keeps track of against all of
+ * its lots.  Give it numbers of trades to time assigning them to lots,
+ * e.g.
+ *
+ *   test-lots 1000 10000 50000
  */
 
 #include "config.h"
 #include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <glib.h>
 #include "qof.h"
 #include "Account.h"
+#include "Scrub2.h"
 #include "Scrub3.h"
+#include "Split.h"
+#include "cap-gains.h"
+#include "gnc-lot.h"
 #include "cashobjects.h"
 #include "test-stuff.h"
 #include "test-engine-stuff.h"
@@ -69,6 +81,138 @@ run_test (void)
 
 }
 
+#define DAY 86400
+
+static void
+add_trade (QofBook *book, Account *stock, Account *cash,
+           gnc_commodity *currency, time_t date, gint64 shares, gint64 price)
+{
+    Transaction *trans = xaccMallocTransaction (book);
+    Split *s_stock = xaccMallocSplit (book);
+    Split *s_cash = xaccMallocSplit (book);
+
+    xaccTransBeginEdit (trans);
+    xaccTransSetCurrency (trans, currency);
+    xaccTransSetDatePostedSecs (trans, date);
+    xaccSplitSetParent (s_stock, trans);
+    xaccSplitSetAccount (s_stock, stock);
+    xaccSplitSetAmount (s_stock, gnc_numeric_create (shares, 1));
+    xaccSplitSetValue (s_stock, gnc_numeric_create (shares * price, 1));
+    xaccSplitSetParent (s_cash, trans);
+    xaccSplitSetAccount (s_cash, cash);
+    xaccSplitSetAmount (s_cash, gnc_numeric_create (-shares * price, 1));
+    xaccSplitSetValue (s_cash, gnc_numeric_create (-shares * price, 1));
+    xaccTransCommitEdit (trans);
+}
+
+/* The open lots of 'acc' are the ones found by going through all its
+ * lots */
+static gboolean
+open_lots_match (Account *acc, guint *n_open)
+{
+    LotList *all = xaccAccountGetLotList (acc);
+    LotList *open = xaccAccountFindOpenLots (acc, NULL, NULL, NULL);
+    LotList *expected = NULL, *node, *onode;
+    gboolean same;
+
+    /* xaccAccountFindOpenLots reverses the lot list */
+    for (node = all; node; node = node->next)
+        if (!gnc_lot_is_closed (node->data))
+            expected = g_list_prepend (expected, node->data);
+
+    *n_open = g_list_length (open);
+    for (node = expected, onode = open; node && onode;
+            node = node->next, onode = onode->next)
+        if (node->data != onode->data)
+            break;
+    same = (node == NULL && onode == NULL);
+
+    g_list_free (all);
+    g_list_free (open);
+    g_list_free (expected);
+    return same;
+}
+
+/* 'n' days of a purchase followed by a sale of the same shares, except
+ * that the last few purchases are kept. */
+static void
+run_trading_test (guint n, gboolean verbose)
+{
+    QofSession *sess = qof_session_new ();
+    QofBook *book = qof_session_get_book (sess);
+    Account *root = gnc_book_get_root_account (book);
+    gnc_commodity_table *table = gnc_commodity_table_get_table (book);
+    gnc_commodity *currency, *shares;
+    Account *stock, *cash;
+    GNCLot *lot;
+    Split *split;
+    GTimer *timer;
+    gdouble secs;
+    guint i, n_open;
+
+    currency = gnc_commodity_table_lookup (table, GNC_COMMODITY_NS_CURRENCY,
+                                           "USD");
+    shares = gnc_commodity_new (book, "Test Shares", "NYSE", "TST", NULL, 1);
+    shares = gnc_commodity_table_insert (table, shares);
+
+    stock = xaccMallocAccount (book);
+    xaccAccountBeginEdit (stock);
+    xaccAccountSetName (stock, "Stock");
+    xaccAccountSetType (stock, ACCT_TYPE_STOCK);
+    xaccAccountSetCommodity (stock, shares);
+    xaccAccountCommitEdit (stock);
+    gnc_account_append_child (root, stock);
+
+    cash = xaccMallocAccount (book);
+    xaccAccountBeginEdit (cash);
+    xaccAccountSetName (cash, "Cash");
+    xaccAccountSetType (cash, ACCT_TYPE_BANK);
+    xaccAccountSetCommodity (cash, currency);
+    xaccAccountCommitEdit (cash);
+    gnc_account_append_child (root, cash);
+
+    for (i = 0; i < n; i++)
+    {
+        add_trade (book, stock, cash, currency, 2 * DAY * (time_t)i, 10, 10);
+        if (i < n - 3)
+            add_trade (book, stock, cash, currency,
+                       2 * DAY * (time_t)i + DAY, -10, 11);
+    }
+
+    timer = g_timer_new ();
+    xaccAccountAssignLots (stock);
+    secs = g_timer_elapsed (timer, NULL);
+    g_timer_destroy (timer);
+    if (verbose)
+        printf ("%8u trades assigned to lots in %8.3fs\n", 2 * n - 3, secs);
+
+    do_test (open_lots_match (stock, &n_open) && n_open == 3,
+             "FIFO leaves the last three purchases open");
+    lot = xaccAccountFindEarliestOpenLot (stock, gnc_numeric_create (-1, 1),
+                                          currency);
+    split = lot ? gnc_lot_get_earliest_split (lot) : NULL;
+    do_test (split && xaccTransGetDate (xaccSplitGetParent (split))
+             == 2 * DAY * (time_t)(n - 3),
+             "earliest open lot is the first one not sold");
+
+    /* Selling less reopens the first lot, which holds the first two
+     * splits */
+    lot = xaccSplitGetLot (xaccAccountGetSplitList (stock)->next->data);
+    split = gnc_lot_get_latest_split (lot);
+    xaccTransBeginEdit (xaccSplitGetParent (split));
+    xaccSplitSetAmount (split, gnc_numeric_create (-5, 1));
+    xaccSplitSetValue (split, gnc_numeric_create (-55, 1));
+    xaccTransCommitEdit (xaccSplitGetParent (split));
+    do_test (open_lots_match (stock, &n_open) && n_open == 4,
+             "a lot is open again when its balance changes");
+    do_test (xaccAccountFindEarliestOpenLot (stock, gnc_numeric_create (-1, 1),
+             currency) == lot,
+             "the reopened lot is now the earliest");
+
+    qof_session_end (sess);
+    qof_session_destroy (sess);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -94,6 +238,10 @@ main (int argc, char **argv)
     /* 'erase' the recurring tag line with dummy spaces. */
     fprintf(stdout, "Lots: Test series complete.         \n");
     fflush(stdout);
+
+    run_trading_test (50, FALSE);
+    for (i = 1; i < argc; i++)
+        run_trading_test ((guint) atoi (argv[i]), TRUE);
     print_test_results();
 
     qof_close();
@@ -25,6 +25,8 @@
 
 #include "config.h"
 #include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <glib.h>
 #include "cashobjects.h"
 #include "test-stuff.h"
@@ -861,6 +863,305 @@ check_reciprocal(void)
 
 /* ======================================================= */
 
+/* The values the accumulator tests add up: numerators over
+ * denominators that are equal, multiples, coprime or reciprocal. */
+static const gint64 accum_nums[] =
+{
+    0, 1, -1, 2, -3, 7, 99, -100, 12345, -67890,
+    G_GINT64_CONSTANT(1000000000000), G_GINT64_CONSTANT(-3000000000000000)
+};
+static const gint64 accum_denoms[] = { 1, 2, 3, 4, 100, 1000, 7, -10 };
+
+#define N_ACCUM_NUMS (sizeof (accum_nums) / sizeof (accum_nums[0]))
+#define N_ACCUM_DENOMS (sizeof (accum_denoms) / sizeof (accum_denoms[0]))
+
+static gnc_numeric
+accum_total_of (const gnc_numeric *vals, int n, gint64 denom, gint how)
+{
+    GncNumericAccum accum;
+    int i;
+
+    gnc_numeric_accum_init (&accum);
+    for (i = 0; i < n; i++)
+        gnc_numeric_accum_add (&accum, vals[i]);
+    return gnc_numeric_accum_total (&accum, denom, how);
+}
+
+static gnc_numeric
+fold_total_of (const gnc_numeric *vals, int n, gint64 denom, gint how)
+{
+    gnc_numeric sum = gnc_numeric_zero ();
+    int i;
+
+    for (i = 0; i < n; i++)
+        sum = gnc_numeric_add (sum, vals[i], denom, how);
+    return sum;
+}
+
+/* Both the same error, or the same value in the same form. */
+static gboolean
+same_total (gnc_numeric a, gnc_numeric b)
+{
+    if (gnc_numeric_check (a) || gnc_numeric_check (b))
+        return gnc_numeric_check (a) == gnc_numeric_check (b);
+    return gnc_numeric_eq (a, b);
+}
+
+/* Every pair of test values, added up both ways. */
+static void
+check_accum_pairs (void)
+{
+    gnc_numeric vals[2], fold, accum;
+    gboolean lcd_ok = TRUE, exact_ok = TRUE, fixed_ok = TRUE, round_ok = TRUE;
+    guint i, j, k, l;
+
+    for (i = 0; i < N_ACCUM_NUMS; i++)
+        for (j = 0; j < N_ACCUM_DENOMS; j++)
+            for (k = 0; k < N_ACCUM_NUMS; k++)
+                for (l = 0; l < N_ACCUM_DENOMS; l++)
+                {
+                    vals[0] = gnc_numeric_create (accum_nums[i], accum_denoms[j]);
+                    vals[1] = gnc_numeric_create (accum_nums[k], accum_denoms[l]);
+
+                    fold = fold_total_of (vals, 2, GNC_DENOM_AUTO,
+                                          GNC_HOW_DENOM_LCD);
+                    accum = accum_total_of (vals, 2, GNC_DENOM_AUTO,
+                                            GNC_HOW_DENOM_LCD);
+                    if (!same_total (fold, accum))
+                        lcd_ok = FALSE;
+
+                    /* Rounded once, from the exact sum. */
+                    accum = accum_total_of (vals, 2, 100, GNC_HOW_RND_ROUND);
+                    if (!gnc_numeric_check (fold)
+                            && !same_total (gnc_numeric_convert
+                                            (fold, 100, GNC_HOW_RND_ROUND),
+                                            accum))
+                        round_ok = FALSE;
+
+                    fold = fold_total_of (vals, 2, GNC_DENOM_AUTO,
+                                          GNC_HOW_DENOM_EXACT);
+                    accum = accum_total_of (vals, 2, GNC_DENOM_AUTO,
+                                            GNC_HOW_DENOM_EXACT);
+                    if (!same_total (fold, accum))
+                        exact_ok = FALSE;
+
+                    /* A zero total may come out over another
+                     * denominator. */
+                    fold = fold_total_of (vals, 2, GNC_DENOM_AUTO,
+                                          GNC_HOW_DENOM_FIXED |
+                                          GNC_HOW_RND_NEVER);
+                    accum = accum_total_of (vals, 2, GNC_DENOM_AUTO,
+                                            GNC_HOW_DENOM_FIXED |
+                                            GNC_HOW_RND_NEVER);
+                    if (gnc_numeric_zero_p (fold) ?
+                            !gnc_numeric_zero_p (accum) :
+                            !same_total (fold, accum))
+                        fixed_ok = FALSE;
+                }
+
+    do_test (lcd_ok, "accumulated pairs match gnc_numeric_add with LCD");
+    do_test (exact_ok, "accumulated pairs match gnc_numeric_add with EXACT");
+    do_test (fixed_ok, "accumulated pairs match gnc_numeric_add with FIXED");
+    do_test (round_ok, "accumulated pairs round like their exact sum");
+}
+
+/* Runs of random values over more denominators than the accumulator
+ * has slots for. */
+static void
+check_accum_sequences (void)
+{
+    gnc_numeric vals[64];
+    gboolean ok = TRUE;
+    int i, n, rep;
+
+    for (rep = 0; rep < NREPS; rep++)
+    {
+        n = get_random_int_in_range (1, 64);
+        for (i = 0; i < n; i++)
+            vals[i] = gnc_numeric_create
+                      (get_random_int_in_range (-1000000000, 1000000000),
+                       accum_denoms[get_random_int_in_range
+                                    (0, N_ACCUM_DENOMS - 1)]);
+
+        if (!same_total (fold_total_of (vals, n, GNC_DENOM_AUTO,
+                                        GNC_HOW_DENOM_LCD),
+                         accum_total_of (vals, n, GNC_DENOM_AUTO,
+                                         GNC_HOW_DENOM_LCD)))
+            ok = FALSE;
+    }
+    do_test (ok, "accumulated sequences match gnc_numeric_add");
+}
+
+#define N_ACCUM_ARRAY 1000
+
+static void
+check_accum_nums (void)
+{
+    GncNumericAccum by_one, by_array;
+    gint64 nums[N_ACCUM_ARRAY];
+    gnc_numeric vals[N_ACCUM_ARRAY];
+    gboolean same = TRUE, exact = TRUE;
+    int i, rep;
+
+    for (rep = 0; rep < 100; rep++)
+    {
+        /* Mostly small values, with some at the ends of the range. */
+        for (i = 0; i < N_ACCUM_ARRAY; i++)
+            nums[i] = get_random_int_in_range (-1000000, 1000000);
+        for (i = rep; i < N_ACCUM_ARRAY; i += 97)
+            nums[i] = rep % 2 ? G_MAXINT64 : -G_MAXINT64;
+
+        gnc_numeric_accum_init (&by_one);
+        gnc_numeric_accum_init (&by_array);
+        for (i = 0; i < N_ACCUM_ARRAY; i++)
+            gnc_numeric_accum_add (&by_one, gnc_numeric_create (nums[i], 100));
+        for (i = 0; i < N_ACCUM_ARRAY; i += N_ACCUM_ARRAY / 4)
+            gnc_numeric_accum_add_nums (&by_array, nums + i,
+                                        N_ACCUM_ARRAY / 4, 100);
+        if (!same_total (gnc_numeric_accum_total (&by_one, GNC_DENOM_AUTO,
+                         GNC_HOW_DENOM_LCD),
+                         gnc_numeric_accum_total (&by_array, GNC_DENOM_AUTO,
+                                 GNC_HOW_DENOM_LCD)))
+            same = FALSE;
+
+        /* Without the big ones gnc_numeric_add cannot overflow. */
+        for (i = rep; i < N_ACCUM_ARRAY; i += 97)
+            nums[i] = 0;
+        for (i = 0; i < N_ACCUM_ARRAY; i++)
+            vals[i] = gnc_numeric_create (nums[i], 100);
+        gnc_numeric_accum_init (&by_array);
+        gnc_numeric_accum_add_nums (&by_array, nums, N_ACCUM_ARRAY, 100);
+        if (!same_total (gnc_numeric_accum_total (&by_array, GNC_DENOM_AUTO,
+                         GNC_HOW_DENOM_LCD),
+                         fold_total_of (vals, N_ACCUM_ARRAY, GNC_DENOM_AUTO,
+                                        GNC_HOW_DENOM_LCD)))
+            exact = FALSE;
+    }
+    do_test (same, "adding arrays matches adding one by one");
+    do_test (exact, "adding arrays matches gnc_numeric_add");
+}
+
+static void
+check_accum_edges (void)
+{
+    GncNumericAccum accum;
+    gnc_numeric total;
+
+    gnc_numeric_accum_init (&accum);
+    check_unary_op (gnc_numeric_eq, gnc_numeric_zero (),
+                    gnc_numeric_accum_total (&accum, GNC_DENOM_AUTO,
+                            GNC_HOW_DENOM_LCD),
+                    gnc_numeric_zero (), "expected %s got %s for empty sum %s");
+
+    /* The running sum may leave the 64-bit range on the way. */
+    gnc_numeric_accum_add (&accum, gnc_numeric_create (G_MAXINT64, 100));
+    gnc_numeric_accum_add (&accum, gnc_numeric_create (G_MAXINT64, 100));
+    total = gnc_numeric_accum_total (&accum, GNC_DENOM_AUTO,
+                                     GNC_HOW_DENOM_LCD);
+    do_test (gnc_numeric_check (total) == GNC_ERROR_OVERFLOW,
+             "a total beyond 64 bits overflows");
+    gnc_numeric_accum_add (&accum, gnc_numeric_create (-G_MAXINT64, 100));
+    check_unary_op (gnc_numeric_eq, gnc_numeric_create (G_MAXINT64, 100),
+                    gnc_numeric_accum_total (&accum, GNC_DENOM_AUTO,
+                            GNC_HOW_DENOM_LCD),
+                    gnc_numeric_create (G_MAXINT64, 100),
+                    "expected %s got %s for sum back to %s");
+
+    /* Reciprocal denominators give integers bigger than 64 bits. */
+    gnc_numeric_accum_init (&accum);
+    gnc_numeric_accum_add (&accum, gnc_numeric_create (G_MAXINT64, -4));
+    gnc_numeric_accum_add (&accum, gnc_numeric_create (-G_MAXINT64, -4));
+    gnc_numeric_accum_add (&accum, gnc_numeric_create (3, -10));
+    check_unary_op (gnc_numeric_eq, gnc_numeric_create (30, 1),
+                    gnc_numeric_accum_total (&accum, GNC_DENOM_AUTO,
+                            GNC_HOW_DENOM_LCD),
+                    gnc_numeric_create (3, -10),
+                    "expected %s got %s for reciprocal sum %s");
+
+    /* Scaling to the common denominator may overflow too. */
+    gnc_numeric_accum_init (&accum);
+    gnc_numeric_accum_add (&accum, gnc_numeric_create (G_MAXINT64 / 2, 1));
+    gnc_numeric_accum_add (&accum, gnc_numeric_create (1, 3));
+    total = gnc_numeric_accum_total (&accum, GNC_DENOM_AUTO,
+                                     GNC_HOW_DENOM_LCD);
+    do_test (gnc_numeric_check (total) == GNC_ERROR_OVERFLOW,
+             "scaling a total beyond 64 bits overflows");
+
+    gnc_numeric_accum_init (&accum);
+    gnc_numeric_accum_add (&accum, gnc_numeric_create (1, 2));
+    gnc_numeric_accum_add (&accum, gnc_numeric_error (GNC_ERROR_ARG));
+    gnc_numeric_accum_add (&accum, gnc_numeric_create (1, 2));
+    total = gnc_numeric_accum_total (&accum, GNC_DENOM_AUTO,
+                                     GNC_HOW_DENOM_LCD);
+    do_test (gnc_numeric_check (total) == GNC_ERROR_ARG,
+             "an invalid value spoils the total");
+}
+
+static void
+check_accumulator (void)
+{
+    check_accum_pairs ();
+    check_accum_sequences ();
+    check_accum_nums ();
+    check_accum_edges ();
+}
+
+/* ======================================================= */
+
+/* Time adding up 'n' values in hundredths with gnc_numeric_add(),
+ * with an accumulator value by value, and with one as an array. */
+static void
+run_benchmark (int n)
+{
+    gint64 *nums = g_new (gint64, n);
+    gnc_numeric *vals = g_new (gnc_numeric, n);
+    gnc_numeric sum, by_add, by_one, by_array;
+    GncNumericAccum accum;
+    GTimer *timer = g_timer_new ();
+    gdouble t_add, t_one, t_array;
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        nums[i] = get_random_int_in_range (-1000000, 1000000);
+        vals[i] = gnc_numeric_create (nums[i], 100);
+    }
+
+    g_timer_start (timer);
+    sum = gnc_numeric_zero ();
+    for (i = 0; i < n; i++)
+        sum = gnc_numeric_add (sum, vals[i], GNC_DENOM_AUTO,
+                               GNC_HOW_DENOM_LCD);
+    by_add = sum;
+    t_add = g_timer_elapsed (timer, NULL);
+
+    g_timer_start (timer);
+    gnc_numeric_accum_init (&accum);
+    for (i = 0; i < n; i++)
+        gnc_numeric_accum_add (&accum, vals[i]);
+    by_one = gnc_numeric_accum_total (&accum, GNC_DENOM_AUTO,
+                                      GNC_HOW_DENOM_LCD);
+    t_one = g_timer_elapsed (timer, NULL);
+
+    g_timer_start (timer);
+    gnc_numeric_accum_init (&accum);
+    gnc_numeric_accum_add_nums (&accum, nums, n, 100);
+    by_array = gnc_numeric_accum_total (&accum, GNC_DENOM_AUTO,
+                                        GNC_HOW_DENOM_LCD);
+    t_array = g_timer_elapsed (timer, NULL);
+
+    do_test (gnc_numeric_eq (by_add, by_one) && gnc_numeric_eq (by_add, by_array),
+             "benchmark sums agree");
+    printf ("%10d values:  add %8.4fs  accum %8.4fs  accum array %8.4fs\n",
+            n, t_add, t_one, t_array);
+
+    g_timer_destroy (timer);
+    g_free (vals);
+    g_free (nums);
+}
+
+/* ======================================================= */
+
 static void
 run_test (void)
 {
@@ -873,6 +1174,7 @@ run_test (void)
     check_add_subtract();
     check_mult_div ();
     check_reciprocal();
+    check_accumulator();
 }
 
 int
@@ -881,7 +1183,13 @@ main (int argc, char **argv)
     qof_init();
     if (cashobjects_register())
     {
-        run_test ();
+        int i;
+
+        /* Value counts on the command line time the accumulator. */
+        if (argc < 2)
+            run_test ();
+        for (i = 1; i < argc; i++)
+            run_benchmark (atoi (argv[i]));
         print_test_results();
     }
     qof_close();
@@ -0,0 +1,413 @@
+/***************************************************************************
+ *            test-query-index.c
+ *
+ *  Tests and benchmark for queries answered from secondary indexes.
+ ****************************************************************************/
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301, USA.
+ */
+/**
+ * @file test-query-index.c
+ * @brief Check indexed queries against a walk over the whole book.
+ *
+ * Run without arguments this is a quick correctness test, including
+ * transactions that are open for editing.  Give it transaction counts
+ * to get timings, e.g.
+ *
+ *   test-query-index 10000 100000 500000
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include "qof.h"
+#include "cashobjects.h"
+#include "Account.h"
+#include "Query.h"
+#include "Split.h"
+#include "Transaction.h"
+#include "TransLog.h"
+#include "test-stuff.h"
+#include "test-engine-stuff.h"
+
+#define NUM_ACCOUNTS 20
+#define NUM_DAYS 3650
+#define DAY 86400
+
+static Account *accounts[NUM_ACCOUNTS];
+
+static Split *
+add_split (QofBook *book, Transaction *trans, Account *acc)
+{
+    Split *split = xaccMallocSplit (book);
+
+    xaccSplitSetParent (split, trans);
+    xaccSplitSetAccount (split, acc);
+    return split;
+}
+
+/* 'n' two-split transactions between random accounts on random days */
+static void
+make_book (QofBook *book, gnc_commodity *currency, guint n)
+{
+    Account *root = gnc_book_get_root_account (book);
+    guint i;
+
+    for (i = 0; i < NUM_ACCOUNTS; i++)
+    {
+        gchar *name = g_strdup_printf ("Account %u", i);
+
+        accounts[i] = xaccMallocAccount (book);
+        xaccAccountBeginEdit (accounts[i]);
+        xaccAccountSetName (accounts[i], name);
+        xaccAccountSetCommodity (accounts[i], currency);
+        xaccAccountCommitEdit (accounts[i]);
+        gnc_account_append_child (root, accounts[i]);
+        g_free (name);
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        Transaction *trans = xaccMallocTransaction (book);
+
+        xaccTransBeginEdit (trans);
+        xaccTransSetCurrency (trans, currency);
+        xaccTransSetDatePostedSecs (trans, DAY * (time_t)(rand () % NUM_DAYS));
+        add_split (book, trans, accounts[rand () % NUM_ACCOUNTS]);
+        add_split (book, trans, accounts[rand () % NUM_ACCOUNTS]);
+        xaccTransCommitEdit (trans);
+    }
+}
+
+/* What a query should find, worked out the slow way */
+typedef struct
+{
+    Account *acc_a;
+    Account *acc_b;
+    time_t lo;
+    time_t hi;
+    GHashTable *found;
+} Expect;
+
+static gboolean
+expect_date (const Expect *e, Transaction *trans)
+{
+    time_t t = xaccTransGetDate (trans);
+    return e->lo <= t && t <= e->hi;
+}
+
+static void
+expect_split_cb (QofInstance *inst, gpointer data)
+{
+    Expect *e = data;
+    Split *split = GNC_SPLIT (inst);
+    Account *acc = xaccSplitGetAccount (split);
+    Transaction *trans = xaccSplitGetParent (split);
+
+    if (e->acc_a && acc != e->acc_a && acc != e->acc_b)
+        return;
+    if (e->hi && (!trans || !expect_date (e, trans)))
+        return;
+    g_hash_table_insert (e->found, split, split);
+}
+
+static void
+expect_trans_cb (QofInstance *inst, gpointer data)
+{
+    Expect *e = data;
+
+    if (expect_date (e, GNC_TRANS (inst)))
+        g_hash_table_insert (e->found, inst, inst);
+}
+
+static gboolean
+same_results (GList *results, GHashTable *expected)
+{
+    GList *node;
+
+    if (g_list_length (results) != g_hash_table_size (expected))
+        return FALSE;
+    for (node = results; node; node = node->next)
+        if (!g_hash_table_lookup (expected, node->data))
+            return FALSE;
+    return TRUE;
+}
+
+static gboolean
+explain_mentions (QofQuery *q, const char *what)
+{
+    gchar *plan = qof_query_explain (q);
+    gboolean found = plan && strstr (plan, what) != NULL;
+
+    g_free (plan);
+    return found;
+}
+
+/* Splits in either of two accounts, optionally within dates */
+static QofQuery *
+make_split_query (QofBook *book, const Expect *e)
+{
+    QofQuery *q = qof_query_create_for (GNC_ID_SPLIT);
+
+    qof_query_set_book (q, book);
+    if (e->acc_a)
+    {
+        xaccQueryAddSingleAccountMatch (q, e->acc_a, QOF_QUERY_AND);
+        if (e->acc_b)
+            xaccQueryAddSingleAccountMatch (q, e->acc_b, QOF_QUERY_OR);
+    }
+    if (e->hi)
+        xaccQueryAddDateMatchTT (q, TRUE, e->lo, TRUE, e->hi, QOF_QUERY_AND);
+    return q;
+}
+
+static QofQuery *
+make_trans_query (QofBook *book, const Expect *e)
+{
+    QofQuery *q = qof_query_create_for (GNC_ID_TRANS);
+    Timespec ts;
+
+    qof_query_set_book (q, book);
+    ts.tv_nsec = 0;
+    ts.tv_sec = e->lo;
+    qof_query_add_term (q, qof_query_build_param_list (TRANS_DATE_POSTED, NULL),
+                        qof_query_date_predicate (QOF_COMPARE_GTE,
+                                QOF_DATE_MATCH_NORMAL, ts), QOF_QUERY_AND);
+    ts.tv_sec = e->hi;
+    qof_query_add_term (q, qof_query_build_param_list (TRANS_DATE_POSTED, NULL),
+                        qof_query_date_predicate (QOF_COMPARE_LTE,
+                                QOF_DATE_MATCH_NORMAL, ts), QOF_QUERY_AND);
+    return q;
+}
+
+/* Run 'q' and compare it with a walk over the book */
+static void
+check_query (QofBook *book, QofQuery *q, Expect *e, const char *index,
+             const char *msg)
+{
+    QofIdTypeConst type = qof_query_get_search_for (q);
+    GList *results;
+
+    e->found = g_hash_table_new (g_direct_hash, g_direct_equal);
+    qof_collection_foreach (qof_book_get_collection (book, type),
+                            safe_strcmp (type, GNC_ID_SPLIT) ?
+                            expect_trans_cb : expect_split_cb, e);
+    results = qof_query_run (q);
+
+    do_test_args (same_results (results, e->found), msg, __FILE__, __LINE__,
+                  "%d results, expected %d", g_list_length (results),
+                  g_hash_table_size (e->found));
+    if (index)
+        do_test_args (explain_mentions (q, index), "query uses its index",
+                      __FILE__, __LINE__, "%s: no %s", msg, index);
+    g_hash_table_destroy (e->found);
+}
+
+static void
+test_queries (QofBook *book)
+{
+    Expect e;
+    QofQuery *q;
+
+    memset (&e, 0, sizeof (e));
+    e.acc_a = accounts[3];
+    q = make_split_query (book, &e);
+    check_query (book, q, &e, "split-by-account", "splits in one account");
+    qof_query_destroy (q);
+
+    e.acc_b = accounts[7];
+    q = make_split_query (book, &e);
+    check_query (book, q, &e, "split-by-account", "splits in either account");
+    qof_query_destroy (q);
+
+    e.acc_a = e.acc_b = NULL;
+    e.lo = DAY * 1000;
+    e.hi = DAY * 1030;
+    q = make_split_query (book, &e);
+    check_query (book, q, &e, "split-by-transaction-date", "splits by date");
+    qof_query_destroy (q);
+
+    q = make_trans_query (book, &e);
+    check_query (book, q, &e, "transaction-by-date", "transactions by date");
+    qof_query_destroy (q);
+
+    e.acc_a = accounts[5];
+    q = make_split_query (book, &e);
+    check_query (book, q, &e, NULL, "splits in an account by date");
+    qof_query_destroy (q);
+
+    /* Dates before and after everything */
+    memset (&e, 0, sizeof (e));
+    e.lo = -DAY * 100;
+    e.hi = -DAY;
+    q = make_trans_query (book, &e);
+    check_query (book, q, &e, NULL, "no transactions before the first");
+    qof_query_destroy (q);
+    e.lo = DAY * NUM_DAYS;
+    e.hi = DAY * (NUM_DAYS + 100);
+    q = make_trans_query (book, &e);
+    check_query (book, q, &e, NULL, "no transactions after the last");
+    qof_query_destroy (q);
+}
+
+static void
+test_guid_lookup (QofBook *book)
+{
+    Split *split = xaccAccountGetSplitList (accounts[0])->data;
+    QofQuery *q = qof_query_create_for (GNC_ID_SPLIT);
+    GList *results;
+
+    qof_query_set_book (q, book);
+    xaccQueryAddGUIDMatch (q, qof_instance_get_guid (split), GNC_ID_SPLIT,
+                           QOF_QUERY_AND);
+    results = qof_query_run (q);
+    do_test (g_list_length (results) == 1 && results->data == split,
+             "split found by GUID");
+    do_test (explain_mentions (q, "GUID lookup"), "split looked up by GUID");
+    qof_query_destroy (q);
+}
+
+/* Edits in progress have to be found before they're committed */
+static void
+test_open_edits (QofBook *book)
+{
+    Split *split = xaccAccountGetSplitList (accounts[1])->data;
+    Transaction *trans = xaccSplitGetParent (split);
+    time_t date = xaccTransGetDate (trans);
+    time_t new_date = date < DAY * 2000 ? DAY * 3000 : DAY * 1000;
+    Expect e;
+    QofQuery *q;
+
+    xaccTransBeginEdit (trans);
+    xaccTransSetDatePostedSecs (trans, new_date);
+    xaccSplitSetAccount (split, accounts[2]);
+
+    memset (&e, 0, sizeof (e));
+    e.lo = new_date;
+    e.hi = new_date;
+    q = make_trans_query (book, &e);
+    check_query (book, q, &e, NULL, "open transaction found by its new date");
+    qof_query_destroy (q);
+
+    e.lo = e.hi = 0;
+    e.acc_a = accounts[2];
+    q = make_split_query (book, &e);
+    check_query (book, q, &e, NULL, "open split found in its new account");
+    qof_query_destroy (q);
+
+    xaccTransCommitEdit (trans);
+    test_queries (book);
+
+    xaccTransBeginEdit (trans);
+    xaccTransSetDatePostedSecs (trans, date);
+    xaccSplitSetAccount (split, accounts[1]);
+    xaccTransRollbackEdit (trans);
+    test_queries (book);
+
+    xaccTransDestroy (trans);
+    test_queries (book);
+}
+
+static gdouble
+time_query (QofQuery *q, guint *count)
+{
+    GTimer *timer = g_timer_new ();
+    GList *results = qof_query_run (q);
+    gdouble secs = g_timer_elapsed (timer, NULL);
+
+    *count = g_list_length (results);
+    g_timer_destroy (timer);
+    return secs;
+}
+
+static void
+run_size (guint n)
+{
+    QofSession *session = qof_session_new ();
+    QofBook *book = qof_session_get_book (session);
+    gnc_commodity *currency = get_random_commodity (book);
+    QofQuery *q;
+    Expect e;
+    guint count;
+    gdouble secs;
+
+    make_book (book, currency, n);
+
+    memset (&e, 0, sizeof (e));
+    e.acc_a = accounts[3];
+    q = make_split_query (book, &e);
+    secs = time_query (q, &count);
+    printf ("%8u txs  account:    %8u splits %8.3fs\n", n, count, secs);
+    qof_query_destroy (q);
+
+    e.acc_a = NULL;
+    e.lo = DAY * 1000;
+    e.hi = DAY * 1030;
+    q = make_split_query (book, &e);
+    /* The first date query builds the index */
+    secs = time_query (q, &count);
+    printf ("%8u txs  date (1st): %8u splits %8.3fs\n", n, count, secs);
+    secs = time_query (q, &count);
+    printf ("%8u txs  date:       %8u splits %8.3fs\n", n, count, secs);
+    qof_query_destroy (q);
+
+    /* The same splits, but frozen splits, of which there are none,
+     * have no index to come from, so the book is scanned */
+    q = qof_query_create_for (GNC_ID_SPLIT);
+    qof_query_set_book (q, book);
+    xaccQueryAddDateMatchTT (q, TRUE, e.lo, TRUE, e.hi, QOF_QUERY_AND);
+    xaccQueryAddClearedMatch (q, CLEARED_FROZEN, QOF_QUERY_OR);
+    secs = time_query (q, &count);
+    printf ("%8u txs  date, scan: %8u splits %8.3fs\n", n, count, secs);
+    qof_query_destroy (q);
+
+    qof_session_end (session);
+    qof_session_destroy (session);
+}
+
+int
+main (int argc, char **argv)
+{
+    QofSession *session;
+    QofBook *book;
+    int i;
+
+    qof_init();
+    if (!cashobjects_register())
+        exit(1);
+    xaccLogDisable ();
+    srand(0);
+
+    if (argc < 2)
+    {
+        session = qof_session_new ();
+        book = qof_session_get_book (session);
+        make_book (book, get_random_commodity (book), 2000);
+        test_queries (book);
+        test_guid_lookup (book);
+        test_open_edits (book);
+        qof_session_end (session);
+        qof_session_destroy (session);
+    }
+    for (i = 1; i < argc; i++)
+        run_size ((guint)atoi (argv[i]));
+
+    print_test_results();
+    qof_close();
+    return get_rv();
+}
@@ -22,9 +22,12 @@
  */
 
 #include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
 #include <glib.h>
 #include "qof.h"
 #include "cashobjects.h"
+#include "Account.h"
 #include "Transaction.h"
 #include "TransLog.h"
 #include "gnc-engine.h"
@@ -65,6 +68,48 @@ test_trans_query (Transaction *trans, gpointer data)
     return 0;
 }
 
+/* A query limited to 'max' results should return the last 'max' of
+ * the full results, whether or not it is sorted. */
+static gboolean
+check_max_results (QofBook *book, gboolean sorted, int max)
+{
+    QofQuery *q = qof_query_create_for (GNC_ID_SPLIT);
+    GList *all, *some, *tail;
+    gboolean same;
+
+    qof_query_set_book (q, book);
+    if (!sorted)
+        qof_query_set_sort_order (q, NULL, NULL, NULL);
+    all = g_list_copy (qof_query_run (q));
+
+    qof_query_set_max_results (q, max);
+    some = qof_query_run (q);
+
+    tail = g_list_nth (all, MAX ((int) g_list_length (all) - max, 0));
+    for (same = TRUE; tail && some; tail = tail->next, some = some->next)
+        if (tail->data != some->data)
+            same = FALSE;
+    same = same && !tail && !some;
+
+    g_list_free (all);
+    qof_query_destroy (q);
+    return same;
+}
+
+static void
+test_max_results (QofBook *book)
+{
+    int max;
+
+    for (max = 0; max < 50; max += 7)
+    {
+        do_test_args (check_max_results (book, TRUE, max), "sorted max_results",
+                      __FILE__, __LINE__, "max_results %d", max);
+        do_test_args (check_max_results (book, FALSE, max), "unsorted max_results",
+                      __FILE__, __LINE__, "max_results %d", max);
+    }
+}
+
 static void
 run_test (void)
 {
@@ -79,10 +124,77 @@ run_test (void)
     add_random_transactions_to_book (book, 20);
 
     xaccAccountTreeForEachTransaction (root, test_trans_query, book);
+    test_max_results (book);
 
     qof_session_end (session);
 }
 
+/* 'n' splits in n / 2 transactions on random dates */
+static void
+make_splits (QofBook *book, guint n)
+{
+    gnc_commodity *currency = get_random_commodity (book);
+    Account *acc = xaccMallocAccount (book);
+    guint i;
+
+    xaccAccountBeginEdit (acc);
+    xaccAccountSetCommodity (acc, currency);
+    xaccAccountCommitEdit (acc);
+    gnc_account_append_child (gnc_book_get_root_account (book), acc);
+
+    for (i = 0; i < n / 2; i++)
+    {
+        Transaction *trans = xaccMallocTransaction (book);
+        Split *s1 = xaccMallocSplit (book);
+        Split *s2 = xaccMallocSplit (book);
+
+        xaccTransBeginEdit (trans);
+        xaccTransSetCurrency (trans, currency);
+        xaccTransSetDatePostedSecs (trans, 86400 * (time_t)(rand () % 10000));
+        xaccSplitSetParent (s1, trans);
+        xaccSplitSetParent (s2, trans);
+        xaccSplitSetAccount (s1, acc);
+        xaccSplitSetAccount (s2, acc);
+        xaccTransCommitEdit (trans);
+    }
+}
+
+/* Time the last 100 splits in date order, taken by sorting them all
+ * and cropping the list, and by letting the query keep only 100. */
+static void
+run_benchmark (guint n)
+{
+    QofSession *session = qof_session_new ();
+    QofBook *book = qof_session_get_book (session);
+    QofQuery *q = qof_query_create_for (GNC_ID_SPLIT);
+    GTimer *timer = g_timer_new ();
+    GList *list;
+    gdouble t_full, t_topk;
+
+    make_splits (book, n);
+    qof_query_set_book (q, book);
+
+    g_timer_start (timer);
+    list = qof_query_run (q);
+    list = g_list_nth (list, MAX ((int) g_list_length (list) - 100, 0));
+    t_full = g_timer_elapsed (timer, NULL);
+    do_test (g_list_length (list) == MIN (n & ~1u, 100), "full sort result");
+
+    qof_query_set_max_results (q, 100);
+    g_timer_start (timer);
+    list = qof_query_run (q);
+    t_topk = g_timer_elapsed (timer, NULL);
+    do_test (g_list_length (list) == MIN (n & ~1u, 100), "top-k result");
+
+    printf ("%8u splits  sort and crop %8.3fs  max_results %8.3fs\n",
+            n, t_full, t_topk);
+
+    g_timer_destroy (timer);
+    qof_query_destroy (q);
+    qof_session_end (session);
+    qof_session_destroy (session);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -101,6 +213,15 @@ main (int argc, char **argv)
         goto cleanup;
     }
 
+    /* Given split counts, e.g. 1000000, just run the benchmark */
+    if (argc > 1)
+    {
+        for (i = 1; i < argc; i++)
+            run_benchmark ((guint)atoi (argv[i]));
+        print_test_results();
+        goto cleanup;
+    }
+
     /* Loop the test. */
     for (i = 0; i < 10; i++)
     {
@@ -0,0 +1,392 @@
+/***************************************************************************
+ *            test-split-index.c
+ *
+ *  Tests and micro-benchmark for the account split index.
+ ****************************************************************************/
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301, USA.
+ */
+/**
+ * @file test-split-index.c
+ * @brief Check GncSplitIndex against a sorted GList and time both.
+ *
+ * Run without arguments this is a quick correctness test.  Give it
+ * split counts to get a benchmark, e.g.
+ *
+ *   test-split-index 10000 100000 1000000
+ *
+ * The sorted GList is quadratic, so it is skipped above 100k splits.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <glib.h>
+#include "qof.h"
+#include "cashobjects.h"
+#include "Account.h"
+#include "Split.h"
+#include "Transaction.h"
+#include "TransLog.h"
+#include "gnc-split-index.h"
+#include "test-stuff.h"
+#include "test-engine-stuff.h"
+
+#define GLIST_LIMIT 100000
+
+/* Build 'n' single-split transactions with shuffled posting dates. */
+static Split **
+make_splits (QofBook *book, gnc_commodity *currency, guint n)
+{
+    Split **splits = g_new (Split *, n);
+    guint i;
+
+    for (i = 0; i < n; i++)
+    {
+        Transaction *trans = xaccMallocTransaction (book);
+        Split *split = xaccMallocSplit (book);
+
+        xaccTransBeginEdit (trans);
+        xaccTransSetCurrency (trans, currency);
+        xaccTransSetDatePostedSecs (trans, 86400 * (time_t)(rand () % 10000));
+        xaccSplitSetParent (split, trans);
+        xaccTransCommitEdit (trans);
+        splits[i] = split;
+    }
+    return splits;
+}
+
+static gdouble
+elapsed (GTimer *timer)
+{
+    gdouble secs = g_timer_elapsed (timer, NULL);
+    g_timer_start (timer);
+    return secs;
+}
+
+static void
+run_size (QofBook *book, gnc_commodity *currency, guint n, gboolean verbose)
+{
+    Split **splits = make_splits (book, currency, n);
+    GncSplitIndex *idx = gnc_split_index_new ((GCompareFunc)xaccSplitOrder);
+    GList *list = NULL, *la, *lb;
+    GTimer *timer = g_timer_new ();
+    gboolean same = TRUE;
+    gdouble t_insert, t_find, t_remove;
+    guint i;
+
+    /* The index */
+    g_timer_start (timer);
+    for (i = 0; i < n; i++)
+        gnc_split_index_insert (idx, splits[i]);
+    t_insert = elapsed (timer);
+    for (i = 0; i < n; i++)
+        if (!gnc_split_index_lookup (idx, splits[i]))
+            same = FALSE;
+    t_find = elapsed (timer);
+    for (i = 0; i < n; i += 2)
+        gnc_split_index_remove (idx, splits[i]);
+    t_remove = elapsed (timer);
+
+    do_test (same, "every inserted split is found");
+    do_test (gnc_split_index_size (idx) == n / 2, "index size after removal");
+    if (verbose)
+        printf ("%8u splits  index:  insert %8.3fs  find %8.3fs  remove %8.3fs\n",
+                n, t_insert, t_find, t_remove);
+
+    /* The sorted GList the account used to keep */
+    if (n <= GLIST_LIMIT)
+    {
+        g_timer_start (timer);
+        for (i = 0; i < n; i++)
+            if (!g_list_find (list, splits[i]))
+                list = g_list_insert_sorted (list, splits[i],
+                                             (GCompareFunc)xaccSplitOrder);
+        t_insert = elapsed (timer);
+        for (i = 0; i < n; i++)
+            if (!g_list_find (list, splits[i]))
+                same = FALSE;
+        t_find = elapsed (timer);
+        for (i = 0; i < n; i += 2)
+            list = g_list_delete_link (list, g_list_find (list, splits[i]));
+        t_remove = elapsed (timer);
+
+        for (la = list, lb = gnc_split_index_get_list (idx);
+                la && lb; la = la->next, lb = lb->next)
+            if (la->data != lb->data)
+                same = FALSE;
+        do_test (same && !la && !lb, "index order matches sorted GList");
+        if (verbose)
+            printf ("%8u splits  GList:  insert %8.3fs  find %8.3fs  remove %8.3fs\n",
+                    n, t_insert, t_find, t_remove);
+        g_list_free (list);
+    }
+    else if (verbose)
+    {
+        printf ("%8u splits  GList:  skipped\n", n);
+    }
+
+    g_timer_destroy (timer);
+    gnc_split_index_destroy (idx);
+    g_free (splits);
+}
+
+static time_t
+split_date (gconstpointer split)
+{
+    return xaccTransGetDate (xaccSplitGetParent ((Split *)split));
+}
+
+/* Order splits by posting date alone, against a time_t key. */
+static gint
+compare_date (gconstpointer split, gconstpointer key)
+{
+    time_t a = split_date (split), b = *(const time_t *)key;
+    return a < b ? -1 : a > b ? 1 : 0;
+}
+
+static gboolean
+list_in_order (GList *list)
+{
+    for (; list && list->next; list = list->next)
+        if (xaccSplitOrder (list->data, list->next->data) > 0)
+            return FALSE;
+    return TRUE;
+}
+
+/* The search must find the last split on or before every date, and
+ * nothing before the first. */
+static gboolean
+search_matches_list (GncSplitIndex *idx)
+{
+    GList *node, *found;
+    time_t key;
+
+    for (node = gnc_split_index_get_list (idx); node; node = node->next)
+    {
+        key = split_date (node->data);
+        found = gnc_split_index_search (idx, compare_date, &key);
+        if (!found || split_date (found->data) != key
+                || (found->next && split_date (found->next->data) <= key))
+            return FALSE;
+        key--;
+        found = gnc_split_index_search (idx, compare_date, &key);
+        if (found && (split_date (found->data) > key
+                      || (found->next && split_date (found->next->data) <= key)))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static void
+run_order_test (QofBook *book, gnc_commodity *currency)
+{
+    const guint n = 500;
+    Split **splits = make_splits (book, currency, n);
+    GncSplitIndex *idx = gnc_split_index_new ((GCompareFunc)xaccSplitOrder);
+    GList *first, *last;
+    time_t key;
+    guint i;
+
+    /* Prepended in arbitrary order, sorted afterwards. */
+    for (i = 0; i < n; i++)
+        gnc_split_index_prepend (idx, splits[i]);
+    do_test (gnc_split_index_prepend (idx, splits[0]) == NULL,
+             "prepending a present split fails");
+    do_test (gnc_split_index_get_list (idx)->data == splits[n - 1]
+             && gnc_split_index_get_last (idx)->data == splits[0],
+             "prepend puts splits at the head");
+    do_test (gnc_split_index_sort (idx), "sort after prepends reorders");
+    do_test (list_in_order (gnc_split_index_get_list (idx)),
+             "list is in order after sort");
+    do_test (!gnc_split_index_sort (idx), "sorting a sorted index is a no-op");
+    do_test (g_list_last (gnc_split_index_get_list (idx))
+             == gnc_split_index_get_last (idx), "last node after sort");
+
+    /* Keys changed behind the index's back, with many equal dates. */
+    for (i = 0; i < n; i += 3)
+    {
+        Transaction *trans = xaccSplitGetParent (splits[i]);
+        xaccTransBeginEdit (trans);
+        xaccTransSetDatePostedSecs (trans, 86400 * (time_t)(rand () % 50));
+        xaccTransCommitEdit (trans);
+    }
+    gnc_split_index_sort (idx);
+    do_test (list_in_order (gnc_split_index_get_list (idx)),
+             "list is in order after keys change");
+    for (i = 0; i < n; i++)
+        if (!gnc_split_index_lookup (idx, splits[i]))
+            break;
+    do_test (i == n, "every split is found after sort");
+    do_test (search_matches_list (idx), "search finds the last split of a date");
+
+    /* The ends of the list. */
+    first = gnc_split_index_get_list (idx);
+    last = gnc_split_index_get_last (idx);
+    key = split_date (first->data) - 1;
+    do_test (gnc_split_index_search (idx, compare_date, &key) == NULL,
+             "search before the first split finds nothing");
+    key = split_date (last->data);
+    do_test (gnc_split_index_search (idx, compare_date, &key) == last,
+             "search at the last date finds the last split");
+    key += 86400;
+    do_test (gnc_split_index_search (idx, compare_date, &key) == last,
+             "search after the last split finds the last split");
+
+    /* Sorted inserts after the sort keep the order and the search. */
+    for (i = 0; i < n; i += 2)
+        gnc_split_index_remove (idx, splits[i]);
+    for (i = 0; i < n; i += 2)
+        gnc_split_index_insert (idx, splits[i]);
+    do_test (gnc_split_index_size (idx) == n
+             && list_in_order (gnc_split_index_get_list (idx))
+             && search_matches_list (idx), "reinserted splits are in order");
+
+    gnc_split_index_clear (idx);
+    key = 0;
+    do_test (gnc_split_index_get_list (idx) == NULL
+             && gnc_split_index_search (idx, compare_date, &key) == NULL,
+             "a cleared index is empty");
+
+    gnc_split_index_destroy (idx);
+    g_free (splits);
+}
+
+/* Append 'n' splits to an account, one transaction at a time, in
+ * date order.  Each lands in place, so none may leave the account
+ * sort-dirty; otherwise every read after an append would scan the
+ * whole list.  Returns how many did. */
+static guint
+append_splits (Account *acc, gnc_commodity *currency, guint n, time_t start)
+{
+    QofBook *book = gnc_account_get_book (acc);
+    guint i, dirty = 0;
+
+    for (i = 0; i < n; i++)
+    {
+        Transaction *trans = xaccMallocTransaction (book);
+        Split *split = xaccMallocSplit (book);
+
+        xaccTransBeginEdit (trans);
+        xaccTransSetCurrency (trans, currency);
+        xaccTransSetDatePostedSecs (trans, start + 86400 * (time_t)i);
+        xaccSplitSetParent (split, trans);
+        xaccSplitSetAccount (split, acc);
+        xaccSplitSetAmount (split, gnc_numeric_create (1, 1));
+        xaccSplitSetValue (split, gnc_numeric_create (1, 1));
+        xaccTransCommitEdit (trans);
+
+        if (gnc_account_get_sort_dirty (acc))
+            dirty++;
+        xaccAccountSortSplits (acc, TRUE);
+    }
+    return dirty;
+}
+
+static void
+run_append_test (QofBook *book, gnc_commodity *currency)
+{
+    Account *acc = xaccMallocAccount (book);
+    Transaction *trans;
+    GList *splits;
+    guint n = 300;
+
+    xaccAccountBeginEdit (acc);
+    xaccAccountSetCommodity (acc, currency);
+    xaccAccountCommitEdit (acc);
+
+    do_test (append_splits (acc, currency, n, 86400) == 0,
+             "appends in date order leave the account sorted");
+    do_test (gnc_numeric_equal (xaccAccountGetBalance (acc),
+                                gnc_numeric_create (n, 1)),
+             "balance after appends");
+
+    /* Moving one split past its neighbours must be noticed. */
+    splits = xaccAccountGetSplitList (acc);
+    trans = xaccSplitGetParent (g_list_nth_data (splits, 10));
+    xaccTransBeginEdit (trans);
+    xaccTransSetDatePostedSecs (trans, 86400 * (time_t)(n + 10));
+    xaccTransCommitEdit (trans);
+    do_test (gnc_account_get_sort_dirty (acc), "a moved split dirties the sort");
+    xaccAccountSortSplits (acc, TRUE);
+    do_test (list_in_order (xaccAccountGetSplitList (acc))
+             && g_list_last (xaccAccountGetSplitList (acc))->data
+             == xaccTransGetSplit (trans, 0), "the moved split is re-sorted");
+
+    /* Changing a date without moving the split doesn't. */
+    trans = xaccSplitGetParent (g_list_nth_data (xaccAccountGetSplitList (acc), 20));
+    xaccTransBeginEdit (trans);
+    xaccTransSetDatePostedSecs (trans, xaccTransGetDate (trans) + 3600);
+    xaccTransCommitEdit (trans);
+    do_test (!gnc_account_get_sort_dirty (acc),
+             "a split that stays in place keeps the sort clean");
+}
+
+/* Time appending 'n' splits to one account, reading its sorted split
+ * list after each, as a register or a loader does. */
+static void
+run_append_benchmark (QofBook *book, gnc_commodity *currency, guint n)
+{
+    Account *acc = xaccMallocAccount (book);
+    GTimer *timer = g_timer_new ();
+    guint dirty;
+
+    xaccAccountBeginEdit (acc);
+    xaccAccountSetCommodity (acc, currency);
+    xaccAccountCommitEdit (acc);
+
+    g_timer_start (timer);
+    dirty = append_splits (acc, currency, n, 86400);
+    printf ("%8u splits  append:  %8.3fs  (%u left the account unsorted)\n",
+            n, g_timer_elapsed (timer, NULL), dirty);
+    g_timer_destroy (timer);
+}
+
+int
+main (int argc, char **argv)
+{
+    QofSession *session;
+    QofBook *book;
+    gnc_commodity *currency;
+    int i;
+
+    qof_init();
+    if (!cashobjects_register())
+        exit(1);
+    xaccLogDisable ();
+    srand(0);
+
+    session = qof_session_new ();
+    book = qof_session_get_book (session);
+    currency = get_random_commodity (book);
+
+    if (argc < 2)
+    {
+        run_order_test (book, currency);
+        run_append_test (book, currency);
+        run_size (book, currency, 2000, FALSE);
+    }
+    for (i = 1; i < argc; i++)
+    {
+        run_size (book, currency, (guint)atoi (argv[i]), TRUE);
+        run_append_benchmark (book, currency, (guint)atoi (argv[i]));
+    }
+
+    print_test_results();
+    qof_session_end (session);
+    qof_close();
+    return get_rv();
+}
@@ -58,6 +58,10 @@ static QofLogModule log_module = GNC_MOD_IMPORT;
 
 static const int MATCH_DATE_THRESHOLD = 4; /*within 4 days*/
 static const int MATCH_DATE_NOT_THRESHOLD = 14;
+/* The most a split whose amount doesn't match can score: +3 for the
+   date, +4 for the number, +2 each for memo and description, and -5 for
+   the amount.  Keep in step with split_score_match(). */
+static const int MATCH_MAX_PROB_OTHER_AMOUNT = 3 + 4 + 2 + 2 - 5;
 
 /********************************************************************\
  *   Forward declared prototypes                                    *
@@ -106,6 +110,30 @@ struct _matchinfo
     gboolean update_proposed;
 };
 
+struct _matchindex
+{
+    /* Account* to its GNCImportMatchAccount */
+    GHashTable * accounts;
+};
+
+/* What the match heuristics need of an existing split, so it doesn't
+   have to be worked out again for every imported transaction. */
+typedef struct
+{
+    GncGUID guid;
+    time_t date;
+    double amount;
+    /* position in the account, to keep that order among equal dates */
+    guint order;
+} GNCImportMatchCandidate;
+
+/* The splits of one import account, as GNCImportMatchCandidates */
+typedef struct
+{
+    GArray *by_date;
+    GArray *by_amount;
+} GNCImportMatchAccount;
+
 /* Some simple getters and setters for the above data types. */
 
 GList *
@@ -584,10 +612,12 @@ matchmap_store_destination (GncImportMatchMap *matchmap,
 
 /** @brief The transaction matching heuristics are here.
  */
-static void split_find_match (GNCImportTransInfo * trans_info,
-                              Split * split,
-                              gint display_threshold,
-                              double fuzzy_amount_difference)
+static void split_score_match (GNCImportTransInfo * trans_info,
+                               Split * split,
+                               double match_split_amount,
+                               time_t match_time,
+                               gint display_threshold,
+                               double fuzzy_amount_difference)
 {
     /* DEBUG("Begin"); */
 
@@ -598,8 +628,8 @@ static void split_find_match (GNCImportTransInfo * trans_info,
         GNCImportMatchInfo * match_info;
         gint prob = 0;
         gboolean update_proposed;
-        double downloaded_split_amount, match_split_amount;
-        time_t match_time, download_time;
+        double downloaded_split_amount;
+        time_t download_time;
         int datediff_day;
         Transaction *new_trans = gnc_import_TransInfo_get_trans (trans_info);
         Split *new_trans_fsplit = gnc_import_TransInfo_get_fsplit (trans_info);
@@ -610,7 +640,6 @@ static void split_find_match (GNCImportTransInfo * trans_info,
         downloaded_split_amount =
             gnc_numeric_to_double (xaccSplitGetAmount(new_trans_fsplit));
         /*DEBUG(" downloaded_split_amount=%f", downloaded_split_amount);*/
-        match_split_amount = gnc_numeric_to_double(xaccSplitGetAmount(split));
         /*DEBUG(" match_split_amount=%f", match_split_amount);*/
         if (fabs(downloaded_split_amount - match_split_amount) < 1e-6)
             /* bug#347791: Double type shouldn't be compared for exact
@@ -642,7 +671,6 @@ static void split_find_match (GNCImportTransInfo * trans_info,
         }
 
         /* Date heuristics */
-        match_time = xaccTransGetDate (xaccSplitGetParent (split));
         download_time = xaccTransGetDate (new_trans);
         datediff_day = abs(match_time - download_time) / 86400;
         /* Sorry, there are not really functions around at all that
@@ -792,7 +820,218 @@ static void split_find_match (GNCImportTransInfo * trans_info,
             g_list_prepend(trans_info->match_list,
                            match_info);
     }
-}/* end split_find_match */
+}/* end split_score_match */
+
+/** @brief Score a split of the originating account as a match.
+ */
+static void split_find_match (GNCImportTransInfo * trans_info,
+                              Split * split,
+                              gint display_threshold,
+                              double fuzzy_amount_difference)
+{
+    split_score_match (trans_info, split,
+                       gnc_numeric_to_double (xaccSplitGetAmount (split)),
+                       xaccTransGetDate (xaccSplitGetParent (split)),
+                       display_threshold, fuzzy_amount_difference);
+}
+
+static gint compare_match_candidate (gconstpointer a, gconstpointer b)
+{
+    const GNCImportMatchCandidate *ca = a;
+    const GNCImportMatchCandidate *cb = b;
+
+    if (ca->date != cb->date)
+        return ca->date < cb->date ? -1 : 1;
+    return ca->order < cb->order ? -1 : (ca->order > cb->order ? 1 : 0);
+}
+
+static gint compare_match_candidate_amount (gconstpointer a, gconstpointer b)
+{
+    const GNCImportMatchCandidate *ca = a;
+    const GNCImportMatchCandidate *cb = b;
+
+    if (ca->amount != cb->amount)
+        return ca->amount < cb->amount ? -1 : 1;
+    return compare_match_candidate (a, b);
+}
+
+static void match_account_free (gpointer data)
+{
+    GNCImportMatchAccount *match_account = data;
+
+    g_array_free (match_account->by_date, TRUE);
+    g_array_free (match_account->by_amount, TRUE);
+    g_free (match_account);
+}
+
+GNCImportMatchIndex *
+gnc_import_MatchIndex_new (void)
+{
+    GNCImportMatchIndex *index = g_new0 (GNCImportMatchIndex, 1);
+
+    index->accounts = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                      NULL, match_account_free);
+    return index;
+}
+
+void
+gnc_import_MatchIndex_delete (GNCImportMatchIndex *index)
+{
+    if (index == NULL)
+        return;
+
+    g_hash_table_destroy (index->accounts);
+    g_free (index);
+}
+
+/** Get the candidates of an account, reading in its splits the first
+   time it is asked for. */
+static GNCImportMatchAccount *
+matchindex_get_account (GNCImportMatchIndex *index, Account *account)
+{
+    GNCImportMatchAccount *match_account;
+    GList *node, *accounts;
+    guint order = 0;
+
+    match_account = g_hash_table_lookup (index->accounts, account);
+    if (match_account != NULL)
+        return match_account;
+
+    /* The query this replaces had the backend page in older splits, so
+       make sure they are all here. */
+    accounts = g_list_prepend (NULL, account);
+    gnc_account_list_load_splits (accounts, FALSE);
+    g_list_free (accounts);
+
+    match_account = g_new0 (GNCImportMatchAccount, 1);
+    match_account->by_date =
+        g_array_new (FALSE, FALSE, sizeof (GNCImportMatchCandidate));
+    for (node = xaccAccountGetSplitList (account); node; node = node->next)
+    {
+        Split *split = node->data;
+        GNCImportMatchCandidate candidate;
+
+        candidate.guid = *xaccSplitGetGUID (split);
+        candidate.date = xaccTransGetDate (xaccSplitGetParent (split));
+        candidate.amount = gnc_numeric_to_double (xaccSplitGetAmount (split));
+        candidate.order = order++;
+        g_array_append_val (match_account->by_date, candidate);
+    }
+    match_account->by_amount =
+        g_array_sized_new (FALSE, FALSE, sizeof (GNCImportMatchCandidate),
+                           match_account->by_date->len);
+    g_array_append_vals (match_account->by_amount,
+                         match_account->by_date->data,
+                         match_account->by_date->len);
+    g_array_sort (match_account->by_date, compare_match_candidate);
+    g_array_sort (match_account->by_amount, compare_match_candidate_amount);
+
+    g_hash_table_insert (index->accounts, account, match_account);
+    return match_account;
+}
+
+/** Score the splits of the originating account dated within
+   match_date_hardlimit days of the imported transaction, as
+   gnc_import_find_split_matches() does, but taking them from the
+   index. */
+static void
+find_split_matches_indexed (GNCImportTransInfo *trans_info,
+                            GNCImportMatchIndex *index,
+                            gint process_threshold,
+                            double fuzzy_amount_difference,
+                            gint match_date_hardlimit)
+{
+    Account *importaccount =
+        xaccSplitGetAccount (gnc_import_TransInfo_get_fsplit (trans_info));
+    time_t download_time = xaccTransGetDate (gnc_import_TransInfo_get_trans (trans_info));
+    time_t earliest = download_time - match_date_hardlimit * 86400;
+    time_t latest = download_time + match_date_hardlimit * 86400;
+    QofBook *book = gnc_get_current_book ();
+    GNCImportMatchAccount *match_account;
+    GArray *candidates;
+    gboolean by_amount;
+    guint lo, hi, i;
+
+    match_account = matchindex_get_account (index, importaccount);
+
+    /* When a split of another amount can't score high enough to be
+       shown, only look at the splits of about the same amount.  They are
+       put back in date order, so that matches of equal probability come
+       out as the date ordered lookup has them. */
+    by_amount = process_threshold > MATCH_MAX_PROB_OTHER_AMOUNT;
+    if (by_amount)
+    {
+        GArray *sorted = match_account->by_amount;
+        double amount = gnc_numeric_to_double (xaccSplitGetAmount (
+                gnc_import_TransInfo_get_fsplit (trans_info)));
+        /* a little over what split_score_match() takes as fuzzy */
+        double width = MAX (fuzzy_amount_difference, 0.0) + 1e-6;
+
+        lo = 0;
+        hi = sorted->len;
+        while (lo < hi)
+        {
+            guint mid = lo + (hi - lo) / 2;
+
+            if (g_array_index (sorted, GNCImportMatchCandidate, mid).amount
+                    < amount - width)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+
+        candidates = g_array_new (FALSE, FALSE, sizeof (GNCImportMatchCandidate));
+        for (; lo < sorted->len; lo++)
+        {
+            GNCImportMatchCandidate *candidate =
+                &g_array_index (sorted, GNCImportMatchCandidate, lo);
+
+            if (candidate->amount > amount + width)
+                break;
+            if (candidate->date >= earliest && candidate->date <= latest)
+                g_array_append_vals (candidates, candidate, 1);
+        }
+        g_array_sort (candidates, compare_match_candidate);
+        lo = 0;
+    }
+    else
+    {
+        /* Find the first candidate in the date range */
+        candidates = match_account->by_date;
+        lo = 0;
+        hi = candidates->len;
+        while (lo < hi)
+        {
+            guint mid = lo + (hi - lo) / 2;
+
+            if (g_array_index (candidates, GNCImportMatchCandidate, mid).date < earliest)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+    }
+
+    for (i = lo; i < candidates->len; i++)
+    {
+        GNCImportMatchCandidate *candidate =
+            &g_array_index (candidates, GNCImportMatchCandidate, i);
+        Split *split;
+
+        if (candidate->date > latest)
+            break;
+
+        /* The split may have gone away since the index was built */
+        split = xaccSplitLookup (&candidate->guid, book);
+        if (split == NULL || xaccSplitGetAccount (split) != importaccount)
+            continue;
+
+        split_score_match (trans_info, split, candidate->amount, candidate->date,
+                           process_threshold, fuzzy_amount_difference);
+    }
+
+    if (by_amount)
+        g_array_free (candidates, TRUE);
+}
 
 
 /** /brief Iterate through all splits of the originating account of the given
@@ -1187,16 +1426,30 @@ static gint compare_probability (gconstpointer a,
 void
 gnc_import_TransInfo_init_matches (GNCImportTransInfo *trans_info,
                                    GNCImportSettings *settings)
+{
+    gnc_import_TransInfo_init_matches_indexed (trans_info, settings, NULL);
+}
+
+void
+gnc_import_TransInfo_init_matches_indexed (GNCImportTransInfo *trans_info,
+        GNCImportSettings *settings,
+        GNCImportMatchIndex *index)
 {
     GNCImportMatchInfo * best_match = NULL;
     g_assert (trans_info);
 
 
     /* Find all split matches in originating account. */
-    gnc_import_find_split_matches(trans_info,
-                                  gnc_import_Settings_get_display_threshold (settings),
-                                  gnc_import_Settings_get_fuzzy_amount (settings),
-                                  gnc_import_Settings_get_match_date_hardlimit (settings));
+    if (index != NULL)
+        find_split_matches_indexed (trans_info, index,
+                                    gnc_import_Settings_get_display_threshold (settings),
+                                    gnc_import_Settings_get_fuzzy_amount (settings),
+                                    gnc_import_Settings_get_match_date_hardlimit (settings));
+    else
+        gnc_import_find_split_matches(trans_info,
+                                      gnc_import_Settings_get_display_threshold (settings),
+                                      gnc_import_Settings_get_fuzzy_amount (settings),
+                                      gnc_import_Settings_get_match_date_hardlimit (settings));
 
     if (trans_info->match_list != NULL)
     {
@@ -34,6 +34,7 @@
 
 typedef struct _transactioninfo GNCImportTransInfo;
 typedef struct _matchinfo GNCImportMatchInfo;
+typedef struct _matchindex GNCImportMatchIndex;
 
 typedef enum _action
 {
@@ -59,6 +60,20 @@ typedef enum _action
  * online_id. */
 gboolean gnc_import_exists_online_id (Transaction *trans);
 
+/** Create an index of the splits of the accounts transactions are
+ * imported into, ordered by date posted and by amount. The splits of
+ * an account are loaded and read in the first time a transaction
+ * imported into it is matched, so the index
+ * is a snapshot: use it for the transactions of one import, and delete
+ * it before the user gets to change the book.
+ *
+ * @return A new GNCImportMatchIndex, to be freed with
+ * gnc_import_MatchIndex_delete(). */
+GNCImportMatchIndex *gnc_import_MatchIndex_new (void);
+
+/** Destroy a GNCImportMatchIndex. */
+void gnc_import_MatchIndex_delete (GNCImportMatchIndex *index);
+
 /** Iterate through all splits of the originating account of the given
  * transaction, find all matching splits there, and store them in the
  * GNCImportTransInfo structure.
@@ -101,6 +116,17 @@ void
 gnc_import_TransInfo_init_matches (GNCImportTransInfo *trans_info,
                                    GNCImportSettings *settings);
 
+/** Like gnc_import_TransInfo_init_matches(), but takes the candidate
+ * splits from @a index instead of running a query over the book.
+ *
+ * @param index The GNCImportMatchIndex to look the candidates up in,
+ * or NULL to run a query as gnc_import_TransInfo_init_matches() does.
+ */
+void
+gnc_import_TransInfo_init_matches_indexed (GNCImportTransInfo *trans_info,
+        GNCImportSettings *settings,
+        GNCImportMatchIndex *index);
+
 /** This function is intended to be called when the importer dialog is
  * finished. It should be called once for each imported transaction
  * and processes each ImportTransInfo according to its selected action:
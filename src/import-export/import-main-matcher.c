@@ -55,6 +55,8 @@ struct _main_matcher_info
     int selected_row;
     GNCTransactionProcessedCB transaction_processed_cb;
     gpointer user_data;
+    /* the splits to match the downloaded transactions against */
+    GNCImportMatchIndex *match_index;
 };
 
 enum downloaded_cols
@@ -122,6 +124,7 @@ void gnc_gen_trans_list_delete (GNCImportMainMatcher *info)
 
     gnc_save_window_size(GCONF_SECTION, GTK_WINDOW(info->dialog));
     gnc_import_Settings_delete (info->user_settings);
+    gnc_import_MatchIndex_delete (info->match_index);
     gtk_widget_destroy (GTK_WIDGET (info->dialog));
     g_free (info);
 }
@@ -145,6 +148,8 @@ on_matcher_ok_clicked (GtkButton *button,
     if (!gtk_tree_model_get_iter_first(model, &iter))
         return;
 
+    /* Have the many events of the import delivered once at the end */
+    qof_event_begin_batch();
     do
     {
         gtk_tree_model_get(model, &iter,
@@ -176,6 +181,7 @@ on_matcher_ok_clicked (GtkButton *button,
 
     }
     while (gtk_tree_model_iter_next (model, &iter));
+    qof_event_end_batch();
 
     /* DEBUG ("Deleting") */
     /* DRH: Is this necessary. Isn't the call to trans_list_delete at
@@ -591,6 +597,11 @@ gboolean gnc_gen_trans_list_run (GNCImportMainMatcher *info)
     gboolean result;
 
     /* DEBUG("Begin"); */
+
+    /* All matches are in; the user may change the book from here on. */
+    gnc_import_MatchIndex_delete (info->match_index);
+    info->match_index = NULL;
+
     result = gtk_dialog_run (GTK_DIALOG (info->dialog));
     /* DEBUG("Result was %d", result); */
 
@@ -838,8 +849,11 @@ void gnc_gen_trans_list_add_trans_with_ref_id(GNCImportMainMatcher *gui, Transac
         transaction_info = gnc_import_TransInfo_new(trans, NULL);
         gnc_import_TransInfo_set_ref_id(transaction_info, ref_id);
 
-        gnc_import_TransInfo_init_matches(transaction_info,
-                                          gui->user_settings);
+        if (gui->match_index == NULL)
+            gui->match_index = gnc_import_MatchIndex_new();
+        gnc_import_TransInfo_init_matches_indexed(transaction_info,
+                gui->user_settings,
+                gui->match_index);
 
         model = gtk_tree_view_get_model(gui->view);
         gtk_list_store_append(GTK_LIST_STORE(model), &iter);
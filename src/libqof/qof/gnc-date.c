@@ -1133,6 +1133,259 @@ xaccDateUtilGetStampNow (void)
     return xaccDateUtilGetStamp (now);
 }
 
+/********************************************************************\
+ * Calendar arithmetic and the local time cache
+\********************************************************************/
+
+#ifdef HAVE_STRUCT_TM_GMTOFF
+
+/* Days from 1970-01-01 to a date of the proleptic Gregorian calendar.
+ * Days past the end of the month run on into the next, like timegm()
+ * and mktime() have them. */
+static gint64
+days_from_civil (gint64 year, int month, int day)
+{
+    gint64 era, yoe, doy, doe;
+
+    year -= month <= 2;
+    era = (year >= 0 ? year : year - 399) / 400;
+    yoe = year - era * 400;
+    doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+/* The inverse of days_from_civil(). */
+static void
+civil_from_days (gint64 days, int *year, int *month, int *day)
+{
+    gint64 era, doe, yoe, doy, mp;
+
+    days += 719468;
+    era = (days >= 0 ? days : days - 146096) / 146097;
+    doe = days - era * 146097;
+    yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    mp = (5 * doy + 2) / 153;
+    *day = doy - (153 * mp + 2) / 5 + 1;
+    *month = mp < 10 ? mp + 3 : mp - 9;
+    *year = yoe + era * 400 + (*month <= 2);
+}
+
+/* Set the calendar fields of 'tm' from seconds since the epoch, taken
+ * as they are; the other fields are left alone. */
+static void
+tm_set_fields (gint64 secs, struct tm *tm)
+{
+    gint64 days = secs / 86400;
+    gint64 rest = secs % 86400;
+    int year, month, day;
+
+    if (rest < 0)
+    {
+        rest += 86400;
+        days--;
+    }
+    civil_from_days (days, &year, &month, &day);
+
+    tm->tm_year = year - 1900;
+    tm->tm_mon = month - 1;
+    tm->tm_mday = day;
+    tm->tm_hour = rest / 3600;
+    tm->tm_min = rest / 60 % 60;
+    tm->tm_sec = rest % 60;
+    tm->tm_wday = ((days + 4) % 7 + 7) % 7;
+    tm->tm_yday = days - days_from_civil (year, 1, 1);
+}
+
+#define LOCALTIME_CACHE_SIZE 64
+
+/* A UTC day known to have the one UTC offset throughout, with what
+ * localtime_r() gave for its first second. */
+typedef struct
+{
+    gint64 day;
+    gboolean valid;
+    struct tm start;
+} LocaltimeDay;
+
+static LocaltimeDay localtime_cache[LOCALTIME_CACHE_SIZE];
+G_LOCK_DEFINE_STATIC (localtime_cache);
+
+static gboolean
+tm_same_fields (const struct tm *a, const struct tm *b)
+{
+    return a->tm_year == b->tm_year && a->tm_mon == b->tm_mon
+           && a->tm_mday == b->tm_mday && a->tm_hour == b->tm_hour
+           && a->tm_min == b->tm_min && a->tm_sec == b->tm_sec
+           && a->tm_wday == b->tm_wday && a->tm_yday == b->tm_yday;
+}
+
+/* Set 'start' to the local time at the start of the UTC day of
+ * 'secs'.  FALSE if the local time on that day is not just 'secs'
+ * plus the offset of 'start'. */
+static gboolean
+localtime_day (gint64 secs, struct tm *start)
+{
+    gint64 day = (secs >= 0 ? secs : secs - 86399) / 86400;
+    LocaltimeDay *entry = &localtime_cache[(guint64) day % LOCALTIME_CACHE_SIZE];
+    time_t first = day * 86400, last = first + 86399;
+    struct tm end, check;
+    gboolean found;
+
+    G_LOCK (localtime_cache);
+    found = entry->valid && entry->day == day;
+    if (found)
+        *start = entry->start;
+    G_UNLOCK (localtime_cache);
+    if (found)
+        return TRUE;
+
+    /* A day the time_t cannot hold all of. */
+    if (first != day * 86400 || last != day * 86400 + 86399)
+        return FALSE;
+
+    /* Both ends must agree with the arithmetic, which rules out an
+     * offset change or a leap second in between.  No zone changes its
+     * offset and back again within a day. */
+    if (!localtime_r (&first, start) || !localtime_r (&last, &end))
+        return FALSE;
+    if (start->tm_gmtoff != end.tm_gmtoff || start->tm_isdst != end.tm_isdst)
+        return FALSE;
+    tm_set_fields ((gint64) first + start->tm_gmtoff, &check);
+    if (!tm_same_fields (start, &check))
+        return FALSE;
+    tm_set_fields ((gint64) last + end.tm_gmtoff, &check);
+    if (!tm_same_fields (&end, &check))
+        return FALSE;
+
+    G_LOCK (localtime_cache);
+    entry->day = day;
+    entry->start = *start;
+    entry->valid = TRUE;
+    G_UNLOCK (localtime_cache);
+    return TRUE;
+}
+#endif /* HAVE_STRUCT_TM_GMTOFF */
+
+/* Write 'value' as exactly 'n' decimal digits. */
+static inline gchar *
+put_digits (gchar *buff, int value, int n)
+{
+    int i;
+
+    for (i = n - 1; i >= 0; i--)
+    {
+        buff[i] = '0' + value % 10;
+        value /= 10;
+    }
+    return buff + n;
+}
+
+/* Read exactly 'n' decimal digits. */
+static inline gboolean
+get_digits (const gchar **str, int n, int *value)
+{
+    const gchar *s = *str;
+    int i;
+
+    *value = 0;
+    for (i = 0; i < n; i++)
+    {
+        if (s[i] < '0' || s[i] > '9')
+            return FALSE;
+        *value = *value * 10 + (s[i] - '0');
+    }
+    *str = s + n;
+    return TRUE;
+}
+
+/* The strings gnc_timespec_to_iso8601_buff() writes and the SQL
+ * backend reads, "YYYY-MM-DD HH:MM:SS[.fraction][ ][+-hh[mm]]", read
+ * with plain arithmetic.  Returns FALSE for anything else, and for
+ * the times the mktime() based conversion below might get different,
+ * so that it can handle those as it always has. */
+static gboolean
+iso8601_to_timespec_fast (const gchar *str, Timespec *ts)
+{
+#ifdef HAVE_STRUCT_TM_GMTOFF
+    int year, month, day, hour, min, sec;
+    int sign = 0, tz_hour = 0, tz_min = 0;
+    long int nsec = 0;
+    struct tm before, after;
+    gint64 secs;
+
+    if (!get_digits (&str, 4, &year) || *str++ != '-'
+            || !get_digits (&str, 2, &month) || *str++ != '-'
+            || !get_digits (&str, 2, &day) || *str++ != ' '
+            || !get_digits (&str, 2, &hour) || *str++ != ':'
+            || !get_digits (&str, 2, &min) || *str++ != ':'
+            || !get_digits (&str, 2, &sec))
+        return FALSE;
+
+    if (*str == '.')
+    {
+        long int multiplier = NANOS_PER_SECOND;
+
+        str++;
+        if (!isdigit ((unsigned char)*str))
+            return FALSE;
+        for (; isdigit ((unsigned char)*str); str++)
+        {
+            if (multiplier == 1)
+                return FALSE;
+            multiplier /= 10;
+            nsec = nsec * 10 + (*str - '0');
+        }
+        nsec *= multiplier;
+    }
+
+    if (*str == ' ')
+        str++;
+    if (*str == '+' || *str == '-')
+    {
+        sign = (*str++ == '+') ? 1 : -1;
+        if (!get_digits (&str, 2, &tz_hour))
+            return FALSE;
+        if (*str && !get_digits (&str, 2, &tz_min))
+            return FALSE;
+    }
+    if (*str)
+        return FALSE;
+
+    if (month < 1 || month > 12 || day < 1 || day > 31
+            || hour > 23 || min > 59 || sec > 59)
+        return FALSE;
+
+    secs = days_from_civil (year, month, day) * 86400
+           + hour * 3600 + min * 60 + sec
+           - sign * (tz_hour * 3600 + tz_min * 60);
+
+    /* mktime() fails for local times before the epoch, and those
+     * cannot be told apart from times just after it without the
+     * offset, so the first days are left alone. */
+    if (secs < 2 * 86400 || (time_t)(secs + 2 * 86400) != secs + 2 * 86400)
+        return FALSE;
+
+    /* The conversion below reads the time as local time to find the
+     * offset, and drops the seconds of it.  That only comes out right
+     * if the offset is a whole number of minutes, and the same for
+     * every local reading of the time, so for 15 hours either side. */
+    if (!localtime_day (secs - 15 * 3600, &before)
+            || !localtime_day (secs + 15 * 3600, &after)
+            || before.tm_gmtoff != after.tm_gmtoff
+            || before.tm_isdst != after.tm_isdst
+            || before.tm_gmtoff % 60 != 0)
+        return FALSE;
+
+    ts->tv_sec = secs;
+    ts->tv_nsec = nsec;
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
 /********************************************************************\
  * iso 8601 datetimes should look like 1998-07-02 11:00:00.68-05
 \********************************************************************/
@@ -1151,6 +1404,7 @@ gnc_iso8601_to_timespec_gmt(const char *str)
     ts.tv_sec = 0;
     ts.tv_nsec = 0;
     if (!str) return ts;
+    if (iso8601_to_timespec_fast (str, &ts)) return ts;
     dupe = g_strdup(str);
     stm.tm_year = atoi(str) - 1900;
     str = strchr (str, '-');
@@ -1346,7 +1600,7 @@ gnc_timespec_to_iso8601_buff (Timespec ts, char * buff)
     struct tm parsed;
 
     tmp = ts.tv_sec;
-    localtime_r(&tmp, &parsed);
+    gnc_localtime_r(&tmp, &parsed);
 
     secs = gnc_timezone (&parsed);
 
@@ -1363,6 +1617,32 @@ gnc_timespec_to_iso8601_buff (Timespec ts, char * buff)
     tz_hour = secs / 3600;
     tz_min = (secs % 3600) / 60;
 
+    /* Write the usual case by hand; sprintf is slow. */
+    if (parsed.tm_year + 1900 >= 1000 && parsed.tm_year + 1900 <= 9999
+            && ts.tv_nsec >= 0 && ts.tv_nsec < NANOS_PER_SECOND
+            && tz_hour < 100)
+    {
+        buff = put_digits (buff, parsed.tm_year + 1900, 4);
+        *buff++ = '-';
+        buff = put_digits (buff, parsed.tm_mon + 1, 2);
+        *buff++ = '-';
+        buff = put_digits (buff, parsed.tm_mday, 2);
+        *buff++ = ' ';
+        buff = put_digits (buff, parsed.tm_hour, 2);
+        *buff++ = ':';
+        buff = put_digits (buff, parsed.tm_min, 2);
+        *buff++ = ':';
+        buff = put_digits (buff, parsed.tm_sec, 2);
+        *buff++ = '.';
+        buff = put_digits (buff, ts.tv_nsec / 1000, 6);
+        *buff++ = ' ';
+        *buff++ = cyn;
+        buff = put_digits (buff, tz_hour, 2);
+        buff = put_digits (buff, tz_min, 2);
+        *buff = '\0';
+        return buff;
+    }
+
     len = sprintf (buff, "%4d-%02d-%02d %02d:%02d:%02d.%06ld %c%02d%02d",
                    parsed.tm_year + 1900,
                    parsed.tm_mon + 1,
@@ -1510,6 +1790,22 @@ gnc_timezone (const struct tm *tm)
 #endif
 }
 
+struct tm *
+gnc_localtime_r (const time_t *secs, struct tm *time)
+{
+#ifdef HAVE_STRUCT_TM_GMTOFF
+    struct tm start;
+
+    if (localtime_day (*secs, &start))
+    {
+        *time = start;
+        tm_set_fields ((gint64) *secs + start.tm_gmtoff, time);
+        return time;
+    }
+#endif
+    return localtime_r (secs, time);
+}
+
 
 void
 timespecFromTime_t( Timespec *ts, time_t t )
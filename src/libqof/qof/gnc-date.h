@@ -296,6 +296,17 @@ void gnc_timespec2dmy (Timespec ts, gint *day, gint *month, gint *year);
  * standardized and is a big mess.
  */
 glong gnc_timezone (const struct tm *tm);
+
+/** The same as localtime_r(), but faster for many times close
+ *  together.  It remembers the UTC offset of the days it has last
+ *  converted, so within those days the local time is plain arithmetic
+ *  and needs no timezone lookup.  Days with an offset change or a
+ *  leap second in them are left to localtime_r().
+ *
+ *  A change to the TZ environment variable after the first call is
+ *  not noticed.
+ */
+struct tm * gnc_localtime_r (const time_t *secs, struct tm *time);
 // @}
 
 /* ------------------------------------------------------------------------ */
@@ -1346,6 +1346,323 @@ gnc_numeric_div_with_error(gnc_numeric a, gnc_numeric b,
     return quot;
 }
 
+/* *******************************************************************
+ *  gnc_numeric_accum
+ ********************************************************************/
+
+/* The slots hold two's complement 128-bit numerators as hi:lo.  All
+ * the arithmetic is unsigned, so that wrapping around is defined and
+ * overflow can be checked for afterwards. */
+
+/* Sums of this many numerator halves cannot overflow 64 bits. */
+#define ACCUM_CHUNK ((gsize) 1 << 31)
+
+/* Add hi:lo to the slot; FALSE if the sum overflowed. */
+static inline gboolean
+accum_slot_add (GncNumericAccumSlot *slot, guint64 hi, guint64 lo)
+{
+    guint64 old_hi = slot->hi;
+
+    slot->lo += lo;
+    slot->hi += hi + (slot->lo < lo);
+
+    /* Addends of the same sign with a sum of the other sign. */
+    return ((~(old_hi ^ hi) & (old_hi ^ slot->hi)) >> 63) == 0;
+}
+
+/* The full 128-bit product of two unsigned 64-bit numbers. */
+static inline void
+accum_mul64 (guint64 a, guint64 b, guint64 *hi, guint64 *lo)
+{
+    guint64 a0 = a & 0xffffffff, a1 = a >> 32;
+    guint64 b0 = b & 0xffffffff, b1 = b >> 32;
+    guint64 p00 = a0 * b0, p01 = a0 * b1;
+    guint64 p10 = a1 * b0, p11 = a1 * b1;
+    guint64 mid = (p00 >> 32) + (p01 & 0xffffffff) + (p10 & 0xffffffff);
+
+    *lo = (mid << 32) | (p00 & 0xffffffff);
+    *hi = p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+}
+
+static inline void
+accum_negate (guint64 *hi, guint64 *lo)
+{
+    *lo = ~*lo + 1;
+    *hi = ~*hi + (*lo == 0);
+}
+
+/* Multiply the slot's numerator by 'factor'; FALSE on overflow. */
+static gboolean
+accum_slot_scale (GncNumericAccumSlot *slot, guint64 factor)
+{
+    gboolean neg = (slot->hi >> 63) != 0;
+    guint64 hi = slot->hi, lo = slot->lo;
+    guint64 p_hi, p_lo, q_hi, q_lo;
+
+    if (factor == 1)
+        return TRUE;
+
+    if (neg)
+        accum_negate (&hi, &lo);
+    accum_mul64 (lo, factor, &p_hi, &p_lo);
+    accum_mul64 (hi, factor, &q_hi, &q_lo);
+    hi = p_hi + q_lo;
+    if (q_hi != 0 || hi < q_lo || (hi >> 63) != 0)
+        return FALSE;
+
+    lo = p_lo;
+    if (neg)
+        accum_negate (&hi, &lo);
+    slot->hi = hi;
+    slot->lo = lo;
+    return TRUE;
+}
+
+/* Values with a reciprocal denominator are kept as the integers they
+ * are, in a slot of their own so that GNC_HOW_DENOM_FIXED can tell
+ * them apart. */
+static inline gint64
+accum_slot_denom (const GncNumericAccumSlot *slot)
+{
+    return slot->denom > 0 ? slot->denom : 1;
+}
+
+/* The least common multiple of the denominators of the slots, and 1,
+ * like a sum started from gnc_numeric_zero() has; 0 on overflow. */
+static gint64
+accum_lcd (const GncNumericAccumSlot *slots, guint n_slots)
+{
+    guint64 lcd = 1;
+    guint i;
+
+    for (i = 0; i < n_slots; i++)
+    {
+        guint64 denom = accum_slot_denom (&slots[i]);
+        qofint128 lcm;
+
+        if (lcd % denom == 0)
+            continue;
+        lcm = lcm128 (lcd, denom);
+        if (lcm.isbig)
+            return 0;
+        lcd = lcm.lo;
+    }
+    return lcd;
+}
+
+/* Bring all the slots to 'lcd' and add them up into 'sum'. */
+static gboolean
+accum_sum_slots (const GncNumericAccumSlot *slots, guint n_slots,
+                 gint64 lcd, GncNumericAccumSlot *sum)
+{
+    guint i;
+
+    sum->denom = lcd;
+    sum->hi = sum->lo = 0;
+    for (i = 0; i < n_slots; i++)
+    {
+        GncNumericAccumSlot scaled = slots[i];
+
+        if (!accum_slot_scale (&scaled, lcd / accum_slot_denom (&slots[i]))
+                || !accum_slot_add (sum, scaled.hi, scaled.lo))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+/* The slot for 'denom', making room for it if need be.  NULL, with
+ * the error set, if the slots could not be folded together. */
+static GncNumericAccumSlot *
+accum_slot_for (GncNumericAccum *accum, gint64 denom)
+{
+    GncNumericAccumSlot *slot;
+    guint i;
+
+    if (G_LIKELY(accum->n_slots > 0
+                 && accum->slots[accum->last].denom == denom))
+        return &accum->slots[accum->last];
+
+    for (i = 0; i < accum->n_slots; i++)
+    {
+        if (accum->slots[i].denom == denom)
+        {
+            accum->last = i;
+            return &accum->slots[i];
+        }
+    }
+
+    if (accum->n_slots == GNC_NUMERIC_ACCUM_SLOTS)
+    {
+        GncNumericAccumSlot sum;
+        gint64 lcd = accum_lcd (accum->slots, accum->n_slots);
+
+        if (lcd == 0 || !accum_sum_slots (accum->slots, accum->n_slots,
+                                          lcd, &sum))
+        {
+            accum->error = GNC_ERROR_OVERFLOW;
+            return NULL;
+        }
+        accum->slots[0] = sum;
+        accum->n_slots = 1;
+    }
+
+    accum->last = accum->n_slots++;
+    slot = &accum->slots[accum->last];
+    slot->denom = denom;
+    slot->hi = slot->lo = 0;
+    return slot;
+}
+
+void
+gnc_numeric_accum_init(GncNumericAccum *accum)
+{
+    accum->n_slots = 0;
+    accum->last = 0;
+    accum->error = GNC_ERROR_OK;
+}
+
+void
+gnc_numeric_accum_add(GncNumericAccum *accum, gnc_numeric value)
+{
+    GncNumericAccumSlot *slot;
+    guint64 hi, lo;
+
+    if (accum->error)
+        return;
+    if (gnc_numeric_check(value))
+    {
+        accum->error = GNC_ERROR_ARG;
+        return;
+    }
+
+    if (value.denom > 0)
+    {
+        hi = value.num < 0 ? G_MAXUINT64 : 0;
+        lo = (guint64) value.num;
+        slot = accum_slot_for (accum, value.denom);
+    }
+    else
+    {
+        /* num / (1 / -denom) is an integer that may need 128 bits. */
+        guint64 mag = value.num < 0 ? -(guint64) value.num : (guint64) value.num;
+
+        accum_mul64 (mag, -(guint64) value.denom, &hi, &lo);
+        if (value.num < 0)
+            accum_negate (&hi, &lo);
+        slot = accum_slot_for (accum, value.denom);
+    }
+
+    if (slot && !accum_slot_add (slot, hi, lo))
+        accum->error = GNC_ERROR_OVERFLOW;
+}
+
+void
+gnc_numeric_accum_add_nums(GncNumericAccum *accum, const gint64 *nums,
+                           gsize n, gint64 denom)
+{
+    GncNumericAccumSlot *slot;
+    gsize i;
+
+    if (accum->error || n == 0)
+        return;
+    if (denom <= 0)
+    {
+        for (i = 0; i < n && !accum->error; i++)
+            gnc_numeric_accum_add (accum, gnc_numeric_create (nums[i], denom));
+        return;
+    }
+
+    slot = accum_slot_for (accum, denom);
+    if (!slot)
+        return;
+
+    while (n > 0)
+    {
+        gsize chunk = MIN (n, ACCUM_CHUNK);
+        gint64 hi_sum = 0;
+        guint64 lo_sum = 0;
+
+        /* Each numerator is its signed upper half times 2^32 plus its
+         * unsigned lower half.  The halves add up without carries. */
+        for (i = 0; i < chunk; i++)
+        {
+            hi_sum += nums[i] >> 32;
+            lo_sum += (guint32) nums[i];
+        }
+
+        /* hi_sum * 2^32 + lo_sum */
+        if (!accum_slot_add (slot, (guint64) (hi_sum >> 32),
+                             (guint64) hi_sum << 32)
+                || !accum_slot_add (slot, 0, lo_sum))
+        {
+            accum->error = GNC_ERROR_OVERFLOW;
+            return;
+        }
+        nums += chunk;
+        n -= chunk;
+    }
+}
+
+gnc_numeric
+gnc_numeric_accum_total(const GncNumericAccum *accum, gint64 denom, gint how)
+{
+    const GncNumericAccumSlot *slots = accum->slots;
+    GncNumericAccumSlot parts[GNC_NUMERIC_ACCUM_SLOTS], sum;
+    guint n_slots = accum->n_slots;
+    gnc_numeric total;
+    gint64 lcd;
+    guint i;
+
+    if (accum->error)
+        return gnc_numeric_error(accum->error);
+
+    /* Only the nonzero parts of the sum have to share a fixed
+     * denominator, and only they need scaling. */
+    if ((denom == GNC_DENOM_AUTO) &&
+            (how & GNC_NUMERIC_DENOM_MASK) == GNC_HOW_DENOM_FIXED)
+    {
+        guint n_parts = 0;
+
+        for (i = 0; i < n_slots; i++)
+        {
+            if (slots[i].hi == 0 && slots[i].lo == 0)
+                continue;
+            if (n_parts > 0 && slots[i].denom != parts[0].denom)
+                return gnc_numeric_error(GNC_ERROR_DENOM_DIFF);
+            parts[n_parts++] = slots[i];
+        }
+        denom = n_parts ? parts[0].denom : n_slots ? slots[0].denom : 1;
+        slots = parts;
+        n_slots = n_parts;
+    }
+
+    lcd = accum_lcd (slots, n_slots);
+    if (lcd == 0 || !accum_sum_slots (slots, n_slots, lcd, &sum))
+        return gnc_numeric_error(GNC_ERROR_OVERFLOW);
+
+    /* The same range as gnc_numeric_add() allows. */
+    if ((sum.hi == 0 && (sum.lo >> 63) == 0)
+            || (sum.hi == G_MAXUINT64 && (sum.lo >> 63) != 0
+                && sum.lo != G_GUINT64_CONSTANT(0x8000000000000000)))
+    {
+        total.num = (gint64) sum.lo;
+        total.denom = lcd;
+    }
+    else
+    {
+        return gnc_numeric_error(GNC_ERROR_OVERFLOW);
+    }
+
+    if ((denom == GNC_DENOM_AUTO) &&
+            ((how & GNC_NUMERIC_DENOM_MASK) == GNC_HOW_DENOM_LCD))
+    {
+        denom = lcd;
+        how   = how & GNC_NUMERIC_RND_MASK;
+    }
+
+    return gnc_numeric_convert(total, denom, how);
+}
+
 /* *******************************************************************
  *  gnc_numeric text IO
  ********************************************************************/
@@ -476,6 +476,79 @@ gnc_numeric gnc_numeric_div_with_error(gnc_numeric a, gnc_numeric b,
                                        gnc_numeric * error);
 /** @} */
 
+/** @name Accumulating Sums
+
+    Adding up a long series of values with gnc_numeric_add() checks,
+    normalizes and converts the running total at every step.  An
+    accumulator instead keeps an exact 128-bit sum of the numerators
+    for each denominator it has seen, and only brings them to a common
+    denominator when the total is asked for.  Overflow is reported in
+    the total instead of wrapping around silently.
+
+    @code
+    GncNumericAccum accum;
+
+    gnc_numeric_accum_init (&accum);
+    for (node = splits; node; node = node->next)
+        gnc_numeric_accum_add (&accum, xaccSplitGetValue (node->data));
+    total = gnc_numeric_accum_total (&accum, GNC_DENOM_AUTO,
+                                     GNC_HOW_DENOM_LCD);
+    @endcode
+ @{
+*/
+/** The number of different denominators an accumulator keeps apart.
+ *  Beyond that they are folded into one sum over their least common
+ *  denominator. */
+#define GNC_NUMERIC_ACCUM_SLOTS 4
+
+/** One exact partial sum, a two's complement 128-bit numerator. */
+typedef struct
+{
+    gint64  denom;
+    guint64 lo;
+    guint64 hi;
+} GncNumericAccumSlot;
+
+/** A running sum of gnc_numeric values.  It needs no cleanup and may
+ *  live on the stack; its fields are private. */
+typedef struct
+{
+    guint n_slots;
+    guint last;
+    GNCNumericErrorCode error;
+    GncNumericAccumSlot slots[GNC_NUMERIC_ACCUM_SLOTS];
+} GncNumericAccum;
+
+/** Start an empty sum. */
+void gnc_numeric_accum_init(GncNumericAccum *accum);
+
+/** Add 'value' to the sum.  An invalid value makes the total a
+ *  GNC_ERROR_ARG error. */
+void gnc_numeric_accum_add(GncNumericAccum *accum, gnc_numeric value);
+
+/** Add the 'n' numerators in 'nums', all over 'denom', to the sum.
+ *  This is much faster than adding them one by one: the inner loop
+ *  has no branches, so the compiler can vectorize it. */
+void gnc_numeric_accum_add_nums(GncNumericAccum *accum, const gint64 *nums,
+                                gsize n, gint64 denom);
+
+/** Return the sum under the standard arguments 'denom' and 'how'.
+ *
+ *  With GNC_DENOM_AUTO and GNC_HOW_DENOM_LCD or GNC_HOW_DENOM_EXACT
+ *  this is the exact sum over the least common denominator of all the
+ *  values, the same as adding them up with gnc_numeric_add() starting
+ *  from gnc_numeric_zero() gives when nothing overflows.  With
+ *  GNC_DENOM_AUTO and GNC_HOW_DENOM_FIXED the denominators of the
+ *  nonzero parts of the sum must agree.  Otherwise the exact sum is
+ *  converted once, so it is rounded once rather than at every step.
+ *
+ *  The accumulator is not changed; more values may be added after
+ *  taking a total.
+ */
+gnc_numeric gnc_numeric_accum_total(const GncNumericAccum *accum,
+                                    gint64 denom, gint how);
+/** @} */
+
 /** @name Change Denominator
  @{
 */
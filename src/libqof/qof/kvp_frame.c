@@ -27,18 +27,35 @@
 #include <glib.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <math.h>
 
 #include "qof.h"
 
-/* Note that we keep the keys for this hash table in a GCache
- * (qof_util_string_cache), as it is very likely we will see the
- * same keys over and over again  */
+/* A frame keeps its slots in an array sorted by key.  Most frames hold
+ * only a handful of slots, and for those a sorted array is a fraction
+ * of the size of a GHashTable and just as quick to search.  A frame
+ * that grows past KVP_FRAME_MAX_SLOTS moves its slots into a hash
+ * table for good.
+ *
+ * Note that we keep the keys in a GCache (qof_util_string_cache), as
+ * it is very likely we will see the same keys over and over again.  */
+
+#define KVP_FRAME_MAX_SLOTS 16
+
+typedef struct
+{
+    const char  * key;
+    KvpValue    * value;
+} KvpSlot;
 
 struct _KvpFrame
 {
-    GHashTable  * hash;
+    KvpSlot     * slots;        /* sorted by key, NULL until first used */
+    guint16       n_slots;
+    guint16       n_alloc;
+    GHashTable  * hash;         /* used instead of slots by big frames */
 };
 
 
@@ -57,7 +74,7 @@ struct _KvpValue
         double dbl;
         gnc_numeric numeric;
         gchar *str;
-        GncGUID *guid;
+        GncGUID guid;
         Timespec timespec;
         KvpValueBinaryData binary;
         GList *list;
@@ -88,21 +105,105 @@ kvp_comp_func(gconstpointer v, gconstpointer v2)
 static gboolean
 init_frame_body_if_needed(KvpFrame *f)
 {
-    if (!f->hash)
+    if (!f->hash && !f->slots)
+    {
+        f->slots = g_new(KvpSlot, 1);
+        f->n_alloc = 1;
+    }
+    return TRUE;
+}
+
+/* Compare a whole key with one given by its first 'len' bytes, in
+ * strcmp() order. */
+static inline gint
+kvp_key_cmp(const char *key, const char *other, gsize len)
+{
+    gint retval = strncmp(key, other, len);
+    if (retval) return retval;
+    return key[len] ? 1 : 0;
+}
+
+/* Binary search of the slot array.  Returns whether the key is there,
+ * and its position, or the one where it would go, in 'pos'. */
+static gboolean
+kvp_frame_find_slot(const KvpFrame *f, const char *key, gsize len, guint *pos)
+{
+    guint lo = 0, hi = f->n_slots;
+
+    while (lo < hi)
     {
-        f->hash = g_hash_table_new(&kvp_hash_func, &kvp_comp_func);
+        guint mid = (lo + hi) / 2;
+        gint cmp = kvp_key_cmp(f->slots[mid].key, key, len);
+
+        if (cmp == 0)
+        {
+            *pos = mid;
+            return TRUE;
+        }
+        if (cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
     }
-    return(f->hash != NULL);
+    *pos = lo;
+    return FALSE;
+}
+
+/* Look up the slot named by the first 'len' bytes of 'key', which
+ * needn't be terminated there.  This lets paths be walked in place. */
+#define KVP_KEY_BUF 128
+
+static KvpValue *
+kvp_frame_lookup(const KvpFrame *f, const char *key, gsize len)
+{
+    guint pos;
+
+    if (f->hash)
+    {
+        char buf[KVP_KEY_BUF];
+        gchar *tmp;
+        KvpValue *value;
+
+        if (key[len] == '\0')
+            return g_hash_table_lookup(f->hash, key);
+        if (len < KVP_KEY_BUF)
+        {
+            memcpy(buf, key, len);
+            buf[len] = '\0';
+            return g_hash_table_lookup(f->hash, buf);
+        }
+        tmp = g_strndup(key, len);
+        value = g_hash_table_lookup(f->hash, tmp);
+        g_free(tmp);
+        return value;
+    }
+
+    if (f->slots && kvp_frame_find_slot(f, key, len, &pos))
+        return f->slots[pos].value;
+    return NULL;
+}
+
+/* Move a frame's slots into a hash table */
+static void
+kvp_frame_make_hash(KvpFrame *f)
+{
+    guint i;
+
+    if (f->hash) return;
+    f->hash = g_hash_table_new(&kvp_hash_func, &kvp_comp_func);
+    for (i = 0; i < f->n_slots; i++)
+        g_hash_table_insert(f->hash, (gpointer) f->slots[i].key,
+                            f->slots[i].value);
+    g_free(f->slots);
+    f->slots = NULL;
+    f->n_slots = f->n_alloc = 0;
 }
 
 KvpFrame *
 kvp_frame_new(void)
 {
-    KvpFrame * retval = g_new0(KvpFrame, 1);
-
     /* Save space until the frame is actually used */
-    retval->hash = NULL;
-    return retval;
+    return g_slice_new0(KvpFrame);
 }
 
 static void
@@ -115,6 +216,8 @@ kvp_frame_delete_worker(gpointer key, gpointer value, gpointer user_data)
 void
 kvp_frame_delete(KvpFrame * frame)
 {
+    guint i;
+
     if (!frame) return;
 
     if (frame->hash)
@@ -127,14 +230,18 @@ kvp_frame_delete(KvpFrame * frame)
         g_hash_table_destroy(frame->hash);
         frame->hash = NULL;
     }
-    g_free(frame);
+    for (i = 0; i < frame->n_slots; i++)
+        kvp_frame_delete_worker((gpointer) frame->slots[i].key,
+                                frame->slots[i].value, frame);
+    g_free(frame->slots);
+    g_slice_free(KvpFrame, frame);
 }
 
 gboolean
 kvp_frame_is_empty(const KvpFrame * frame)
 {
     if (!frame) return TRUE;
-    if (!frame->hash) return TRUE;
+    if (!frame->hash && !frame->slots) return TRUE;
     return FALSE;
 }
 
@@ -151,16 +258,30 @@ KvpFrame *
 kvp_frame_copy(const KvpFrame * frame)
 {
     KvpFrame * retval = kvp_frame_new();
+    guint i;
 
     if (!frame) return retval;
 
     if (frame->hash)
     {
-        if (!init_frame_body_if_needed(retval)) return(NULL);
+        retval->hash = g_hash_table_new(&kvp_hash_func, &kvp_comp_func);
         g_hash_table_foreach(frame->hash,
                              & kvp_frame_copy_worker,
                              (gpointer)retval);
     }
+    else if (frame->slots)
+    {
+        /* The slots are already in order */
+        retval->n_alloc = MAX(frame->n_slots, 1);
+        retval->slots = g_new(KvpSlot, retval->n_alloc);
+        for (i = 0; i < frame->n_slots; i++)
+        {
+            retval->slots[i].key =
+                qof_util_string_cache_insert(frame->slots[i].key);
+            retval->slots[i].value = kvp_value_copy(frame->slots[i].value);
+        }
+        retval->n_slots = frame->n_slots;
+    }
     return retval;
 }
 
@@ -175,10 +296,47 @@ kvp_frame_replace_slot_nc (KvpFrame * frame, const char * slot,
     gpointer orig_key;
     gpointer orig_value = NULL;
     int      key_exists;
+    guint    pos;
 
     if (!frame || !slot) return NULL;
     if (!init_frame_body_if_needed(frame)) return NULL; /* Error ... */
 
+    if (!frame->hash)
+    {
+        if (kvp_frame_find_slot(frame, slot, strlen(slot), &pos))
+        {
+            orig_value = frame->slots[pos].value;
+            if (new_value)
+            {
+                frame->slots[pos].value = new_value;
+                return (KvpValue *) orig_value;
+            }
+            qof_util_string_cache_remove(frame->slots[pos].key);
+            frame->n_slots--;
+            memmove(&frame->slots[pos], &frame->slots[pos + 1],
+                    (frame->n_slots - pos) * sizeof(KvpSlot));
+            return (KvpValue *) orig_value;
+        }
+        if (!new_value)
+            return NULL;
+
+        if (frame->n_slots < KVP_FRAME_MAX_SLOTS)
+        {
+            if (frame->n_slots == frame->n_alloc)
+            {
+                frame->n_alloc *= 2;
+                frame->slots = g_renew(KvpSlot, frame->slots, frame->n_alloc);
+            }
+            memmove(&frame->slots[pos + 1], &frame->slots[pos],
+                    (frame->n_slots - pos) * sizeof(KvpSlot));
+            frame->slots[pos].key = qof_util_string_cache_insert(slot);
+            frame->slots[pos].value = new_value;
+            frame->n_slots++;
+            return NULL;
+        }
+        kvp_frame_make_hash(frame);
+    }
+
     key_exists = g_hash_table_lookup_extended(frame->hash, slot,
                  & orig_key, & orig_value);
     if (key_exists)
@@ -238,33 +396,41 @@ get_or_make (KvpFrame *fr, const char * key)
     return next_frame;
 }
 
-/* Get pointer to last frame in path. If the path doesn't exist,
- * it is created.  The string stored in keypath will be hopelessly
- * mangled .
+/* Get pointer to the frame at the end of the part of a slash-separated
+ * path that runs up to 'end'.  If 'make' is set missing frames are
+ * created, otherwise NULL is returned if the path doesn't exist.  The
+ * path is walked in place; it is only copied to create a frame.
  */
-static inline KvpFrame *
-kvp_frame_get_frame_slash_trash (KvpFrame *frame, char *key_path)
+static KvpFrame *
+kvp_frame_walk_path (KvpFrame *frame, const char *key, const char *end,
+                     gboolean make)
 {
-    char *key, *next;
-    if (!frame || !key_path) return frame;
+    while (frame && key < end)
+    {
+        const char *next;
+        KvpValue *value;
 
-    key = key_path;
-    key --;
+        while (key < end && '/' == *key)
+            key++;
+        if (key == end) break;    /* trailing slash */
+        next = memchr (key, '/', end - key);
+        if (!next) next = end;
 
-    while (key)
-    {
-        key ++;
-        while ('/' == *key)
+        value = kvp_frame_lookup (frame, key, next - key);
+        if (value)
         {
-            key++;
+            frame = kvp_value_get_frame (value);
+        }
+        else if (make)
+        {
+            gchar *name = g_strndup (key, next - key);
+            frame = get_or_make (frame, name);
+            g_free (name);
+        }
+        else
+        {
+            return NULL;
         }
-        if (0x0 == *key) break;    /* trailing slash */
-        next = strchr (key, '/');
-        if (next) *next = 0x0;
-
-        frame = get_or_make (frame, key);
-        if (!frame) break;  /* error - should never happen */
-
         key = next;
     }
     return frame;
@@ -272,37 +438,14 @@ kvp_frame_get_frame_slash_trash (KvpFrame *frame, char *key_path)
 
 /* ============================================================ */
 /* Get pointer to last frame in path, or NULL if the path doesn't
- * exist. The string stored in keypath will be hopelessly mangled .
+ * exist.  Despite the name, the path is no longer modified.
  */
 static inline const KvpFrame *
 kvp_frame_get_frame_or_null_slash_trash (const KvpFrame *frame, char *key_path)
 {
-    KvpValue *value;
-    char *key, *next;
     if (!frame || !key_path) return NULL;
-
-    key = key_path;
-    key --;
-
-    while (key)
-    {
-        key ++;
-        while ('/' == *key)
-        {
-            key++;
-        }
-        if (0x0 == *key) break;    /* trailing slash */
-        next = strchr (key, '/');
-        if (next) *next = 0x0;
-
-        value = kvp_frame_get_slot (frame, key);
-        if (!value) return NULL;
-        frame = kvp_value_get_frame (value);
-        if (!frame) return NULL;
-
-        key = next;
-    }
-    return frame;
+    return kvp_frame_walk_path ((KvpFrame *) frame, key_path,
+                                key_path + strlen (key_path), FALSE);
 }
 
 /* Return pointer to last frame in path, and also store the
@@ -332,13 +475,7 @@ get_trailer_make (KvpFrame * frame, const char * key_path, char **end_key)
     }
     else
     {
-        char *root, *lkey;
-        root = g_strdup (key_path);
-        lkey = strrchr (root, '/');
-        *lkey = 0;
-        frame = kvp_frame_get_frame_slash_trash (frame, root);
-        g_free(root);
-
+        frame = kvp_frame_walk_path (frame, key_path, last_key, TRUE);
         last_key ++;
     }
 
@@ -374,13 +511,8 @@ get_trailer_or_null (const KvpFrame * frame, const char * key_path, char **end_k
     }
     else
     {
-        char *root, *lkey;
-        root = g_strdup (key_path);
-        lkey = strrchr (root, '/');
-        *lkey = 0;
-        frame = kvp_frame_get_frame_or_null_slash_trash (frame, root);
-        g_free(root);
-
+        frame = kvp_frame_walk_path ((KvpFrame *) frame, key_path, last_key,
+                                     FALSE);
         last_key ++;
     }
 
@@ -607,11 +739,8 @@ kvp_frame_set_slot_nc(KvpFrame * frame, const char * slot,
 KvpValue *
 kvp_frame_get_slot(const KvpFrame * frame, const char * slot)
 {
-    KvpValue *v;
-    if (!frame) return NULL;
-    if (!frame->hash) return NULL;  /* Error ... */
-    v = g_hash_table_lookup(frame->hash, slot);
-    return v;
+    if (!frame || !slot) return NULL;
+    return kvp_frame_lookup(frame, slot, strlen(slot));
 }
 
 /* ============================================================ */
@@ -885,13 +1014,9 @@ kvp_frame_get_frame_path (KvpFrame *frame, const char *key,  ...)
 KvpFrame *
 kvp_frame_get_frame_slash (KvpFrame *frame, const char *key_path)
 {
-    char *root;
     if (!frame || !key_path) return frame;
-
-    root = g_strdup (key_path);
-    frame = kvp_frame_get_frame_slash_trash (frame, root);
-    g_free(root);
-    return frame;
+    return kvp_frame_walk_path (frame, key_path, key_path + strlen (key_path),
+                                TRUE);
 }
 
 /* ============================================================ */
@@ -1033,7 +1158,7 @@ kvp_glist_compare(const GList * list1, const GList * list2)
 KvpValue *
 kvp_value_new_gint64(gint64 value)
 {
-    KvpValue * retval  = g_new0(KvpValue, 1);
+    KvpValue * retval  = g_slice_new0(KvpValue);
     retval->type        = KVP_TYPE_GINT64;
     retval->value.int64 = value;
     return retval;
@@ -1042,7 +1167,7 @@ kvp_value_new_gint64(gint64 value)
 KvpValue *
 kvp_value_new_double(double value)
 {
-    KvpValue * retval  = g_new0(KvpValue, 1);
+    KvpValue * retval  = g_slice_new0(KvpValue);
     retval->type        = KVP_TYPE_DOUBLE;
     retval->value.dbl   = value;
     return retval;
@@ -1051,7 +1176,7 @@ kvp_value_new_double(double value)
 KvpValue *
 kvp_value_new_numeric(gnc_numeric value)
 {
-    KvpValue * retval    = g_new0(KvpValue, 1);
+    KvpValue * retval    = g_slice_new0(KvpValue);
     retval->type          = KVP_TYPE_NUMERIC;
     retval->value.numeric = value;
     return retval;
@@ -1063,7 +1188,7 @@ kvp_value_new_string(const char * value)
     KvpValue * retval;
     if (!value) return NULL;
 
-    retval = g_new0(KvpValue, 1);
+    retval = g_slice_new0(KvpValue);
     retval->type       = KVP_TYPE_STRING;
     retval->value.str  = g_strdup(value);
     return retval;
@@ -1075,17 +1200,16 @@ kvp_value_new_guid(const GncGUID * value)
     KvpValue * retval;
     if (!value) return NULL;
 
-    retval = g_new0(KvpValue, 1);
+    retval = g_slice_new0(KvpValue);
     retval->type       = KVP_TYPE_GUID;
-    retval->value.guid = g_new0(GncGUID, 1);
-    memcpy(retval->value.guid, value, sizeof(GncGUID));
+    retval->value.guid = *value;
     return retval;
 }
 
 KvpValue *
 kvp_value_new_timespec(Timespec value)
 {
-    KvpValue * retval = g_new0(KvpValue, 1);
+    KvpValue * retval = g_slice_new0(KvpValue);
     retval->type       = KVP_TYPE_TIMESPEC;
     retval->value.timespec = value;
     return retval;
@@ -1094,7 +1218,7 @@ kvp_value_new_timespec(Timespec value)
 KvpValue *
 kvp_value_new_gdate(GDate value)
 {
-    KvpValue * retval = g_new0(KvpValue, 1);
+    KvpValue * retval = g_slice_new0(KvpValue);
     retval->type       = KVP_TYPE_GDATE;
     retval->value.gdate = value;
     return retval;
@@ -1106,7 +1230,7 @@ kvp_value_new_binary(const void * value, guint64 datasize)
     KvpValue * retval;
     if (!value) return NULL;
 
-    retval = g_new0(KvpValue, 1);
+    retval = g_slice_new0(KvpValue);
     retval->type = KVP_TYPE_BINARY;
     retval->value.binary.data = g_new0(char, datasize);
     retval->value.binary.datasize = datasize;
@@ -1120,7 +1244,7 @@ kvp_value_new_binary_nc(void * value, guint64 datasize)
     KvpValue * retval;
     if (!value) return NULL;
 
-    retval = g_new0(KvpValue, 1);
+    retval = g_slice_new0(KvpValue);
     retval->type = KVP_TYPE_BINARY;
     retval->value.binary.data = value;
     retval->value.binary.datasize = datasize;
@@ -1133,7 +1257,7 @@ kvp_value_new_glist(const GList * value)
     KvpValue * retval;
     if (!value) return NULL;
 
-    retval = g_new0(KvpValue, 1);
+    retval = g_slice_new0(KvpValue);
     retval->type       = KVP_TYPE_GLIST;
     retval->value.list = kvp_glist_copy(value);
     return retval;
@@ -1145,7 +1269,7 @@ kvp_value_new_glist_nc(GList * value)
     KvpValue * retval;
     if (!value) return NULL;
 
-    retval = g_new0(KvpValue, 1);
+    retval = g_slice_new0(KvpValue);
     retval->type       = KVP_TYPE_GLIST;
     retval->value.list = value;
     return retval;
@@ -1157,7 +1281,7 @@ kvp_value_new_frame(const KvpFrame * value)
     KvpValue * retval;
     if (!value) return NULL;
 
-    retval  = g_new0(KvpValue, 1);
+    retval  = g_slice_new0(KvpValue);
     retval->type        = KVP_TYPE_FRAME;
     retval->value.frame = kvp_frame_copy(value);
     return retval;
@@ -1169,7 +1293,7 @@ kvp_value_new_frame_nc(KvpFrame * value)
     KvpValue * retval;
     if (!value) return NULL;
 
-    retval  = g_new0(KvpValue, 1);
+    retval  = g_slice_new0(KvpValue);
     retval->type        = KVP_TYPE_FRAME;
     retval->value.frame = value;
     return retval;
@@ -1185,9 +1309,6 @@ kvp_value_delete(KvpValue * value)
     case KVP_TYPE_STRING:
         g_free(value->value.str);
         break;
-    case KVP_TYPE_GUID:
-        g_free(value->value.guid);
-        break;
     case KVP_TYPE_BINARY:
         g_free(value->value.binary.data);
         break;
@@ -1201,11 +1322,12 @@ kvp_value_delete(KvpValue * value)
     case KVP_TYPE_GINT64:
     case KVP_TYPE_DOUBLE:
     case KVP_TYPE_NUMERIC:
+    case KVP_TYPE_GUID:
     case KVP_TYPE_TIMESPEC:
     case KVP_TYPE_GDATE:
         break;
     }
-    g_free(value);
+    g_slice_free(KvpValue, value);
 }
 
 KvpValueType
@@ -1277,7 +1399,7 @@ kvp_value_get_guid(const KvpValue * value)
     if (!value) return NULL;
     if (value->type == KVP_TYPE_GUID)
     {
-        return value->value.guid;
+        return (GncGUID *) &value->value.guid;
     }
     else
     {
@@ -1408,7 +1530,7 @@ kvp_value_copy(const KvpValue * value)
         return kvp_value_new_string(value->value.str);
         break;
     case KVP_TYPE_GUID:
-        return kvp_value_new_guid(value->value.guid);
+        return kvp_value_new_guid(&value->value.guid);
         break;
     case KVP_TYPE_GDATE:
         return kvp_value_new_gdate(value->value.gdate);
@@ -1437,11 +1559,59 @@ kvp_frame_for_each_slot(KvpFrame *f,
                                      gpointer data),
                         gpointer data)
 {
+    guint i;
+
     if (!f) return;
     if (!proc) return;
-    if (!(f->hash)) return;
 
-    g_hash_table_foreach(f->hash, (GHFunc) proc, data);
+    if (f->hash)
+    {
+        g_hash_table_foreach(f->hash, (GHFunc) proc, data);
+        return;
+    }
+    for (i = 0; i < f->n_slots; i++)
+        proc(f->slots[i].key, f->slots[i].value, data);
+}
+
+static gint
+kvp_key_compare(gconstpointer a, gconstpointer b)
+{
+    return strcmp(*(const char **) a, *(const char **) b);
+}
+
+void
+kvp_frame_for_each_slot_sorted(KvpFrame *f,
+                               void (*proc)(const char *key,
+                                       KvpValue *value,
+                                       gpointer data),
+                               gpointer data)
+{
+    GHashTableIter iter;
+    gpointer key;
+    const char **keys;
+    guint i, n;
+
+    if (!f) return;
+    if (!proc) return;
+
+    /* Small frames are kept in order anyway */
+    if (!f->hash)
+    {
+        kvp_frame_for_each_slot(f, proc, data);
+        return;
+    }
+
+    n = g_hash_table_size(f->hash);
+    keys = g_new(const char *, n);
+    i = 0;
+    g_hash_table_iter_init(&iter, f->hash);
+    while (g_hash_table_iter_next(&iter, &key, NULL))
+        keys[i++] = key;
+    qsort(keys, n, sizeof(const char *), kvp_key_compare);
+
+    for (i = 0; i < n; i++)
+        proc(keys[i], g_hash_table_lookup(f->hash, keys[i]), data);
+    g_free(keys);
 }
 
 #ifdef _MSC_VER
@@ -1484,7 +1654,7 @@ kvp_value_compare(const KvpValue * kva, const KvpValue * kvb)
         return strcmp(kva->value.str, kvb->value.str);
         break;
     case KVP_TYPE_GUID:
-        return guid_compare(kva->value.guid, kvb->value.guid);
+        return guid_compare(&kva->value.guid, &kvb->value.guid);
         break;
     case KVP_TYPE_TIMESPEC:
         return timespec_cmp(&(kva->value.timespec), &(kvb->value.timespec));
@@ -1549,8 +1719,8 @@ kvp_frame_compare(const KvpFrame *fa, const KvpFrame *fb)
     if (fa && !fb) return 1;
 
     /* nothing is always less than something */
-    if (!fa->hash && fb->hash) return -1;
-    if (fa->hash && !fb->hash) return 1;
+    if (kvp_frame_is_empty(fa) && !kvp_frame_is_empty(fb)) return -1;
+    if (!kvp_frame_is_empty(fa) && kvp_frame_is_empty(fb)) return 1;
 
     status.compare = 0;
     status.other_frame = (KvpFrame *) fb;
@@ -1635,7 +1805,7 @@ static gchar*
 kvp_value_to_bare_string(const KvpValue *val);
 
 static void
-kvp_frame_to_bare_string_helper(gpointer key, gpointer value, gpointer data)
+kvp_frame_to_bare_string_helper(const char *key, KvpValue *value, gpointer data)
 {
     gchar **str = (gchar**)data;
     *str = g_strdup_printf("%s", kvp_value_to_bare_string((KvpValue *)value));
@@ -1710,11 +1880,8 @@ kvp_value_to_bare_string(const KvpValue *val)
         KvpFrame *frame;
 
         frame = kvp_value_get_frame(val);
-        if (frame->hash)
-        {
-            tmp1 = g_strdup("");
-            g_hash_table_foreach(frame->hash, kvp_frame_to_bare_string_helper, &tmp1);
-        }
+        tmp1 = g_strdup("");
+        kvp_frame_for_each_slot(frame, kvp_frame_to_bare_string_helper, &tmp1);
         return tmp1;
     }
     case KVP_TYPE_GDATE:
@@ -1810,7 +1977,7 @@ kvp_value_to_string(const KvpValue *val)
 }
 
 static void
-kvp_frame_to_string_helper(gpointer key, gpointer value, gpointer data)
+kvp_frame_to_string_helper(const char *key, KvpValue *value, gpointer data)
 {
     gchar *tmp_val;
     gchar **str = (gchar**)data;
@@ -1836,8 +2003,8 @@ kvp_frame_to_string(const KvpFrame *frame)
 
     tmp1 = g_strdup_printf("{\n");
 
-    if (frame->hash)
-        g_hash_table_foreach(frame->hash, kvp_frame_to_string_helper, &tmp1);
+    kvp_frame_for_each_slot((KvpFrame *) frame, kvp_frame_to_string_helper,
+                            &tmp1);
 
     {
         gchar *tmp2;
@@ -1852,8 +2019,14 @@ kvp_frame_to_string(const KvpFrame *frame)
 GHashTable*
 kvp_frame_get_hash(const KvpFrame *frame)
 {
+    KvpFrame *f = (KvpFrame *) frame;
+
     g_return_val_if_fail (frame != NULL, NULL);
-    return frame->hash;
+
+    /* Callers may hold on to the table, so the frame stays hashed */
+    if (kvp_frame_is_empty (f)) return NULL;
+    kvp_frame_make_hash (f);
+    return f->hash;
 }
 
 /* ========================== END OF FILE ======================= */
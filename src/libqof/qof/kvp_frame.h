@@ -622,11 +622,23 @@ void kvp_frame_for_each_slot(KvpFrame *f,
                                      gpointer data),
                              gpointer data);
 
+/** Like kvp_frame_for_each_slot(), but visits the slots in strcmp()
+   order of their keys, so that output built from them is stable. */
+void kvp_frame_for_each_slot_sorted(KvpFrame *f,
+                                    void (*proc)(const gchar *key,
+                                            KvpValue *value,
+                                            gpointer data),
+                                    gpointer data);
+
 /** @} */
 
 /** Internal helper routines, you probably shouldn't be using these. */
 gchar* kvp_frame_to_string(const KvpFrame *frame);
 gchar* binary_to_string(const void *data, guint32 size);
+/** Returns the slots of a frame as a hash table of key to KvpValue,
+   or NULL if the frame is empty.  Frames with few slots don't keep a
+   hash table, so this converts the frame for good; use
+   kvp_frame_for_each_slot() instead. */
 GHashTable* kvp_frame_get_hash(const KvpFrame *frame);
 
 /** @} */
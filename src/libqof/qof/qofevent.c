@@ -34,6 +34,15 @@ static guint   handler_run_level = 0;
 static guint   pending_deletes   = 0;
 static GList   *handlers  =   NULL;
 
+/* Events generated inside a batch.  There is one change per entity, in
+ * the order the entities first showed up; batch_deferred holds the
+ * events of each that the per-event handlers haven't been sent yet.
+ * batch_entities maps an entity to its change's index plus one. */
+static guint      batch_level      = 0;
+static GArray     *batch_changes   = NULL;
+static GArray     *batch_deferred  = NULL;
+static GHashTable *batch_entities  = NULL;
+
 /* This static indicates the debugging module that this .o belongs to.  */
 static QofLogModule log_module = QOF_MOD_ENGINE;
 
@@ -98,6 +107,35 @@ qof_event_register_handler (QofEventHandler handler, gpointer user_data)
     return handler_id;
 }
 
+gint
+qof_event_register_batch_handler (QofEventBatchHandler handler,
+                                  gpointer user_data)
+{
+    HandlerInfo *hi;
+    gint handler_id;
+
+    ENTER ("(handler=%p, data=%p)", handler, user_data);
+
+    /* sanity check */
+    if (!handler)
+    {
+        PERR ("no handler specified");
+        return 0;
+    }
+
+    handler_id = find_next_handler_id();
+
+    hi = g_new0 (HandlerInfo, 1);
+
+    hi->batch_handler = handler;
+    hi->user_data = user_data;
+    hi->handler_id = handler_id;
+
+    handlers = g_list_prepend (handlers, hi);
+    LEAVE ("(handler=%p, data=%p) handler_id=%d", handler, user_data, handler_id);
+    return handler_id;
+}
+
 void
 qof_event_unregister_handler (gint handler_id)
 {
@@ -116,12 +154,14 @@ qof_event_unregister_handler (gint handler_id)
            of a generated event, such as QOF_EVENT_DESTROY.  In that case,
            we're in the middle of walking the GList and it is wrong to
            modify the list. So, instead, we just NULL the handler. */
-        if (hi->handler)
+        if (hi->handler || hi->batch_handler)
             LEAVE ("(handler_id=%d) handler=%p data=%p", handler_id,
-                   hi->handler, hi->user_data);
+                   hi->handler ? (gpointer) hi->handler
+                   : (gpointer) hi->batch_handler, hi->user_data);
 
         /* safety -- clear the handler in case we're running events now */
         hi->handler = NULL;
+        hi->batch_handler = NULL;
 
         if (handler_run_level == 0)
         {
@@ -163,29 +203,15 @@ qof_event_resume (void)
     suspend_counter--;
 }
 
+/* Run the registered handlers.  Per-event handlers are sent the event
+ * if 'entity' is set, batch handlers the change set if 'changes' is. */
 static void
-qof_event_generate_internal (QofInstance *entity, QofEventId event_id,
-                             gpointer event_data)
+qof_event_run_handlers (QofInstance *entity, QofEventId event_id,
+                        gpointer event_data,
+                        const QofEventChange *changes, guint n_changes)
 {
     GList *node;
     GList *next_node = NULL;
-    gboolean use_old_handlers = FALSE;
-
-    g_return_if_fail(entity);
-
-    if (event_id <= QOF_EVENT__LAST)
-    {
-        use_old_handlers = TRUE;
-    }
-
-    switch (event_id)
-    {
-    case QOF_EVENT_NONE:
-    {
-        /* if none, don't log, just return. */
-        return;
-    }
-    }
 
     handler_run_level++;
     for (node = handlers; node; node = next_node)
@@ -193,12 +219,18 @@ qof_event_generate_internal (QofInstance *entity, QofEventId event_id,
         HandlerInfo *hi = node->data;
 
         next_node = node->next;
-        if (hi->handler)
+        if (hi->handler && entity)
         {
             PINFO("id=%d hi=%p han=%p data=%p", hi->handler_id, hi,
                   hi->handler, event_data);
             hi->handler (entity, event_id, hi->user_data, event_data);
         }
+        else if (hi->batch_handler && changes)
+        {
+            PINFO("id=%d hi=%p han=%p changes=%u", hi->handler_id, hi,
+                  hi->batch_handler, n_changes);
+            hi->batch_handler (changes, n_changes, hi->user_data);
+        }
     }
     handler_run_level--;
 
@@ -211,7 +243,7 @@ qof_event_generate_internal (QofInstance *entity, QofEventId event_id,
         {
             HandlerInfo *hi = node->data;
             next_node = node->next;
-            if (hi->handler == NULL)
+            if (hi->handler == NULL && hi->batch_handler == NULL)
             {
                 /* remove this node from the list, then free this node */
                 handlers = g_list_remove_link (handlers, node);
@@ -223,6 +255,183 @@ qof_event_generate_internal (QofInstance *entity, QofEventId event_id,
     }
 }
 
+/* Send each of the events in 'events' to the per-event handlers */
+static void
+qof_event_run_deferred (QofInstance *entity, QofEventId events)
+{
+    guint bit;
+
+    for (bit = 1; bit && bit <= (guint) events; bit <<= 1)
+    {
+        if (events & bit)
+            qof_event_run_handlers (entity, bit, NULL, NULL, 0);
+    }
+}
+
+/* Take the entity out of the batch, returning its change so far. */
+static QofEventChange
+qof_event_batch_take (QofInstance *entity, QofEventId *deferred)
+{
+    QofEventChange change;
+    guint idx;
+
+    change.entity = entity;
+    change.events = 0;
+    *deferred = 0;
+    idx = GPOINTER_TO_UINT (g_hash_table_lookup (batch_entities, entity));
+    if (idx)
+    {
+        QofEventChange *pending;
+
+        pending = &g_array_index (batch_changes, QofEventChange, idx - 1);
+        change.events = pending->events;
+        pending->entity = NULL;
+        *deferred = g_array_index (batch_deferred, QofEventId, idx - 1);
+        g_hash_table_remove (batch_entities, entity);
+    }
+    return change;
+}
+
+static void
+qof_event_batch_add (QofInstance *entity, QofEventId event_id,
+                     gpointer event_data)
+{
+    QofEventChange change;
+    QofEventId deferred;
+    guint idx;
+
+    /* The entity won't be around at the end of the batch, so send what
+     * it has so far, and its destruction, right away. */
+    if (event_id == QOF_EVENT_DESTROY)
+    {
+        change = qof_event_batch_take (entity, &deferred);
+        change.events |= event_id;
+        qof_event_run_deferred (entity, deferred);
+        qof_event_run_handlers (entity, event_id, event_data, &change, 1);
+        return;
+    }
+
+    idx = GPOINTER_TO_UINT (g_hash_table_lookup (batch_entities, entity));
+    if (!idx)
+    {
+        change.entity = entity;
+        change.events = 0;
+        deferred = 0;
+        g_array_append_val (batch_changes, change);
+        g_array_append_val (batch_deferred, deferred);
+        idx = batch_changes->len;
+        g_hash_table_insert (batch_entities, entity, GUINT_TO_POINTER (idx));
+    }
+    g_array_index (batch_changes, QofEventChange, idx - 1).events |= event_id;
+
+    /* Event data may not outlive the call, so such events go to the
+     * per-event handlers now.  The batch handlers only get the entity. */
+    if (event_data)
+        qof_event_run_handlers (entity, event_id, event_data, NULL, 0);
+    else
+        g_array_index (batch_deferred, QofEventId, idx - 1) |= event_id;
+}
+
+static void
+qof_event_generate_internal (QofInstance *entity, QofEventId event_id,
+                             gpointer event_data)
+{
+    QofEventChange change;
+
+    g_return_if_fail(entity);
+
+    switch (event_id)
+    {
+    case QOF_EVENT_NONE:
+    {
+        /* if none, don't log, just return. */
+        return;
+    }
+    }
+
+    if (batch_level)
+    {
+        qof_event_batch_add (entity, event_id, event_data);
+        return;
+    }
+
+    change.entity = entity;
+    change.events = event_id;
+    qof_event_run_handlers (entity, event_id, event_data, &change, 1);
+}
+
+void
+qof_event_begin_batch (void)
+{
+    if (batch_level++)
+        return;
+
+    batch_changes = g_array_new (FALSE, FALSE, sizeof (QofEventChange));
+    batch_deferred = g_array_new (FALSE, FALSE, sizeof (QofEventId));
+    batch_entities = g_hash_table_new (g_direct_hash, g_direct_equal);
+}
+
+void
+qof_event_end_batch (void)
+{
+    GArray *changes, *deferred;
+    guint i, n;
+
+    if (batch_level == 0)
+    {
+        PERR ("batch level underflow");
+        return;
+    }
+    if (--batch_level)
+        return;
+
+    /* Handlers may generate events of their own, which aren't batched */
+    changes = batch_changes;
+    deferred = batch_deferred;
+    g_hash_table_destroy (batch_entities);
+    batch_changes = batch_deferred = NULL;
+    batch_entities = NULL;
+
+    /* Drop the entities that went away during the batch */
+    for (i = n = 0; i < changes->len; i++)
+    {
+        QofEventChange *change = &g_array_index (changes, QofEventChange, i);
+        if (!change->entity)
+            continue;
+        g_array_index (changes, QofEventChange, n) = *change;
+        g_array_index (deferred, QofEventId, n) =
+            g_array_index (deferred, QofEventId, i);
+        n++;
+    }
+
+    PINFO ("delivering %u changes", n);
+    for (i = 0; i < n; i++)
+        qof_event_run_deferred (g_array_index (changes, QofEventChange, i).entity,
+                                g_array_index (deferred, QofEventId, i));
+    if (n)
+        qof_event_run_handlers (NULL, QOF_EVENT_NONE, NULL,
+                                (QofEventChange *) changes->data, n);
+
+    g_array_free (changes, TRUE);
+    g_array_free (deferred, TRUE);
+}
+
+gboolean
+qof_event_in_batch (void)
+{
+    return batch_level > 0;
+}
+
+void
+qof_event_forget_instance (QofInstance *entity)
+{
+    QofEventId deferred;
+
+    if (!batch_level || !entity)
+        return;
+    qof_event_batch_take (entity, &deferred);
+}
+
 void
 qof_event_force (QofInstance *entity, QofEventId event_id, gpointer event_data)
 {
@@ -84,6 +84,30 @@ for future libqof1 or libqof2 usage.
 typedef void (*QofEventHandler) (QofInstance *ent,  QofEventId event_type,
                                  gpointer handler_data, gpointer event_data);
 
+/** \brief One entry of the change set given to batch handlers.
+ *
+ * @param entity:  Entity that generated the events
+ * @param events:  The ids of all its events, or'ed together.
+ */
+typedef struct
+{
+    QofInstance *entity;
+    QofEventId   events;
+} QofEventChange;
+
+/** \brief Handler invoked with a set of changes.
+ *
+ * Outside a batch it is invoked once per event, with a single change.
+ * The event data of the events is not passed on.
+ *
+ * @param changes:  The entities that changed, each listed once.
+ * @param n_changes:  The number of entries in changes.
+ * @param handler_data:   data supplied when handler was registered.
+ */
+typedef void (*QofEventBatchHandler) (const QofEventChange *changes,
+                                      guint n_changes,
+                                      gpointer handler_data);
+
 /** \brief Register a handler for events.
  *
  * @param handler:   handler to register
@@ -93,6 +117,18 @@ typedef void (*QofEventHandler) (QofInstance *ent,  QofEventId event_type,
  */
 gint qof_event_register_handler (QofEventHandler handler, gpointer handler_data);
 
+/** \brief Register a handler that is sent the changes of a whole
+ * event batch in one call.
+ *
+ * @param handler:   handler to register
+ * @param handler_data: data provided when handler is invoked
+ *
+ * @return id identifying handler, which is unregistered with
+ * qof_event_unregister_handler()
+ */
+gint qof_event_register_batch_handler (QofEventBatchHandler handler,
+                                       gpointer handler_data);
+
 /** \brief Unregister an event handler.
  *
  * @param handler_id: the id of the handler to unregister
@@ -134,5 +170,36 @@ void qof_event_suspend (void);
 /** Resume engine event generation. */
 void qof_event_resume (void);
 
+/** \brief Start collecting events instead of delivering them.
+ *
+ *    Until the matching qof_event_end_batch, each entity's events are
+ *    collected rather than sent, and every distinct event is only
+ *    sent once.  Batches nest; events are delivered when the outermost
+ *    one ends.  Wrap bulk changes such as imports in a batch.
+ *
+ *    A few events can't wait for the end of the batch:
+ *
+ * - Events with event data are still sent to per-event handlers at
+ *     once, as their data may not outlive the call.
+ * - A QOF_EVENT_DESTROY is sent at once, preceded by whatever the
+ *     entity had collected, since the entity won't be around later.
+ *
+ *    An entity freed without a QOF_EVENT_DESTROY is dropped from the
+ *    batch.
+ */
+void qof_event_begin_batch (void);
+
+/** \brief End an event batch, delivering its events if it is the
+ *  outermost one.
+ *
+ *    Per-event handlers are sent each entity's collected events in
+ *    the order the entities first changed.  Then every batch handler
+ *    is sent the whole change set in one call.
+ */
+void qof_event_end_batch (void);
+
+/** Whether events are currently being batched. */
+gboolean qof_event_in_batch (void);
+
 #endif
 /** @} */
@@ -33,12 +33,36 @@
 static QofLogModule log_module = QOF_MOD_ENGINE;
 static gboolean qof_alt_dirty_mode = FALSE;
 
+/* One slot of the entity table.  The GncGUID is copied in, so a probe
+ * compares the key without following a pointer. */
+typedef struct
+{
+    GncGUID       guid;
+    QofInstance * ent;       /* NULL if the slot is empty */
+} QofCollectionSlot;
+
+/* Marks a slot whose entity was removed.  Probes go on past it, and
+ * inserts may reuse it. */
+static gchar slot_removed;
+#define SLOT_REMOVED ((QofInstance *) &slot_removed)
+
+/* The table is kept at most three quarters full, removed slots
+ * included. */
+#define SLOT_FULL(used,size) ((guint64) (used) * 4 > (guint64) (size) * 3)
+
 struct QofCollection_s
 {
     QofIdType    e_type;
     gboolean     is_dirty;
 
-    GHashTable * hash_of_entities;
+    /* The entities, in an open addressing table of 2^slot_bits slots
+     * keyed by their GncGUID. */
+    QofCollectionSlot * slots;
+    guint        slot_bits;
+    guint        n_entities;
+    guint        n_used;     /* entities plus removed slots */
+    guint        iterating;  /* nesting depth of qof_collection_foreach */
+
     gpointer     data;       /* place where object class can hang arbitrary data */
 };
 
@@ -56,6 +80,138 @@ qof_set_alt_dirty_mode (gboolean enabled)
     qof_alt_dirty_mode = enabled;
 }
 
+/* =============================================================== */
+/* The entity table */
+
+/* GUIDs are random already, so folding the two halves and spreading
+ * them with a Fibonacci multiply is all the hashing needed.  The
+ * multiply keeps made-up GUIDs that differ in a few bytes apart. */
+static inline guint
+slot_index (const GncGUID *guid, guint slot_bits)
+{
+    guint64 a, b;
+
+    memcpy (&a, guid->data, sizeof (a));
+    memcpy (&b, guid->data + sizeof (a), sizeof (b));
+    return (guint) (((a ^ b) * G_GUINT64_CONSTANT (0x9E3779B97F4A7C15))
+                    >> (64 - slot_bits));
+}
+
+static QofCollectionSlot *
+collection_find_slot (const QofCollection *col, const GncGUID *guid)
+{
+    guint mask, i;
+
+    if (!col->slots) return NULL;
+
+    mask = (1U << col->slot_bits) - 1;
+    for (i = slot_index (guid, col->slot_bits); ; i = (i + 1) & mask)
+    {
+        QofCollectionSlot *slot = &col->slots[i];
+
+        if (slot->ent == NULL)
+            return NULL;
+        if (slot->ent != SLOT_REMOVED &&
+                memcmp (slot->guid.data, guid->data, GUID_DATA_SIZE) == 0)
+            return slot;
+    }
+}
+
+/* Rebuild the table with 2^slot_bits slots, dropping removed slots. */
+static void
+collection_resize (QofCollection *col, guint slot_bits)
+{
+    QofCollectionSlot *old_slots = col->slots;
+    guint old_size = old_slots ? 1U << col->slot_bits : 0;
+    guint mask = (1U << slot_bits) - 1;
+    guint i, j;
+
+    col->slots = g_new0 (QofCollectionSlot, mask + 1);
+    col->slot_bits = slot_bits;
+    col->n_used = col->n_entities;
+
+    for (i = 0; i < old_size; i++)
+    {
+        QofCollectionSlot *slot = &old_slots[i];
+
+        if (slot->ent == NULL || slot->ent == SLOT_REMOVED)
+            continue;
+
+        j = slot_index (&slot->guid, slot_bits);
+        while (col->slots[j].ent != NULL)
+            j = (j + 1) & mask;
+        col->slots[j] = *slot;
+    }
+
+    g_free (old_slots);
+}
+
+/* The number of bits of the smallest table that takes 'n' entities. */
+static guint
+collection_bits_for (guint64 n)
+{
+    guint bits = 4;
+
+    while (SLOT_FULL (n, 1U << bits))
+        bits++;
+    return bits;
+}
+
+static void
+collection_table_insert (QofCollection *col, const GncGUID *guid,
+                         QofInstance *ent)
+{
+    QofCollectionSlot *slot, *free_slot = NULL;
+    guint mask, i;
+
+    slot = collection_find_slot (col, guid);
+    if (slot)
+    {
+        slot->ent = ent;
+        return;
+    }
+
+    /* A foreach may be walking the slots, so only grow once it is done,
+     * unless the table is about to run out of empty slots.  Grow to
+     * twice the size needed, so that inserts seldom resize. */
+    if (!col->slots ||
+            (SLOT_FULL (col->n_used + 1, 1U << col->slot_bits) &&
+             (!col->iterating || col->n_used + 2 > (1U << col->slot_bits))))
+        collection_resize (col, collection_bits_for (2 * ((guint64) col->n_entities + 1)));
+
+    mask = (1U << col->slot_bits) - 1;
+    for (i = slot_index (guid, col->slot_bits); ; i = (i + 1) & mask)
+    {
+        slot = &col->slots[i];
+        if (slot->ent == SLOT_REMOVED && !free_slot)
+            free_slot = slot;
+        else if (slot->ent == NULL)
+            break;
+    }
+
+    if (free_slot)
+        slot = free_slot;
+    else
+        col->n_used++;
+
+    slot->guid = *guid;
+    slot->ent = ent;
+    col->n_entities++;
+}
+
+static void
+collection_table_remove (QofCollection *col, const GncGUID *guid)
+{
+    QofCollectionSlot *slot = collection_find_slot (col, guid);
+
+    if (!slot) return;
+
+    /* Removed slots stay in place, so that a foreach which removes
+     * entities still sees every other one exactly once. */
+    slot->ent = SLOT_REMOVED;
+    col->n_entities--;
+}
+
 /* =============================================================== */
 
 QofCollection *
@@ -64,7 +220,7 @@ qof_collection_new (QofIdType type)
     QofCollection *col;
     col = g_new0(QofCollection, 1);
     col->e_type = CACHE_INSERT (type);
-    col->hash_of_entities = guid_hash_table_new();
+    col->slots = NULL;
     col->data = NULL;
     return col;
 }
@@ -73,13 +229,25 @@ void
 qof_collection_destroy (QofCollection *col)
 {
     CACHE_REMOVE (col->e_type);
-    g_hash_table_destroy(col->hash_of_entities);
+    g_free (col->slots);
     col->e_type = NULL;
-    col->hash_of_entities = NULL;
+    col->slots = NULL;
     col->data = NULL;   /** XXX there should be a destroy notifier for this */
     g_free (col);
 }
 
+void
+qof_collection_reserve (QofCollection *col, guint n_entities)
+{
+    guint bits;
+
+    g_return_if_fail (col);
+
+    bits = collection_bits_for (MAX (n_entities, col->n_entities));
+    if (!col->slots || bits > col->slot_bits)
+        collection_resize (col, bits);
+}
+
 /* =============================================================== */
 /* getters */
 
@@ -101,7 +269,7 @@ qof_collection_remove_entity (QofInstance *ent)
     col = qof_instance_get_collection(ent);
     if (!col) return;
     guid = qof_instance_get_guid(ent);
-    g_hash_table_remove (col->hash_of_entities, guid);
+    collection_table_remove (col, guid);
     if (!qof_alt_dirty_mode)
         qof_collection_mark_dirty(col);
     qof_instance_set_collection(ent, NULL);
@@ -117,7 +285,7 @@ qof_collection_insert_entity (QofCollection *col, QofInstance *ent)
     if (guid_equal(guid, guid_null())) return;
     g_return_if_fail (col->e_type == ent->e_type);
     qof_collection_remove_entity (ent);
-    g_hash_table_insert (col->hash_of_entities, (gpointer)guid, ent);
+    collection_table_insert (col, guid, ent);
     if (!qof_alt_dirty_mode)
         qof_collection_mark_dirty(col);
     qof_instance_set_collection(ent, col);
@@ -145,7 +313,7 @@ qof_collection_add_entity (QofCollection *coll, QofInstance *ent)
     {
         return FALSE;
     }
-    g_hash_table_insert (coll->hash_of_entities, (gpointer)guid, ent);
+    collection_table_insert (coll, guid, ent);
     if (!qof_alt_dirty_mode)
         qof_collection_mark_dirty(coll);
     return TRUE;
@@ -231,11 +399,11 @@ qof_collection_compare (QofCollection *target, QofCollection *merge)
 QofInstance *
 qof_collection_lookup_entity (const QofCollection *col, const GncGUID * guid)
 {
-    QofInstance *ent;
+    QofCollectionSlot *slot;
     g_return_val_if_fail (col, NULL);
     if (guid == NULL) return NULL;
-    ent = g_hash_table_lookup (col->hash_of_entities, guid);
-    return ent;
+    slot = collection_find_slot (col, guid);
+    return slot ? slot->ent : NULL;
 }
 
 QofCollection *
@@ -260,10 +428,7 @@ qof_collection_from_glist (QofIdType type, const GList *glist)
 guint
 qof_collection_count (const QofCollection *col)
 {
-    guint c;
-
-    c = g_hash_table_size(col->hash_of_entities);
-    return c;
+    return col->n_entities;
 }
 
 /* =============================================================== */
@@ -319,33 +484,28 @@ qof_collection_set_data (QofCollection *col, gpointer user_data)
 
 /* =============================================================== */
 
-struct _iterate
-{
-    QofInstanceForeachCB      fcn;
-    gpointer                data;
-};
-
-static void foreach_cb (gpointer key, gpointer item, gpointer arg)
-{
-    struct _iterate *iter = arg;
-    QofInstance *ent = item;
-
-    iter->fcn (ent, iter->data);
-}
-
 void
 qof_collection_foreach (const QofCollection *col, QofInstanceForeachCB cb_func,
                         gpointer user_data)
 {
-    struct _iterate iter;
+    QofCollection *coll = (QofCollection *) col;
+    guint i;
 
     g_return_if_fail (col);
     g_return_if_fail (cb_func);
 
-    iter.fcn = cb_func;
-    iter.data = user_data;
+    /* The callback may add or remove entities.  Removing one leaves its
+     * slot in place and inserting holds off growing the table, so the
+     * slots stay put while they are walked. */
+    coll->iterating++;
+    for (i = 0; coll->slots && i < (1U << coll->slot_bits); i++)
+    {
+        QofInstance *ent = coll->slots[i].ent;
 
-    g_hash_table_foreach (col->hash_of_entities, foreach_cb, &iter);
+        if (ent != NULL && ent != SLOT_REMOVED)
+            cb_func (ent, user_data);
+    }
+    coll->iterating--;
 }
 
 /* =============================================================== */
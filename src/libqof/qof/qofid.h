@@ -135,7 +135,7 @@ print error message if its bad  */
 
 @param e_type QofIdType
 @param is_dirty gboolean
-@param hash_of_entities GHashTable
+@param slots open addressing table of the entities, keyed by GncGUID
 @param data gpointer, place where object class can hang arbitrary data
 
 */
@@ -167,6 +167,14 @@ QofCollection * qof_collection_new (QofIdType type);
 /** return the number of entities in the collection. */
 guint qof_collection_count (const QofCollection *col);
 
+/** Make room for 'n_entities' entities in the collection up front.
+ *
+ * A loader that knows how many entities it is about to insert can call
+ * this to avoid growing the lookup table over and over.  The table is
+ * sized for just that many, so reserve no more than will come.  It
+ * never shrinks the table. */
+void qof_collection_reserve (QofCollection *col, guint n_entities);
+
 /** destroy the collection */
 void qof_collection_destroy (QofCollection *col);
 
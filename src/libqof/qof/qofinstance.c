@@ -33,6 +33,7 @@
 #include "qof.h"
 #include "kvp-util-p.h"
 #include "qofbook-p.h"
+#include "qofevent-p.h"
 #include "qofid-p.h"
 #include "qofinstance-p.h"
 
@@ -327,6 +328,8 @@ qof_instance_dispose (GObject *instp)
     QofInstancePrivate *priv;
     QofInstance* inst = QOF_INSTANCE(instp);
 
+    qof_event_forget_instance(inst);
+
     priv = GET_PRIVATE(instp);
     if (!priv->collection)
         return;
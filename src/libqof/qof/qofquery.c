@@ -80,6 +80,10 @@ struct _QofQuery
      * logical expression. */
     GList *           terms;
 
+    /* The AND-terms of each OR-term in the order they are checked,
+     * most selective first.  Filled in when the terms are compiled. */
+    GList *           plan;
+
     /* sorting and chopping is independent of the search filter */
 
     QofQuerySort      primary_sort;
@@ -103,13 +107,54 @@ struct _QofQuery
     GList *           results;
 };
 
+/* An object that passed the query, and the order in which it did */
+typedef struct
+{
+    gpointer          object;
+    guint             seq;
+} QofQueryMatch;
+
 typedef struct _QofQueryCB
 {
     QofQuery *        query;
-    GList *           list;
+    GArray *          matches;  /* QofQueryMatch */
+    gint              limit;    /* keep at most this many; -1 keeps all */
+    gboolean          sorted;
     gint              count;
 } QofQueryCB;
 
+/* A registered secondary index */
+typedef struct
+{
+    const char *            name;
+    QofQueryParamList *     param_list;
+    QofQueryIndexEstimate   estimate;
+    QofQueryIndexForeach    foreach;
+} QofQueryIndex;
+
+/* How the candidates for one OR-term are fetched from a book: from an
+ * index on one of its terms, or, with no index, by looking up the
+ * GUIDs of a QOF_PARAM_GUID term. */
+typedef struct
+{
+    const QofQueryTerm *    term;
+    const QofQueryIndex *   index;
+    gint64                  estimate;
+} QofQueryAccess;
+
+/* obj_type -> GList of QofQueryIndex */
+static GHashTable *indexTable = NULL;
+
+static void query_free_plan (QofQuery *q)
+{
+    GList *node;
+
+    for (node = q->plan; node; node = node->next)
+        g_list_free (node->data);
+    g_list_free (q->plan);
+    q->plan = NULL;
+}
+
 /* initial_term will be owned by the new Query */
 static void query_init (QofQuery *q, QofQueryTerm *initial_term)
 {
@@ -159,6 +204,9 @@ static void swap_terms (QofQuery *q1, QofQuery *q2)
 
     if (!q1 || !q2) return;
 
+    query_free_plan (q1);
+    query_free_plan (q2);
+
     g = q1->terms;
     q1->terms = q2->terms;
     q2->terms = g;
@@ -243,6 +291,7 @@ static void free_members (QofQuery *q)
 
     if (q == NULL) return;
 
+    query_free_plan (q);
     for (cur_or = q->terms; cur_or; cur_or = cur_or->next)
     {
         GList * cur_and;
@@ -349,6 +398,97 @@ static int sort_func (const gconstpointer a, const gconstpointer b, const gpoint
     }
 }
 
+/* Matches are ordered by the sort, and then by the order they were
+ * found in, which is the order the old list-based code left them in. */
+static int match_cmp (gconstpointer a, gconstpointer b, gpointer q)
+{
+    const QofQueryMatch *ma = a, *mb = b;
+    int retval = sort_func (ma->object, mb->object, q);
+
+    if (retval)
+        return retval;
+    if (ma->seq == mb->seq)
+        return 0;
+    return ma->seq < mb->seq ? -1 : 1;
+}
+
+/* With max_results set on a sorted query only the last max_results
+ * matches are wanted.  They are kept in a heap with the first of them
+ * at the top, so a new match only has to be compared against that one
+ * to know whether it is kept: O(n log k) rather than sorting them all. */
+static void match_heap_sift_up (QofQueryCB *qcb, guint i)
+{
+    QofQueryMatch *heap = (QofQueryMatch *) qcb->matches->data;
+
+    while (i > 0)
+    {
+        guint parent = (i - 1) / 2;
+        QofQueryMatch tmp;
+
+        if (match_cmp (&heap[parent], &heap[i], qcb->query) <= 0)
+            break;
+        tmp = heap[parent];
+        heap[parent] = heap[i];
+        heap[i] = tmp;
+        i = parent;
+    }
+}
+
+static void match_heap_sift_down (QofQueryCB *qcb, guint i)
+{
+    QofQueryMatch *heap = (QofQueryMatch *) qcb->matches->data;
+    guint n = qcb->matches->len;
+
+    while (TRUE)
+    {
+        guint least = i, child = 2 * i + 1;
+        QofQueryMatch tmp;
+
+        if (child < n && match_cmp (&heap[child], &heap[least], qcb->query) < 0)
+            least = child;
+        if (child + 1 < n &&
+                match_cmp (&heap[child + 1], &heap[least], qcb->query) < 0)
+            least = child + 1;
+        if (least == i)
+            break;
+        tmp = heap[least];
+        heap[least] = heap[i];
+        heap[i] = tmp;
+        i = least;
+    }
+}
+
+static void query_keep_match (QofQueryCB *qcb, gpointer object)
+{
+    GArray *matches = qcb->matches;
+    QofQueryMatch match;
+
+    match.object = object;
+    match.seq = qcb->count++;
+
+    if (qcb->limit < 0 || matches->len < (guint) qcb->limit)
+    {
+        g_array_append_val (matches, match);
+        if (qcb->sorted && qcb->limit > 0)
+            match_heap_sift_up (qcb, matches->len - 1);
+    }
+    else if (qcb->limit == 0)
+    {
+        return;
+    }
+    else if (!qcb->sorted)
+    {
+        /* Unsorted, the last ones found are kept: use a ring */
+        g_array_index (matches, QofQueryMatch, match.seq % qcb->limit) = match;
+    }
+    else if (match_cmp (&match, &g_array_index (matches, QofQueryMatch, 0),
+                        qcb->query) > 0)
+    {
+        g_array_index (matches, QofQueryMatch, 0) = match;
+        match_heap_sift_down (qcb, 0);
+    }
+}
+
 /* ==================================================================== */
 /* This is the main workhorse for performing the query.  For each
  * object, it walks over all of the query terms to see if the
@@ -363,7 +503,7 @@ check_object (const QofQuery *q, gpointer object)
     const QofQueryTerm * qt;
     int       and_terms_ok = 1;
 
-    for (or_ptr = q->terms; or_ptr; or_ptr = or_ptr->next)
+    for (or_ptr = q->plan ? q->plan : q->terms; or_ptr; or_ptr = or_ptr->next)
     {
         and_terms_ok = 1;
         for (and_ptr = or_ptr->data; and_ptr; and_ptr = and_ptr->next)
@@ -499,6 +639,74 @@ compile_sort (QofQuerySort *sort, QofIdType obj)
     LEAVE ("sort=%p id=%s", sort, obj);
 }
 
+/* A rough guess at the fraction of objects a term lets through.  It
+ * doesn't have to be good: the point is to check the terms most likely
+ * to fail first. */
+static double
+term_selectivity (const QofQueryTerm *qt)
+{
+    const QofQueryPredData *pd = qt->pdata;
+    double sel;
+
+    /* Terms that couldn't be compiled are never checked */
+    if (!qt->param_fcns || !qt->pred_fcn)
+        return 1.0;
+
+    if (!safe_strcmp (pd->type_name, QOF_TYPE_GUID))
+    {
+        switch (((const query_guid_def *) pd)->options)
+        {
+        case QOF_GUID_MATCH_ANY:
+        case QOF_GUID_MATCH_LIST_ANY:
+            sel = 0.01;
+            break;
+        case QOF_GUID_MATCH_ALL:
+            sel = 0.05;
+            break;
+        case QOF_GUID_MATCH_NULL:
+            sel = 0.1;
+            break;
+        default:
+            sel = 0.99;
+            break;
+        }
+    }
+    else if (!safe_strcmp (pd->type_name, QOF_TYPE_BOOLEAN))
+    {
+        sel = 0.5;
+    }
+    else
+    {
+        switch (pd->how)
+        {
+        case QOF_COMPARE_EQUAL:
+            sel = 0.05;
+            break;
+        case QOF_COMPARE_NEQ:
+            sel = 0.95;
+            break;
+        default:
+            sel = 0.33;
+            break;
+        }
+    }
+
+    return qt->invert ? 1.0 - sel : sel;
+}
+
+/* Most selective first, then the shorter parameter chains */
+static gint
+term_order (gconstpointer a, gconstpointer b)
+{
+    const QofQueryTerm *ta = a, *tb = b;
+    double sa = term_selectivity (ta), sb = term_selectivity (tb);
+
+    if (sa != sb)
+        return sa < sb ? -1 : 1;
+    return (gint) g_slist_length (ta->param_fcns) -
+           (gint) g_slist_length (tb->param_fcns);
+}
+
 static void compile_terms (QofQuery *q)
 {
     GList *or_ptr, *and_ptr, *node;
@@ -532,6 +740,14 @@ static void compile_terms (QofQuery *q)
         }
     }
 
+    /* Order the AND-terms for check_object.  The sort is stable, so
+     * terms that look alike keep the order they were given in. */
+    query_free_plan (q);
+    for (or_ptr = q->terms; or_ptr; or_ptr = or_ptr->next)
+        q->plan = g_list_prepend (q->plan, g_list_sort (g_list_copy (or_ptr->data),
+                                  term_order));
+    q->plan = g_list_reverse (q->plan);
+
     /* Update the sort functions */
     compile_sort (&(q->primary_sort), q->search_for);
     compile_sort (&(q->secondary_sort), q->search_for);
@@ -562,10 +778,7 @@ static void check_item_cb (gpointer object, gpointer user_data)
     if (!object || !ql) return;
 
     if (check_object (ql->query, object))
-    {
-        ql->list = g_list_prepend (ql->list, object);
-        ql->count++;
-    }
+        query_keep_match (ql, object);
     return;
 }
 
@@ -623,6 +836,149 @@ static void query_clear_compiles (QofQuery *q)
     g_hash_table_foreach_remove (q->be_compiled, query_free_compiled, NULL);
 }
 
+/* A QOF_PARAM_GUID term naming the objects it wants */
+static gboolean
+term_is_guid_lookup (const QofQuery *q, const QofQueryTerm *qt)
+{
+    const QofObject *obj;
+
+    if (qt->param_list == NULL || qt->param_list->next != NULL ||
+            safe_strcmp (qt->param_list->data, QOF_PARAM_GUID) ||
+            safe_strcmp (qt->pdata->type_name, QOF_TYPE_GUID) ||
+            ((const query_guid_def *) qt->pdata)->options != QOF_GUID_MATCH_ANY)
+        return FALSE;
+
+    /* Objects whose foreach skips some of the collection have to be
+     * scanned, or the lookup could find objects the scan wouldn't. */
+    obj = qof_object_lookup (q->search_for);
+    return obj && obj->foreach == qof_collection_foreach;
+}
+
+/* Estimate the candidates an index, or a GUID lookup, would give for
+ * the term in 'book'.  Returns -1 if neither can be used. */
+static gint64
+term_estimate (const QofQuery *q, const QofQueryTerm *qt, QofBook *book,
+               const QofQueryIndex **index)
+{
+    GList *node;
+
+    *index = NULL;
+    if (qt->invert || !qt->param_fcns || !qt->pred_fcn)
+        return -1;
+
+    if (term_is_guid_lookup (q, qt))
+        return g_list_length (((const query_guid_def *) qt->pdata)->guids);
+
+    if (!indexTable)
+        return -1;
+    for (node = g_hash_table_lookup (indexTable, q->search_for); node;
+            node = node->next)
+    {
+        const QofQueryIndex *idx = node->data;
+        gint64 estimate;
+
+        if (param_list_cmp (idx->param_list, qt->param_list))
+            continue;
+        estimate = (idx->estimate)(book, qt->pdata);
+        if (estimate >= 0)
+        {
+            *index = idx;
+            return estimate;
+        }
+    }
+    return -1;
+}
+
+/* Pick the access with the fewest candidates for each OR-term.  Returns
+ * FALSE, and no accesses, if the book is better off scanned: some
+ * OR-term has nothing to go on, or the indexes would hand back most of
+ * the book anyway. */
+static gboolean
+query_plan_book (const QofQuery *q, QofBook *book, GList **accesses,
+                 gint64 *total)
+{
+    QofCollection *col = qof_book_get_collection (book, q->search_for);
+    GList *or_ptr, *and_ptr;
+
+    *accesses = NULL;
+    *total = 0;
+    if (!q->terms)
+        return FALSE;
+
+    for (or_ptr = q->terms; or_ptr; or_ptr = or_ptr->next)
+    {
+        QofQueryAccess *best = NULL;
+
+        for (and_ptr = or_ptr->data; and_ptr; and_ptr = and_ptr->next)
+        {
+            const QofQueryIndex *index;
+            gint64 estimate = term_estimate (q, and_ptr->data, book, &index);
+
+            if (estimate < 0 || (best && estimate >= best->estimate))
+                continue;
+            if (!best)
+                best = g_new0 (QofQueryAccess, 1);
+            best->term = and_ptr->data;
+            best->index = index;
+            best->estimate = estimate;
+        }
+
+        if (!best)
+            break;
+        *accesses = g_list_append (*accesses, best);
+        *total += best->estimate;
+    }
+
+    if (or_ptr || *total >= (gint64) qof_collection_count (col))
+    {
+        g_list_foreach (*accesses, (GFunc) g_free, NULL);
+        g_list_free (*accesses);
+        *accesses = NULL;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static void
+access_foreach (const QofQuery *q, QofBook *book, const QofQueryAccess *access,
+                QofInstanceForeachCB cb, gpointer user_data)
+{
+    QofCollection *col;
+    GList *node;
+
+    if (access->index)
+    {
+        (access->index->foreach)(book, access->term->pdata, cb, user_data);
+        return;
+    }
+
+    col = qof_book_get_collection (book, q->search_for);
+    for (node = ((const query_guid_def *) access->term->pdata)->guids; node;
+            node = node->next)
+    {
+        QofInstance *inst = qof_collection_lookup_entity (col, node->data);
+        if (inst)
+            cb (inst, user_data);
+    }
+}
+
+typedef struct
+{
+    QofQueryCB *    qcb;
+    GHashTable *    seen;
+} QofQueryCandidates;
+
+/* Different OR-terms, or an index, may offer an object more than once */
+static void check_candidate_cb (QofInstance *inst, gpointer user_data)
+{
+    QofQueryCandidates *cand = user_data;
+
+    if (!inst || g_hash_table_lookup (cand->seen, inst))
+        return;
+    g_hash_table_insert (cand->seen, inst, inst);
+    check_item_cb (inst, cand->qcb);
+}
+
 /********************************************************************/
 /* PUBLISHED API FUNCTIONS */
 
@@ -677,6 +1033,7 @@ void qof_query_purge_terms (QofQuery *q, QofQueryParamList *param_list)
 
     if (!q || !param_list) return;
 
+    query_free_plan (q);
     for (or = q->terms; or; or = or->next)
     {
         for (and = or->data; and; and = and->next)
@@ -712,6 +1069,9 @@ static GList * qof_query_run_internal (QofQuery *q,
 {
     GList *matching_objects = NULL;
     int        object_count = 0;
+    QofQueryCB qcb;
+    QofQueryMatch *match;
+    guint      i, first;
 
     if (!q) return NULL;
     g_return_val_if_fail (q->search_for, NULL);
@@ -719,8 +1079,6 @@ static GList * qof_query_run_internal (QofQuery *q,
     g_return_val_if_fail (run_cb, NULL);
     ENTER (" q=%p", q);
 
-    /* XXX: Prioritize the query terms? */
-
     /* prepare the Query for processing */
     if (q->changed)
     {
@@ -730,64 +1088,43 @@ static GList * qof_query_run_internal (QofQuery *q,
 
     /* Maybe log this sucker */
     if (qof_log_check (log_module, QOF_LOG_DEBUG))
+    {
+        gchar *plan = qof_query_explain (q);
         qof_query_print (q);
+        DEBUG ("%s", plan);
+        g_free (plan);
+    }
 
     /* Now run the query over all the objects and save the results */
-    {
-        QofQueryCB qcb;
+    memset (&qcb, 0, sizeof (qcb));
+    qcb.query = q;
+    qcb.limit = q->max_results < 0 ? -1 : q->max_results;
+    qcb.sorted = (q->primary_sort.comp_fcn || q->primary_sort.obj_cmp ||
+                  (q->primary_sort.use_default && q->defaultSort));
+    qcb.matches = g_array_sized_new (FALSE, FALSE, sizeof (QofQueryMatch),
+                                     qcb.limit > 0 ? qcb.limit : 0);
 
-        memset (&qcb, 0, sizeof (qcb));
-        qcb.query = q;
+    /* Run the query callback */
+    run_cb(&qcb, cb_arg);
 
-        /* Run the query callback */
-        run_cb(&qcb, cb_arg);
-
-        matching_objects = qcb.list;
-        object_count = qcb.count;
-    }
-    PINFO ("matching objects=%p count=%d", matching_objects, object_count);
-
-    /* There is no absolute need to reverse this list, since it's being
-     * sorted below. However, in the common case, we will be searching
-     * in a confined location where the objects are already in order,
-     * thus reversing will put us in the correct order we want and make
-     * the sorting go much faster.
-     */
-    matching_objects = g_list_reverse(matching_objects);
+    PINFO ("matching objects count=%d kept=%u", qcb.count, qcb.matches->len);
 
     /* Now sort the matching objects based on the search criteria */
-    if (q->primary_sort.comp_fcn || q->primary_sort.obj_cmp ||
-            (q->primary_sort.use_default && q->defaultSort))
-    {
-        matching_objects = g_list_sort_with_data(matching_objects, sort_func, q);
-    }
-
-    /* Crop the list to limit the number of splits. */
-    if ((object_count > q->max_results) && (q->max_results > -1))
-    {
-        if (q->max_results > 0)
-        {
-            GList *mptr;
-
-            /* mptr is set to the first node of what will be the new list */
-            mptr = g_list_nth(matching_objects, object_count - q->max_results);
-            /* mptr should not be NULL, but let's be safe */
-            if (mptr != NULL)
-            {
-                if (mptr->prev != NULL) mptr->prev->next = NULL;
-                mptr->prev = NULL;
-            }
-            g_list_free(matching_objects);
-            matching_objects = mptr;
-        }
-        else
-        {
-            /* q->max_results == 0 */
-            g_list_free(matching_objects);
-            matching_objects = NULL;
-        }
-        object_count = q->max_results;
-    }
+    match = (QofQueryMatch *) qcb.matches->data;
+    object_count = qcb.matches->len;
+    if (qcb.sorted)
+        g_qsort_with_data (match, object_count, sizeof (QofQueryMatch),
+                           match_cmp, q);
+
+    /* The kept matches are now in order, except for an unsorted ring
+     * that wrapped around, which starts after the last one written. */
+    first = 0;
+    if (!qcb.sorted && qcb.limit > 0 && qcb.count > qcb.limit)
+        first = qcb.count % qcb.limit;
+    for (i = object_count; i > 0; i--)
+        matching_objects = g_list_prepend (matching_objects,
+                                           match[(first + i - 1) % object_count].object);
+    g_array_free (qcb.matches, TRUE);
 
     q->changed = 0;
 
@@ -800,7 +1137,8 @@ static GList * qof_query_run_internal (QofQuery *q,
 
 static void qof_query_run_cb(QofQueryCB* qcb, gpointer cb_arg)
 {
-    GList *node;
+    GList *node, *node2, *accesses;
+    gint64 total;
 
     (void)cb_arg; /* unused */
     g_return_if_fail(qcb);
@@ -822,9 +1160,27 @@ static void qof_query_run_cb(QofQueryCB* qcb, gpointer cb_arg)
             }
         }
 
-        /* And then iterate over all the objects */
-        qof_object_foreach (qcb->query->search_for, book,
-                            (QofInstanceForeachCB) check_item_cb, qcb);
+        /* And then check the objects the indexes offer, or all of them */
+        if (query_plan_book (qcb->query, book, &accesses, &total))
+        {
+            QofQueryCandidates cand;
+
+            cand.qcb = qcb;
+            cand.seen = g_hash_table_new (g_direct_hash, g_direct_equal);
+            for (node2 = accesses; node2; node2 = node2->next)
+            {
+                access_foreach (qcb->query, book, node2->data,
+                                check_candidate_cb, &cand);
+                g_free (node2->data);
+            }
+            g_list_free (accesses);
+            g_hash_table_destroy (cand.seen);
+        }
+        else
+        {
+            qof_object_foreach (qcb->query->search_for, book,
+                                (QofInstanceForeachCB) check_item_cb, qcb);
+        }
     }
 }
 
@@ -992,6 +1348,7 @@ QofQuery * qof_query_copy (QofQuery *q)
     memcpy (copy, q, sizeof (QofQuery));
 
     copy->be_compiled = ht;
+    copy->plan = NULL;
     copy->terms = copy_or_terms (q->terms);
     copy->books = g_list_copy (q->books);
     copy->results = g_list_copy (q->results);
@@ -1320,16 +1677,58 @@ void qof_query_add_boolean_match (QofQuery *q, QofQueryParamList *param_list, gb
 /**********************************************************************/
 /* PRIVATE PUBLISHED API FUNCTIONS                                    */
 
+void qof_query_register_index (QofIdTypeConst obj_type, const char *name,
+                               QofQueryParamList *param_list,
+                               QofQueryIndexEstimate estimate,
+                               QofQueryIndexForeach foreach)
+{
+    QofQueryIndex *idx;
+    GList *indexes;
+
+    g_return_if_fail (indexTable);
+    g_return_if_fail (obj_type && param_list && estimate && foreach);
+
+    idx = g_new0 (QofQueryIndex, 1);
+    idx->name = name;
+    idx->param_list = param_list;
+    idx->estimate = estimate;
+    idx->foreach = foreach;
+
+    indexes = g_hash_table_lookup (indexTable, obj_type);
+    g_hash_table_insert (indexTable, (gpointer) obj_type,
+                         g_list_append (indexes, idx));
+}
+
+static void free_indexes (gpointer key, gpointer value, gpointer not_used)
+{
+    GList *node;
+
+    for (node = value; node; node = node->next)
+    {
+        QofQueryIndex *idx = node->data;
+        g_slist_free (idx->param_list);
+        g_free (idx);
+    }
+    g_list_free (value);
+}
+
 void qof_query_init (void)
 {
     ENTER (" ");
     qof_query_core_init ();
     qof_class_init ();
+    indexTable = g_hash_table_new (g_str_hash, g_str_equal);
     LEAVE ("Completed initialization of QofQuery");
 }
 
 void qof_query_shutdown (void)
 {
+    if (indexTable)
+    {
+        g_hash_table_foreach (indexTable, free_indexes, NULL);
+        g_hash_table_destroy (indexTable);
+        indexTable = NULL;
+    }
     qof_class_shutdown ();
     qof_query_core_shutdown ();
 }
@@ -1485,6 +1884,7 @@ static gchar *qof_query_printGuidMatch (QofGuidMatch g);
 static gchar *qof_query_printCharMatch (QofCharMatch c);
 static GList *qof_query_printPredData (QofQueryPredData *pd, GList *lst);
 static GString *qof_query_printParamPath (QofQueryParamList * parmList);
+static void qof_query_explainTerm (const QofQueryTerm *qt, GString *gs);
 static void qof_query_printValueForParam (QofQueryPredData *pd, GString * gs);
 static void qof_query_printOutput (GList * output);
 
@@ -1931,4 +2331,86 @@ qof_query_printCharMatch (QofCharMatch c)
     return "UNKNOWN MATCH TYPE";
 }         /* qof_query_printGuidMatch */
 
+/* ************************************************************************ */
+
+static void
+qof_query_explainTerm (const QofQueryTerm *qt, GString *gs)
+{
+    QofQueryParamList *path;
+
+    for (path = qt->param_list; path; path = path->next)
+        g_string_append_printf (gs, "%s%s", (gchar *) path->data,
+                                path->next ? "->" : "");
+    g_string_append_printf (gs, " %s%s", qt->invert ? "NOT " : "",
+                            qof_query_printStringForHow (qt->pdata->how));
+}
+
+gchar *
+qof_query_explain (QofQuery * query)
+{
+    GString *gs;
+    GList *node, *or_ptr, *and_ptr;
+    gint n;
+
+    if (!query)
+        return NULL;
+
+    if (query->changed)
+    {
+        query_clear_compiles (query);
+        compile_terms (query);
+    }
+
+    gs = g_string_new ("");
+    g_string_append_printf (gs, "Query for %s\n",
+                            query->search_for ? query->search_for : "(null)");
+
+    for (node = query->books; node; node = node->next)
+    {
+        QofBook *book = node->data;
+        QofCollection *col = qof_book_get_collection (book, query->search_for);
+        gchar guidstr[GUID_ENCODING_LENGTH+1];
+        GList *accesses, *acc;
+        gint64 total;
+
+        guid_to_string_buff (qof_instance_get_guid (book), guidstr);
+        if (query_plan_book (query, book, &accesses, &total))
+            g_string_append_printf (gs, "  Book %s: index lookups, about %"
+                                    G_GINT64_FORMAT " of %u objects\n",
+                                    guidstr, total, qof_collection_count (col));
+        else
+            g_string_append_printf (gs, "  Book %s: full scan of %u objects\n",
+                                    guidstr, qof_collection_count (col));
+
+        for (acc = accesses, n = 1; acc; acc = acc->next, n++)
+        {
+            QofQueryAccess *access = acc->data;
+
+            g_string_append_printf (gs, "    OR-term %d: %s on ", n,
+                                    access->index ? access->index->name
+                                    : "GUID lookup");
+            qof_query_explainTerm (access->term, gs);
+            g_string_append_printf (gs, ", about %" G_GINT64_FORMAT
+                                    " candidates\n", access->estimate);
+            g_free (access);
+        }
+        g_list_free (accesses);
+    }
+
+    for (or_ptr = query->plan, n = 1; or_ptr; or_ptr = or_ptr->next, n++)
+    {
+        g_string_append_printf (gs, "  OR-term %d checks", n);
+        for (and_ptr = or_ptr->data; and_ptr; and_ptr = and_ptr->next)
+        {
+            g_string_append (gs, and_ptr == or_ptr->data ? " " : ", then ");
+            qof_query_explainTerm (and_ptr->data, gs);
+        }
+        g_string_append (gs, "\n");
+    }
+    if (!query->plan)
+        g_string_append (gs, "  No terms: every object matches\n");
+
+    return g_string_free (gs, FALSE);
+}
+
 /* ======================== END OF FILE =================== */
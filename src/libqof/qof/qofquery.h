@@ -352,6 +352,8 @@ void qof_query_set_sort_increasing (QofQuery *q, gboolean prim_inc,
  * only the last bit of results are returned.  For example,
  * if the sort order is set to be increasing date order, then
  * only the objects with the most recent dates will be returned.
+ * Only that many matches are held on to while the query runs, so a
+ * small limit also saves sorting all of the matches.
  */
 void qof_query_set_max_results (QofQuery *q, int n);
 
@@ -371,6 +373,49 @@ gboolean qof_query_equal (const QofQuery *q1, const QofQuery *q2);
  */
 void qof_query_print (QofQuery *query);
 
+/** Describe how qof_query_run() would go about the query: for each
+ *  book, which index (if any) each OR-term would fetch its candidates
+ *  from, how many it expects, and the order in which the AND-terms are
+ *  checked.  The description is also logged with the query at debug
+ *  level.
+ *
+ *  @return A newly allocated string, to be freed with g_free().
+ */
+gchar * qof_query_explain (QofQuery *query);
+
+/** @name Secondary indexes
+
+ Without help a query checks every object in each of its books.  An
+ object module can register an index on a parameter path; when every
+ OR-term of a query has an AND-term on an indexed path, only the
+ objects the indexes hand back are checked.  A term matching
+ ::QOF_PARAM_GUID against a list of GUIDs is always looked up
+ directly.
+ @{ */
+
+/** Estimate how many objects in @a book the index would return for
+ *  @a pdata, or return -1 if it can't be used for this predicate. */
+typedef gint64 (*QofQueryIndexEstimate) (QofBook *book,
+        QofQueryPredData *pdata);
+
+/** Call @a cb on the objects in @a book that may match @a pdata.
+ *  Returning objects that don't match is harmless, since the query
+ *  checks every term again; leaving out any that do is not. */
+typedef void (*QofQueryIndexForeach) (QofBook *book,
+                                      QofQueryPredData *pdata,
+                                      QofInstanceForeachCB cb,
+                                      gpointer user_data);
+
+/** Register an index for queries searching for @a obj_type, on terms
+ *  whose parameter path is @a param_list.  The list becomes the
+ *  property of the query module.  @a name is what qof_query_explain()
+ *  calls the index. */
+void qof_query_register_index (QofIdTypeConst obj_type, const char *name,
+                               QofQueryParamList *param_list,
+                               QofQueryIndexEstimate estimate,
+                               QofQueryIndexForeach foreach);
+/** @} */
+
 /** Return the type of data we're querying for */
 /*@ dependent @*/
 QofIdType qof_query_get_search_for (const QofQuery *q);
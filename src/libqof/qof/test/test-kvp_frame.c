@@ -1455,6 +1455,116 @@ test_get_trailer_or_null( Fixture *fixture, gconstpointer pData )
     g_assert_cmpstr( last_key, ==, "test2" );
 }
 
+static void
+check_slot_order( const char *key, KvpValue *value, gpointer data )
+{
+    const char **last = (const char **)data;
+    if ( *last )
+        g_assert_cmpint( strcmp( *last, key ), <, 0 );
+    *last = key;
+}
+
+static void
+test_kvp_frame_many_slots( Fixture *fixture, gconstpointer pData )
+{
+    /* Small frames keep their slots in an array that is turned into a
+     * hash table when it fills up; check both sides of that. */
+    KvpFrame *copy;
+    const char *last;
+    gchar key[16];
+    gint i, n = 50;
+
+    for ( i = 0; i < n; i++ )
+    {
+        /* not in key order */
+        g_snprintf( key, sizeof( key ), "key-%02d", ( i * 7 ) % n );
+        kvp_frame_set_gint64( fixture->frame, key, ( i * 7 ) % n );
+
+        copy = kvp_frame_copy( fixture->frame );
+        g_assert_cmpint( kvp_frame_compare( copy, fixture->frame ), ==, 0 );
+        last = NULL;
+        kvp_frame_for_each_slot_sorted( copy, check_slot_order, &last );
+        kvp_frame_delete( copy );
+    }
+    for ( i = 0; i < n; i++ )
+    {
+        g_snprintf( key, sizeof( key ), "/key-%02d", i );
+        g_assert_cmpint( kvp_frame_get_gint64( fixture->frame, key ), ==, i );
+    }
+    g_assert( kvp_frame_get_slot( fixture->frame, "key-" ) == NULL );
+    g_assert( kvp_frame_get_slot( fixture->frame, "key-000" ) == NULL );
+
+    g_test_message( "Test slots can be removed again" );
+    for ( i = 0; i < n; i++ )
+    {
+        g_snprintf( key, sizeof( key ), "key-%02d", i );
+        kvp_frame_set_slot( fixture->frame, key, NULL );
+        g_assert( kvp_frame_get_slot( fixture->frame, key ) == NULL );
+    }
+    last = NULL;
+    kvp_frame_for_each_slot_sorted( fixture->frame, check_slot_order, &last );
+    g_assert( last == NULL );
+
+    g_test_message( "Test long keys in deep paths" );
+    copy = kvp_frame_new();
+    for ( i = 0; i < n; i++ )
+    {
+        gchar *path = g_strdup_printf( "/%0200d-%02d/value", 0, i );
+        kvp_frame_set_gint64( copy, path, i );
+        g_assert_cmpint( kvp_frame_get_gint64( copy, path ), ==, i );
+        g_free( path );
+    }
+    kvp_frame_delete( copy );
+}
+
+/* Run with -m perf to get timings for the typical case of many small
+ * frames, looked up by path. */
+static void
+test_kvp_frame_perf( void )
+{
+    static const char *keys[] =
+    {
+        "notes", "old-currency", "reconcile-info/last-date",
+        "reconcile-info/include-children", "placeholder", "color",
+        "tax-related", "void-reason"
+    };
+    const guint n_keys = G_N_ELEMENTS( keys ), n_frames = 100000;
+    KvpFrame **frames;
+    gdouble secs;
+    guint i, j;
+    gint64 found = 0;
+
+    if ( !g_test_perf() ) return;
+
+    frames = g_new( KvpFrame*, n_frames );
+    g_test_timer_start();
+    for ( i = 0; i < n_frames; i++ )
+    {
+        frames[i] = kvp_frame_new();
+        for ( j = 0; j < n_keys; j++ )
+            kvp_frame_set_gint64( frames[i], keys[j], j );
+    }
+    secs = g_test_timer_elapsed();
+    g_test_minimized_result( secs, "build %u frames of %u slots: %.3fs",
+                             n_frames, n_keys, secs );
+
+    g_test_timer_start();
+    for ( i = 0; i < n_frames; i++ )
+        for ( j = 0; j < n_keys; j++ )
+            found += kvp_frame_get_gint64( frames[i], keys[j] );
+    secs = g_test_timer_elapsed();
+    g_assert_cmpint( found, ==, (gint64)n_frames * n_keys * ( n_keys - 1 ) / 2 );
+    g_test_minimized_result( secs, "%u path lookups: %.3fs",
+                             n_frames * n_keys, secs );
+
+    g_test_timer_start();
+    for ( i = 0; i < n_frames; i++ )
+        kvp_frame_delete( frames[i] );
+    secs = g_test_timer_elapsed();
+    g_test_minimized_result( secs, "delete %u frames: %.3fs", n_frames, secs );
+    g_free( frames );
+}
+
 void
 test_suite_kvp_frame( void )
 {
@@ -1482,4 +1592,6 @@ test_suite_kvp_frame( void )
     GNC_TEST_ADD( suitename, "get or make", Fixture, NULL, setup_static, test_get_or_make, teardown_static );
     GNC_TEST_ADD( suitename, "kvp frame get frame or null slash trash", Fixture, NULL, setup_static, test_kvp_frame_get_frame_or_null_slash_trash, teardown_static );
     GNC_TEST_ADD( suitename, "get trailer or null", Fixture, NULL, setup_static, test_get_trailer_or_null, teardown_static );
+    GNC_TEST_ADD( suitename, "kvp frame many slots", Fixture, NULL, setup, test_kvp_frame_many_slots, teardown );
+    GNC_TEST_ADD_FUNC( suitename, "kvp frame perf", test_kvp_frame_perf );
 }
\ No newline at end of file
@@ -30,6 +30,7 @@ extern void test_suite_qofinstance();
 extern void test_suite_kvp_frame();
 extern void test_suite_qofobject();
 extern void test_suite_qofsession();
+extern void test_suite_qofevent();
 
 int
 main (int   argc,
@@ -45,6 +46,7 @@ main (int   argc,
     test_suite_kvp_frame();
     test_suite_qofobject();
     test_suite_qofsession();
+    test_suite_qofevent();
 
     return g_test_run( );
 }
@@ -0,0 +1,282 @@
+/********************************************************************
+ * test-qofevent.c: GLib g_test test suite for qofevent.c.          *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+********************************************************************/
+#include "config.h"
+#include <string.h>
+#include <glib.h>
+#include "test-stuff.h"
+#include "qof.h"
+
+static const gchar *suitename = "/qof/qofevent";
+void test_suite_qofevent ( void );
+
+/* What the handlers were sent, one entry per call */
+typedef struct
+{
+    QofInstance *entity;
+    QofEventId event_id;
+    gpointer event_data;
+} EventRecord;
+
+typedef struct
+{
+    QofInstance *inst_a;
+    QofInstance *inst_b;
+    GArray *events;
+    GArray *changes;
+    guint batch_calls;
+    gint handler_id;
+    gint batch_handler_id;
+} Fixture;
+
+static void
+event_handler( QofInstance *entity, QofEventId event_id,
+               gpointer handler_data, gpointer event_data )
+{
+    Fixture *fixture = handler_data;
+    EventRecord record;
+
+    record.entity = entity;
+    record.event_id = event_id;
+    record.event_data = event_data;
+    g_array_append_val( fixture->events, record );
+}
+
+static void
+batch_handler( const QofEventChange *changes, guint n_changes,
+               gpointer handler_data )
+{
+    Fixture *fixture = handler_data;
+
+    fixture->batch_calls++;
+    g_array_append_vals( fixture->changes, changes, n_changes );
+}
+
+static void
+setup( Fixture *fixture, gconstpointer pData )
+{
+    fixture->inst_a = g_object_new( QOF_TYPE_INSTANCE, NULL );
+    fixture->inst_b = g_object_new( QOF_TYPE_INSTANCE, NULL );
+    fixture->events = g_array_new( FALSE, FALSE, sizeof( EventRecord ) );
+    fixture->changes = g_array_new( FALSE, FALSE, sizeof( QofEventChange ) );
+    fixture->batch_calls = 0;
+    fixture->handler_id = qof_event_register_handler( event_handler, fixture );
+    fixture->batch_handler_id =
+        qof_event_register_batch_handler( batch_handler, fixture );
+}
+
+static void
+teardown( Fixture *fixture, gconstpointer pData )
+{
+    qof_event_unregister_handler( fixture->handler_id );
+    qof_event_unregister_handler( fixture->batch_handler_id );
+    g_array_free( fixture->events, TRUE );
+    g_array_free( fixture->changes, TRUE );
+    if ( fixture->inst_a )
+        g_object_unref( fixture->inst_a );
+    if ( fixture->inst_b )
+        g_object_unref( fixture->inst_b );
+}
+
+static void
+check_event( Fixture *fixture, guint i, QofInstance *entity,
+             QofEventId event_id, gpointer event_data )
+{
+    EventRecord *record;
+
+    g_assert_cmpuint( i, <, fixture->events->len );
+    record = &g_array_index( fixture->events, EventRecord, i );
+    g_assert( record->entity == entity );
+    g_assert_cmpint( record->event_id, ==, event_id );
+    g_assert( record->event_data == event_data );
+}
+
+static void
+check_change( Fixture *fixture, guint i, QofInstance *entity,
+              QofEventId events )
+{
+    QofEventChange *change;
+
+    g_assert_cmpuint( i, <, fixture->changes->len );
+    change = &g_array_index( fixture->changes, QofEventChange, i );
+    g_assert( change->entity == entity );
+    g_assert_cmpint( change->events, ==, events );
+}
+
+static void
+test_qof_event_unbatched( Fixture *fixture, gconstpointer pData )
+{
+    gint data;
+
+    g_assert( !qof_event_in_batch() );
+    qof_event_gen( fixture->inst_a, QOF_EVENT_MODIFY, NULL );
+    qof_event_gen( fixture->inst_a, QOF_EVENT_MODIFY, &data );
+    qof_event_gen( fixture->inst_b, QOF_EVENT_NONE, NULL );
+
+    g_assert_cmpuint( fixture->events->len, ==, 2 );
+    check_event( fixture, 0, fixture->inst_a, QOF_EVENT_MODIFY, NULL );
+    check_event( fixture, 1, fixture->inst_a, QOF_EVENT_MODIFY, &data );
+
+    g_test_message( "Test batch handlers get every event on its own" );
+    g_assert_cmpuint( fixture->batch_calls, ==, 2 );
+    check_change( fixture, 0, fixture->inst_a, QOF_EVENT_MODIFY );
+    check_change( fixture, 1, fixture->inst_a, QOF_EVENT_MODIFY );
+
+    g_test_message( "Test suspended events are dropped" );
+    qof_event_suspend();
+    qof_event_gen( fixture->inst_a, QOF_EVENT_MODIFY, NULL );
+    qof_event_resume();
+    g_assert_cmpuint( fixture->events->len, ==, 2 );
+}
+
+static void
+test_qof_event_batch( Fixture *fixture, gconstpointer pData )
+{
+    gint i;
+
+    qof_event_begin_batch();
+    g_assert( qof_event_in_batch() );
+    for ( i = 0; i < 100; i++ )
+    {
+        qof_event_gen( fixture->inst_b, QOF_EVENT_MODIFY, NULL );
+        qof_event_gen( fixture->inst_a, QOF_EVENT_ADD, NULL );
+        qof_event_gen( fixture->inst_a, QOF_EVENT_MODIFY, NULL );
+    }
+    qof_event_gen( fixture->inst_b, QOF_EVENT_CREATE, NULL );
+
+    g_test_message( "Test nested batches are delivered at the outermost end" );
+    qof_event_begin_batch();
+    qof_event_gen( fixture->inst_a, QOF_EVENT_REMOVE, NULL );
+    qof_event_end_batch();
+    g_assert_cmpuint( fixture->events->len, ==, 0 );
+    g_assert_cmpuint( fixture->batch_calls, ==, 0 );
+    qof_event_end_batch();
+    g_assert( !qof_event_in_batch() );
+
+    /* In order of the entities, and then of the event ids */
+    g_assert_cmpuint( fixture->events->len, ==, 5 );
+    check_event( fixture, 0, fixture->inst_b, QOF_EVENT_CREATE, NULL );
+    check_event( fixture, 1, fixture->inst_b, QOF_EVENT_MODIFY, NULL );
+    check_event( fixture, 2, fixture->inst_a, QOF_EVENT_MODIFY, NULL );
+    check_event( fixture, 3, fixture->inst_a, QOF_EVENT_ADD, NULL );
+    check_event( fixture, 4, fixture->inst_a, QOF_EVENT_REMOVE, NULL );
+
+    g_assert_cmpuint( fixture->batch_calls, ==, 1 );
+    g_assert_cmpuint( fixture->changes->len, ==, 2 );
+    check_change( fixture, 0, fixture->inst_b,
+                  QOF_EVENT_CREATE | QOF_EVENT_MODIFY );
+    check_change( fixture, 1, fixture->inst_a,
+                  QOF_EVENT_MODIFY | QOF_EVENT_ADD | QOF_EVENT_REMOVE );
+
+    g_test_message( "Test an empty batch delivers nothing" );
+    qof_event_begin_batch();
+    qof_event_end_batch();
+    g_assert_cmpuint( fixture->batch_calls, ==, 1 );
+}
+
+static void
+test_qof_event_batch_event_data( Fixture *fixture, gconstpointer pData )
+{
+    gint data;
+
+    qof_event_begin_batch();
+    qof_event_gen( fixture->inst_a, QOF_EVENT_MODIFY, NULL );
+    qof_event_gen( fixture->inst_a, QOF_EVENT_ADD, &data );
+
+    /* Sent right away, as the data may not be around later */
+    g_assert_cmpuint( fixture->events->len, ==, 1 );
+    check_event( fixture, 0, fixture->inst_a, QOF_EVENT_ADD, &data );
+    g_assert_cmpuint( fixture->batch_calls, ==, 0 );
+
+    qof_event_end_batch();
+    g_assert_cmpuint( fixture->events->len, ==, 2 );
+    check_event( fixture, 1, fixture->inst_a, QOF_EVENT_MODIFY, NULL );
+    g_assert_cmpuint( fixture->batch_calls, ==, 1 );
+    g_assert_cmpuint( fixture->changes->len, ==, 1 );
+    check_change( fixture, 0, fixture->inst_a,
+                  QOF_EVENT_MODIFY | QOF_EVENT_ADD );
+}
+
+static void
+test_qof_event_batch_destroy( Fixture *fixture, gconstpointer pData )
+{
+    qof_event_begin_batch();
+    qof_event_gen( fixture->inst_b, QOF_EVENT_MODIFY, NULL );
+    qof_event_gen( fixture->inst_a, QOF_EVENT_MODIFY, NULL );
+    qof_event_gen( fixture->inst_a, QOF_EVENT_DESTROY, NULL );
+
+    g_assert_cmpuint( fixture->events->len, ==, 2 );
+    check_event( fixture, 0, fixture->inst_a, QOF_EVENT_MODIFY, NULL );
+    check_event( fixture, 1, fixture->inst_a, QOF_EVENT_DESTROY, NULL );
+    g_assert_cmpuint( fixture->batch_calls, ==, 1 );
+    check_change( fixture, 0, fixture->inst_a,
+                  QOF_EVENT_MODIFY | QOF_EVENT_DESTROY );
+    g_object_unref( fixture->inst_a );
+    fixture->inst_a = NULL;
+
+    g_test_message( "Test an instance freed without an event is dropped" );
+    qof_event_gen( fixture->inst_b, QOF_EVENT_ADD, NULL );
+    g_object_unref( fixture->inst_b );
+    fixture->inst_b = NULL;
+
+    qof_event_end_batch();
+    g_assert_cmpuint( fixture->events->len, ==, 2 );
+    g_assert_cmpuint( fixture->batch_calls, ==, 1 );
+}
+
+static gint unregister_id;
+
+static void
+unregister_handler( QofInstance *entity, QofEventId event_id,
+                    gpointer handler_data, gpointer event_data )
+{
+    qof_event_unregister_handler( unregister_id );
+}
+
+static void
+test_qof_event_batch_unregister( Fixture *fixture, gconstpointer pData )
+{
+    gint id;
+
+    /* Handlers are prepended, so this one runs before the fixture's */
+    unregister_id = fixture->batch_handler_id;
+    id = qof_event_register_handler( unregister_handler, NULL );
+
+    qof_event_begin_batch();
+    qof_event_gen( fixture->inst_a, QOF_EVENT_MODIFY, NULL );
+    qof_event_end_batch();
+
+    g_assert_cmpuint( fixture->events->len, ==, 1 );
+    g_assert_cmpuint( fixture->batch_calls, ==, 0 );
+
+    qof_event_unregister_handler( id );
+    fixture->batch_handler_id = qof_event_register_batch_handler( batch_handler,
+                                fixture );
+}
+
+void
+test_suite_qofevent( void )
+{
+    GNC_TEST_ADD( suitename, "qof event unbatched", Fixture, NULL, setup, test_qof_event_unbatched, teardown );
+    GNC_TEST_ADD( suitename, "qof event batch", Fixture, NULL, setup, test_qof_event_batch, teardown );
+    GNC_TEST_ADD( suitename, "qof event batch event data", Fixture, NULL, setup, test_qof_event_batch_event_data, teardown );
+    GNC_TEST_ADD( suitename, "qof event batch destroy", Fixture, NULL, setup, test_qof_event_batch_destroy, teardown );
+    GNC_TEST_ADD( suitename, "qof event batch unregister", Fixture, NULL, setup, test_qof_event_batch_unregister, teardown );
+}
@@ -103,6 +103,11 @@
 
 //Ignored because it is unimplemented
 %ignore gnc_numeric_convert_with_error;
+//Ignored because they are not methods of a GncNumeric
+%ignore gnc_numeric_accum_init;
+%ignore gnc_numeric_accum_add;
+%ignore gnc_numeric_accum_add_nums;
+%ignore gnc_numeric_accum_total;
 %include <gnc-numeric.h>
 
 %include <gnc-commodity.h>
@@ -32,6 +32,7 @@
 #include "qof.h"
 #include "gnc-ui-util.h"
 #include "gnc-gui-query.h"
+#include "gnc-trans-quickfill.h"
 #include "numcell.h"
 #include "quickfillcell.h"
 #include "recncell.h"
@@ -45,6 +46,8 @@ static QofLogModule log_module = GNC_MOD_LEDGER;
 
 static void gnc_split_register_load_xfer_cells (SplitRegister *reg,
         Account *base_account);
+static void gnc_split_register_load_text_cells (SplitRegister *reg,
+        Account *account);
 
 static void
 gnc_split_register_load_recn_cells (SplitRegister *reg)
@@ -238,6 +241,75 @@ static void add_quickfill_completions(TableLayout *layout, Transaction *trans,
     }
 }
 
+/* Append the rows @a trans takes up in the register to @a rows: its
+ * leading row, anchored on @a split, and then a row for each split. */
+static void
+gnc_split_register_add_load_rows (GArray *rows, Transaction *trans,
+                                  Split *split)
+{
+    SRLoadedRow row;
+    GList *node;
+
+    row.trans = trans;
+    row.split = split;
+    row.split_guid = *xaccSplitGetGUID (split);
+    row.lead = TRUE;
+    row.date = xaccTransGetDate (trans);
+    g_array_append_val (rows, row);
+
+    row.lead = FALSE;
+    row.date = 0;
+    for (node = xaccTransGetSplitList (trans); node; node = node->next)
+    {
+        if (!xaccTransStillHasSplit (trans, node->data)) continue;
+
+        row.split = node->data;
+        row.split_guid = *xaccSplitGetGUID (row.split);
+        g_array_append_val (rows, row);
+    }
+}
+
+/* Whether the first @a n_rows rows of @a rows all lead with a split in
+ * @a account, i.e. the register shows just that account. */
+static gboolean
+gnc_split_register_rows_in_account (GArray *rows, guint n_rows,
+                                    Account *account)
+{
+    guint i;
+
+    for (i = 0; i < n_rows; i++)
+    {
+        SRLoadedRow *row = &g_array_index (rows, SRLoadedRow, i);
+
+        if (row->lead && xaccSplitGetAccount (row->split) != account)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static gboolean
+gnc_split_register_same_rows (GArray *a, GArray *b)
+{
+    guint i;
+
+    if (a->len != b->len)
+        return FALSE;
+
+    for (i = 0; i < a->len; i++)
+    {
+        SRLoadedRow *row_a = &g_array_index (a, SRLoadedRow, i);
+        SRLoadedRow *row_b = &g_array_index (b, SRLoadedRow, i);
+
+        if (!guid_equal (&row_a->split_guid, &row_b->split_guid) ||
+                row_a->lead != row_b->lead ||
+                row_a->date != row_b->date)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
 void
 gnc_split_register_load (SplitRegister *reg, GList * slist,
                          Account *default_account)
@@ -258,12 +330,16 @@ gnc_split_register_load (SplitRegister *reg, GList * slist,
     Split *find_split;
     Split *split;
     Table *table;
+    GArray *rows;
     GList *node;
+    guint n_loaded;
+    guint i;
 
     gboolean start_primary_color = TRUE;
     gboolean found_pending = FALSE;
     gboolean found_divider = FALSE;
     gboolean has_last_num = FALSE;
+    gboolean shared_text_cells = FALSE;
     gboolean multi_line;
     gboolean dynamic;
     gboolean we_own_slist = FALSE;
@@ -414,21 +490,6 @@ gnc_split_register_load (SplitRegister *reg, GList * slist,
      * callbacks while we are fiddling with loading the register */
     gnc_table_control_allow_move (table->control, FALSE);
 
-    /* invalidate the cursor */
-    {
-        VirtualLocation virt_loc;
-
-        gnc_virtual_location_init(&virt_loc);
-        gnc_table_move_cursor_gui (table, virt_loc);
-    }
-
-    /* make sure that the header is loaded */
-    vcell_loc.virt_row = 0;
-    vcell_loc.virt_col = 0;
-    cursor_header = gnc_table_layout_get_cursor (table->layout, CURSOR_HEADER);
-    gnc_table_set_vcell (table, cursor_header, NULL, TRUE, TRUE, vcell_loc);
-    vcell_loc.virt_row++;
-
     /* get the current time and reset the dividing row */
     present = gnc_timet_get_today_end ();
 
@@ -473,8 +534,6 @@ gnc_split_register_load (SplitRegister *reg, GList * slist,
             gnc_split_register_recn_cell_confirm, reg);
     }
 
-    table->model->dividing_row = -1;
-
     // Ensure that the transaction and splits being edited are in the split
     // list we're about to load.
     if (pending_trans != NULL)
@@ -503,7 +562,9 @@ gnc_split_register_load (SplitRegister *reg, GList * slist,
     if (multi_line)
         trans_table = g_hash_table_new (g_direct_hash, g_direct_equal);
 
-    /* populate the table */
+    /* work out the rows of the table */
+    rows = g_array_new (FALSE, FALSE, sizeof (SRLoadedRow));
+
     for (node = slist; node; node = node->next)
     {
         split = node->data;
@@ -528,48 +589,27 @@ gnc_split_register_load (SplitRegister *reg, GList * slist,
             g_hash_table_insert (trans_table, trans, trans);
         }
 
-        if (info->show_present_divider &&
-                !found_divider &&
-                (present < xaccTransGetDate (trans)))
-        {
-            table->model->dividing_row = vcell_loc.virt_row;
-            found_divider = TRUE;
-        }
-
-        /* If this is the first load of the register,
-         * fill up the quickfill cells. */
-        if (info->first_pass)
-            add_quickfill_completions(reg->table->layout, trans, has_last_num);
-
-        if (trans == find_trans)
-            new_trans_row = vcell_loc.virt_row;
-
-        if (split == find_trans_split)
-            new_trans_split_row = vcell_loc.virt_row;
-
-        gnc_split_register_add_transaction (reg, trans, split,
-                                            lead_cursor, split_cursor,
-                                            multi_line, start_primary_color,
-                                            TRUE,
-                                            find_trans, find_split, find_class,
-                                            &new_split_row, &vcell_loc);
-
-        if (!multi_line)
-            start_primary_color = !start_primary_color;
+        gnc_split_register_add_load_rows (rows, trans, split);
     }
 
     if (multi_line)
         g_hash_table_destroy (trans_table);
 
-    /* add the blank split at the end. */
+    /* the blank split goes at the end. */
+    n_loaded = rows->len;
+    gnc_split_register_add_load_rows (rows, blank_trans, blank_split);
+
     if (pending_trans == blank_trans)
         found_pending = TRUE;
 
-    if (blank_trans == find_trans)
-        new_trans_row = vcell_loc.virt_row;
-
-    if (blank_split == find_trans_split)
-        new_trans_split_row = vcell_loc.virt_row;
+    /* A register of a single account completes from the texts shared
+     * by every register of that account, rather than loading its own. */
+    if (info->first_pass && default_account &&
+            gnc_split_register_rows_in_account (rows, n_loaded, default_account))
+    {
+        gnc_split_register_load_text_cells (reg, default_account);
+        shared_text_cells = TRUE;
+    }
 
     /* If we didn't find the pending transaction, it was removed
      * from the account. */
@@ -584,76 +624,185 @@ gnc_split_register_load (SplitRegister *reg, GList * slist,
         pending_trans = NULL;
     }
 
-    /* go to blank on first pass */
-    if (info->first_pass)
+    /* If the table would come out just as it is, with the cursor where
+     * it is now, only the contents need to be brought up to date. The
+     * cells are filled in from the splits as they are drawn. */
+    if (!info->first_pass &&
+            info->loaded_rows != NULL &&
+            !info->traverse_to_new &&
+            info->loaded_style == reg->style &&
+            info->loaded_present == present &&
+            info->loaded_divider == info->show_present_divider &&
+            info->loaded_blank_edited == info->blank_split_edited &&
+            info->loaded_expanded == info->trans_expanded &&
+            find_trans == gnc_split_register_get_current_trans (reg) &&
+            find_split == gnc_split_register_get_current_split (reg) &&
+            find_trans_split ==
+            gnc_split_register_get_current_trans_split (reg, NULL) &&
+            find_class == gnc_split_register_get_current_cursor_class (reg) &&
+            gnc_split_register_same_rows (info->loaded_rows, rows))
     {
-        new_split_row = -1;
-        new_trans_split_row = -1;
-        new_trans_row = -1;
+        DEBUG("table layout unchanged, refreshing contents");
 
-        save_loc.vcell_loc = vcell_loc;
-        save_loc.phys_row_offset = 0;
-        save_loc.phys_col_offset = 0;
+        g_array_free (rows, TRUE);
+
+        /* reload the cursor from the splits */
+        gnc_table_move_cursor_gui (table, save_loc);
+        if (cursor_buffer)
+            gnc_table_restore_current_cursor (table, cursor_buffer);
     }
+    else
+    {
+        /* invalidate the cursor */
+        {
+            VirtualLocation virt_loc;
 
-    gnc_split_register_add_transaction (reg, blank_trans, blank_split,
-                                        lead_cursor, split_cursor,
-                                        multi_line, start_primary_color,
-                                        info->blank_split_edited, find_trans,
-                                        find_split, find_class, &new_split_row,
-                                        &vcell_loc);
+            gnc_virtual_location_init(&virt_loc);
+            gnc_table_move_cursor_gui (table, virt_loc);
+        }
 
-    /* resize the table to the sizes we just counted above */
-    /* num_virt_cols is always one. */
-    gnc_table_set_size (table, vcell_loc.virt_row, 1);
+        /* make sure that the header is loaded */
+        vcell_loc.virt_row = 0;
+        vcell_loc.virt_col = 0;
+        cursor_header = gnc_table_layout_get_cursor (table->layout, CURSOR_HEADER);
+        gnc_table_set_vcell (table, cursor_header, NULL, TRUE, TRUE, vcell_loc);
+        vcell_loc.virt_row++;
 
-    /* restore the cursor to its rightful position */
-    {
-        VirtualLocation trans_split_loc;
-        Split *trans_split;
+        table->model->dividing_row = -1;
 
-        if (new_split_row > 0)
-            save_loc.vcell_loc.virt_row = new_split_row;
-        else if (new_trans_split_row > 0)
-            save_loc.vcell_loc.virt_row = new_trans_split_row;
-        else if (new_trans_row > 0)
-            save_loc.vcell_loc.virt_row = new_trans_row;
+        /* populate the table */
+        for (i = 0; i < n_loaded; i++)
+        {
+            SRLoadedRow *row = &g_array_index (rows, SRLoadedRow, i);
 
-        trans_split_loc = save_loc;
+            if (!row->lead)
+                continue;
 
-        trans_split =
-            gnc_split_register_get_trans_split (reg, save_loc.vcell_loc,
-                                                &trans_split_loc.vcell_loc);
+            split = row->split;
+            trans = row->trans;
 
-        if (dynamic || multi_line || info->trans_expanded)
-        {
-            gnc_table_set_virt_cell_cursor(
-                table, trans_split_loc.vcell_loc,
-                gnc_split_register_get_active_cursor (reg));
-            gnc_split_register_set_trans_visible (reg, trans_split_loc.vcell_loc,
-                                                  TRUE, multi_line);
+            if (info->show_present_divider &&
+                    !found_divider &&
+                    (present < row->date))
+            {
+                table->model->dividing_row = vcell_loc.virt_row;
+                found_divider = TRUE;
+            }
 
-            info->trans_expanded = (reg->style == REG_STYLE_LEDGER);
+            /* If this is the first load of the register,
+             * fill up the quickfill cells. */
+            if (info->first_pass && !shared_text_cells)
+                add_quickfill_completions(reg->table->layout, trans, has_last_num);
+            else if (info->first_pass && !has_last_num)
+                gnc_num_cell_set_last_num(
+                    (NumCell *) gnc_table_layout_get_cell(table->layout, NUM_CELL),
+                    xaccTransGetNum(trans));
+
+            if (trans == find_trans)
+                new_trans_row = vcell_loc.virt_row;
+
+            if (split == find_trans_split)
+                new_trans_split_row = vcell_loc.virt_row;
+
+            gnc_split_register_add_transaction (reg, trans, split,
+                                                lead_cursor, split_cursor,
+                                                multi_line, start_primary_color,
+                                                TRUE,
+                                                find_trans, find_split, find_class,
+                                                &new_split_row, &vcell_loc);
+
+            if (!multi_line)
+                start_primary_color = !start_primary_color;
         }
-        else
+
+        /* add the blank split at the end. */
+        if (blank_trans == find_trans)
+            new_trans_row = vcell_loc.virt_row;
+
+        if (blank_split == find_trans_split)
+            new_trans_split_row = vcell_loc.virt_row;
+
+        /* go to blank on first pass */
+        if (info->first_pass)
         {
-            save_loc = trans_split_loc;
-            info->trans_expanded = FALSE;
+            new_split_row = -1;
+            new_trans_split_row = -1;
+            new_trans_row = -1;
+
+            save_loc.vcell_loc = vcell_loc;
+            save_loc.phys_row_offset = 0;
+            save_loc.phys_col_offset = 0;
         }
 
-        if (gnc_table_find_close_valid_cell (table, &save_loc, FALSE))
+        gnc_split_register_add_transaction (reg, blank_trans, blank_split,
+                                            lead_cursor, split_cursor,
+                                            multi_line, start_primary_color,
+                                            info->blank_split_edited, find_trans,
+                                            find_split, find_class, &new_split_row,
+                                            &vcell_loc);
+
+        /* resize the table to the sizes we just counted above */
+        /* num_virt_cols is always one. */
+        gnc_table_set_size (table, vcell_loc.virt_row, 1);
+
+        /* restore the cursor to its rightful position */
         {
-            gnc_table_move_cursor_gui (table, save_loc);
-            new_split_row = save_loc.vcell_loc.virt_row;
+            VirtualLocation trans_split_loc;
+            Split *trans_split;
+
+            if (new_split_row > 0)
+                save_loc.vcell_loc.virt_row = new_split_row;
+            else if (new_trans_split_row > 0)
+                save_loc.vcell_loc.virt_row = new_trans_split_row;
+            else if (new_trans_row > 0)
+                save_loc.vcell_loc.virt_row = new_trans_row;
+
+            trans_split_loc = save_loc;
+
+            trans_split =
+                gnc_split_register_get_trans_split (reg, save_loc.vcell_loc,
+                                                    &trans_split_loc.vcell_loc);
+
+            if (dynamic || multi_line || info->trans_expanded)
+            {
+                gnc_table_set_virt_cell_cursor(
+                    table, trans_split_loc.vcell_loc,
+                    gnc_split_register_get_active_cursor (reg));
+                gnc_split_register_set_trans_visible (reg, trans_split_loc.vcell_loc,
+                                                      TRUE, multi_line);
+
+                info->trans_expanded = (reg->style == REG_STYLE_LEDGER);
+            }
+            else
+            {
+                save_loc = trans_split_loc;
+                info->trans_expanded = FALSE;
+            }
+
+            if (gnc_table_find_close_valid_cell (table, &save_loc, FALSE))
+            {
+                gnc_table_move_cursor_gui (table, save_loc);
+                new_split_row = save_loc.vcell_loc.virt_row;
 
-            if (find_split == gnc_split_register_get_current_split (reg))
-                gnc_table_restore_current_cursor (table, cursor_buffer);
+                if (find_split == gnc_split_register_get_current_split (reg))
+                    gnc_table_restore_current_cursor (table, cursor_buffer);
+            }
         }
 
-        gnc_cursor_buffer_destroy (cursor_buffer);
-        cursor_buffer = NULL;
+        /* remember how the table was laid out */
+        if (info->loaded_rows)
+            g_array_free (info->loaded_rows, TRUE);
+        info->loaded_rows = rows;
+        info->loaded_style = reg->style;
+        info->loaded_present = present;
+        info->loaded_divider = info->show_present_divider;
+        info->loaded_blank_edited = info->blank_split_edited;
+        info->loaded_expanded = info->trans_expanded;
     }
 
+    gnc_cursor_buffer_destroy (cursor_buffer);
+    cursor_buffer = NULL;
+
     /* Set up the hint transaction, split, transaction split, and column. */
     info->cursor_hint_trans = gnc_split_register_get_current_trans (reg);
     info->cursor_hint_split = gnc_split_register_get_current_split (reg);
@@ -726,4 +875,28 @@ gnc_split_register_load_xfer_cells (SplitRegister *reg, Account *base_account)
     gnc_combo_cell_use_list_store_cache (cell, store);
 }
 
+#define TKEY  "split_reg_shared_trans_quickfill"
+
+static void
+gnc_split_register_load_text_cells (SplitRegister *reg, Account *account)
+{
+    QuickFillCell *cell;
+
+    cell = (QuickFillCell *)
+           gnc_table_layout_get_cell (reg->table->layout, DESC_CELL);
+    gnc_quickfill_cell_use_quickfill_cache (
+        cell, gnc_get_shared_trans_quickfill (account, TKEY,
+                TRANS_QF_DESCRIPTION));
+
+    cell = (QuickFillCell *)
+           gnc_table_layout_get_cell (reg->table->layout, NOTES_CELL);
+    gnc_quickfill_cell_use_quickfill_cache (
+        cell, gnc_get_shared_trans_quickfill (account, TKEY, TRANS_QF_NOTES));
+
+    cell = (QuickFillCell *)
+           gnc_table_layout_get_cell (reg->table->layout, MEMO_CELL);
+    gnc_quickfill_cell_use_quickfill_cache (
+        cell, gnc_get_shared_trans_quickfill (account, TKEY, TRANS_QF_MEMO));
+}
+
 /* ====================== END OF FILE ================================== */
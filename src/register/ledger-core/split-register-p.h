@@ -31,6 +31,20 @@
 
 #define ACTION_BUY_STR  _("Buy")
 #define ACTION_SELL_STR _("Sell")
+
+/* A row of the register as it was loaded */
+typedef struct
+{
+    Transaction *trans;
+    Split *split;
+    /* what the virtual cell remembers of the split */
+    GncGUID split_guid;
+    /* TRUE for the leading row of the transaction */
+    gboolean lead;
+    /* the date posted of the transaction, on its leading row */
+    time_t date;
+} SRLoadedRow;
+
 struct sr_info
 {
     /* The blank split at the bottom of the register */
@@ -117,6 +131,17 @@ struct sr_info
 
     /* true if the account separator has changed */
     gboolean separator_changed;
+
+    /* The rows of the last load, and what else decided the layout of
+     * the table then. A load that would lay the table out the same way
+     * only refreshes its contents. The multi-line and dynamic layouts
+     * follow from the style. */
+    GArray *loaded_rows;
+    SplitRegisterStyle loaded_style;
+    time_t loaded_present;
+    gboolean loaded_divider;
+    gboolean loaded_blank_edited;
+    gboolean loaded_expanded;
 };
 
 
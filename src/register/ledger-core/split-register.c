@@ -217,6 +217,8 @@ gnc_split_register_expand_current_trans (SplitRegister *reg, gboolean expand)
     }
 
     info->trans_expanded = expand;
+    /* The table is laid out for the new state right here */
+    info->loaded_expanded = expand;
 
     gnc_table_set_virt_cell_cursor (reg->table,
                                     reg->table->current_cursor_loc.vcell_loc,
@@ -2612,6 +2614,10 @@ gnc_split_register_destroy_info (SplitRegister *reg)
     info->credit_str = NULL;
     info->tcredit_str = NULL;
 
+    if (info->loaded_rows)
+        g_array_free (info->loaded_rows, TRUE);
+    info->loaded_rows = NULL;
+
     g_free (reg->sr_info);
 
     reg->sr_info = NULL;
@@ -388,8 +388,9 @@
 
 ;; Go through all toplevel non-'report-commodity' balances in
 ;; 'sumlist' and add them to 'report-commodity', if possible. This
-;; function takes a sumlist (described in gnc:get-exchange-totals) and
-;; returns an alist similar to one value of the sumlist's alist,
+;; function takes a sumlist (described in
+;; gnc:exchange-totals->sumlist) and returns an alist similar to one
+;; value of the sumlist's alist,
 ;; e.g. (cadr (assoc report-commodity sumlist))). This resulting alist
 ;; can immediately be plugged into gnc:make-exchange-alist.
 (define (gnc:resolve-unknown-comm sumlist report-commodity)
@@ -526,181 +527,60 @@
 ;; this functions to use some kind of recursiveness.
 
 
+;; Turn the exchange totals of one date, as they come from the
+;; engine, into a sumlist: a multilevel alist. Each element has a
+;; commodity as key, and another alist as a value. The value-alist's
+;; elements consist of a commodity as a key, and a pair of two
+;; value-collectors as value, e.g. with only one (the report-)
+;; commodity DEM in the outer alist: ( {DEM ( [USD (400 . 1000)] [FRF
+;; (300 . 100)] ) } ) where DEM,USD,FRF are <gnc:commodity> and the
+;; numbers are a numeric-collector which in turn store a
+;; <gnc:numeric>. In the example, USD 400 were bought for an amount of
+;; DEM 1000, FRF 300 were bought for DEM 100. The reason for the outer
+;; alist is that there might be commodity transactions which do not
+;; involve the report-commodity, but which can still be calculated
+;; after *all* transactions are processed.
+(define (gnc:exchange-totals->sumlist totals)
+  (map
+   (lambda (group)
+     (list (car group)
+	   (map
+	    (lambda (pair)
+	      (let ((foreign (gnc:make-numeric-collector))
+		    (domestic (gnc:make-numeric-collector)))
+		(foreign 'add (caadr pair))
+		(domestic 'add (cdadr pair))
+		(list (car pair) (cons foreign domestic))))
+	    (cadr group))))
+   totals))
+
+;; Calculate the exchange totals between all commodities and the
+;; 'report-commodity' at each date of 'end-dates', in one pass over
+;; the book. With 'cost?' these are the volume-weighted average
+;; costs, otherwise the weighted average exchange rates. Returns a
+;; list with one alist per date, see gnc:get-exchange-totals.
+(define (gnc:get-exchange-totals-at-dates report-commodity end-dates cost?)
+  (map
+   (lambda (totals)
+     (gnc:resolve-unknown-comm (gnc:exchange-totals->sumlist totals)
+			       report-commodity))
+   (gnc-book-get-exchange-totals-scm (gnc-get-current-book)
+				     report-commodity end-dates cost?)))
+
 ;; Calculate the weighted average exchange rate between all
 ;; commodities and the 'report-commodity'. Uses all currency
 ;; transactions up until the 'end-date'. Returns an alist, see
-;; sumlist.
+;; gnc:exchange-totals->sumlist.
 (define (gnc:get-exchange-totals report-commodity end-date)
-  (let ((curr-accounts 
-	 ;;(filter gnc:account-has-shares? ))
-	 ;; -- use all accounts, not only share accounts, since gnucash-1.7
-	 (gnc-account-get-descendants-sorted (gnc-get-current-root-account)))
-	;; sumlist: a multilevel alist. Each element has a commodity
-	;; as key, and another alist as a value. The value-alist's
-	;; elements consist of a commodity as a key, and a pair of two
-	;; value-collectors as value, e.g. with only one (the report-)
-	;; commodity DEM in the outer alist: ( {DEM ( [USD (400 .
-	;; 1000)] [FRF (300 . 100)] ) } ) where DEM,USD,FRF are
-	;; <gnc:commodity> and the numbers are a numeric-collector
-	;; which in turn store a <gnc:numeric>. In the example, USD
-	;; 400 were bought for an amount of DEM 1000, FRF 300 were
-	;; bought for DEM 100. The reason for the outer alist is that
-	;; there might be commodity transactions which do not involve
-	;; the report-commodity, but which can still be calculated
-	;; after *all* transactions are processed.
-	(sumlist (list (list report-commodity '()))))
-
-    (if (not (null? curr-accounts))
-	;; Go through all splits and add up all value-amounts
-	;; and share-amounts
-	(for-each 
-	 (lambda (a)
-	   (let* ((transaction-comm (xaccTransGetCurrency
-				     (xaccSplitGetParent a)))
-		  (account-comm (xaccAccountGetCommodity
-				 (xaccSplitGetAccount a)))
-		  ;; Always use the absolute value here.
-		  (share-amount (gnc-numeric-abs
-				 (xaccSplitGetAmount a)))
-		  (value-amount (gnc-numeric-abs
-				 (xaccSplitGetValue a)))
-		  (tmp (assoc transaction-comm sumlist))
-		  (comm-list (if (not tmp) 
-				 (assoc account-comm sumlist)
-				 tmp)))
-	       
-             (cond ((gnc-numeric-zero-p share-amount)
-                    ;; Without shares this is not a buy or sell; ignore it.
-                    #f)
-
-                   ((not comm-list)
-	            ;; entry doesn't exist in comm-list
-		    ;; create sub-alist from scratch
-		    (let ((pair (list transaction-comm
-				      (cons (gnc:make-numeric-collector)
-					    (gnc:make-numeric-collector)))))
-		      ((caadr pair) 'add value-amount)
-		      ((cdadr pair) 'add share-amount)
-		      (set! comm-list (list account-comm (list pair)))
-		      ;; and add the new sub-alist to sumlist.
-		      (set! sumlist (cons comm-list sumlist))))
-
-                   (else
-		    (let* 
-		          ;; Put the amounts in the right place.
-		          ((foreignlist 
-		            (if (gnc-commodity-equiv transaction-comm
-						      (car comm-list))
-			        (list account-comm 
-				      share-amount value-amount)
-			        (list transaction-comm 
-				      value-amount share-amount)))
-		           ;; second commodity already existing in comm-list?
-		           (pair (assoc (car foreignlist) (cadr comm-list))))
-		      ;; if not, create a new entry in comm-list.
-		      (if (not pair)
-		          (begin
-			    (set! 
-			     pair (list (car foreignlist)
-				        (cons (gnc:make-numeric-collector) 
-					      (gnc:make-numeric-collector))))
-			    (set! 
-			     comm-list (list (car comm-list) 
-					     (cons pair (cadr comm-list))))
-			    (set! 
-			     sumlist (cons comm-list 
-					   (alist-delete 
-					    (car comm-list) sumlist)))))
-		      ;; And add the balances to the comm-list entry.
-		      ((caadr pair) 'add (cadr foreignlist))
-		      ((cdadr pair) 'add (caddr foreignlist)))))))
-	 (gnc:get-all-commodity-splits curr-accounts end-date)))
-  
-    (gnc:resolve-unknown-comm sumlist report-commodity)))
+  (car (gnc:get-exchange-totals-at-dates
+	report-commodity (list end-date) #f)))
 
 ;; Calculate the volume-weighted average cost of all commodities,
 ;; priced in the 'report-commodity'. Uses all transactions up until
-;; the 'end-date'. Returns an alist, see sumlist.
+;; the 'end-date'. Returns an alist, see gnc:exchange-totals->sumlist.
 (define (gnc:get-exchange-cost-totals report-commodity end-date)
-  (let ((curr-accounts 
-	 ;;(filter gnc:account-has-shares? ))
-	 ;; -- use all accounts, not only share accounts, since gnucash-1.7
-	 (gnc-account-get-descendants-sorted (gnc-get-current-root-account)))
-	;; sumlist: a multilevel alist. Each element has a commodity
-	;; as key, and another alist as a value. The value-alist's
-	;; elements consist of a commodity as a key, and a pair of two
-	;; value-collectors as value, e.g. with only one (the report-)
-	;; commodity DEM in the outer alist: ( {DEM ( [USD (400 .
-	;; 1000)] [FRF (300 . 100)] ) } ) where DEM,USD,FRF are
-	;; <gnc:commodity> and the numbers are a numeric-collector
-	;; which in turn store a <gnc:numeric>. In the example, USD
-	;; 400 were bought for an amount of DEM 1000, FRF 300 were
-	;; bought for DEM 100. The reason for the outer alist is that
-	;; there might be commodity transactions which do not involve
-	;; the report-commodity, but which can still be calculated
-	;; after *all* transactions are processed.
-	(sumlist (list (list report-commodity '()))))
-
-    (if (not (null? curr-accounts))
-	;; Go through all splits and add up all value-amounts
-	;; and share-amounts
-	(for-each 
-	 (lambda (a)
-	   (let* ((transaction-comm (xaccTransGetCurrency
-				     (xaccSplitGetParent a)))
-		  (account-comm (xaccAccountGetCommodity
-				 (xaccSplitGetAccount a)))
-		  (share-amount (xaccSplitGetAmount a))
-		  (value-amount (xaccSplitGetValue a))
-		  (tmp (assoc transaction-comm sumlist))
-		  (comm-list (if (not tmp) 
-				 (assoc account-comm sumlist)
-				 tmp)))
-	       
-	     ;; entry exists already in comm-list?
-	     (if (not comm-list)
-		 ;; no, create sub-alist from scratch
-		 (let ((pair (list transaction-comm
-				   (cons (gnc:make-numeric-collector)
-					 (gnc:make-numeric-collector)))))
-		   ((caadr pair) 'add value-amount)
-		   ((cdadr pair) 'add share-amount)
-		   (set! comm-list (list account-comm (list pair)))
-		   ;; and add the new sub-alist to sumlist.
-		   (set! sumlist (cons comm-list sumlist)))
-		 ;; yes, check for second commodity.
-		 (let* 
-		     ;; Put the amounts in the right place.
-		     ((foreignlist 
-		       (if (gnc-commodity-equiv transaction-comm
-						 (car comm-list))
-			   (list account-comm 
-				 share-amount value-amount)
-			   (list transaction-comm 
-				 (gnc-numeric-neg value-amount)
-                                 (gnc-numeric-neg share-amount))))
-		      ;; second commodity already existing in comm-list?
-		      (pair (assoc (car foreignlist) (cadr comm-list))))
-		   ;; if not, create a new entry in comm-list.
-		   (if (not pair)
-		       (begin
-			 (set! 
-			  pair (list (car foreignlist)
-				     (cons (gnc:make-numeric-collector) 
-					   (gnc:make-numeric-collector))))
-			 (set! 
-			  comm-list (list (car comm-list) 
-					  (cons pair (cadr comm-list))))
-			 (set! 
-			  sumlist (cons comm-list 
-					(alist-delete 
-					 (car comm-list) sumlist)))))
-		   ;; And add the balances to the comm-list entry.
-		   ((caadr pair) 'add (cadr foreignlist))
-		   ((cdadr pair) 'add (caddr foreignlist))))))
-	 (gnc:get-all-commodity-splits curr-accounts end-date)))
-  
-    (gnc:resolve-unknown-comm sumlist report-commodity)))
+  (car (gnc:get-exchange-totals-at-dates
+	report-commodity (list end-date) #t)))
 
 ;; Anybody feel free to reimplement any of these functions, either in
 ;; scheme or in C. -- cstim
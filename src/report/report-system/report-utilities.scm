@@ -474,37 +474,31 @@
 ;; values rather than double values.
 (define (gnc:account-get-comm-balance-at-date account 
 					      date include-children?)
-  (let ((balance-collector (gnc:make-commodity-collector))
-	(query (qof-query-create-for-splits))
-	(splits #f))
-
-      (if include-children?
-	  (for-each 
-	   (lambda (x) 
-	     (gnc-commodity-collector-merge balance-collector x))
-	   (gnc:account-map-descendants
-	    (lambda (child)
-	      (gnc:account-get-comm-balance-at-date child date #f))
-	    account)))
-
-      (qof-query-set-book query (gnc-get-current-book))
-      (xaccQueryAddSingleAccountMatch query account QOF-QUERY-AND)
-      (xaccQueryAddDateMatchTS query #f date #t date QOF-QUERY-AND)
-      (qof-query-set-sort-order query
-				(list SPLIT-TRANS TRANS-DATE-POSTED)
-				(list QUERY-DEFAULT-SORT)
-				'())
-      (qof-query-set-sort-increasing query #t #t #t)
-      (qof-query-set-max-results query 1)
-      
-      (set! splits (qof-query-run query))
-      (qof-query-destroy query)
-
-      (if (and splits (not (null? splits)))
-	  (gnc-commodity-collector-add balance-collector
-				       (xaccAccountGetCommodity account)
-				       (xaccSplitGetBalance (car splits))))
-      balance-collector))
+  (caar (gnc:accounts-get-comm-balances-at-dates
+         (list account) (list date) include-children? #f)))
+
+;; Get the balances of each of the accounts at each of the dates, all
+;; in one go, which is a lot quicker than asking for them one by one.
+;; Returns a list with an element for each account, which is a list
+;; of commodity collectors with its balance at each date. If value?
+;; is true, the "value" of the splits is summed per transaction
+;; currency rather than their "amount". If include-children? is true,
+;; the balances of all children (not just direct children) are
+;; included in the calculation.
+(define (gnc:accounts-get-comm-balances-at-dates accounts dates
+                                                 include-children? value?)
+  (map
+   (lambda (account-balances)
+     (map
+      (lambda (balances)
+        (let ((collector (gnc:make-commodity-collector)))
+          (for-each
+           (lambda (balance)
+             (gnc-commodity-collector-add collector (car balance) (cdr balance)))
+           balances)
+          collector))
+      account-balances))
+   (gnc-accounts-get-balance-matrix accounts dates value? include-children?)))
 
 ;; Calculate the increase in the balance of the account in terms of
 ;; "value" (as opposed to "amount") between the specified dates.
@@ -555,7 +549,8 @@
 ;; are included in the calculation. The results are returned in a
 ;; commodity collector.
 (define (gnc:account-get-comm-value-at-date account date include-children?)
-  (gnc:account-get-comm-value-interval account #f date include-children?))
+  (caar (gnc:accounts-get-comm-balances-at-dates
+         (list account) (list date) include-children? #t)))
 
 ;; Adds all accounts' balances, where the balances are determined with
 ;; the get-balance-fn. The reverse-balance-fn
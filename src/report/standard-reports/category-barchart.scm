@@ -355,11 +355,20 @@ developing over time"))
                   date-list-entry))))
           
           ;; Creates the <balance-list> to be used in the function
-          ;; below. 
+          ;; below. The balances at all the dates are fetched at once.
           (define (account->balance-list account subacct?)
-            (map 
-             (lambda (d) (get-balance account d subacct?))
-             dates-list))
+            (if do-intervals?
+                (map 
+                 (lambda (d) (get-balance account d subacct?))
+                 dates-list)
+                (map
+                 (lambda (collector date)
+                   ((if (reverse-balance? account)
+                        - +)
+                    (collector->double collector date)))
+                 (car (gnc:accounts-get-comm-balances-at-dates
+                       (list account) dates-list subacct? #f))
+                 dates-list)))
           
 	  (define (count-accounts current-depth accts)
 	    (if (< current-depth tree-depth)
@@ -212,24 +212,40 @@
     ;; settings. Uses the collector->double conversion function
     ;; above. Returns a list of doubles.
     (define (process-datelist accounts dates income?)
+      (if inc-exp?
+          (process-interval-list accounts dates income?)
+          (process-date-balances accounts dates)))
+
+    ;; For a balance chart, the balances of all the accounts at all
+    ;; the dates are fetched at once.
+    (define (process-date-balances accounts dates)
+      (apply map
+             (lambda (date . collectors)
+               (let ((total (gnc:make-commodity-collector)))
+                 (for-each
+                  (lambda (collector)
+                    (gnc-commodity-collector-merge total collector))
+                  collectors)
+                 (collector->double total date)))
+             dates
+             (gnc:accounts-get-comm-balances-at-dates
+              (filter (lambda (a) (not (gnc:account-is-inc-exp? a)))
+                      accounts)
+              dates #f #f)))
+
+    (define (process-interval-list accounts dates income?)
       (map 
        (lambda (date)
          (collector->double
-          ((if inc-exp?
-               (if income?
-                   gnc:accounts-get-comm-total-income
-                   gnc:accounts-get-comm-total-expense)
-               gnc:accounts-get-comm-total-assets)
+          ((if income?
+               gnc:accounts-get-comm-total-income
+               gnc:accounts-get-comm-total-expense)
            accounts 
            (lambda (account)
-             (if inc-exp?
-                 ;; for inc-exp, 'date' is a pair of time values, else
-                 ;; it is a time value.
-                 (gnc:account-get-comm-balance-interval 
-                  account (first date) (second date) #f)
-                 (gnc:account-get-comm-balance-at-date 
-                  account date #f))))
-          (if inc-exp? (second date) date)))
+             ;; for inc-exp, 'date' is a pair of time values.
+             (gnc:account-get-comm-balance-interval 
+              account (first date) (second date) #f)))
+          (second date)))
        dates))
 
     (gnc:report-percent-done 1)